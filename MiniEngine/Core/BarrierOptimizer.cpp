@@ -0,0 +1,592 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "BarrierOptimizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+//
+// BarrierTrace implementation
+//
+
+uint32_t BarrierTrace::GetResourceId( const void* Resource )
+{
+    auto Iter = m_ResourceIds.find(Resource);
+    if (Iter != m_ResourceIds.end())
+        return Iter->second;
+
+    uint32_t Id = m_NumResources++;
+    m_ResourceIds[Resource] = Id;
+    return Id;
+}
+
+void BarrierTrace::NoteResource( uint32_t Resource )
+{
+    if (Resource >= m_NumResources)
+        m_NumResources = Resource + 1;
+}
+
+void BarrierTrace::RecordTransition( uint32_t Resource, BarrierState Before, BarrierState After )
+{
+    NoteResource(Resource);
+    BarrierEvent Event = { BarrierEvent::kRequire, Resource, 0, Before, After };
+    m_Events.push_back(Event);
+}
+
+void BarrierTrace::RecordUAVBarrier( uint32_t Resource )
+{
+    NoteResource(Resource);
+    BarrierEvent Event = { BarrierEvent::kUAV, Resource, 0, 0, 0 };
+    m_Events.push_back(Event);
+}
+
+void BarrierTrace::RecordAliasBarrier( uint32_t Before, uint32_t After )
+{
+    NoteResource(Before);
+    NoteResource(After);
+    BarrierEvent Event = { BarrierEvent::kAlias, Before, After, 0, 0 };
+    m_Events.push_back(Event);
+}
+
+void BarrierTrace::RecordWork( void )
+{
+    BarrierEvent Event = { BarrierEvent::kWork, 0, 0, 0, 0 };
+    m_Events.push_back(Event);
+}
+
+void BarrierTrace::Clear( void )
+{
+    m_Events.clear();
+    m_ResourceIds.clear();
+    m_NumResources = 0;
+}
+
+void BarrierTrace::Write( ostream& Output ) const
+{
+    char Line[64];
+    for (const BarrierEvent& Event : m_Events)
+    {
+        switch (Event.EventType)
+        {
+        case BarrierEvent::kRequire:
+            snprintf(Line, sizeof(Line), "t %u %x %x\n", Event.Resource, Event.Before, Event.After);
+            break;
+        case BarrierEvent::kUAV:
+            snprintf(Line, sizeof(Line), "u %u\n", Event.Resource);
+            break;
+        case BarrierEvent::kAlias:
+            snprintf(Line, sizeof(Line), "a %u %u\n", Event.Resource, Event.OtherResource);
+            break;
+        case BarrierEvent::kWork:
+            snprintf(Line, sizeof(Line), "w\n");
+            break;
+        }
+        Output << Line;
+    }
+}
+
+bool BarrierTrace::Read( istream& Input )
+{
+    Clear();
+
+    string Line;
+    while (getline(Input, Line))
+    {
+        istringstream Tokens(Line);
+        string Op;
+        if (!(Tokens >> Op) || Op[0] == '#')
+            continue;
+
+        uint32_t Resource, Other;
+        BarrierState Before, After;
+
+        if (Op == "t")
+        {
+            if (!(Tokens >> Resource >> hex >> Before >> After))
+                return false;
+            RecordTransition(Resource, Before, After);
+        }
+        else if (Op == "u")
+        {
+            if (!(Tokens >> Resource))
+                return false;
+            RecordUAVBarrier(Resource);
+        }
+        else if (Op == "a")
+        {
+            if (!(Tokens >> Resource >> Other))
+                return false;
+            RecordAliasBarrier(Resource, Other);
+        }
+        else if (Op == "w")
+            RecordWork();
+        else
+            return false;
+    }
+    return true;
+}
+
+//
+// BarrierOptimizer implementation
+//
+
+namespace
+{
+    struct Request
+    {
+        uint32_t Pos;
+        BarrierState State;
+    };
+
+    struct ResourceRequests
+    {
+        bool Seen = false;
+        BarrierState Initial = kBarrierStateCommon;
+        vector<Request> Requires;       // At most one per position, in order
+        vector<uint32_t> UAVSyncs;      // Positions, in order and unique
+        vector<uint32_t> Aliases;       // Positions where the resource is aliased in or out
+    };
+
+    struct AliasRecord
+    {
+        uint32_t Pos;
+        uint32_t Before;
+        uint32_t After;
+    };
+
+    struct ParsedTrace
+    {
+        uint32_t NumWork = 0;
+        vector<ResourceRequests> Resources;
+        vector<AliasRecord> Aliases;
+
+        uint32_t NaiveBarriers = 0;
+        uint32_t NaiveBatches = 0;
+        uint32_t CollapsedRequests = 0;
+    };
+
+    void AddUAVSync( ResourceRequests& Res, uint32_t Pos )
+    {
+        if (Res.UAVSyncs.empty() || Res.UAVSyncs.back() != Pos)
+            Res.UAVSyncs.push_back(Pos);
+    }
+
+    // Groups a trace by work item.  Position i holds what was requested before work item i.
+    void ParseTrace( const BarrierTrace& Trace, ParsedTrace& Parsed )
+    {
+        Parsed.Resources.resize(Trace.GetNumResources());
+
+        uint32_t Pos = 0;
+        bool BatchHasBarriers = false;
+
+        for (const BarrierEvent& Event : Trace.GetEvents())
+        {
+            switch (Event.EventType)
+            {
+            case BarrierEvent::kRequire:
+            {
+                ResourceRequests& Res = Parsed.Resources[Event.Resource];
+                if (!Res.Seen)
+                {
+                    Res.Seen = true;
+                    Res.Initial = Event.Before;
+                }
+
+                // CommandContext turns a request for UNORDERED_ACCESS while already in it into a UAV barrier
+                if (Event.Before == Event.After)
+                {
+                    if (Event.After == kBarrierStateUnorderedAccess)
+                    {
+                        AddUAVSync(Res, Pos);
+                        ++Parsed.NaiveBarriers;
+                        BatchHasBarriers = true;
+                    }
+                }
+                else
+                {
+                    ++Parsed.NaiveBarriers;
+                    BatchHasBarriers = true;
+                }
+
+                if (!Res.Requires.empty() && Res.Requires.back().Pos == Pos)
+                {
+                    if (Res.Requires.back().State != Event.After)
+                        ++Parsed.CollapsedRequests;
+                    Res.Requires.back().State = Event.After;
+                }
+                else
+                {
+                    Request Req = { Pos, Event.After };
+                    Res.Requires.push_back(Req);
+                }
+                break;
+            }
+
+            case BarrierEvent::kUAV:
+            {
+                ResourceRequests& Res = Parsed.Resources[Event.Resource];
+                if (!Res.Seen)
+                {
+                    Res.Seen = true;
+                    Res.Initial = kBarrierStateUnorderedAccess;
+                }
+                AddUAVSync(Res, Pos);
+                ++Parsed.NaiveBarriers;
+                BatchHasBarriers = true;
+                break;
+            }
+
+            case BarrierEvent::kAlias:
+            {
+                AliasRecord Alias = { Pos, Event.Resource, Event.OtherResource };
+                Parsed.Aliases.push_back(Alias);
+                Parsed.Resources[Event.Resource].Aliases.push_back(Pos);
+                Parsed.Resources[Event.OtherResource].Aliases.push_back(Pos);
+                ++Parsed.NaiveBarriers;
+                BatchHasBarriers = true;
+                break;
+            }
+
+            case BarrierEvent::kWork:
+                if (BatchHasBarriers)
+                    ++Parsed.NaiveBatches;
+                BatchHasBarriers = false;
+                ++Pos;
+                break;
+            }
+        }
+
+        if (BatchHasBarriers)
+            ++Parsed.NaiveBatches;
+
+        Parsed.NumWork = Pos;
+    }
+
+    // Barriers within a batch are recorded in this order
+    enum BarrierOrder
+    {
+        kOrderAlias,
+        kOrderUAV,
+        kOrderEndSplit,
+        kOrderTransition,
+        kOrderBeginSplit
+    };
+
+    struct PlacedBarrier
+    {
+        uint32_t Pos;
+        BarrierOrder Order;
+        uint32_t Sequence;
+        OptimizedBarrier Barrier;
+
+        bool operator< ( const PlacedBarrier& Rhs ) const
+        {
+            if (Pos != Rhs.Pos)
+                return Pos < Rhs.Pos;
+            if (Order != Rhs.Order)
+                return Order < Rhs.Order;
+            return Sequence < Rhs.Sequence;
+        }
+    };
+
+    void PlaceBarrier( vector<PlacedBarrier>& Placed, uint32_t Pos, BarrierOrder Order, OptimizedBarrier::Type Type,
+        uint32_t Resource, BarrierState Before, BarrierState After, uint32_t Other = 0 )
+    {
+        PlacedBarrier NewBarrier;
+        NewBarrier.Pos = Pos;
+        NewBarrier.Order = Order;
+        NewBarrier.Sequence = (uint32_t)Placed.size();
+        NewBarrier.Barrier.BarrierType = Type;
+        NewBarrier.Barrier.Resource = Resource;
+        NewBarrier.Barrier.OtherResource = Other;
+        NewBarrier.Barrier.Before = Before;
+        NewBarrier.Barrier.After = After;
+        Placed.push_back(NewBarrier);
+    }
+
+    // Replaces each maximal run of read-only requests with the union of their states.  Returns the
+    // number of state changes that no longer need a barrier.
+    uint32_t CombineReadRuns( vector<Request>& Requires, BarrierState AllowedStates )
+    {
+        uint32_t Avoided = 0;
+
+        for (size_t First = 0; First < Requires.size(); )
+        {
+            if (!BarrierOptimizer::IsReadOnlyState(Requires[First].State))
+            {
+                ++First;
+                continue;
+            }
+
+            BarrierState Union = Requires[First].State;
+            size_t Last = First;
+            while (Last + 1 < Requires.size() && BarrierOptimizer::IsReadOnlyState(Requires[Last + 1].State) &&
+                ((Union | Requires[Last + 1].State) & ~AllowedStates) == 0)
+            {
+                ++Last;
+                if (Requires[Last].State != Requires[Last - 1].State)
+                    ++Avoided;
+                Union |= Requires[Last].State;
+            }
+
+            for (size_t i = First; i <= Last; ++i)
+                Requires[i].State = Union;
+
+            First = Last + 1;
+        }
+
+        return Avoided;
+    }
+}
+
+BarrierSchedule BarrierOptimizer::Optimize( const BarrierTrace& Trace, const BarrierOptimizerOptions& Options,
+    BarrierOptimizerStats* Stats )
+{
+    ParsedTrace Parsed;
+    ParseTrace(Trace, Parsed);
+
+    const bool CanSplit = Options.ExplicitAccesses && Options.UseSplitBarriers;
+
+    BarrierSchedule Schedule;
+    Schedule.Batches.resize(Parsed.NumWork + 1);
+    Schedule.FinalStates.resize(Parsed.Resources.size(), kBarrierStateCommon);
+
+    uint32_t CombinedReads = 0;
+    uint32_t SplitTransitions = 0;
+    uint32_t DroppedUAVBarriers = 0;
+
+    vector<PlacedBarrier> Placed;
+
+    for (const AliasRecord& Alias : Parsed.Aliases)
+        PlaceBarrier(Placed, Alias.Pos, kOrderAlias, OptimizedBarrier::kAlias, Alias.Before, 0, 0, Alias.After);
+
+    for (uint32_t ResourceId = 0; ResourceId < (uint32_t)Parsed.Resources.size(); ++ResourceId)
+    {
+        ResourceRequests& Res = Parsed.Resources[ResourceId];
+        if (!Res.Seen)
+            continue;
+
+        if (Options.CombineReads)
+            CombinedReads += CombineReadRuns(Res.Requires, Options.AllowedStates);
+
+        BarrierState CurrentState = Res.Initial;
+        int LastUse = -1;                   // Last work item that used CurrentState
+        int LastTouch = -1;                 // Last batch with a UAV or aliasing barrier for this resource
+        bool WrittenSinceSync = (Res.Initial & kBarrierStateUnorderedAccess) != 0;   // Possibly by an earlier command list
+
+        size_t NextRequire = 0;
+        size_t NextSync = 0;
+        size_t NextAlias = 0;
+
+        while (NextRequire < Res.Requires.size() || NextSync < Res.UAVSyncs.size())
+        {
+            const uint32_t RequirePos = NextRequire < Res.Requires.size() ? Res.Requires[NextRequire].Pos : ~0u;
+            const uint32_t SyncPos = NextSync < Res.UAVSyncs.size() ? Res.UAVSyncs[NextSync] : ~0u;
+
+            // Aliasing barriers fence off everything before them
+            while (NextAlias < Res.Aliases.size() && Res.Aliases[NextAlias] <= min(RequirePos, SyncPos))
+                LastTouch = max(LastTouch, (int)Res.Aliases[NextAlias++]);
+
+            if (SyncPos <= RequirePos)
+            {
+                // A transition in the same batch already waits for outstanding writes
+                const bool CoveredByTransition = RequirePos == SyncPos && Res.Requires[NextRequire].State != CurrentState;
+                const bool NothingToWaitFor = Options.ExplicitAccesses && !WrittenSinceSync;
+
+                if (CoveredByTransition || NothingToWaitFor)
+                    ++DroppedUAVBarriers;
+                else
+                {
+                    PlaceBarrier(Placed, SyncPos, kOrderUAV, OptimizedBarrier::kUAV, ResourceId, CurrentState, CurrentState);
+                    WrittenSinceSync = false;
+                    LastTouch = (int)SyncPos;
+                }
+                ++NextSync;
+                continue;
+            }
+
+            const Request& Req = Res.Requires[NextRequire++];
+            if (Req.State != CurrentState)
+            {
+                int BeginPos = max(LastUse + 1, max(LastTouch, 0));
+                if (CanSplit && BeginPos < (int)Req.Pos)
+                {
+                    PlaceBarrier(Placed, BeginPos, kOrderBeginSplit, OptimizedBarrier::kBeginSplit, ResourceId, CurrentState, Req.State);
+                    PlaceBarrier(Placed, Req.Pos, kOrderEndSplit, OptimizedBarrier::kEndSplit, ResourceId, CurrentState, Req.State);
+                    ++SplitTransitions;
+                }
+                else
+                {
+                    PlaceBarrier(Placed, Req.Pos, kOrderTransition, OptimizedBarrier::kTransition, ResourceId, CurrentState, Req.State);
+                }
+                CurrentState = Req.State;
+                WrittenSinceSync = false;
+            }
+
+            LastUse = (int)Req.Pos;
+            if (Req.State & kBarrierStateUnorderedAccess)
+                WrittenSinceSync = true;
+        }
+
+        Schedule.FinalStates[ResourceId] = CurrentState;
+    }
+
+    sort(Placed.begin(), Placed.end());
+
+    uint32_t EmittedBatches = 0;
+    for (const PlacedBarrier& Barrier : Placed)
+    {
+        vector<OptimizedBarrier>& Batch = Schedule.Batches[Barrier.Pos];
+        if (Batch.empty())
+            ++EmittedBatches;
+        Batch.push_back(Barrier.Barrier);
+    }
+
+    if (Stats != nullptr)
+    {
+        Stats->NumWorkItems = Parsed.NumWork;
+        Stats->NaiveBarriers = Parsed.NaiveBarriers;
+        Stats->NaiveBatches = Parsed.NaiveBatches;
+        Stats->EmittedBarriers = (uint32_t)Placed.size();
+        Stats->EmittedBatches = EmittedBatches;
+        Stats->CollapsedRequests = Parsed.CollapsedRequests;
+        Stats->CombinedReads = CombinedReads;
+        Stats->SplitTransitions = SplitTransitions;
+        Stats->DroppedUAVBarriers = DroppedUAVBarriers;
+    }
+
+    return Schedule;
+}
+
+bool BarrierOptimizer::Validate( const BarrierTrace& Trace, const BarrierSchedule& Schedule, string* Error )
+{
+    ParsedTrace Parsed;
+    ParseTrace(Trace, Parsed);
+
+    char Message[160];
+    auto Fail = [&]( const char* Format, uint32_t Pos, uint32_t Resource ) -> bool
+    {
+        if (Error != nullptr)
+        {
+            snprintf(Message, sizeof(Message), Format, Resource, Pos);
+            *Error = Message;
+        }
+        return false;
+    };
+
+    if (Schedule.Batches.size() != Parsed.NumWork + 1)
+    {
+        if (Error != nullptr)
+            *Error = "Schedule does not have one batch per work item plus a final one";
+        return false;
+    }
+
+    // Requests by position
+    vector<vector<pair<uint32_t, BarrierState>>> Requires(Parsed.NumWork + 1);
+    vector<vector<uint32_t>> Syncs(Parsed.NumWork + 1);
+
+    const uint32_t NumResources = (uint32_t)Parsed.Resources.size();
+    for (uint32_t ResourceId = 0; ResourceId < NumResources; ++ResourceId)
+    {
+        for (const Request& Req : Parsed.Resources[ResourceId].Requires)
+            Requires[Req.Pos].push_back(make_pair(ResourceId, Req.State));
+        for (uint32_t Pos : Parsed.Resources[ResourceId].UAVSyncs)
+            Syncs[Pos].push_back(ResourceId);
+    }
+
+    vector<BarrierState> State(NumResources);
+    vector<bool> InSplit(NumResources, false);
+    vector<BarrierState> SplitTarget(NumResources, 0);
+    vector<bool> PendingWrite(NumResources, false);
+
+    for (uint32_t ResourceId = 0; ResourceId < NumResources; ++ResourceId)
+        State[ResourceId] = Parsed.Resources[ResourceId].Initial;
+
+    for (uint32_t Pos = 0; Pos <= Parsed.NumWork; ++Pos)
+    {
+        for (const OptimizedBarrier& Barrier : Schedule.Batches[Pos])
+        {
+            const uint32_t Res = Barrier.Resource;
+            if (Res >= NumResources || (Barrier.BarrierType == OptimizedBarrier::kAlias && Barrier.OtherResource >= NumResources))
+                return Fail("Barrier names unknown resource %u before work item %u", Pos, Res);
+
+            switch (Barrier.BarrierType)
+            {
+            case OptimizedBarrier::kTransition:
+            case OptimizedBarrier::kBeginSplit:
+                if (InSplit[Res])
+                    return Fail("Resource %u transitioned while a split barrier is in flight before work item %u", Pos, Res);
+                if (State[Res] != Barrier.Before)
+                    return Fail("Transition of resource %u starts from the wrong state before work item %u", Pos, Res);
+                if (Barrier.BarrierType == OptimizedBarrier::kTransition)
+                {
+                    State[Res] = Barrier.After;
+                    PendingWrite[Res] = false;
+                }
+                else
+                {
+                    InSplit[Res] = true;
+                    SplitTarget[Res] = Barrier.After;
+                }
+                break;
+
+            case OptimizedBarrier::kEndSplit:
+                if (!InSplit[Res] || SplitTarget[Res] != Barrier.After)
+                    return Fail("Split barrier for resource %u ends without a matching begin before work item %u", Pos, Res);
+                InSplit[Res] = false;
+                State[Res] = Barrier.After;
+                PendingWrite[Res] = false;
+                break;
+
+            case OptimizedBarrier::kUAV:
+                PendingWrite[Res] = false;
+                break;
+
+            case OptimizedBarrier::kAlias:
+                break;
+            }
+        }
+
+        for (uint32_t Res : Syncs[Pos])
+        {
+            if (PendingWrite[Res])
+                return Fail("Missing UAV barrier for resource %u before work item %u", Pos, Res);
+        }
+
+        for (const pair<uint32_t, BarrierState>& Req : Requires[Pos])
+        {
+            const uint32_t Res = Req.first;
+            const BarrierState Needed = Req.second;
+
+            if (InSplit[Res])
+                return Fail("Resource %u used by work item %u while a split barrier is in flight", Pos, Res);
+
+            bool Satisfied = Needed == kBarrierStateCommon ? State[Res] == kBarrierStateCommon : (State[Res] & Needed) == Needed;
+            if (!Satisfied)
+                return Fail("Resource %u is in the wrong state for work item %u", Pos, Res);
+
+            if (Needed & kBarrierStateUnorderedAccess)
+                PendingWrite[Res] = true;
+        }
+    }
+
+    for (uint32_t ResourceId = 0; ResourceId < NumResources; ++ResourceId)
+    {
+        if (InSplit[ResourceId])
+            return Fail("Split barrier for resource %u is still in flight after work item %u", Parsed.NumWork, ResourceId);
+    }
+
+    return true;
+}
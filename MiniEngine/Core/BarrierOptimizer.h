@@ -0,0 +1,178 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Whole-stream resource barrier planning, with no knowledge of D3D.  A BarrierTrace
+// records the state each resource must be in at each point in a command stream, as requested through
+// CommandContext::TransitionResource() and friends.  BarrierOptimizer then works out the fewest
+// barriers that satisfy it:
+//
+//   - Requests made with no work between them collapse to the last one, so A->B->C becomes A->C and
+//     A->B->A disappears.
+//   - Consecutive read-only uses combine into one state, e.g. PIXEL_SHADER_RESOURCE followed by
+//     NON_PIXEL_SHADER_RESOURCE becomes a single transition to both.
+//   - UAV barriers are dropped where a transition already synchronizes the resource, or, when
+//     accesses are explicit, where nothing has written to it since the last barrier.
+//   - When accesses are explicit, a transition that follows some idle work is split.  It begins right
+//     after the last use of the old state and ends right before the first use of the new one.
+//
+// Splitting is only sound if every work item lists every resource it touches.  CommandContext can't
+// know that, since draws reach resources through descriptors, so its captures treat a resource as in use
+// from one request until the next.  A pass-level scheduler that declares its reads and writes can set
+// BarrierOptimizerOptions::ExplicitAccesses.
+//
+// States are D3D12_RESOURCE_STATES values kept as plain integers.  Optimize() and Validate() together
+// form a CPU simulator for replaying recorded traces.
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t BarrierState;
+
+// Mirrors of the D3D12_RESOURCE_STATES bits that the optimizer has to reason about
+static const BarrierState kBarrierStateCommon = 0;
+static const BarrierState kBarrierStateUnorderedAccess = 0x8;
+static const BarrierState kBarrierStateReadOnly =
+    0x1 |       // VERTEX_AND_CONSTANT_BUFFER
+    0x2 |       // INDEX_BUFFER
+    0x20 |      // DEPTH_READ
+    0x40 |      // NON_PIXEL_SHADER_RESOURCE
+    0x80 |      // PIXEL_SHADER_RESOURCE
+    0x200 |     // INDIRECT_ARGUMENT
+    0x800 |     // COPY_SOURCE
+    0x2000;     // RESOLVE_SOURCE
+
+struct BarrierEvent
+{
+    enum Type
+    {
+        kRequire,   // Resource must be in After for the next work item
+        kUAV,       // Writes to Resource must complete before the next work item
+        kAlias,     // Resource gives way to OtherResource in the same memory
+        kWork       // A draw, dispatch, copy or anything else that executes on the GPU
+    };
+
+    Type EventType;
+    uint32_t Resource;
+    uint32_t OtherResource;     // kAlias only
+    BarrierState Before;        // kRequire only.  The state the resource was tracked in at the time.
+    BarrierState After;
+};
+
+class BarrierTrace
+{
+public:
+
+    BarrierTrace() {}
+
+    // Resource ids are dense and assigned in order of first use
+    uint32_t GetResourceId( const void* Resource );
+    uint32_t GetNumResources( void ) const { return m_NumResources; }
+
+    void RecordTransition( uint32_t Resource, BarrierState Before, BarrierState After );
+    void RecordUAVBarrier( uint32_t Resource );
+    void RecordAliasBarrier( uint32_t Before, uint32_t After );
+    void RecordWork( void );
+
+    void Clear( void );
+
+    const std::vector<BarrierEvent>& GetEvents( void ) const { return m_Events; }
+
+    // Text format, one event per line:  "t <id> <before> <after>" with states in hex, "u <id>",
+    // "a <before id> <after id>", or "w".  Blank lines and lines starting with '#' are ignored.
+    void Write( std::ostream& Output ) const;
+    bool Read( std::istream& Input );
+
+private:
+
+    void NoteResource( uint32_t Resource );
+
+    std::vector<BarrierEvent> m_Events;
+    std::unordered_map<const void*, uint32_t> m_ResourceIds;
+    uint32_t m_NumResources = 0;
+};
+
+struct OptimizedBarrier
+{
+    enum Type
+    {
+        kTransition,
+        kBeginSplit,
+        kEndSplit,
+        kUAV,
+        kAlias
+    };
+
+    Type BarrierType;
+    uint32_t Resource;
+    uint32_t OtherResource;     // kAlias only
+    BarrierState Before;
+    BarrierState After;
+};
+
+struct BarrierSchedule
+{
+    // Batches[i] is recorded before work item i.  The final batch follows the last work item.
+    std::vector<std::vector<OptimizedBarrier>> Batches;
+
+    // The state of each resource at the end of the stream, by resource id
+    std::vector<BarrierState> FinalStates;
+};
+
+struct BarrierOptimizerOptions
+{
+    // True when every work item requests every resource it touches.  Enables split barriers and
+    // dropping UAV barriers with no write to wait for.
+    bool ExplicitAccesses = false;
+    bool CombineReads = true;
+    bool UseSplitBarriers = true;
+
+    // Combined read states must stay within this mask, e.g. VALID_COMPUTE_QUEUE_RESOURCE_STATES
+    BarrierState AllowedStates = ~0u;
+};
+
+struct BarrierOptimizerStats
+{
+    uint32_t NumWorkItems;
+
+    // What CommandContext emits for the same requests without optimization
+    uint32_t NaiveBarriers;
+    uint32_t NaiveBatches;
+
+    uint32_t EmittedBarriers;   // Each half of a split barrier counts once
+    uint32_t EmittedBatches;
+
+    uint32_t CollapsedRequests;     // Superseded before any work used them
+    uint32_t CombinedReads;         // Transitions avoided by combining read states
+    uint32_t SplitTransitions;
+    uint32_t DroppedUAVBarriers;
+};
+
+class BarrierOptimizer
+{
+public:
+
+    static BarrierSchedule Optimize( const BarrierTrace& Trace, const BarrierOptimizerOptions& Options,
+        BarrierOptimizerStats* Stats = nullptr );
+
+    // Replays the schedule and checks that every work item sees its resources in the requested states,
+    // with no transition in flight.  On failure, describes the first problem in Error.
+    static bool Validate( const BarrierTrace& Trace, const BarrierSchedule& Schedule, std::string* Error = nullptr );
+
+    static bool IsReadOnlyState( BarrierState State )
+    {
+        return State != kBarrierStateCommon && (State & ~kBarrierStateReadOnly) == 0;
+    }
+};
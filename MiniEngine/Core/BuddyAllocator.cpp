@@ -61,6 +61,7 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
     , m_maxBlockSize(maxBlockSize)
     , m_minBlockSize(MinBlockSize)
     , m_pBackingHeap(nullptr)
+    , m_defragTargetOrder(-1)
 #if defined(PROFILE) || defined(_DEBUG)
     , m_SpaceUsed(0)
     , m_InternalFragmentation(0)
@@ -70,6 +71,7 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
     ASSERT(Math::IsPowerOfTwo(maxBlockSize / m_minBlockSize));
 
     m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
+    ASSERT(m_maxOrder <= BuddyAllocatorCore::kMaxSupportedOrder, "Too many units; raise the minimum block size");
 
     Reset();
 }
@@ -103,68 +105,22 @@ void BuddyAllocator::Destroy()
     else
     {
         m_BackingResource.Destroy();
+        m_defragScratch.Destroy();
     }
 }
 
 size_t BuddyAllocator::AllocateBlock(UINT order)
 {
-    size_t offset;
+    size_t offset = m_freeBlocks.Allocate(order);
 
-    if (order > m_maxOrder)
+    if (offset == BuddyAllocatorCore::kInvalidOffset)
     {
-        throw(std::bad_alloc()); // Can't allocate a block that large  
-    }
-
-    auto it = m_freeBlocks[order].begin();
-
-    if (it == m_freeBlocks[order].end())
-    {
-        // No free nodes in the requested pool.  Try to find a higher-order block and split it.  
-        size_t left = AllocateBlock(order + 1);
-
-        size_t size = OrderToUnitSize(order);
-
-        size_t right = left + size;
-
-        m_freeBlocks[order].insert(right); // Add the right block to the free pool  
-
-        offset = left; // Return the left block  
-    }
-
-    else
-    {
-        offset = *it;
-
-        // Remove the block from the free list  
-        m_freeBlocks[order].erase(it);
+        throw(std::bad_alloc()); // No free block of this order or larger
     }
 
     return offset;
 }
 
-void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
-{
-    // See if the buddy block is free  
-    size_t size = OrderToUnitSize(order);
-
-    size_t buddy = GetBuddyOffset(offset, size);
-
-    auto it = m_freeBlocks[order].find(buddy);
-
-    if (it != m_freeBlocks[order].end())
-    {
-        // Deallocate merged blocks  
-        DeallocateBlock(min(offset, buddy), order + 1);
-        // Remove the buddy from the free list  
-        m_freeBlocks[order].erase(it);
-    }
-    else
-    {
-        // Add the block to the free list  
-        m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
-    }
-}
-
 BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
 {
     size_t size = numElements * elementSize;
@@ -195,6 +151,7 @@ BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize,
             //      the case in which blocks from this allocator are used on multiple threads 
             //      (because it's really only 1 resource underneath)
             pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
+            m_defragmenter.TrackAllocation(offset, order, pBlock);
         }
 
         return pBlock;
@@ -203,18 +160,37 @@ BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize,
     catch (std::bad_alloc&)
     {
         // There are no blocks available for the requested size so  
-        // return the NULL block type  
+        // return the NULL block type.  Remember the size so Defragment() can make room for it.
+        RequestFreeBlock(size);
         return new BuddyBlock();
     }
 }
 
-/*
 void BuddyAllocator::Deallocate(BuddyBlock* pBlock)
 {
-    pBlock->m_fenceValue = g_CommandManager.GetNextFenceValue();
+    // A failed Allocate() returns an empty block that owns no space and was never tracked
+    if (pBlock->GetSize() == 0)
+    {
+        delete(pBlock);
+        return;
+    }
+
+    // A block that is on its way out is never worth moving
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kManualSubAllocationStrategy)
+        m_defragmenter.UntrackAllocation(SizeToUnitSize(pBlock->GetOffset() - m_baseOffset));
+
+    // Anything submitted so far may still reference the block, so it can't be reused until the
+    // next fence signals.
+    DeferDeallocation(pBlock, g_CommandManager.GetGraphicsQueue().GetNextFenceValue());
+}
+
+void BuddyAllocator::DeferDeallocation(BuddyBlock* pBlock, uint64_t fenceValue)
+{
+    pBlock->m_fenceValue = fenceValue;
+
+    lock_guard<mutex> LockGuard(m_deferredDeletionMutex);
     m_deferredDeletionQueue.push(pBlock);
 }
-*/
 
 void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 {
@@ -226,33 +202,24 @@ void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 
     UINT order = UnitSizeToOrder(size);
 
-    try
-    {
-        DeallocateBlock(offset, order); // throw(std::bad_alloc)
+    m_freeBlocks.Free(offset, order);
 
-        DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
-        DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
-        
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            // Release the resource
-            pBlock->Destroy();
-        }
-        delete(pBlock);
-    }
+    DECREASE_BUDDY_COUNTER(m_SpaceUsed, pBlock->GetSize());
+    DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (pBlock->GetSize() - pBlock->m_unpaddedSize));
 
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate failed trying to add the free block to the pool  
-        // resulting in a leak.  Unfortunately there is not much we can do.  
-        // Fortunately this is expected to be extremely rare as the storage  
-        // needed for each deallocate is very small.  
+        // Release the resource
+        pBlock->Destroy();
     }
+    delete(pBlock);
 };
 
-/*
 void BuddyAllocator::CleanUpAllocations()
 {
+    lock_guard<mutex> LockGuard(m_deferredDeletionMutex);
+
+    // Fence values only increase, so the queue is retired in order
     while (m_deferredDeletionQueue.empty() == false &&
         g_CommandManager.IsFenceComplete(m_deferredDeletionQueue.front()->m_fenceValue))
     {
@@ -261,4 +228,132 @@ void BuddyAllocator::CleanUpAllocations()
 
         DeallocateInternal(pBlock);
     }
-}*/
+}
+
+void BuddyAllocator::RequestFreeBlock(size_t size)
+{
+    int order = (int)UnitSizeToOrder(SizeToUnitSize(size));
+    int current = m_defragTargetOrder;
+    while (order > current && !m_defragTargetOrder.compare_exchange_weak(current, order))
+        ;
+}
+
+size_t BuddyAllocator::Defragment(size_t maxBytesToMove)
+{
+    if (m_allocationStrategy != kBuddyAllocationStrategy::kManualSubAllocationStrategy)
+        return 0;
+
+    int targetOrder = m_defragTargetOrder;
+    if (targetOrder < 0)
+        return 0;
+
+    vector<BuddyRelocation> moves;
+    if (m_defragmenter.PlanStep(m_freeBlocks, (uint32_t)targetOrder, maxBytesToMove / m_minBlockSize, moves))
+        m_defragTargetOrder.compare_exchange_strong(targetOrder, -1);
+
+    if (moves.empty())
+        return 0;
+
+    // A resource can't be a copy source and a copy destination at the same time, so every block
+    // goes out to a scratch buffer and back.  Moves larger than the scratch buffer are split up.
+    if (m_defragScratch.GetResource() == nullptr)
+    {
+        size_t scratchSize = Math::AlignUp(max(maxBytesToMove, m_minBlockSize), 256);
+        m_defragScratch.Create(L"Buddy Allocator Defragment Scratch", uint32_t(scratchSize), 1, nullptr);
+    }
+    const size_t scratchSize = m_defragScratch.GetBufferSize();
+
+    struct CopyRange
+    {
+        size_t src;
+        size_t dst;
+        size_t bytes;
+    };
+
+    vector<CopyRange> copies;
+    for (const BuddyRelocation& move : moves)
+    {
+        size_t src = m_baseOffset + move.SrcOffset * m_minBlockSize;
+        size_t dst = m_baseOffset + move.DstOffset * m_minBlockSize;
+        size_t bytes = OrderToUnitSize(move.Order) * m_minBlockSize;
+
+        for (size_t done = 0; done < bytes; done += scratchSize)
+        {
+            CopyRange range = { src + done, dst + done, min(scratchSize, bytes - done) };
+            copies.push_back(range);
+        }
+    }
+
+    CommandContext& context = CommandContext::Begin(L"Buddy Allocator Defragment");
+
+    // Both buffers swap roles twice per batch, so every copy is preceded by explicit transitions of its
+    // source and destination.  Leaning on implicit promotion from COMMON would leave the tracked
+    // states out of step with the real ones after the first batch.
+    const D3D12_RESOURCE_STATES backingState = m_BackingResource.GetUsageState();
+
+    for (size_t first = 0; first < copies.size(); )
+    {
+        size_t last = first;
+        size_t scratchUsed = 0;
+        while (last < copies.size() && scratchUsed + copies[last].bytes <= scratchSize)
+            scratchUsed += copies[last++].bytes;
+
+        context.TransitionResource(m_BackingResource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        context.TransitionResource(m_defragScratch, D3D12_RESOURCE_STATE_COPY_DEST, true);
+        scratchUsed = 0;
+        for (size_t i = first; i < last; ++i)
+        {
+            context.CopyBufferRegion(m_defragScratch, scratchUsed, m_BackingResource, copies[i].src, copies[i].bytes);
+            scratchUsed += copies[i].bytes;
+        }
+
+        context.TransitionResource(m_defragScratch, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        context.TransitionResource(m_BackingResource, D3D12_RESOURCE_STATE_COPY_DEST, true);
+        scratchUsed = 0;
+        for (size_t i = first; i < last; ++i)
+        {
+            context.CopyBufferRegion(m_BackingResource, copies[i].dst, m_defragScratch, scratchUsed, copies[i].bytes);
+            scratchUsed += copies[i].bytes;
+        }
+
+        first = last;
+    }
+
+    // Buffers decay to COMMON when the command list completes, so return the scratch buffer there
+    // explicitly to keep its tracked state right for the next call
+    context.TransitionResource(m_defragScratch, D3D12_RESOURCE_STATE_COMMON);
+    context.TransitionResource(m_BackingResource, backingState, true);
+    uint64_t fenceValue = context.Finish();
+
+    // Patch the handles and release the old ranges once the copy (and anything already in flight
+    // that reads them) has finished
+    for (const BuddyRelocation& move : moves)
+    {
+        BuddyBlock* pBlock = (BuddyBlock*)move.Handle;
+        uint32_t size = uint32_t(OrderToUnitSize(move.Order) * m_minBlockSize);
+
+        BuddyBlock* pOldRange = new BuddyBlock(uint32_t(pBlock->m_offset), size, size);
+        pBlock->m_offset = m_baseOffset + move.DstOffset * m_minBlockSize;
+
+        INCREASE_BUDDY_COUNTER(m_SpaceUsed, size);
+        DeferDeallocation(pOldRange, fenceValue);
+    }
+
+    return moves.size();
+}
+
+BuddyAllocatorStats BuddyAllocator::GetStats() const
+{
+    BuddyAllocatorStats Stats = m_freeBlocks.GetStats();
+    Stats.TotalUnits *= m_minBlockSize;
+    Stats.UsedUnits *= m_minBlockSize;
+    Stats.HighWaterUnits *= m_minBlockSize;
+    Stats.LargestFreeUnits *= m_minBlockSize;
+    return Stats;
+}
+
+size_t BuddyAllocator::GetPendingDeallocations() const
+{
+    lock_guard<mutex> LockGuard(m_deferredDeletionMutex);
+    return m_deferredDeletionQueue.size();
+}
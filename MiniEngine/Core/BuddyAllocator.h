@@ -16,22 +16,26 @@
 // When a block is de-allocated an attempt is made to merge it with it's 
 // neighbour (buddy) if it is contiguous and free.
 // Based on reference implementation by Bill Kristiansen
+//
+// The free lists are per-order bitmaps in BuddyAllocatorCore, so allocation and deallocation
+// never touch the heap and are safe to call from multiple threads.  Deallocated blocks are held
+// until the GPU has passed the fence that was pending when they were released.
 //  
 
 #pragma once
 
 #include "GpuBuffer.h"
-#include <vector>
+#include "BuddyDefragmenter.h"
+#include <atomic>
 #include <queue>
 #include <mutex>
-#include <set>
 
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
 
 #if defined(PROFILE) || defined(_DEBUG)
-#define INCREASE_BUDDY_COUNTER(A, B) (A = A + B);
-#define DECREASE_BUDDY_COUNTER(A, B) (A = A - B);
+#define INCREASE_BUDDY_COUNTER(A, B) (A += B);
+#define DECREASE_BUDDY_COUNTER(A, B) (A -= B);
 #else
 #define INCREASE_BUDDY_COUNTER(A, B)
 #define DECREASE_BUDDY_COUNTER(A, B)
@@ -87,6 +91,7 @@ public:
 
     BuddyBlock* Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData = nullptr);
 
+    // Queues the block for release once the GPU is finished with it.  See CleanUpAllocations().
     void Deallocate(BuddyBlock* pBlock);
 
     inline bool IsOwner(const BuddyBlock &block)
@@ -96,24 +101,43 @@ public:
 
     inline void Reset()
     {
-        // Clear the free blocks collection  
-        m_freeBlocks.clear();
-
         // Initialize the pool with a free inner block of max inner block size  
-        m_freeBlocks.resize(m_maxOrder + 1);
-        m_freeBlocks[m_maxOrder].insert((size_t)0);
+        m_freeBlocks.Reset(m_maxOrder);
+        m_defragmenter.Reset();
+        m_defragTargetOrder = -1;
     }
 
+    // Returns deallocated blocks whose fence has completed to the free pool
     void CleanUpAllocations();
 
+    // Only for kManualSubAllocationStrategy.  Moves at most maxBytesToMove of live blocks (or one
+    // larger block) towards making room for the largest allocation that has failed, and returns the
+    // number of blocks moved.  A moved block has its offset patched in place, so any views built from
+    // it must be recreated from GetOffset().  Call once per frame, at a point where no other thread
+    // is recording commands that use this allocator's blocks.
+    size_t Defragment(size_t maxBytesToMove);
+
+    // Makes Defragment() work towards a free block of at least this size without waiting for an
+    // allocation to fail first
+    void RequestFreeBlock(size_t size);
+
+    // Sizes are in bytes rather than units of the minimum block size
+    BuddyAllocatorStats GetStats() const;
+    size_t GetPendingDeallocations() const;
+
 private:
     ID3D12Heap* m_pBackingHeap;
     ByteAddressBuffer m_BackingResource;
 
     const D3D12_HEAP_TYPE m_heapType;
 
+    mutable std::mutex m_deferredDeletionMutex;
     std::queue<BuddyBlock*> m_deferredDeletionQueue;
-    std::vector<std::set<size_t>> m_freeBlocks;
+    BuddyAllocatorCore m_freeBlocks;
+
+    BuddyDefragmenter m_defragmenter;
+    std::atomic<int> m_defragTargetOrder;   // -1 when no allocation is waiting on a defragment
+    ByteAddressBuffer m_defragScratch;
     UINT m_maxOrder;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
@@ -128,22 +152,17 @@ private:
 
     inline UINT UnitSizeToOrder(size_t size) const
     {
-        return Math::Log2(size); // Log2 rounds up fractions to next whole value
-    }
-
-    inline size_t GetBuddyOffset(const size_t &offset, const size_t &size)
-    {
-        return offset ^ size;
+        return BuddyAllocatorCore::UnitsToOrder(size);
     }
 
     void DeallocateInternal(BuddyBlock* pBlock);
+    void DeferDeallocation(BuddyBlock* pBlock, uint64_t fenceValue);
 
     size_t OrderToUnitSize(UINT order) const { return ((size_t)1) << order; }
     size_t AllocateBlock(UINT order);
-    void DeallocateBlock(size_t offset, UINT order);
 
 #if defined(PROFILE) || defined(_DEBUG)
-    size_t m_SpaceUsed;
-    size_t m_InternalFragmentation;
+    std::atomic<size_t> m_SpaceUsed;
+    std::atomic<size_t> m_InternalFragmentation;
 #endif
 };
@@ -0,0 +1,267 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "BuddyAllocatorCore.h"
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+uint32_t BuddyAllocatorCore::CountTrailingZeros( uint64_t Value )
+{
+    assert(Value != 0);
+#ifdef _MSC_VER
+    unsigned long Index;
+    _BitScanForward64(&Index, Value);
+    return Index;
+#else
+    return (uint32_t)__builtin_ctzll(Value);
+#endif
+}
+
+uint32_t BuddyAllocatorCore::CountLeadingZeros( uint64_t Value )
+{
+    assert(Value != 0);
+#ifdef _MSC_VER
+    unsigned long Index;
+    _BitScanReverse64(&Index, Value);
+    return 63 - Index;
+#else
+    return (uint32_t)__builtin_clzll(Value);
+#endif
+}
+
+uint32_t BuddyAllocatorCore::CountBits( uint64_t Value )
+{
+#ifdef _MSC_VER
+    return (uint32_t)__popcnt64(Value);
+#else
+    return (uint32_t)__builtin_popcountll(Value);
+#endif
+}
+
+void BuddyAllocatorCore::BitTree::Init( size_t NumBits )
+{
+    Levels.clear();
+    NumSet = 0;
+
+    // Keep adding summary levels until one word covers everything
+    do
+    {
+        size_t NumWords = (NumBits + 63) / 64;
+        Levels.emplace_back(NumWords, 0);
+        NumBits = NumWords;
+    }
+    while (NumBits > 1);
+}
+
+void BuddyAllocatorCore::BitTree::Set( size_t Index )
+{
+    ++NumSet;
+    for (auto& Level : Levels)
+    {
+        uint64_t& Word = Level[Index >> 6];
+        bool WasEmpty = Word == 0;
+        Word |= (uint64_t)1 << (Index & 63);
+        if (!WasEmpty)
+            break;
+        Index >>= 6;
+    }
+}
+
+void BuddyAllocatorCore::BitTree::Clear( size_t Index )
+{
+    --NumSet;
+    for (auto& Level : Levels)
+    {
+        uint64_t& Word = Level[Index >> 6];
+        Word &= ~((uint64_t)1 << (Index & 63));
+        if (Word != 0)
+            break;
+        Index >>= 6;
+    }
+}
+
+size_t BuddyAllocatorCore::BitTree::FindFirst( void ) const
+{
+    if (NumSet == 0)
+        return kInvalidOffset;
+
+    size_t Index = 0;
+    for (size_t Level = Levels.size(); Level-- > 0; )
+        Index = (Index << 6) + CountTrailingZeros(Levels[Level][Index]);
+    return Index;
+}
+
+BuddyAllocatorCore::BuddyAllocatorCore( uint32_t MaxOrder )
+{
+    Reset(MaxOrder);
+}
+
+void BuddyAllocatorCore::Reset( uint32_t MaxOrder )
+{
+    assert(MaxOrder <= kMaxSupportedOrder);
+    if (MaxOrder > kMaxSupportedOrder)
+        MaxOrder = kMaxSupportedOrder;
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    m_MaxOrder = MaxOrder;
+    m_FreeBits.resize(MaxOrder + 1);
+    for (uint32_t Order = 0; Order <= MaxOrder; ++Order)
+        m_FreeBits[Order].Init((size_t)1 << (MaxOrder - Order));
+
+    m_NonEmptyOrders = 0;
+    m_UsedUnits = 0;
+    m_HighWaterUnits = 0;
+    m_NumAllocations = 0;
+
+    // The whole range starts out as a single free block of the highest order
+    MarkFree(0, MaxOrder);
+}
+
+void BuddyAllocatorCore::MarkFree( size_t Index, uint32_t Order )
+{
+    m_FreeBits[Order].Set(Index);
+    m_NonEmptyOrders |= (uint64_t)1 << Order;
+}
+
+void BuddyAllocatorCore::MarkUsed( size_t Index, uint32_t Order )
+{
+    m_FreeBits[Order].Clear(Index);
+    if (m_FreeBits[Order].NumSet == 0)
+        m_NonEmptyOrders &= ~((uint64_t)1 << Order);
+}
+
+size_t BuddyAllocatorCore::Allocate( uint32_t Order )
+{
+    if (Order > m_MaxOrder)
+        return kInvalidOffset;
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    // Smallest order at or above the request that has a free block
+    uint64_t Candidates = m_NonEmptyOrders >> Order;
+    if (Candidates == 0)
+        return kInvalidOffset;
+
+    uint32_t FoundOrder = Order + CountTrailingZeros(Candidates);
+    size_t Index = m_FreeBits[FoundOrder].FindFirst();
+    MarkUsed(Index, FoundOrder);
+
+    // Split down to the requested size, freeing the right half at each step
+    while (FoundOrder > Order)
+    {
+        --FoundOrder;
+        Index <<= 1;
+        MarkFree(Index + 1, FoundOrder);
+    }
+
+    m_UsedUnits += (size_t)1 << Order;
+    if (m_UsedUnits > m_HighWaterUnits)
+        m_HighWaterUnits = m_UsedUnits;
+    ++m_NumAllocations;
+
+    return Index << Order;
+}
+
+void BuddyAllocatorCore::Free( size_t Offset, uint32_t Order )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    assert(Order <= m_MaxOrder && (Offset & (((size_t)1 << Order) - 1)) == 0);
+
+    m_UsedUnits -= (size_t)1 << Order;
+    --m_NumAllocations;
+
+    // Merge with the buddy for as long as it is free
+    size_t Index = Offset >> Order;
+    while (Order < m_MaxOrder && m_FreeBits[Order].Test(Index ^ 1))
+    {
+        MarkUsed(Index ^ 1, Order);
+        Index >>= 1;
+        ++Order;
+    }
+
+    MarkFree(Index, Order);
+}
+
+bool BuddyAllocatorCore::IsAllocated( size_t Offset, uint32_t Order ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    for (uint32_t Level = Order; Level <= m_MaxOrder; ++Level)
+    {
+        if (m_FreeBits[Level].Test(Offset >> Level))
+            return false;
+    }
+    return true;
+}
+
+size_t BuddyAllocatorCore::CountFreeUnits( size_t Offset, uint32_t Order ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    assert(Order <= m_MaxOrder && (Offset & (((size_t)1 << Order) - 1)) == 0);
+
+    // Entirely inside a larger free block?
+    for (uint32_t Level = Order; Level <= m_MaxOrder; ++Level)
+    {
+        if (m_FreeBits[Level].Test(Offset >> Level))
+            return (size_t)1 << Order;
+    }
+
+    // Otherwise sum the free blocks of each smaller order that fall inside the range
+    size_t FreeUnits = 0;
+    for (uint32_t Level = 0; Level < Order; ++Level)
+    {
+        const std::vector<uint64_t>& Bits = m_FreeBits[Level].Levels[0];
+        size_t First = Offset >> Level;
+        size_t Last = First + ((size_t)1 << (Order - Level));
+
+        size_t NumBlocks = 0;
+        for (size_t Index = First; Index < Last; )
+        {
+            uint64_t Word = Bits[Index >> 6] >> (Index & 63);
+            size_t BitsInWord = 64 - (Index & 63);
+            if (Last - Index < BitsInWord)
+            {
+                BitsInWord = Last - Index;
+                Word &= ((uint64_t)1 << BitsInWord) - 1;
+            }
+            NumBlocks += CountBits(Word);
+            Index += BitsInWord;
+        }
+        FreeUnits += NumBlocks << Level;
+    }
+    return FreeUnits;
+}
+
+BuddyAllocatorStats BuddyAllocatorCore::GetStats( void ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    BuddyAllocatorStats Stats = {};
+    Stats.TotalUnits = (size_t)1 << m_MaxOrder;
+    Stats.UsedUnits = m_UsedUnits;
+    Stats.HighWaterUnits = m_HighWaterUnits;
+    Stats.NumAllocations = m_NumAllocations;
+    Stats.LargestFreeUnits = m_NonEmptyOrders == 0 ? 0 : (size_t)1 << (63 - CountLeadingZeros(m_NonEmptyOrders));
+
+    for (uint32_t Order = 0; Order <= m_MaxOrder; ++Order)
+        Stats.NumFreeBlocks += m_FreeBits[Order].NumSet;
+
+    return Stats;
+}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The bookkeeping half of BuddyAllocator, with no knowledge of D3D.  It hands out
+// power-of-two runs of abstract "units" from a range of 2^MaxOrder units.
+//
+// Free blocks of each order are tracked in a bit tree: the bottom level has one bit per block, and
+// each level above has one bit per 64-bit word below it that is non-zero.  Finding a free block is a
+// tzcnt per level (at most four levels for 2^24 blocks), and a further 64-bit mask of non-empty
+// orders finds the smallest order that can satisfy a request with a single tzcnt.  Splitting and
+// merging buddies are individual bit operations rather than tree inserts and erases.
+//
+// All operations take a single short-lived lock, so one allocator can back buffers that are shared
+// across threads.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct BuddyAllocatorStats
+{
+    size_t TotalUnits;
+    size_t UsedUnits;
+    size_t HighWaterUnits;      // Peak of UsedUnits since creation or Reset()
+    size_t LargestFreeUnits;    // Size of the largest allocation that would succeed now
+    size_t NumAllocations;
+    size_t NumFreeBlocks;
+
+    // 0 when all free space is one contiguous block, approaching 1 as it is scattered into small
+    // pieces.  This is what makes large requests fail while plenty of space is free.
+    float GetExternalFragmentation() const
+    {
+        size_t FreeUnits = TotalUnits - UsedUnits;
+        return FreeUnits == 0 ? 0.0f : 1.0f - (float)LargestFreeUnits / (float)FreeUnits;
+    }
+};
+
+class BuddyAllocatorCore
+{
+public:
+
+    static const size_t kInvalidOffset = ~(size_t)0;
+    // The bit trees take about 2^(MaxOrder - 2) bytes, so this caps them at 64 MB
+    static const uint32_t kMaxSupportedOrder = 28;
+
+    explicit BuddyAllocatorCore( uint32_t MaxOrder = 0 );
+
+    // Discards all allocations and deferred frees.  MaxOrder is clamped to kMaxSupportedOrder.
+    void Reset( uint32_t MaxOrder );
+    void Reset( void ) { Reset(m_MaxOrder); }
+
+    // Returns the unit offset of a free block of 2^Order units, or kInvalidOffset
+    size_t Allocate( uint32_t Order );
+
+    // Returns a block to the free pool immediately, merging it with free buddies
+    void Free( size_t Offset, uint32_t Order );
+
+    // True unless the block lies entirely within a free block
+    bool IsAllocated( size_t Offset, uint32_t Order ) const;
+
+    // Number of free units inside the aligned range of 2^Order units starting at Offset
+    size_t CountFreeUnits( size_t Offset, uint32_t Order ) const;
+
+    uint32_t GetMaxOrder( void ) const { return m_MaxOrder; }
+    BuddyAllocatorStats GetStats( void ) const;
+
+    // Calls Visitor(Offset, Order) for each free block, lowest offset first within each order
+    template <typename Visitor>
+    void ForEachFreeBlock( Visitor Visit ) const
+    {
+        std::lock_guard<std::mutex> Guard(m_Mutex);
+        for (uint32_t Order = 0; Order <= m_MaxOrder; ++Order)
+        {
+            const std::vector<uint64_t>& Bits = m_FreeBits[Order].Levels[0];
+            for (size_t Word = 0; Word < Bits.size(); ++Word)
+            {
+                for (uint64_t Mask = Bits[Word]; Mask != 0; Mask &= Mask - 1)
+                    Visit(((Word << 6) + CountTrailingZeros(Mask)) << Order, Order);
+            }
+        }
+    }
+
+    static uint32_t CountTrailingZeros( uint64_t Value );
+    static uint32_t CountLeadingZeros( uint64_t Value );
+    static uint32_t CountBits( uint64_t Value );
+
+    // Smallest order whose block holds at least Units units
+    static uint32_t UnitsToOrder( size_t Units )
+    {
+        return Units <= 1 ? 0 : 64 - CountLeadingZeros((uint64_t)Units - 1);
+    }
+
+private:
+
+    // A hierarchical bitset supporting set, clear, test and find-first in O(log64 N)
+    struct BitTree
+    {
+        std::vector<std::vector<uint64_t>> Levels;    // Levels[0] is one bit per block
+        size_t NumSet;
+
+        void Init( size_t NumBits );
+        void Set( size_t Index );
+        void Clear( size_t Index );
+        bool Test( size_t Index ) const { return (Levels[0][Index >> 6] >> (Index & 63)) & 1; }
+        size_t FindFirst( void ) const;
+    };
+
+    void MarkFree( size_t Index, uint32_t Order );
+    void MarkUsed( size_t Index, uint32_t Order );
+
+    uint32_t m_MaxOrder;
+    std::vector<BitTree> m_FreeBits;    // One per order
+    uint64_t m_NonEmptyOrders;          // Bit N is set when m_FreeBits[N] has any free block
+
+    size_t m_UsedUnits;
+    size_t m_HighWaterUnits;
+    size_t m_NumAllocations;
+
+    mutable std::mutex m_Mutex;
+};
@@ -0,0 +1,360 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "BuddyDefragmenter.h"
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+BuddyDefragmenter::BuddyDefragmenter() :
+    Policy(kFewestUnitsMoved),
+    m_ActiveRegion(BuddyAllocatorCore::kInvalidOffset),
+    m_ActiveOrder(0),
+    m_AbandonedRegion(BuddyAllocatorCore::kInvalidOffset),
+    m_TotalUnitsMoved(0),
+    m_TotalMoves(0)
+{
+}
+
+void BuddyDefragmenter::TrackAllocation( size_t Offset, uint32_t Order, void* Handle )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    TrackedBlock& Block = m_Tracked[Offset];
+    Block.Order = Order;
+    Block.Handle = Handle;
+}
+
+void BuddyDefragmenter::UntrackAllocation( size_t Offset )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    m_Tracked.erase(Offset);
+}
+
+void BuddyDefragmenter::Reset( void )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    m_Tracked.clear();
+    m_ActiveRegion = BuddyAllocatorCore::kInvalidOffset;
+    m_AbandonedRegion = BuddyAllocatorCore::kInvalidOffset;
+}
+
+size_t BuddyDefragmenter::GetNumTracked( void ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    return m_Tracked.size();
+}
+
+size_t BuddyDefragmenter::CountTrackedUnits( size_t Offset, uint32_t Order ) const
+{
+    size_t End = Offset + ((size_t)1 << Order);
+    size_t Units = 0;
+    for (auto Iter = m_Tracked.lower_bound(Offset); Iter != m_Tracked.end() && Iter->first < End; ++Iter)
+        Units += (size_t)1 << Iter->second.Order;
+    return Units;
+}
+
+// True when a single live block fills the region.  Moving it would only shift the problem elsewhere.
+bool BuddyDefragmenter::IsInsideTrackedBlock( size_t Offset, uint32_t Order ) const
+{
+    auto Iter = m_Tracked.upper_bound(Offset);
+    if (Iter == m_Tracked.begin())
+        return false;
+
+    --Iter;
+    return Iter->second.Order >= Order && Iter->first + ((size_t)1 << Iter->second.Order) > Offset;
+}
+
+BuddyDefragmenter::RegionResult BuddyDefragmenter::ChooseRegion( const BuddyAllocatorCore& Allocator, uint32_t TargetOrder )
+{
+    const size_t RegionUnits = (size_t)1 << TargetOrder;
+    const size_t NumRegions = (size_t)1 << (Allocator.GetMaxOrder() - TargetOrder);
+
+    BuddyAllocatorStats Stats = Allocator.GetStats();
+    size_t TotalFree = Stats.TotalUnits - Stats.UsedUnits;
+    if (TotalFree < RegionUnits)
+        return kNoRegion;
+
+    size_t BestRegion = BuddyAllocatorCore::kInvalidOffset;
+    size_t BestCost = ~(size_t)0;
+
+    for (size_t Region = 0; Region < NumRegions; ++Region)
+    {
+        size_t Offset = Region << TargetOrder;
+        size_t FreeUnits = Allocator.CountFreeUnits(Offset, TargetOrder);
+        if (FreeUnits == RegionUnits)
+            return kRegionAlreadyFree;
+
+        // Everything live in the region has to fit in the free space outside it
+        size_t TrackedUnits = CountTrackedUnits(Offset, TargetOrder);
+        if (TrackedUnits > TotalFree - FreeUnits || Offset == m_AbandonedRegion || IsInsideTrackedBlock(Offset, TargetOrder))
+            continue;
+
+        // Ties go to the higher address, leaving the low end for the blocks being moved
+        size_t Cost = Policy == kHighestAddress ? NumRegions - Region : TrackedUnits;
+        if (Cost <= BestCost)
+        {
+            BestCost = Cost;
+            BestRegion = Offset;
+        }
+    }
+
+    m_AbandonedRegion = BuddyAllocatorCore::kInvalidOffset;
+
+    if (BestRegion == BuddyAllocatorCore::kInvalidOffset)
+        return kNoRegion;
+
+    m_ActiveRegion = BestRegion;
+    m_ActiveOrder = TargetOrder;
+    return kRegionChosen;
+}
+
+bool BuddyDefragmenter::PlanStep( BuddyAllocatorCore& Allocator, uint32_t TargetOrder, size_t BudgetUnits,
+    std::vector<BuddyRelocation>& Moves )
+{
+    if (TargetOrder > Allocator.GetMaxOrder())
+        return false;
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    // Finish the region in progress unless the goal has changed
+    if (m_ActiveRegion != BuddyAllocatorCore::kInvalidOffset && m_ActiveOrder == TargetOrder)
+    {
+        if (Allocator.CountFreeUnits(m_ActiveRegion, TargetOrder) == ((size_t)1 << TargetOrder))
+        {
+            m_ActiveRegion = BuddyAllocatorCore::kInvalidOffset;
+            return true;
+        }
+    }
+    else
+    {
+        m_ActiveRegion = BuddyAllocatorCore::kInvalidOffset;
+
+        RegionResult Result = ChooseRegion(Allocator, TargetOrder);
+        if (Result != kRegionChosen)
+            return Result == kRegionAlreadyFree;
+    }
+
+    if (BudgetUnits == 0)
+        return false;
+
+    // Move the largest blocks first.  They are the hardest to place once free space runs low.
+    const size_t RegionBegin = m_ActiveRegion;
+    const size_t RegionEnd = RegionBegin + ((size_t)1 << TargetOrder);
+
+    vector<pair<size_t, TrackedBlock>> Candidates;
+    for (auto Iter = m_Tracked.lower_bound(RegionBegin); Iter != m_Tracked.end() && Iter->first < RegionEnd; ++Iter)
+        Candidates.push_back(*Iter);
+
+    stable_sort(Candidates.begin(), Candidates.end(),
+        []( const pair<size_t, TrackedBlock>& A, const pair<size_t, TrackedBlock>& B )
+        { return A.second.Order > B.second.Order; });
+
+    // Blocks the allocator hands back from inside the region are held until the end of the step so
+    // that it is forced to look elsewhere.
+    vector<pair<size_t, uint32_t>> Held;
+    size_t UnitsMoved = 0;
+
+    for (auto& Candidate : Candidates)
+    {
+        const uint32_t Order = Candidate.second.Order;
+        const size_t Units = (size_t)1 << Order;
+        if (UnitsMoved > 0 && UnitsMoved + Units > BudgetUnits)
+            continue;
+
+        size_t Dst;
+        while (true)
+        {
+            Dst = Allocator.Allocate(Order);
+            if (Dst == BuddyAllocatorCore::kInvalidOffset || Dst < RegionBegin || Dst >= RegionEnd)
+                break;
+            Held.emplace_back(Dst, Order);
+        }
+
+        if (Dst == BuddyAllocatorCore::kInvalidOffset)
+        {
+            // Free space outside the region is too scattered for this block.  Try another region
+            // next time.
+            m_AbandonedRegion = m_ActiveRegion;
+            m_ActiveRegion = BuddyAllocatorCore::kInvalidOffset;
+            break;
+        }
+
+        BuddyRelocation Move = { Candidate.first, Dst, Order, Candidate.second.Handle };
+        Moves.push_back(Move);
+
+        m_Tracked.erase(Candidate.first);
+        m_Tracked[Dst] = Candidate.second;
+
+        UnitsMoved += Units;
+        m_TotalUnitsMoved += Units;
+        ++m_TotalMoves;
+    }
+
+    for (auto& Block : Held)
+        Allocator.Free(Block.first, Block.second);
+
+    return false;
+}
+
+bool BuddyDefragSimulator::ParseTrace( std::istream& Input, std::vector<BuddyTraceEvent>& Trace )
+{
+    string Line;
+    while (getline(Input, Line))
+    {
+        istringstream Tokens(Line);
+        string Command;
+        if (!(Tokens >> Command) || Command[0] == '#')
+            continue;
+
+        BuddyTraceEvent Event = {};
+        if (Command == "a")
+        {
+            Event.EventType = BuddyTraceEvent::kAllocate;
+            if (!(Tokens >> Event.Id >> Event.Units))
+                return false;
+        }
+        else if (Command == "f")
+        {
+            Event.EventType = BuddyTraceEvent::kFree;
+            if (!(Tokens >> Event.Id))
+                return false;
+        }
+        else if (Command == "e")
+        {
+            Event.EventType = BuddyTraceEvent::kEndFrame;
+        }
+        else
+        {
+            return false;
+        }
+
+        Trace.push_back(Event);
+    }
+    return true;
+}
+
+BuddyDefragSimStats BuddyDefragSimulator::Replay( const std::vector<BuddyTraceEvent>& Trace, uint32_t MaxOrder,
+    size_t BudgetUnitsPerFrame, uint32_t FenceLatency, BuddyDefragmenter::RegionPolicy Policy )
+{
+    struct PendingFree
+    {
+        size_t Frame;
+        size_t Offset;
+        uint32_t Order;
+    };
+
+    // The simulator stands in for BuddyBlock, so the handle the defragmenter patches is a pointer
+    // to one of these.
+    struct SimBlock
+    {
+        size_t Offset;
+        uint32_t Order;
+    };
+
+    BuddyAllocatorCore Allocator(MaxOrder);
+    BuddyDefragmenter Defragmenter;
+    Defragmenter.Policy = Policy;
+
+    unordered_map<uint32_t, SimBlock*> Live;
+    deque<PendingFree> Pending;
+    vector<BuddyRelocation> Moves;
+
+    BuddyDefragSimStats Stats = {};
+    double FragmentationSum = 0.0;
+    int TargetOrder = -1;   // Largest order that has failed and not yet been satisfied
+
+    for (const BuddyTraceEvent& Event : Trace)
+    {
+        switch (Event.EventType)
+        {
+        case BuddyTraceEvent::kAllocate:
+        {
+            ++Stats.NumAllocations;
+            uint32_t Order = BuddyAllocatorCore::UnitsToOrder(Event.Units);
+            size_t Offset = Allocator.Allocate(Order);
+            if (Offset == BuddyAllocatorCore::kInvalidOffset)
+            {
+                ++Stats.NumFailedAllocations;
+                TargetOrder = max(TargetOrder, (int)Order);
+                break;
+            }
+
+            SimBlock*& Block = Live[Event.Id];
+            assert(Block == nullptr);
+            Block = new SimBlock{ Offset, Order };
+            Defragmenter.TrackAllocation(Offset, Order, Block);
+            Stats.PeakUsedUnits = max(Stats.PeakUsedUnits, Allocator.GetStats().UsedUnits);
+            break;
+        }
+
+        case BuddyTraceEvent::kFree:
+        {
+            // Frees of allocations that failed are ignored
+            auto Iter = Live.find(Event.Id);
+            if (Iter == Live.end())
+                break;
+
+            SimBlock* Block = Iter->second;
+            Defragmenter.UntrackAllocation(Block->Offset);
+            PendingFree Free = { Stats.NumFrames + FenceLatency, Block->Offset, Block->Order };
+            Pending.push_back(Free);
+            delete Block;
+            Live.erase(Iter);
+            break;
+        }
+
+        case BuddyTraceEvent::kEndFrame:
+        {
+            if (TargetOrder >= 0 && BudgetUnitsPerFrame > 0)
+            {
+                Moves.clear();
+                if (Defragmenter.PlanStep(Allocator, (uint32_t)TargetOrder, BudgetUnitsPerFrame, Moves))
+                    TargetOrder = -1;
+
+                // The "copy" is instantaneous, but the source can't be reused until the GPU would
+                // have finished reading it.
+                for (const BuddyRelocation& Move : Moves)
+                {
+                    ((SimBlock*)Move.Handle)->Offset = Move.DstOffset;
+                    PendingFree Free = { Stats.NumFrames + FenceLatency, Move.SrcOffset, Move.Order };
+                    Pending.push_back(Free);
+                }
+            }
+
+            while (!Pending.empty() && Pending.front().Frame <= Stats.NumFrames)
+            {
+                Allocator.Free(Pending.front().Offset, Pending.front().Order);
+                Pending.pop_front();
+            }
+
+            float Fragmentation = Allocator.GetStats().GetExternalFragmentation();
+            Stats.PeakFragmentation = max(Stats.PeakFragmentation, Fragmentation);
+            FragmentationSum += Fragmentation;
+            ++Stats.NumFrames;
+            break;
+        }
+        }
+    }
+
+    for (auto& Entry : Live)
+        delete Entry.second;
+
+    Stats.UnitsMoved = Defragmenter.GetTotalUnitsMoved();
+    Stats.NumMoves = Defragmenter.GetTotalMoves();
+    Stats.AverageFragmentation = Stats.NumFrames ? (float)(FragmentationSum / Stats.NumFrames) : 0.0f;
+    return Stats;
+}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Incremental compaction for a BuddyAllocatorCore.  After hours of mixed allocations
+// the free space in a buddy allocator tends to end up as many small blocks, and a large request
+// fails even though the total free space would hold it several times over.
+//
+// The defragmenter fixes that one aligned region at a time.  To make room for a block of order N it
+// picks an aligned region of 2^N units that is cheap to empty, then moves the live blocks in it out
+// to free blocks elsewhere, a per-frame budget at a time.  Once those blocks and any pending frees
+// in the region have been released, the region merges back into a single free block.
+//
+// It is pure bookkeeping: it decides what to move and where, and updates the owner handle of each
+// move.  The caller copies the bytes and frees the source ranges once the copy is complete.
+// BuddyDefragSimulator replays allocation traces through it so that policies and budgets can be
+// compared without a GPU.
+
+#pragma once
+
+#include "BuddyAllocatorCore.h"
+#include <istream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct BuddyRelocation
+{
+    size_t SrcOffset;   // In units
+    size_t DstOffset;
+    uint32_t Order;
+    void* Handle;       // As passed to TrackAllocation()
+};
+
+class BuddyDefragmenter
+{
+public:
+
+    enum RegionPolicy
+    {
+        kFewestUnitsMoved,      // Empty whichever region holds the least live data
+        kHighestAddress         // Sweep live data towards the start of the range
+    };
+
+    BuddyDefragmenter();
+
+    // Only tracked blocks are ever moved.  Untrack a block as soon as it is released, even if the
+    // free itself is deferred.  Untracked allocations in a region are assumed to be on their way out.
+    void TrackAllocation( size_t Offset, uint32_t Order, void* Handle );
+    void UntrackAllocation( size_t Offset );
+
+    // Appends moves of at most BudgetUnits (or a single larger block if nothing else fits) that
+    // work towards a free block of TargetOrder.  Destinations are allocated from Allocator and the
+    // handles are considered moved as of this call; the source ranges remain allocated until the
+    // caller frees them.  Returns true if a free block of TargetOrder already exists.
+    bool PlanStep( BuddyAllocatorCore& Allocator, uint32_t TargetOrder, size_t BudgetUnits,
+        std::vector<BuddyRelocation>& Moves );
+
+    void Reset( void );
+
+    size_t GetNumTracked( void ) const;
+    uint64_t GetTotalUnitsMoved( void ) const { return m_TotalUnitsMoved; }
+    uint64_t GetTotalMoves( void ) const { return m_TotalMoves; }
+
+    RegionPolicy Policy;
+
+private:
+
+    struct TrackedBlock
+    {
+        uint32_t Order;
+        void* Handle;
+    };
+
+    enum RegionResult
+    {
+        kRegionChosen,
+        kRegionAlreadyFree,
+        kNoRegion
+    };
+
+    RegionResult ChooseRegion( const BuddyAllocatorCore& Allocator, uint32_t TargetOrder );
+    size_t CountTrackedUnits( size_t Offset, uint32_t Order ) const;
+    bool IsInsideTrackedBlock( size_t Offset, uint32_t Order ) const;
+
+    mutable std::mutex m_Mutex;
+    std::map<size_t, TrackedBlock> m_Tracked;    // Keyed by unit offset
+
+    size_t m_ActiveRegion;          // kInvalidOffset when idle
+    uint32_t m_ActiveOrder;
+    size_t m_AbandonedRegion;       // Skipped once after a destination could not be found
+
+    uint64_t m_TotalUnitsMoved;
+    uint64_t m_TotalMoves;
+};
+
+// One line of an allocation trace.  Ids are chosen by the trace and may be reused after a free.
+struct BuddyTraceEvent
+{
+    enum Type { kAllocate, kFree, kEndFrame };
+
+    Type EventType;
+    uint32_t Id;
+    size_t Units;   // kAllocate only
+};
+
+struct BuddyDefragSimStats
+{
+    size_t NumFrames;
+    size_t NumAllocations;
+    size_t NumFailedAllocations;
+    size_t PeakUsedUnits;
+    uint64_t UnitsMoved;
+    uint64_t NumMoves;
+    float PeakFragmentation;
+    float AverageFragmentation;     // Sampled at the end of each frame
+};
+
+class BuddyDefragSimulator
+{
+public:
+
+    // Text format, one event per line:  "a <id> <units>", "f <id>", or "e" to end a frame.
+    // Blank lines and lines starting with '#' are ignored.  Returns false on a malformed line.
+    static bool ParseTrace( std::istream& Input, std::vector<BuddyTraceEvent>& Trace );
+
+    // Replays the trace through an allocator of 2^MaxOrder units.  Frees, including the sources of
+    // moves, take effect FenceLatency frames later as they would with a GPU in flight.  A budget of
+    // zero disables defragmentation for a baseline.
+    static BuddyDefragSimStats Replay( const std::vector<BuddyTraceEvent>& Trace, uint32_t MaxOrder,
+        size_t BudgetUnitsPerFrame, uint32_t FenceLatency, BuddyDefragmenter::RegionPolicy Policy );
+};
@@ -87,6 +87,12 @@ namespace Graphics
 #define HDR_MOTION_FORMAT DXGI_FORMAT_R16G16B16A16_FLOAT
 #define DSV_FORMAT DXGI_FORMAT_D32_FLOAT
 
+namespace
+{
+    // Holds the heap that the buffers created in scopes share, for as long as they exist
+    EsramAllocator s_Esram;
+}
+
 void Graphics::InitializeRenderingBuffers( uint32_t bufferWidth, uint32_t bufferHeight )
 {
     GraphicsContext& InitContext = GraphicsContext::Begin();
@@ -104,7 +110,7 @@ void Graphics::InitializeRenderingBuffers( uint32_t bufferWidth, uint32_t buffer
     const uint32_t bufferHeight5 = (bufferHeight + 31) / 32;
     const uint32_t bufferHeight6 = (bufferHeight + 63) / 64;
 
-    EsramAllocator esram;
+    EsramAllocator& esram = s_Esram;
 
     esram.PushStack();
 
@@ -227,6 +233,12 @@ void Graphics::InitializeRenderingBuffers( uint32_t bufferWidth, uint32_t buffer
 
     esram.PopStack(); // End final image
 
+    const IntervalAllocator& Placement = esram.GetPlacement();
+    Utility::Printf("Rendering buffers at %ux%u:  %u textures need %.1f MB, and share %.1f MB (saving %.1f MB, live peak %.1f MB)\n",
+        bufferWidth, bufferHeight, Placement.GetNumIntervals(), Placement.GetTotalSize() / 1048576.0,
+        Placement.GetHeapSize() / 1048576.0, (Placement.GetTotalSize() - Placement.GetHeapSize()) / 1048576.0,
+        Placement.GetPeakLiveSize() / 1048576.0);
+
     InitContext.Finish();
 }
 
@@ -306,4 +318,6 @@ void Graphics::DestroyRenderingBuffers()
     g_FXAAColorQueue.Destroy();
 
     g_GenMipsBuffer.Destroy();
+
+    s_Esram.Destroy();
 }
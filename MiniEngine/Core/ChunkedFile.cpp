@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "ChunkedFile.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <zlib.h>
+
+using namespace std;
+
+static_assert(sizeof(ChunkedFile::Header) == 32, "The header is read straight from the file");
+static_assert(sizeof(ChunkedFile::BlockEntry) == 16, "Block entries are read straight from the file");
+
+uint64_t ChunkedFile::GetUncompressedSize( const uint8_t* Data, size_t Size )
+{
+    if (Size < sizeof(Header))
+        return 0;
+
+    Header FileHeader;
+    memcpy(&FileHeader, Data, sizeof(Header));
+
+    if (FileHeader.Magic != kMagic || FileHeader.Version != kVersion || FileHeader.BlockSize == 0)
+        return 0;
+
+    // The blocks must exactly cover the original file
+    const uint64_t NumBlocks = (FileHeader.UncompressedSize + FileHeader.BlockSize - 1) / FileHeader.BlockSize;
+    if (NumBlocks != FileHeader.NumBlocks)
+        return 0;
+
+    if ((Size - sizeof(Header)) / sizeof(BlockEntry) < NumBlocks)
+        return 0;
+
+    return FileHeader.UncompressedSize;
+}
+
+bool ChunkedFile::Decompress( const uint8_t* Data, size_t Size, uint8_t* Dest, JobScheduler& Scheduler )
+{
+    const uint64_t UncompressedSize = GetUncompressedSize(Data, Size);
+    if (UncompressedSize == 0)
+        return false;
+
+    Header FileHeader;
+    memcpy(&FileHeader, Data, sizeof(Header));
+    const uint8_t* Index = Data + sizeof(Header);
+
+    atomic<bool> Failed(false);
+
+    Scheduler.ParallelFor(0, FileHeader.NumBlocks, 1, [&]( uint32_t Begin, uint32_t End )
+    {
+        for (uint32_t i = Begin; i < End && !Failed.load(memory_order_relaxed); ++i)
+        {
+            BlockEntry Block;
+            memcpy(&Block, Index + i * sizeof(BlockEntry), sizeof(BlockEntry));
+
+            const uint64_t DestOffset = (uint64_t)i * FileHeader.BlockSize;
+            const uint64_t ExpectedSize = min((uint64_t)FileHeader.BlockSize, UncompressedSize - DestOffset);
+
+            if (Block.UncompressedSize != ExpectedSize || Block.Offset > Size || Block.CompressedSize > Size - Block.Offset)
+            {
+                Failed = true;
+                break;
+            }
+
+            if (Block.CompressedSize == Block.UncompressedSize)
+            {
+                memcpy(Dest + DestOffset, Data + Block.Offset, Block.UncompressedSize);
+                continue;
+            }
+
+            uLongf DestSize = Block.UncompressedSize;
+            if (uncompress(Dest + DestOffset, &DestSize, Data + Block.Offset, Block.CompressedSize) != Z_OK ||
+                DestSize != Block.UncompressedSize)
+            {
+                Failed = true;
+            }
+        }
+    });
+
+    return !Failed;
+}
+
+void ChunkedFile::Compress( const uint8_t* Source, size_t Size, vector<uint8_t>& Packed, JobScheduler& Scheduler,
+    uint32_t BlockSize, int Level )
+{
+    assert(BlockSize > 0);
+
+    const uint32_t NumBlocks = (uint32_t)((Size + BlockSize - 1) / BlockSize);
+
+    vector<vector<uint8_t>> Blocks(NumBlocks);
+
+    Scheduler.ParallelFor(0, NumBlocks, 1, [&]( uint32_t Begin, uint32_t End )
+    {
+        for (uint32_t i = Begin; i < End; ++i)
+        {
+            const uint8_t* BlockSource = Source + (size_t)i * BlockSize;
+            const uLong BlockBytes = (uLong)min((size_t)BlockSize, Size - (size_t)i * BlockSize);
+
+            vector<uint8_t>& Block = Blocks[i];
+            Block.resize(compressBound(BlockBytes));
+            uLongf PackedSize = (uLongf)Block.size();
+            if (compress2(Block.data(), &PackedSize, BlockSource, BlockBytes, Level) == Z_OK && PackedSize < BlockBytes)
+                Block.resize(PackedSize);
+            else
+                Block.assign(BlockSource, BlockSource + BlockBytes);
+        }
+    });
+
+    Header FileHeader = { kMagic, kVersion, BlockSize, NumBlocks, (uint64_t)Size, 0 };
+
+    size_t TotalSize = sizeof(Header) + NumBlocks * sizeof(BlockEntry);
+    for (const vector<uint8_t>& Block : Blocks)
+        TotalSize += Block.size();
+
+    Packed.resize(TotalSize);
+    memcpy(Packed.data(), &FileHeader, sizeof(Header));
+
+    uint64_t Offset = sizeof(Header) + NumBlocks * sizeof(BlockEntry);
+    for (uint32_t i = 0; i < NumBlocks; ++i)
+    {
+        BlockEntry Entry;
+        Entry.Offset = Offset;
+        Entry.CompressedSize = (uint32_t)Blocks[i].size();
+        Entry.UncompressedSize = (uint32_t)min((size_t)BlockSize, Size - (size_t)i * BlockSize);
+
+        memcpy(Packed.data() + sizeof(Header) + i * sizeof(BlockEntry), &Entry, sizeof(BlockEntry));
+        memcpy(Packed.data() + Offset, Blocks[i].data(), Blocks[i].size());
+        Offset += Blocks[i].size();
+    }
+}
@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A compressed file made of independently compressed blocks, so that it can be inflated
+// on every core at once.  A gzip stream can only be inflated from start to finish on one thread, which
+// dominates the load time of large models and textures.  The layout, all little-endian, is
+//
+//     [Header][BlockEntry x NumBlocks][block data ...]
+//
+// Every block but the last holds BlockSize bytes of the original file.  A block is a zlib stream, or the
+// original bytes when compressing them didn't make them smaller, which is what CompressedSize equal to
+// UncompressedSize means.  Tools/Scripts/PackChunked.py writes these files as "<file>.cz", and
+// Utility::ReadFileSync() looks for one before "<file>.gz".
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobScheduler;
+
+namespace ChunkedFile
+{
+    static const uint32_t kMagic = 0x5A43454D;     // "MECZ"
+    static const uint32_t kVersion = 1;
+
+    struct Header
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t BlockSize;
+        uint32_t NumBlocks;
+        uint64_t UncompressedSize;
+        uint64_t Reserved;
+    };
+
+    struct BlockEntry
+    {
+        uint64_t Offset;            // From the start of the file
+        uint32_t CompressedSize;
+        uint32_t UncompressedSize;
+    };
+
+    // Checks the header and that the block index lies within the file.  Returns the size of the original
+    // file, or zero if Data isn't a chunked file.
+    uint64_t GetUncompressedSize( const uint8_t* Data, size_t Size );
+
+    // Inflates every block straight into Dest, which must be GetUncompressedSize() bytes.  The blocks are
+    // shared out over the scheduler's threads, and the calling thread helps.  Fails on any corrupt block.
+    bool Decompress( const uint8_t* Data, size_t Size, uint8_t* Dest, JobScheduler& Scheduler );
+
+    // Writes a chunked file, compressing the blocks in parallel.  This is what the packer script does, for
+    // code that produces large files at run time.
+    void Compress( const uint8_t* Source, size_t Size, std::vector<uint8_t>& Packed, JobScheduler& Scheduler,
+        uint32_t BlockSize = 1 << 20, int Level = 6 );
+}
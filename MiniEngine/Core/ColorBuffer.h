@@ -38,19 +38,26 @@ public:
     void Create(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t NumMips,
         DXGI_FORMAT Format, D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
     
-    // Create a color buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows,
-    // this functions the same as Create() without a video address.
+    // Create a color buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows, it is
+    // placed in memory shared with buffers from other scopes, and created when the allocator's
+    // outermost scope is popped.
     void Create(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t NumMips,
         DXGI_FORMAT Format, EsramAllocator& Allocator);
 
+    // Create a color buffer at an offset within a heap that other placed resources may share.  It
+    // starts in RENDER_TARGET, and must be discarded or fully written after an aliasing barrier.
+    void CreatePlaced(const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format,
+        ID3D12Heap* Heap, uint64_t HeapOffset);
+
     // Create a color buffer.  If an address is supplied, memory will not be allocated.
     // The vmem address allows you to alias buffers (which can be especially useful for
     // reusing ESRAM across a frame.)
     void CreateArray(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t ArrayCount,
         DXGI_FORMAT Format, D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
     
-    // Create a color buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows,
-    // this functions the same as Create() without a video address.
+    // Create a color buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows, it is
+    // placed in memory shared with buffers from other scopes, and created when the allocator's
+    // outermost scope is popped.
     void CreateArray(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t ArrayCount,
         DXGI_FORMAT Format, EsramAllocator& Allocator);
 
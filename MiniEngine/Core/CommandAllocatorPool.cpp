@@ -13,11 +13,37 @@
 
 #include "pch.h"
 #include "CommandAllocatorPool.h"
+#include "CommandListManager.h"
+
+namespace Graphics
+{
+    extern CommandListManager g_CommandManager;
+}
+
+namespace
+{
+    // A thread rarely records more than two command lists of one type at once
+    const size_t kAllocatorsPerThread = 2;
+
+    bool IsFenceComplete(uint64_t FenceValue)
+    {
+        return Graphics::g_CommandManager.IsFenceComplete(FenceValue);
+    }
+
+    void WaitForFence(uint64_t FenceValue)
+    {
+        Graphics::g_CommandManager.WaitForFence(FenceValue);
+    }
+}
 
 CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
     m_cCommandListType(Type),
-    m_Device(nullptr)
+    m_Device(nullptr),
+    m_Allocators([this](void) { return CreateAllocator(); }, IsFenceComplete, kAllocatorsPerThread),
+    m_NextAllocatorId(0),
+    m_RequestsUntilTrim(kTrimInterval)
 {
+    m_Allocators.SetMaxPages(kDefaultMaxAllocators, WaitForFence);
 }
 
 CommandAllocatorPool::~CommandAllocatorPool()
@@ -32,47 +58,42 @@ void CommandAllocatorPool::Create(ID3D12Device * pDevice)
 
 void CommandAllocatorPool::Shutdown()
 {
-    for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
-        m_AllocatorPool[i]->Release();
-
-    m_AllocatorPool.clear();
+    m_Allocators.Destroy();
+    m_NextAllocatorId = 0;
 }
 
-ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
+void CommandAllocatorPool::SetMaxAllocators(size_t MaxAllocators)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+    m_Allocators.SetMaxPages(MaxAllocators, WaitForFence);
+}
 
+ID3D12CommandAllocator* CommandAllocatorPool::CreateAllocator(void)
+{
     ID3D12CommandAllocator* pAllocator = nullptr;
+    ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %u", m_NextAllocatorId++);
+    pAllocator->SetName(AllocatorName);
+    return pAllocator;
+}
 
-    if (!m_ReadyAllocators.empty())
-    {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
-
-        if (AllocatorPair.first <= CompletedFenceValue)
-        {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
-            m_ReadyAllocators.pop();
-        }
-    }
-
-    // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
+ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(void)
+{
+    // Whichever thread counts down to zero releases the allocators nobody needed since the last time
+    if (m_RequestsUntilTrim.fetch_sub(1) == 1)
     {
-        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
-        wchar_t AllocatorName[32];
-        swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
-        pAllocator->SetName(AllocatorName);
-        m_AllocatorPool.push_back(pAllocator);
+        m_Allocators.TrimIdle();
+        m_RequestsUntilTrim += kTrimInterval;
     }
 
+    // Resetting a new allocator does nothing, so every allocator is reset the same way
+    ID3D12CommandAllocator* pAllocator = m_Allocators.RequestPage();
+    ASSERT_SUCCEEDED(pAllocator->Reset());
     return pAllocator;
 }
 
 void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    m_Allocators.DiscardPages(FenceValue, std::vector<ID3D12CommandAllocator*>(1, Allocator));
 }
@@ -10,33 +10,56 @@
 //
 // Author:  James Stanard
 //
+// Description:  Recycles the command allocators of one queue type through a PageRecycler.  An allocator
+// can be reset once the fence of the last command list recorded with it has completed, and any ready
+// allocator can be handed out, not just the oldest.  Each thread keeps a couple of ready allocators of its
+// own, so the common path takes no lock.
+//
+// Once the pool reaches its cap it waits for the oldest retired allocator instead of creating another,
+// unless all of them are in use.  Allocators that sit idle through a whole trim interval are released.
+//
 
 #pragma once
 
-#include <vector>
-#include <queue>
-#include <mutex>
+#include "PageRecycler.h"
+#include <atomic>
 #include <stdint.h>
 
 class CommandAllocatorPool
 {
 public:
+    static const size_t kDefaultMaxAllocators = 64;
+    static const uint32_t kTrimInterval = 1024;     // Requests between releases of idle allocators
+
     CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type);
     ~CommandAllocatorPool();
 
     void Create(ID3D12Device* pDevice);
     void Shutdown();
 
-    ID3D12CommandAllocator* RequestAllocator(uint64_t CompletedFenceValue);
+    // The allocator comes back reset
+    ID3D12CommandAllocator* RequestAllocator(void);
     void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
 
-    inline size_t Size() { return m_AllocatorPool.size(); }
+    void SetMaxAllocators(size_t MaxAllocators);
+
+    // Pages are allocators:  PagesCreated, PagesReused, PeakPagesInUse, PagesTrimmed, CapWaits, etc.
+    PageRecyclerStats GetStats(void) const { return m_Allocators.GetStats(); }
+
+    inline size_t Size() { return m_Allocators.GetTotalPages(); }
 
 private:
+    struct ReleaseAllocator
+    {
+        void operator()(ID3D12CommandAllocator* Allocator) const { Allocator->Release(); }
+    };
+
+    ID3D12CommandAllocator* CreateAllocator(void);
+
     const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
 
     ID3D12Device* m_Device;
-    std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
-    std::mutex m_AllocatorMutex;
+    PageRecycler<ID3D12CommandAllocator, ReleaseAllocator> m_Allocators;
+    std::atomic<uint32_t> m_NextAllocatorId;
+    std::atomic<uint32_t> m_RequestsUntilTrim;
 };
@@ -150,6 +150,8 @@ uint64_t CommandContext::Finish( bool WaitForCompletion )
     if (WaitForCompletion)
         g_CommandManager.WaitForFence(FenceValue);
 
+    m_BarrierCapture = nullptr;
+
     g_ContextManager.FreeContext(this);
 
     return FenceValue;
@@ -172,6 +174,7 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
     m_NumBarriersToFlush = 0;
+    m_BarrierCapture = nullptr;
 }
 
 CommandContext::~CommandContext( void )
@@ -334,8 +337,45 @@ void GraphicsContext::SetScissor( const D3D12_RECT& rect )
     m_CommandList->RSSetScissorRects( 1, &rect );
 }
 
+D3D12_RESOURCE_BARRIER* CommandContext::FindBufferedBarrier( ID3D12Resource* Resource )
+{
+    for (UINT i = m_NumBarriersToFlush; i > 0; --i)
+    {
+        D3D12_RESOURCE_BARRIER& Barrier = m_ResourceBarrierBuffer[i - 1];
+        switch (Barrier.Type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            if (Barrier.Transition.pResource == Resource)
+                return &Barrier;
+            break;
+        case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+            if (Barrier.UAV.pResource == Resource)
+                return &Barrier;
+            break;
+        case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+            if (Barrier.Aliasing.pResourceBefore == Resource || Barrier.Aliasing.pResourceAfter == Resource)
+                return &Barrier;
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void CommandContext::RemoveBufferedBarrier( D3D12_RESOURCE_BARRIER* Barrier )
+{
+    // Keep the rest in order in case an aliasing barrier depends on it
+    UINT Index = (UINT)(Barrier - m_ResourceBarrierBuffer);
+    ASSERT(Index < m_NumBarriersToFlush);
+    for (UINT i = Index + 1; i < m_NumBarriersToFlush; ++i)
+        m_ResourceBarrierBuffer[i - 1] = m_ResourceBarrierBuffer[i];
+    --m_NumBarriersToFlush;
+}
+
 void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
 {
+    if (Resource.m_SharesMemoryWith != nullptr && !Resource.m_OwnsMemory)
+        TakeOverMemory(Resource);
+
     D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
 
     if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
@@ -344,7 +384,35 @@ void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_ST
         ASSERT((NewState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == NewState);
     }
 
-    if (OldState != NewState)
+    if (m_BarrierCapture != nullptr)
+    {
+        m_BarrierCapture->RecordTransition(m_BarrierCapture->GetResourceId(Resource.GetResource()),
+            (BarrierState)OldState, (BarrierState)NewState);
+    }
+
+    // No work has been recorded since a buffered transition of this resource, so the resource was never
+    // used in the intermediate state.  Retarget that transition, or drop it if this undoes it.  Undoing a
+    // transition out of UNORDERED_ACCESS still has to order the UAV writes on either side, so that one
+    // becomes a UAV barrier.
+    D3D12_RESOURCE_BARRIER* Buffered = OldState != NewState ? FindBufferedBarrier(Resource.GetResource()) : nullptr;
+    if (Buffered != nullptr && Buffered->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+        Buffered->Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE && NewState != Resource.m_TransitioningState)
+    {
+        ASSERT(Buffered->Transition.StateAfter == OldState);
+
+        if (Buffered->Transition.StateBefore == NewState && NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+        {
+            Buffered->Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+            Buffered->UAV.pResource = Resource.GetResource();
+        }
+        else if (Buffered->Transition.StateBefore == NewState)
+            RemoveBufferedBarrier(Buffered);
+        else
+            Buffered->Transition.StateAfter = NewState;
+
+        Resource.m_UsageState = NewState;
+    }
+    else if (OldState != NewState)
     {
         ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
         D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
@@ -367,7 +435,7 @@ void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_ST
         Resource.m_UsageState = NewState;
     }
     else if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
-        InsertUAVBarrier(Resource, FlushImmediate);
+        InsertUAVBarrier(Resource, FlushImmediate, false);
 
     if (FlushImmediate || m_NumBarriersToFlush == 16)
         FlushResourceBarriers();
@@ -375,6 +443,9 @@ void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_ST
 
 void CommandContext::BeginResourceTransition(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
 {
+    if (Resource.m_SharesMemoryWith != nullptr && !Resource.m_OwnsMemory)
+        TakeOverMemory(Resource);
+
     // If it's already transitioning, finish that transition
     if (Resource.m_TransitioningState != (D3D12_RESOURCE_STATES)-1)
         TransitionResource(Resource, Resource.m_TransitioningState);
@@ -403,6 +474,22 @@ void CommandContext::BeginResourceTransition(GpuResource& Resource, D3D12_RESOUR
 
 void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate)
 {
+    InsertUAVBarrier(Resource, FlushImmediate, true);
+}
+
+void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate, bool Capture)
+{
+    if (Capture && m_BarrierCapture != nullptr)
+        m_BarrierCapture->RecordUAVBarrier(m_BarrierCapture->GetResourceId(Resource.GetResource()));
+
+    // Any buffered barrier on the resource already waits for its outstanding writes
+    if (FindBufferedBarrier(Resource.GetResource()) != nullptr)
+    {
+        if (FlushImmediate)
+            FlushResourceBarriers();
+        return;
+    }
+
     ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
     D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
 
@@ -416,6 +503,12 @@ void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate
 
 void CommandContext::InsertAliasBarrier(GpuResource& Before, GpuResource& After, bool FlushImmediate)
 {
+    if (m_BarrierCapture != nullptr)
+    {
+        m_BarrierCapture->RecordAliasBarrier(m_BarrierCapture->GetResourceId(Before.GetResource()),
+            m_BarrierCapture->GetResourceId(After.GetResource()));
+    }
+
     ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
     D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
 
@@ -428,6 +521,52 @@ void CommandContext::InsertAliasBarrier(GpuResource& Before, GpuResource& After,
         FlushResourceBarriers();
 }
 
+void CommandContext::InsertAliasBarrier(GpuResource& After, bool FlushImmediate)
+{
+    if (m_BarrierCapture != nullptr)
+    {
+        uint32_t Id = m_BarrierCapture->GetResourceId(After.GetResource());
+        m_BarrierCapture->RecordAliasBarrier(Id, Id);
+    }
+
+    ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
+    D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
+
+    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    BarrierDesc.Aliasing.pResourceBefore = nullptr;
+    BarrierDesc.Aliasing.pResourceAfter = After.GetResource();
+
+    if (FlushImmediate)
+        FlushResourceBarriers();
+}
+
+void CommandContext::TakeOverMemory( GpuResource& Resource )
+{
+    // Whatever else was in the memory is gone.  Contexts recording in parallel must not share aliased resources.
+    for (GpuResource* Other : *Resource.m_SharesMemoryWith)
+        Other->m_OwnsMemory = false;
+    Resource.m_OwnsMemory = true;
+
+    // After an aliasing barrier, render targets and depth buffers must be discarded, cleared or copied to before
+    // anything else.  Compute command lists can only discard unordered access resources.
+    D3D12_RESOURCE_STATES DiscardState;
+    if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+    {
+        ASSERT(Resource->GetDesc().Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        DiscardState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    }
+    else if (Resource->GetDesc().Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+        DiscardState = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    else
+        DiscardState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+
+    FlushResourceBarriers();
+    InsertAliasBarrier(Resource);
+    TransitionResource(Resource, DiscardState, true);
+    m_CommandList->DiscardResource(Resource.GetResource(), nullptr);
+}
+
 void CommandContext::WriteBuffer( GpuResource& Dest, size_t DestOffset, const void* BufferData, size_t NumBytes )
 {
     ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
@@ -444,16 +583,24 @@ void CommandContext::FillBuffer( GpuResource& Dest, size_t DestOffset, DWParam V
     CopyBufferRegion(Dest, DestOffset, TempSpace.Buffer, TempSpace.Offset, NumBytes );
 }
 
-void CommandContext::InitializeTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] )
+void CommandContext::WriteTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[], UINT FirstSubresource )
 {
-    UINT64 uploadBufferSize = GetRequiredIntermediateSize(Dest.GetResource(), 0, NumSubresources);
+    // A texture that is streamed in is readable between writes
+    TransitionResource(Dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
 
-    CommandContext& InitContext = CommandContext::Begin();
+    UINT64 uploadBufferSize = GetRequiredIntermediateSize(Dest.GetResource(), FirstSubresource, NumSubresources);
 
-    // copy data to the intermediate upload heap and then schedule a copy from the upload heap to the default texture
-    DynAlloc mem = InitContext.ReserveUploadMemory(uploadBufferSize);
-    UpdateSubresources(InitContext.m_CommandList, Dest.GetResource(), mem.Buffer.GetResource(), 0, 0, NumSubresources, SubData);
-    InitContext.TransitionResource(Dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+    // copy data to the intermediate upload heap and then schedule a copy from the upload heap to the default texture.
+    // Other textures may share the page, so the copy starts at this allocation's offset.
+    DynAlloc mem = m_CpuLinearAllocator.Allocate((size_t)uploadBufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    UpdateSubresources(m_CommandList, Dest.GetResource(), mem.Buffer.GetResource(), mem.Offset, FirstSubresource, NumSubresources, SubData);
+    TransitionResource(Dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+}
+
+void CommandContext::InitializeTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] )
+{
+    CommandContext& InitContext = CommandContext::Begin();
+    InitContext.WriteTexture(Dest, NumSubresources, SubData);
 
     // Execute the command list and wait for it to finish so we can release the upload buffer
     InitContext.Finish(true);
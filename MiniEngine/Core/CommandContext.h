@@ -25,6 +25,7 @@
 #include "LinearAllocator.h"
 #include "CommandSignature.h"
 #include "GraphicsCore.h"
+#include "BarrierOptimizer.h"
 #include <vector>
 
 class ColorBuffer;
@@ -135,14 +136,23 @@ public:
     static void ReadbackTexture2D(GpuResource& ReadbackBuffer, PixelBuffer& SrcBuffer);
 
     void WriteBuffer( GpuResource& Dest, size_t DestOffset, const void* Data, size_t NumBytes );
+
+    // Copies subresources of a texture, from FirstSubresource on, through upload memory, and leaves it readable.
+    // Any number of textures can be written by one context without waiting on the GPU.
+    void WriteTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[], UINT FirstSubresource = 0 );
     void FillBuffer( GpuResource& Dest, size_t DestOffset, DWParam Value, size_t NumBytes );
 
     void TransitionResource(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
     void BeginResourceTransition(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
     void InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate = false);
     void InsertAliasBarrier(GpuResource& Before, GpuResource& After, bool FlushImmediate = false);
+    void InsertAliasBarrier(GpuResource& After, bool FlushImmediate = false);    // Any resource may have been using the memory
     inline void FlushResourceBarriers(void);
 
+    // Records every barrier request and work boundary into Trace until Finish() or until called with
+    // nullptr.  Replay the trace with BarrierOptimizer to see what a smarter schedule would save.
+    void CaptureBarriers( BarrierTrace* Trace ) { m_BarrierCapture = Trace; }
+
     void InsertTimeStamp( ID3D12QueryHeap* pQueryHeap, uint32_t QueryIdx );
     void ResolveTimeStamps( ID3D12Resource* pReadbackHeap, ID3D12QueryHeap* pQueryHeap, uint32_t NumQueries );
     void PIXBeginEvent(const wchar_t* label);
@@ -173,6 +183,17 @@ protected:
     D3D12_RESOURCE_BARRIER m_ResourceBarrierBuffer[16];
     UINT m_NumBarriersToFlush;
 
+    // Returns the last buffered barrier that names Resource, or nullptr
+    D3D12_RESOURCE_BARRIER* FindBufferedBarrier( ID3D12Resource* Resource );
+    void RemoveBufferedBarrier( D3D12_RESOURCE_BARRIER* Barrier );
+
+    void InsertUAVBarrier( GpuResource& Resource, bool FlushImmediate, bool Capture );
+
+    // Makes a resource that shares memory the one using it, leaving its contents undefined
+    void TakeOverMemory( GpuResource& Resource );
+
+    BarrierTrace* m_BarrierCapture;
+
     ID3D12DescriptorHeap* m_CurrentDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
     LinearAllocator m_CpuLinearAllocator;
@@ -303,6 +324,10 @@ private:
 
 inline void CommandContext::FlushResourceBarriers( void )
 {
+    // Barriers are flushed right before the work that needs them
+    if (m_BarrierCapture != nullptr)
+        m_BarrierCapture->RecordWork();
+
     if (m_NumBarriersToFlush > 0)
     {
         m_CommandList->ResourceBarrier(m_NumBarriersToFlush, m_ResourceBarrierBuffer);
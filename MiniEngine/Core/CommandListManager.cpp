@@ -192,9 +192,7 @@ void CommandListManager::WaitForFence(uint64_t FenceValue)
 
 ID3D12CommandAllocator* CommandQueue::RequestAllocator()
 {
-    uint64_t CompletedFence = m_pFence->GetCompletedValue();
-
-    return m_AllocatorPool.RequestAllocator(CompletedFence);
+    return m_AllocatorPool.RequestAllocator();
 }
 
 void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator)
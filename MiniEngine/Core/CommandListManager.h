@@ -47,6 +47,8 @@ public:
 
     uint64_t GetNextFenceValue() { return m_NextFenceValue; }
 
+    PageRecyclerStats GetAllocatorStats() const { return m_AllocatorPool.GetStats(); }
+
 private:
 
     uint64_t ExecuteCommandList(ID3D12CommandList* List);
@@ -973,7 +973,8 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
                                      _In_ size_t maxsize,
                                      _In_ bool forceSRGB,
                                      _Outptr_opt_ ID3D12Resource** texture,
-                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+                                     _Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* deferredInitData )
 {
     HRESULT hr = S_OK;
 
@@ -1182,7 +1183,14 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
             }
         }
 
-        if (SUCCEEDED(hr))
+        // Mips skipped to fit maxsize aren't in the texture
+        subresourceCount = static_cast<UINT>(mipCount - skipMip) * arraySize;
+
+        if (SUCCEEDED(hr) && deferredInitData != nullptr)
+        {
+            deferredInitData->assign(initData.get(), initData.get() + subresourceCount);
+        }
+        else if (SUCCEEDED(hr))
         {
             GpuResource DestTexture(*texture, D3D12_RESOURCE_STATE_COPY_DEST);
             CommandContext::InitializeTexture(DestTexture, subresourceCount, initData.get());
@@ -1231,7 +1239,8 @@ HRESULT CreateDDSTextureFromMemory(
     bool forceSRGB,
     ID3D12Resource** texture,
     D3D12_CPU_DESCRIPTOR_HANDLE textureView,
-    DDS_ALPHA_MODE* alphaMode )
+    DDS_ALPHA_MODE* alphaMode,
+    std::vector<D3D12_SUBRESOURCE_DATA>* deferredInitData )
 {
     if ( texture )
     {
@@ -1284,7 +1293,7 @@ HRESULT CreateDDSTextureFromMemory(
 
     HRESULT hr = CreateTextureFromDDS( d3dDevice,
                                        header, ddsData + offset, ddsDataSize - offset, maxsize,
-                                       forceSRGB, texture, textureView );
+                                       forceSRGB, texture, textureView, deferredInitData );
     if ( SUCCEEDED(hr) )
     {
         if (texture != nullptr && *texture != nullptr)
@@ -1338,10 +1347,166 @@ HRESULT CreateDDSTextureFromFile(
 
     hr = CreateTextureFromDDS( d3dDevice,
                                header, bitData, bitSize, maxsize,
-                               forceSRGB, texture, textureView );
+                               forceSRGB, texture, textureView, nullptr );
 
     if ( alphaMode )
         *alphaMode = GetAlphaMode( header );
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+// How a format is laid out in blocks, for the formats whose mips can be streamed
+//--------------------------------------------------------------------------------------
+static bool GetBlockInfo( _In_ DXGI_FORMAT fmt,
+                          _Out_ uint32_t& blockWidth,
+                          _Out_ uint32_t& blockHeight,
+                          _Out_ uint32_t& bytesPerBlock )
+{
+    blockWidth = 1;
+    blockHeight = 1;
+    bytesPerBlock = 0;
+
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        blockWidth = blockHeight = 4;
+        bytesPerBlock = 8;
+        return true;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        blockWidth = blockHeight = 4;
+        bytesPerBlock = 16;
+        return true;
+
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+        blockWidth = 2;
+        bytesPerBlock = 4;
+        return true;
+
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        blockWidth = 2;
+        bytesPerBlock = 8;
+        return true;
+
+    // Planar formats don't stream
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+    case DXGI_FORMAT_NV11:
+        return false;
+
+    default:
+        {
+            size_t bpp = BitsPerPixel( fmt );
+            if (bpp == 0 || (bpp % 8) != 0)
+            {
+                return false;
+            }
+            bytesPerBlock = static_cast<uint32_t>( bpp / 8 );
+        }
+        return true;
+    }
+}
+
+
+_Use_decl_annotations_
+HRESULT GetDDSMipChain(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    bool forceSRGB,
+    DXGI_FORMAT* format,
+    MipChainLayout& layout )
+{
+    if (!ddsData || !format)
+    {
+        return E_INVALIDARG;
+    }
+
+    *format = DXGI_FORMAT_UNKNOWN;
+
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)) ||
+        *( const uint32_t* )( ddsData ) != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    if (header->size != sizeof(DDS_HEADER) ||
+        header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    size_t offset = sizeof(DDS_HEADER) + sizeof(uint32_t);
+    DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
+
+    if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC))
+    {
+        offset += sizeof(DDS_HEADER_DXT10);
+        if (ddsDataSize < offset)
+        {
+            return E_FAIL;
+        }
+
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>( (const char*)header + sizeof(DDS_HEADER) );
+        if (d3d10ext->resourceDimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D ||
+            d3d10ext->arraySize != 1 ||
+            (d3d10ext->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE))
+        {
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        }
+        fmt = d3d10ext->dxgiFormat;
+    }
+    else
+    {
+        if ((header->flags & DDS_HEADER_FLAGS_VOLUME) || (header->caps2 & DDS_CUBEMAP))
+        {
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        }
+        fmt = GetDXGIFormat( header->ddspf );
+    }
+
+    uint32_t blockWidth, blockHeight, bytesPerBlock;
+    if (!GetBlockInfo( fmt, blockWidth, blockHeight, bytesPerBlock ) ||
+        header->width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+        header->height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+        header->mipMapCount > D3D12_REQ_MIP_LEVELS)
+    {
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    const uint32_t mipCount = header->mipMapCount ? header->mipMapCount : 1;
+    if (!layout.Create( offset, ddsDataSize, header->width, header->height, mipCount,
+        blockWidth, blockHeight, bytesPerBlock ))
+    {
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+
+    *format = forceSRGB ? MakeSRGB( fmt ) : fmt;
+    return S_OK;
+}
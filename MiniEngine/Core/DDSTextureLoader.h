@@ -21,6 +21,8 @@
 #pragma once
 
 #include <d3d12.h>
+#include <vector>
+#include "MipChainLayout.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -43,9 +45,13 @@ HRESULT __cdecl CreateDDSTextureFromMemory( _In_ ID3D12Device* d3dDevice,
                                                 _In_ bool forceSRGB,
                                                 _Outptr_opt_ ID3D12Resource** texture,
                                                 _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
-                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+                                                _Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* deferredInitData = nullptr
                                             );
 
+// With deferredInitData, CreateDDSTextureFromMemory() leaves the texture in the copy destination state and
+// describes its contents there, pointing into ddsData, for the caller to upload (see CommandContext::WriteTexture).
+
 HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             _In_z_ const wchar_t* szFileName,
                                             _In_ size_t maxsize,
@@ -55,4 +61,14 @@ HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                             );
 
+// Reads where each mip of a DDS file lives from its headers, so that the mips can be loaded a few at a time
+// (see StreamingTexture).  Only 2D textures that are neither arrays nor cube maps, in formats made of whole
+// bytes, are supported.  Others fail with ERROR_NOT_SUPPORTED and have to be loaded whole.
+HRESULT __cdecl GetDDSMipChain( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                _In_ size_t ddsDataSize,
+                                _In_ bool forceSRGB,
+                                _Out_ DXGI_FORMAT* format,
+                                _Out_ MipChainLayout& layout
+                              );
+
 size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
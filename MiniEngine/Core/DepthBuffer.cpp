@@ -40,14 +40,35 @@ void DepthBuffer::Create( const std::wstring& Name, uint32_t Width, uint32_t Hei
     CreateDerivedViews(Graphics::g_Device, Format);
 }
 
-void DepthBuffer::Create( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format, EsramAllocator& )
+void DepthBuffer::Create( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format, EsramAllocator& Allocator )
 {
-    Create(Name, Width, Height, Format);
+    Create(Name, Width, Height, 1, Format, Allocator);
 }
 
 void DepthBuffer::Create( const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t Samples, DXGI_FORMAT Format, EsramAllocator& Allocator )
 {
-    Create(Name, Width, Height, Samples, Format);
+    D3D12_RESOURCE_DESC ResourceDesc = DescribeTex2D(Width, Height, 1, 1, Format, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+    ResourceDesc.SampleDesc.Count = Samples;
+
+    D3D12_CLEAR_VALUE ClearValue = {};
+    ClearValue.Format = Format;
+
+    Allocator.AllocTexture(*this, ResourceDesc, [=]( ID3D12Heap* Heap, uint64_t HeapOffset )
+    {
+        CreateTextureResource(Graphics::g_Device, Name, ResourceDesc, ClearValue, Heap, HeapOffset, D3D12_RESOURCE_STATE_COMMON);
+        CreateDerivedViews(Graphics::g_Device, Format);
+    });
+}
+
+void DepthBuffer::CreatePlaced( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format,
+    ID3D12Heap* Heap, uint64_t HeapOffset )
+{
+    D3D12_RESOURCE_DESC ResourceDesc = DescribeTex2D(Width, Height, 1, 1, Format, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+    D3D12_CLEAR_VALUE ClearValue = {};
+    ClearValue.Format = Format;
+    CreateTextureResource(Graphics::g_Device, Name, ResourceDesc, ClearValue, Heap, HeapOffset, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    CreateDerivedViews(Graphics::g_Device, Format);
 }
 
 void DepthBuffer::CreateDerivedViews( ID3D12Device* Device, DXGI_FORMAT Format )
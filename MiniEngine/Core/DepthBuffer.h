@@ -37,11 +37,17 @@ public:
     void Create( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format,
         D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN );
 
-    // Create a depth buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows,
-    // this functions the same as Create() without a video address.
+    // Create a depth buffer.  Memory will be allocated in ESRAM (on Xbox One).  On Windows, it is
+    // placed in memory shared with buffers from other scopes, and created when the allocator's
+    // outermost scope is popped.
     void Create( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format,
         EsramAllocator& Allocator );
 
+    // Create a depth buffer at an offset within a heap that other placed resources may share.  It
+    // starts in DEPTH_WRITE, and must be discarded or cleared after an aliasing barrier.
+    void CreatePlaced( const std::wstring& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format,
+        ID3D12Heap* Heap, uint64_t HeapOffset );
+
     void Create(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t NumSamples, DXGI_FORMAT Format,
         D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN );
     void Create( const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t NumSamples, DXGI_FORMAT Format,
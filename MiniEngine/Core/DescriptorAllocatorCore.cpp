@@ -0,0 +1,302 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "DescriptorAllocatorCore.h"
+#include "BuddyAllocatorCore.h"
+#include <cassert>
+
+using namespace std;
+
+atomic<uint64_t> DescriptorAllocatorCore::sm_NextId(1);
+
+DescriptorAllocatorCore::DescriptorAllocatorCore( uint32_t DescriptorsPerHeap, HeapCreator CreateHeap,
+    FenceCheck IsFenceComplete, uint32_t ThreadCacheSize ) :
+    m_Id(sm_NextId++),
+    m_DescriptorsPerHeap(DescriptorsPerHeap),
+    m_ThreadCacheSize(ThreadCacheSize),
+    m_CreateHeap(CreateHeap),
+    m_IsFenceComplete(IsFenceComplete),
+    m_NumHeaps(0),
+    m_NextIndex(0),
+    m_HeapEnd(0),
+    m_Live(0),
+    m_Padding(0),
+    m_ThreadCached(0),
+    m_HighWaterLive(0),
+    m_PendingRelease(0),
+    m_Leaked(0)
+{
+    assert(DescriptorsPerHeap > 0);
+}
+
+DescriptorAllocatorCore::~DescriptorAllocatorCore()
+{
+}
+
+uint32_t DescriptorAllocatorCore::RoundUpCount( uint32_t Count )
+{
+    return 1u << BuddyAllocatorCore::UnitsToOrder(Count);
+}
+
+DescriptorAllocatorCore::ThreadCache& DescriptorAllocatorCore::GetThreadCache( void )
+{
+    static thread_local ThreadCacheSlot s_Slots[kCacheSlotsPerThread] = {};
+    static thread_local size_t s_NextSlot = 0;
+
+    for (ThreadCacheSlot& Slot : s_Slots)
+    {
+        if (Slot.OwnerId == m_Id && Slot.Cache != nullptr)
+            return *Slot.Cache;
+    }
+
+    // The allocator owns the cache so that it outlives the thread.  Descriptors left in the cache of a
+    // thread that exits stay idle until Destroy().
+    const thread::id ThisThread = this_thread::get_id();
+    ThreadCache* Cache = nullptr;
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        for (auto& Existing : m_ThreadCaches)
+        {
+            if (Existing->Owner == ThisThread)
+            {
+                Cache = Existing.get();
+                break;
+            }
+        }
+
+        if (Cache == nullptr)
+        {
+            Cache = new ThreadCache;
+            Cache->Indices.reserve(m_ThreadCacheSize + 1);
+            Cache->Owner = ThisThread;
+            m_ThreadCaches.emplace_back(Cache);
+        }
+    }
+
+    ThreadCacheSlot& Slot = s_Slots[s_NextSlot++ % kCacheSlotsPerThread];
+    Slot.OwnerId = m_Id;
+    Slot.Cache = Cache;
+    return *Cache;
+}
+
+uint32_t DescriptorAllocatorCore::Allocate( uint32_t Count )
+{
+    assert(Count > 0);
+
+    const uint32_t Order = BuddyAllocatorCore::UnitsToOrder(Count);
+    const uint32_t Size = 1u << Order;
+    if (Size > m_DescriptorsPerHeap)
+        return kInvalidIndex;
+
+    uint32_t Index;
+
+    if (Order == 0 && m_ThreadCacheSize > 0)
+    {
+        ThreadCache& Cache = GetThreadCache();
+        if (Cache.Indices.empty())
+        {
+            // Refill half way so that alternating allocations and frees don't bounce on the lock
+            uint32_t RefillCount = m_ThreadCacheSize / 2 > 0 ? m_ThreadCacheSize / 2 : 1;
+
+            lock_guard<mutex> Guard(m_Mutex);
+            for (uint32_t i = 0; i < RefillCount; ++i)
+                Cache.Indices.push_back(AllocateLocked(0));
+            m_ThreadCached.fetch_add(RefillCount, memory_order_relaxed);
+        }
+
+        Index = Cache.Indices.back();
+        Cache.Indices.pop_back();
+        m_ThreadCached.fetch_sub(1, memory_order_relaxed);
+    }
+    else
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        Index = AllocateLocked(Order);
+    }
+
+    uint64_t Live = m_Live.fetch_add(Size, memory_order_relaxed) + Size;
+    m_Padding.fetch_add(Size - Count, memory_order_relaxed);
+
+    uint64_t HighWater = m_HighWaterLive.load(memory_order_relaxed);
+    while (Live > HighWater && !m_HighWaterLive.compare_exchange_weak(HighWater, Live, memory_order_relaxed))
+        ;
+
+    return Index;
+}
+
+void DescriptorAllocatorCore::Free( uint32_t Index, uint32_t Count, uint64_t FenceValue )
+{
+    assert(Count > 0 && Index != kInvalidIndex);
+
+    const uint32_t Order = BuddyAllocatorCore::UnitsToOrder(Count);
+    const uint32_t Size = 1u << Order;
+
+    m_Live.fetch_sub(Size, memory_order_relaxed);
+    m_Padding.fetch_sub(Size - Count, memory_order_relaxed);
+
+    if (FenceValue == 0 && Order == 0 && m_ThreadCacheSize > 0)
+    {
+        ThreadCache& Cache = GetThreadCache();
+        Cache.Indices.push_back(Index);
+        m_ThreadCached.fetch_add(1, memory_order_relaxed);
+
+        if (Cache.Indices.size() > m_ThreadCacheSize)
+        {
+            // Give back the older half so that this thread keeps what it freed most recently
+            size_t NumToReturn = Cache.Indices.size() / 2;
+
+            lock_guard<mutex> Guard(m_Mutex);
+            for (size_t i = 0; i < NumToReturn; ++i)
+                FreeLocked(Cache.Indices[i], 0);
+            Cache.Indices.erase(Cache.Indices.begin(), Cache.Indices.begin() + NumToReturn);
+            m_ThreadCached.fetch_sub(NumToReturn, memory_order_relaxed);
+        }
+        return;
+    }
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    if (FenceValue == 0)
+    {
+        FreeLocked(Index, Order);
+    }
+    else
+    {
+        PendingFree Pending = { FenceValue, Index, Order };
+        m_Pending[(FenceValue >> 56) % kNumQueueTypes].push_back(Pending);
+        m_PendingRelease += Size;
+    }
+}
+
+void DescriptorAllocatorCore::Reclaim( void )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    ReclaimLocked();
+}
+
+void DescriptorAllocatorCore::ReclaimLocked( void )
+{
+    for (uint32_t Queue = 0; Queue < kNumQueueTypes; ++Queue)
+    {
+        // Fences on one queue complete in order, so stop at the first one that hasn't
+        deque<PendingFree>& Pending = m_Pending[Queue];
+        while (!Pending.empty() && m_IsFenceComplete(Pending.front().FenceValue))
+        {
+            FreeLocked(Pending.front().Index, Pending.front().Order);
+            m_PendingRelease -= 1ull << Pending.front().Order;
+            Pending.pop_front();
+        }
+    }
+}
+
+void DescriptorAllocatorCore::FreeLocked( uint32_t Index, uint32_t Order )
+{
+    m_FreeLists[Order].push_back(Index);
+}
+
+uint32_t DescriptorAllocatorCore::AllocateLocked( uint32_t Order )
+{
+    for (int Pass = 0; Pass < 2; ++Pass)
+    {
+        // Take the smallest free run that fits, returning the unused halves to the smaller lists
+        for (uint32_t FreeOrder = Order; FreeOrder < kMaxOrders; ++FreeOrder)
+        {
+            vector<uint32_t>& FreeList = m_FreeLists[FreeOrder];
+            if (FreeList.empty())
+                continue;
+
+            uint32_t Index = FreeList.back();
+            FreeList.pop_back();
+
+            while (FreeOrder > Order)
+            {
+                --FreeOrder;
+                m_FreeLists[FreeOrder].push_back(Index + (1u << FreeOrder));
+            }
+            return Index;
+        }
+
+        // Only check fences when there is nothing on hand
+        if (Pass == 0)
+            ReclaimLocked();
+    }
+
+    const uint32_t Size = 1u << Order;
+    if (m_NumHeaps == 0 || m_NextIndex + Size > m_HeapEnd)
+    {
+        assert((uint64_t)(m_NumHeaps + 1) * m_DescriptorsPerHeap < kInvalidIndex);
+
+        RetireHeapTail();
+        m_CreateHeap(m_NumHeaps);
+        m_NextIndex = m_NumHeaps * m_DescriptorsPerHeap;
+        m_HeapEnd = m_NextIndex + m_DescriptorsPerHeap;
+        ++m_NumHeaps;
+    }
+
+    uint32_t Index = m_NextIndex;
+    m_NextIndex += Size;
+    return Index;
+}
+
+void DescriptorAllocatorCore::RetireHeapTail( void )
+{
+    // Split whatever is left of the newest heap into power-of-two runs, largest first
+    while (m_NextIndex < m_HeapEnd)
+    {
+        uint32_t Remaining = m_HeapEnd - m_NextIndex;
+        uint32_t Order = 63 - BuddyAllocatorCore::CountLeadingZeros(Remaining);
+        m_FreeLists[Order].push_back(m_NextIndex);
+        m_NextIndex += 1u << Order;
+    }
+}
+
+void DescriptorAllocatorCore::Destroy( void )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    m_Leaked = m_Live.load(memory_order_relaxed);
+
+    for (uint32_t Order = 0; Order < kMaxOrders; ++Order)
+        m_FreeLists[Order].clear();
+    for (uint32_t Queue = 0; Queue < kNumQueueTypes; ++Queue)
+        m_Pending[Queue].clear();
+
+    // Threads may still hold pointers to their caches, so empty them rather than deleting them
+    for (auto& Cache : m_ThreadCaches)
+        Cache->Indices.clear();
+
+    m_NumHeaps = 0;
+    m_NextIndex = 0;
+    m_HeapEnd = 0;
+    m_Live = 0;
+    m_Padding = 0;
+    m_ThreadCached = 0;
+    m_HighWaterLive = 0;
+    m_PendingRelease = 0;
+}
+
+DescriptorAllocatorStats DescriptorAllocatorCore::GetStats( void ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+
+    DescriptorAllocatorStats Stats;
+    Stats.NumHeaps = m_NumHeaps;
+    Stats.Capacity = (uint64_t)m_NumHeaps * m_DescriptorsPerHeap;
+    Stats.Live = m_Live.load(memory_order_relaxed);
+    Stats.Padding = m_Padding.load(memory_order_relaxed);
+    Stats.ThreadCached = m_ThreadCached.load(memory_order_relaxed);
+    Stats.PendingRelease = m_PendingRelease;
+    Stats.Free = Stats.Capacity - Stats.Live - Stats.PendingRelease;
+    Stats.HighWaterLive = m_HighWaterLive.load(memory_order_relaxed);
+    Stats.Leaked = m_Leaked;
+    return Stats;
+}
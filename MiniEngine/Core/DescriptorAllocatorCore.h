@@ -0,0 +1,139 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The index management half of DescriptorAllocator, with no knowledge of D3D.  Descriptors
+// are numbered consecutively across a growing set of equally sized heaps, so index / DescriptorsPerHeap
+// is the heap and index % DescriptorsPerHeap the slot within it.
+//
+// Requests are rounded up to a power of two and freed runs go to a free list for that size.  A request
+// with an empty list splits a larger free run, and only then bump allocates from the newest heap.  Runs
+// never straddle heaps, because descriptor tables must be contiguous within one heap.
+//
+// Single descriptors make up almost all requests, so each thread keeps a small cache of them that it
+// can allocate from and free to without taking the lock.  Frees that carry a fence value wait in a
+// per-queue list until the fence has completed, because a descriptor that has been staged but not yet
+// copied into a shader-visible heap must not be overwritten.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct DescriptorAllocatorStats
+{
+    uint32_t NumHeaps;
+    uint64_t Capacity;          // Descriptors in all heaps
+    uint64_t Live;              // Allocated and not yet freed, including rounding
+    uint64_t Padding;           // Part of Live that was only allocated to round a request up
+    uint64_t Free;              // Available for reuse, including unused heap space and thread caches
+    uint64_t ThreadCached;      // Part of Free held by per-thread caches
+    uint64_t PendingRelease;    // Freed but waiting for a fence
+    uint64_t HighWaterLive;
+    uint64_t Leaked;            // Still live when the allocator was last destroyed
+};
+
+class DescriptorAllocatorCore
+{
+public:
+
+    static const uint32_t kInvalidIndex = ~0u;
+
+    typedef std::function<void (uint32_t HeapIndex)> HeapCreator;
+    typedef std::function<bool (uint64_t FenceValue)> FenceCheck;
+
+    // CreateHeap is called with the allocator lock held, before any index in the new heap is returned.
+    // IsFenceComplete receives fence values whose top byte is the queue type.
+    DescriptorAllocatorCore( uint32_t DescriptorsPerHeap, HeapCreator CreateHeap, FenceCheck IsFenceComplete,
+        uint32_t ThreadCacheSize = 32 );
+    ~DescriptorAllocatorCore();
+
+    // Returns the index of the first of Count consecutive descriptors, or kInvalidIndex if Count is
+    // larger than a heap
+    uint32_t Allocate( uint32_t Count );
+
+    // Returns descriptors to the allocator once FenceValue has completed, or right away if it is zero.
+    // Count must match the allocation.
+    void Free( uint32_t Index, uint32_t Count, uint64_t FenceValue = 0 );
+
+    // Moves deferred frees whose fences have completed to the free lists
+    void Reclaim( void );
+
+    // Forgets all heaps and allocations.  Anything still live is reported as leaked.
+    void Destroy( void );
+
+    DescriptorAllocatorStats GetStats( void ) const;
+    uint32_t GetDescriptorsPerHeap( void ) const { return m_DescriptorsPerHeap; }
+
+    static uint32_t RoundUpCount( uint32_t Count );
+
+private:
+
+    struct PendingFree
+    {
+        uint64_t FenceValue;
+        uint32_t Index;
+        uint32_t Order;
+    };
+
+    struct ThreadCache
+    {
+        std::vector<uint32_t> Indices;
+        std::thread::id Owner;
+    };
+
+    // Same scheme as PageRecycler: slots tagged with a never-reused allocator id.  A thread has exactly
+    // one cache per allocator, so an evicted slot is found again rather than replaced.
+    struct ThreadCacheSlot
+    {
+        uint64_t OwnerId;
+        ThreadCache* Cache;
+    };
+
+    static const uint32_t kNumQueueTypes = 4;
+    static const uint32_t kMaxOrders = 32;
+    static const size_t kCacheSlotsPerThread = 8;
+
+    ThreadCache& GetThreadCache( void );
+
+    // These require m_Mutex
+    uint32_t AllocateLocked( uint32_t Order );
+    void FreeLocked( uint32_t Index, uint32_t Order );
+    void ReclaimLocked( void );
+    void RetireHeapTail( void );
+
+    const uint64_t m_Id;
+    const uint32_t m_DescriptorsPerHeap;
+    const uint32_t m_ThreadCacheSize;
+    HeapCreator m_CreateHeap;
+    FenceCheck m_IsFenceComplete;
+
+    mutable std::mutex m_Mutex;
+    std::vector<uint32_t> m_FreeLists[kMaxOrders];
+    std::deque<PendingFree> m_Pending[kNumQueueTypes];
+    std::vector<std::unique_ptr<ThreadCache>> m_ThreadCaches;
+    uint32_t m_NumHeaps;
+    uint32_t m_NextIndex;       // Bump pointer into the newest heap
+    uint32_t m_HeapEnd;
+
+    std::atomic<uint64_t> m_Live;
+    std::atomic<uint64_t> m_Padding;
+    std::atomic<uint64_t> m_ThreadCached;
+    std::atomic<uint64_t> m_HighWaterLive;
+    uint64_t m_PendingRelease;
+    uint64_t m_Leaked;
+
+    static std::atomic<uint64_t> sm_NextId;
+};
@@ -24,11 +24,49 @@ using namespace Graphics;
 std::mutex DescriptorAllocator::sm_AllocationMutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::sm_DescriptorHeapPool;
 
+DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) :
+    m_Type(Type),
+    m_DescriptorSize(0),
+    m_Core(sm_NumDescriptorsPerHeap,
+        [this]( uint32_t HeapIndex ) { CreateHeap(HeapIndex); },
+        []( uint64_t FenceValue ) { return g_CommandManager.IsFenceComplete(FenceValue); }),
+    m_HeapStarts(new SIZE_T[sm_MaxNumHeaps])
+{
+}
+
 void DescriptorAllocator::DestroyAll(void)
 {
     sm_DescriptorHeapPool.clear();
 }
 
+void DescriptorAllocator::Destroy( void )
+{
+    m_Core.Destroy();
+
+    {
+        std::lock_guard<std::mutex> Guard(m_HeapLookupMutex);
+        m_HeapIndexByStart.clear();
+    }
+
+    DescriptorAllocatorStats Stats = m_Core.GetStats();
+    if (Stats.Leaked > 0)
+        DEBUGPRINT("Descriptor heap type %u:  %llu descriptors still allocated at shutdown", (uint32_t)m_Type, Stats.Leaked);
+}
+
+void DescriptorAllocator::CreateHeap( uint32_t HeapIndex )
+{
+    ASSERT(HeapIndex < sm_MaxNumHeaps, "Too many descriptor heaps.  Are descriptors being freed?");
+
+    if (m_DescriptorSize == 0)
+        m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+
+    SIZE_T Start = RequestNewHeap(m_Type)->GetCPUDescriptorHandleForHeapStart().ptr;
+    m_HeapStarts[HeapIndex] = Start;
+
+    std::lock_guard<std::mutex> Guard(m_HeapLookupMutex);
+    m_HeapIndexByStart[Start] = HeapIndex;
+}
+
 ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE Type)
 {
     std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
@@ -47,20 +85,31 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
 
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
-    {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
-        m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+    uint32_t Index = m_Core.Allocate(Count);
+    ASSERT(Index != DescriptorAllocatorCore::kInvalidIndex, "Descriptor allocation larger than a heap");
+
+    D3D12_CPU_DESCRIPTOR_HANDLE ret;
+    ret.ptr = m_HeapStarts[Index / sm_NumDescriptorsPerHeap] + (Index % sm_NumDescriptorsPerHeap) * m_DescriptorSize;
+    return ret;
+}
 
-        if (m_DescriptorSize == 0)
-            m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    uint32_t HeapIndex;
+    SIZE_T HeapStart;
+    {
+        std::lock_guard<std::mutex> Guard(m_HeapLookupMutex);
+        auto Iter = m_HeapIndexByStart.upper_bound(Handle.ptr);
+        ASSERT(Iter != m_HeapIndexByStart.begin(), "Descriptor was not allocated here");
+        --Iter;
+        HeapStart = Iter->first;
+        HeapIndex = Iter->second;
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
-    m_CurrentHandle.ptr += Count * m_DescriptorSize;
-    m_RemainingFreeHandles -= Count;
-    return ret;
+    uint32_t Slot = (uint32_t)((Handle.ptr - HeapStart) / m_DescriptorSize);
+    ASSERT(Slot + Count <= sm_NumDescriptorsPerHeap, "Descriptor was not allocated here");
+
+    m_Core.Free(HeapIndex * sm_NumDescriptorsPerHeap + Slot, Count, g_CommandManager.GetGraphicsQueue().GetNextFenceValue());
 }
 
 //
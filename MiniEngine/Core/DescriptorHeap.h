@@ -13,36 +13,59 @@
 
 #pragma once
 
+#include "DescriptorAllocatorCore.h"
 #include <mutex>
 #include <vector>
 #include <queue>
+#include <map>
 #include <string>
 
 
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible resource descriptors
 // as resources are created.  For those that need to be made shader-visible, they will need to be copied to a UserDescriptorHeap
 // or a DynamicDescriptorHeap.
+//
+// Freed descriptors are recycled once the GPU has finished with the command lists recorded before the free, so resources
+// can be streamed in and out without the heaps growing without bound.  See DescriptorAllocatorCore for the details.
 class DescriptorAllocator
 {
 public:
-    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_CurrentHeap(nullptr) {}
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type);
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
 
+    // Count must match the allocation.  A descriptor may still be staged in a DynamicDescriptorHeap, so it
+    // isn't reused until the graphics queue has passed its next fence.
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    DescriptorAllocatorStats GetStats( void ) const { return m_Core.GetStats(); }
+
+    // Releases this allocator's heaps.  Descriptors that were never freed are reported as leaked.
+    void Destroy( void );
+
     static void DestroyAll(void);
 
 protected:
 
     static const uint32_t sm_NumDescriptorsPerHeap = 256;
+    static const uint32_t sm_MaxNumHeaps = 4096;
     static std::mutex sm_AllocationMutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
+    // Called by the core with its lock held
+    void CreateHeap( uint32_t HeapIndex );
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
-    uint32_t m_RemainingFreeHandles;
+    DescriptorAllocatorCore m_Core;
+
+    // The start of each heap, by heap index.  Fixed size so that Allocate() can read it without a lock.
+    std::unique_ptr<SIZE_T[]> m_HeapStarts;
+
+    // Maps a heap's start back to its index for Free()
+    std::mutex m_HeapLookupMutex;
+    std::map<SIZE_T, uint32_t> m_HeapIndexByStart;
 };
 
 
@@ -17,9 +17,16 @@
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
 #include "RootSignature.h"
+#include "EngineTuning.h"
+#include "Hash.h"
 
 using namespace Graphics;
 
+namespace
+{
+    BoolVar s_EnableTableCache("Graphics/Descriptor Table Cache", true);
+}
+
 //
 // DynamicDescriptorHeap Implementation
 //
@@ -28,6 +35,18 @@ std::mutex DynamicDescriptorHeap::sm_Mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
 std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
 std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TableCacheLookups(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TableCacheHits(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_DescriptorCopiesSaved(0);
+
+DynamicDescriptorHeap::TableCacheStats DynamicDescriptorHeap::GetTableCacheStats( void )
+{
+    TableCacheStats Stats;
+    Stats.Lookups = sm_TableCacheLookups.load(std::memory_order_relaxed);
+    Stats.Hits = sm_TableCacheHits.load(std::memory_order_relaxed);
+    Stats.DescriptorCopiesSaved = sm_DescriptorCopiesSaved.load(std::memory_order_relaxed);
+    return Stats;
+}
 
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 {
@@ -82,6 +101,9 @@ void DynamicDescriptorHeap::RetireCurrentHeap( void )
     m_RetiredHeaps.push_back(m_CurrentHeapPtr);
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+
+    // Committed tables live in the retired heap and can't be bound from the next one
+    m_TableCache.Clear();
 }
 
 void DynamicDescriptorHeap::RetireUsedHeaps( uint64_t fenceValue )
@@ -124,6 +146,126 @@ inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
     return m_CurrentHeapPtr;
 }
 
+//
+// CommittedTableCache Implementation
+//
+
+void DynamicDescriptorHeap::CommittedTableCache::Clear( void )
+{
+    memset(m_Entries, 0, sizeof(m_Entries));
+}
+
+size_t DynamicDescriptorHeap::CommittedTableCache::HashTable( const DescriptorTableCache& Table )
+{
+    size_t Hash = Utility::HashState(&Table.AssignedHandlesBitMap);
+
+    unsigned long Index;
+    uint32_t SetHandles = Table.AssignedHandlesBitMap;
+    while (_BitScanForward(&Index, SetHandles))
+    {
+        SetHandles ^= (1 << Index);
+        Hash = Utility::HashState(&Table.TableStart[Index], 1, Hash);
+    }
+    return Hash;
+}
+
+uint32_t DynamicDescriptorHeap::CommittedTableCache::Find( const DescriptorTableCache& Table, size_t Hash ) const
+{
+    static const uint32_t kMaxProbes = 8;
+
+    for (uint32_t Probe = 0; Probe < kMaxProbes; ++Probe)
+    {
+        const Entry& Candidate = m_Entries[(Hash + Probe) & (kNumEntries - 1)];
+        if (Candidate.AssignedHandlesBitMap == 0)
+            return kNotFound;
+
+        if (Candidate.Hash != Hash || Candidate.AssignedHandlesBitMap != Table.AssignedHandlesBitMap)
+            continue;
+
+        // Compare against what was actually copied in case two tables share a hash
+        bool Match = true;
+        unsigned long Index;
+        uint32_t SetHandles = Table.AssignedHandlesBitMap;
+        while (Match && _BitScanForward(&Index, SetHandles))
+        {
+            SetHandles ^= (1 << Index);
+            Match = m_Sources[Candidate.HeapOffset + Index].ptr == Table.TableStart[Index].ptr;
+        }
+
+        if (Match)
+            return Candidate.HeapOffset;
+    }
+
+    return kNotFound;
+}
+
+void DynamicDescriptorHeap::CommittedTableCache::Insert( const DescriptorTableCache& Table, size_t Hash, uint32_t HeapOffset )
+{
+    static const uint32_t kMaxProbes = 8;
+
+    // Take the first empty slot in the probe sequence, otherwise evict the first one
+    Entry* Dest = &m_Entries[Hash & (kNumEntries - 1)];
+    for (uint32_t Probe = 0; Probe < kMaxProbes; ++Probe)
+    {
+        Entry& Candidate = m_Entries[(Hash + Probe) & (kNumEntries - 1)];
+        if (Candidate.AssignedHandlesBitMap == 0)
+        {
+            Dest = &Candidate;
+            break;
+        }
+    }
+
+    Dest->Hash = Hash;
+    Dest->AssignedHandlesBitMap = Table.AssignedHandlesBitMap;
+    Dest->HeapOffset = HeapOffset;
+
+    unsigned long Index;
+    uint32_t SetHandles = Table.AssignedHandlesBitMap;
+    while (_BitScanForward(&Index, SetHandles))
+    {
+        SetHandles ^= (1 << Index);
+        ASSERT(HeapOffset + Index < kNumDescriptorsPerHeap);
+        m_Sources[HeapOffset + Index] = Table.TableStart[Index];
+    }
+}
+
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::BindCommittedTables(
+    const CommittedTableCache& TableCache, DescriptorHandle HeapStart, uint32_t DescriptorSize,
+    ID3D12GraphicsCommandList* CmdList, void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
+{
+    uint32_t Lookups = 0;
+    uint32_t Hits = 0;
+    uint32_t CopiesSaved = 0;
+
+    unsigned long RootIndex;
+    uint32_t StaleParams = m_StaleRootParamsBitMap;
+    while (_BitScanForward(&RootIndex, StaleParams))
+    {
+        StaleParams ^= (1 << RootIndex);
+        ++Lookups;
+
+        const DescriptorTableCache& RootDescTable = m_RootDescriptorTable[RootIndex];
+        uint32_t HeapOffset = TableCache.Find(RootDescTable, CommittedTableCache::HashTable(RootDescTable));
+        if (HeapOffset == CommittedTableCache::kNotFound)
+            continue;
+
+        (CmdList->*SetFunc)(RootIndex, (HeapStart + HeapOffset * DescriptorSize).GetGpuHandle());
+        m_StaleRootParamsBitMap ^= (1 << RootIndex);
+
+        ++Hits;
+        CopiesSaved += __popcnt(RootDescTable.AssignedHandlesBitMap);
+    }
+
+    sm_TableCacheLookups.fetch_add(Lookups, std::memory_order_relaxed);
+    if (Hits > 0)
+    {
+        sm_TableCacheHits.fetch_add(Hits, std::memory_order_relaxed);
+        sm_DescriptorCopiesSaved.fetch_add(CopiesSaved, std::memory_order_relaxed);
+    }
+
+    return Hits;
+}
+
 uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
 {
     // Sum the maximum assigned offsets of stale descriptor tables to determine total needed space.
@@ -146,7 +288,8 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
 void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize,
     DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
-    void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
+    void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE),
+    CommittedTableCache* TableCache, uint32_t HeapOffset )
 {
     uint32_t StaleParamCount = 0;
     uint32_t TableSize[DescriptorHandleCache::kMaxNumDescriptorTables];
@@ -192,6 +335,10 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 
         DescriptorTableCache& RootDescTable = m_RootDescriptorTable[RootIndex];
 
+        if (TableCache != nullptr)
+            TableCache->Insert(RootDescTable, CommittedTableCache::HashTable(RootDescTable), HeapOffset);
+        HeapOffset += TableSize[i];
+
         D3D12_CPU_DESCRIPTOR_HANDLE* SrcHandles = RootDescTable.TableStart;
         uint64_t SetHandles = (uint64_t)RootDescTable.AssignedHandlesBitMap;
         D3D12_CPU_DESCRIPTOR_HANDLE CurDest = DestHandleStart.GetCpuHandle();
@@ -249,6 +396,18 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
+    const bool UseTableCache = s_EnableTableCache;
+
+    // Bind whatever is already in the current heap.  The heap stays alive until the fence of the
+    // command list that retires it, so its tables remain valid for the rest of this context.
+    if (UseTableCache && m_CurrentHeapPtr != nullptr)
+    {
+        m_OwningContext.SetDescriptorHeap(m_DescriptorType, m_CurrentHeapPtr);
+        HandleCache.BindCommittedTables(m_TableCache, m_FirstDescriptor, m_DescriptorSize, CmdList, SetFunc);
+        if (HandleCache.m_StaleRootParamsBitMap == 0)
+            return;
+    }
+
     uint32_t NeededSize = HandleCache.ComputeStagedSize();
     if (!HasSpace(NeededSize))
     {
@@ -259,7 +418,9 @@ void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& Hand
 
     // This can trigger the creation of a new heap
     m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
-    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+    uint32_t HeapOffset = m_CurrentOffset;
+    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc,
+        UseTableCache ? &m_TableCache : nullptr, HeapOffset);
 }
 
 void DynamicDescriptorHeap::UnbindAllValid( void )
@@ -15,6 +15,7 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include <atomic>
 #include <vector>
 #include <queue>
 
@@ -26,9 +27,25 @@ namespace Graphics
 // This class is a linear allocation system for dynamically generated descriptor tables.  It internally caches
 // CPU descriptor handles so that when not enough space is available in the current heap, necessary descriptors
 // can be re-copied to the new heap.
+//
+// It also remembers which tables have already been copied into the current heap.  When a draw stages the same
+// handles again (typically when switching back to a material that was used earlier), the existing copy is
+// bound instead of making a new one.  This assumes that the contents of a CPU descriptor are not rewritten in
+// place while a context is recording commands that use it.
 class DynamicDescriptorHeap
 {
 public:
+
+    struct TableCacheStats
+    {
+        uint64_t Lookups;
+        uint64_t Hits;
+        uint64_t DescriptorCopiesSaved;
+    };
+
+    // Totals across all contexts since startup
+    static TableCacheStats GetTableCacheStats( void );
+
     DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
     ~DynamicDescriptorHeap();
 
@@ -109,6 +126,39 @@ private:
         uint32_t TableSize;
     };
 
+    // Descriptor tables that have been copied into the current heap, keyed by their contents
+    struct CommittedTableCache
+    {
+        static const uint32_t kNumEntries = 256;
+        static const uint32_t kNotFound = ~0u;
+
+        CommittedTableCache() { Clear(); }
+
+        void Clear( void );
+        uint32_t Find( const DescriptorTableCache& Table, size_t Hash ) const;
+        void Insert( const DescriptorTableCache& Table, size_t Hash, uint32_t HeapOffset );
+
+        static size_t HashTable( const DescriptorTableCache& Table );
+
+        struct Entry
+        {
+            size_t Hash;
+            uint32_t AssignedHandlesBitMap;     // Zero when the entry is empty
+            uint32_t HeapOffset;
+        };
+
+        Entry m_Entries[kNumEntries];
+
+        // The source of every descriptor copied into the current heap, used to confirm a hash match
+        D3D12_CPU_DESCRIPTOR_HANDLE m_Sources[kNumDescriptorsPerHeap];
+    };
+
+    CommittedTableCache m_TableCache;
+
+    static std::atomic<uint64_t> sm_TableCacheLookups;
+    static std::atomic<uint64_t> sm_TableCacheHits;
+    static std::atomic<uint64_t> sm_DescriptorCopiesSaved;
+
     struct DescriptorHandleCache
     {
         DescriptorHandleCache()
@@ -131,7 +181,12 @@ private:
 
         uint32_t ComputeStagedSize();
         void CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
-            void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
+            void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE),
+            CommittedTableCache* TableCache, uint32_t HeapOffset );
+
+        // Binds stale tables that are already in the current heap and clears their stale bits
+        uint32_t BindCommittedTables( const CommittedTableCache& TableCache, DescriptorHandle HeapStart, uint32_t DescriptorSize,
+            ID3D12GraphicsCommandList* CmdList, void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
 
         DescriptorTableCache m_RootDescriptorTable[kMaxNumDescriptorTables];
         D3D12_CPU_DESCRIPTOR_HANDLE m_HandleCache[kMaxNumDescriptors];
@@ -19,6 +19,7 @@
 #include "GameInput.h"
 #include "GpuTimeManager.h"
 #include "CommandContext.h"
+#include "DynamicDescriptorHeap.h"
 #include <vector>
 #include <unordered_map>
 #include <array>
@@ -425,6 +426,10 @@ namespace EngineProfiling
     BoolVar DrawProfiler("Display Profiler", false);
     //BoolVar DrawPerfGraph("Display Performance Graph", false);
     const bool DrawPerfGraph = false;
+
+    // Descriptor table cache activity during the last frame
+    DynamicDescriptorHeap::TableCacheStats s_TableCacheTotals = {};
+    DynamicDescriptorHeap::TableCacheStats s_TableCacheFrame = {};
     
     void Update( void )
     {
@@ -434,6 +439,12 @@ namespace EngineProfiling
             Paused = !Paused;
         }
         NestedTimingTree::UpdateTimes();
+
+        DynamicDescriptorHeap::TableCacheStats Totals = DynamicDescriptorHeap::GetTableCacheStats();
+        s_TableCacheFrame.Lookups = Totals.Lookups - s_TableCacheTotals.Lookups;
+        s_TableCacheFrame.Hits = Totals.Hits - s_TableCacheTotals.Hits;
+        s_TableCacheFrame.DescriptorCopiesSaved = Totals.DescriptorCopiesSaved - s_TableCacheTotals.DescriptorCopiesSaved;
+        s_TableCacheTotals = Totals;
     }
 
     void BeginBlock(const wstring& name, CommandContext* Context)
@@ -491,6 +502,12 @@ namespace EngineProfiling
             Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
 
             NestedTimingTree::Display( Text, x );
+
+            Text.SetColor(Color(0.8f, 0.8f, 0.8f));
+            Text.DrawFormattedString("Descriptor tables: %llu bound, %.1f%% reused, %llu copies saved\n",
+                s_TableCacheFrame.Lookups,
+                s_TableCacheFrame.Lookups == 0 ? 0.0f : 100.0f * s_TableCacheFrame.Hits / s_TableCacheFrame.Lookups,
+                s_TableCacheFrame.DescriptorCopiesSaved);
         }
 
         Text.GetCommandContext().SetScissor(0, 0, g_DisplayWidth, g_DisplayHeight);
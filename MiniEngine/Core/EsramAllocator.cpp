@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "EsramAllocator.h"
+#include "GpuResource.h"
+#include "GraphicsCore.h"
+
+using namespace Graphics;
+using namespace std;
+
+void EsramAllocator::PushStack()
+{
+    // A new layout begins when the first scope opens
+    if (m_OpenScopes.empty())
+    {
+        m_Clock = 0;
+        m_Scopes.clear();
+        m_Requests.clear();
+    }
+
+    Scope NewScope = { m_Clock++, 0 };
+    m_OpenScopes.push_back((uint32_t)m_Scopes.size());
+    m_Scopes.push_back(NewScope);
+}
+
+void EsramAllocator::PopStack()
+{
+    ASSERT(!m_OpenScopes.empty(), "Unbalanced EsramAllocator scopes");
+
+    m_Scopes[m_OpenScopes.back()].End = m_Clock++;
+    m_OpenScopes.pop_back();
+
+    if (m_OpenScopes.empty())
+        CreatePlacedTextures();
+}
+
+void EsramAllocator::AllocTexture( GpuResource& Resource, const D3D12_RESOURCE_DESC& Desc, const CreateFunction& Create )
+{
+    ASSERT(!m_OpenScopes.empty(), "Textures must be allocated within a scope");
+    ASSERT(Desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+
+    Request NewRequest;
+    NewRequest.Resource = &Resource;
+    NewRequest.Scope = m_OpenScopes.back();
+    NewRequest.AllocationInfo = g_Device->GetResourceAllocationInfo(0, 1, &Desc);
+    NewRequest.Create = Create;
+    m_Requests.push_back(NewRequest);
+}
+
+void EsramAllocator::CreatePlacedTextures( void )
+{
+    // Textures from the last layout that aren't recreated stop sharing memory
+    for (GpuResource* Resource : m_Placed)
+        Resource->m_SharesMemoryWith = nullptr;
+    m_Placed.clear();
+
+    m_Placement.Clear();
+    for (const Request& Texture : m_Requests)
+    {
+        const Scope& Lifetime = m_Scopes[Texture.Scope];
+        m_Placement.AddInterval(Lifetime.Begin, Lifetime.End, Texture.AllocationInfo.SizeInBytes, Texture.AllocationInfo.Alignment);
+    }
+
+    const uint64_t HeapSize = m_Placement.Allocate();
+    ASSERT(m_Placement.Validate());
+
+    // The old heap stays alive until the textures in it have been recreated
+    Microsoft::WRL::ComPtr<ID3D12Heap> OldHeap = m_Heap;
+    m_Heap = nullptr;
+
+    if (HeapSize > 0)
+    {
+        D3D12_HEAP_DESC HeapDesc = {};
+        HeapDesc.SizeInBytes = HeapSize;
+        HeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        HeapDesc.Alignment = m_Placement.GetHeapAlignment() > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT ?
+            D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        HeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+        ASSERT_SUCCEEDED(g_Device->CreateHeap(&HeapDesc, MY_IID_PPV_ARGS(&m_Heap)));
+        m_Heap->SetName(L"Rendering Buffer Heap");
+    }
+
+    const uint32_t NumTextures = (uint32_t)m_Requests.size();
+
+    m_SharesMemoryWith.assign(NumTextures, vector<GpuResource*>());
+    for (uint32_t i = 0; i < NumTextures; ++i)
+    {
+        for (uint32_t j = 0; j < NumTextures; ++j)
+        {
+            if (i != j && m_Placement.MemoryOverlaps(i, j))
+                m_SharesMemoryWith[i].push_back(m_Requests[j].Resource);
+        }
+    }
+
+    for (uint32_t i = 0; i < NumTextures; ++i)
+    {
+        Request& Texture = m_Requests[i];
+        Texture.Create(m_Heap.Get(), m_Placement.GetOffset(i));
+
+        // Even a texture with memory of its own has to be discarded before its first use
+        GpuResource& Resource = *Texture.Resource;
+        Resource.m_SharesMemoryWith = &m_SharesMemoryWith[i];
+        Resource.m_OwnsMemory = false;
+        m_Placed.push_back(&Resource);
+    }
+
+    // The functions hold on to names and descriptions that are no longer needed
+    m_Requests.clear();
+}
+
+void EsramAllocator::Destroy( void )
+{
+    for (GpuResource* Resource : m_Placed)
+        Resource->m_SharesMemoryWith = nullptr;
+
+    m_Placed.clear();
+    m_SharesMemoryWith.clear();
+    m_Placement.Clear();
+    m_Heap = nullptr;
+}
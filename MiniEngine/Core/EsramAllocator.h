@@ -10,18 +10,30 @@
 //
 // Author:  James Stanard 
 //
+// Description:  On Xbox One, the stack of scopes places buffers in ESRAM.  Windows has no ESRAM, but the
+// scopes still say which buffers are in use together, so render targets and depth buffers are placed in
+// one heap instead.  A texture is live for the whole of the scope it was created in, including the scopes
+// nested in it, and textures whose scopes don't nest share memory.  IntervalAllocator does the placement.
+//
+// Creation is deferred until the outermost scope is popped, when every lifetime is known.  A texture that
+// shares memory takes it back on its first transition after another texture used it (see
+// CommandContext::TakeOverMemory), so the first thing done to it in a scope must write all of it.
 
 #pragma once
 
 #include "pch.h"
+#include "IntervalAllocator.h"
+#include <functional>
+
+class GpuResource;
 
 class EsramAllocator
 {
 public:
-    EsramAllocator() {}
+    EsramAllocator() : m_Clock(0) {}
 
-    void PushStack() {}
-    void PopStack() {}
+    void PushStack();
+    void PopStack();
 
     D3D12_GPU_VIRTUAL_ADDRESS Alloc( size_t size, size_t align, const std::wstring& bufferName )
     {
@@ -34,4 +46,42 @@ public:
         return 0;
     }
 
+    // Create is called with the texture's place in the heap when the outermost scope is popped.  The
+    // texture must allow render target or depth stencil use.
+    typedef std::function<void (ID3D12Heap* Heap, uint64_t HeapOffset)> CreateFunction;
+    void AllocTexture( GpuResource& Resource, const D3D12_RESOURCE_DESC& Desc, const CreateFunction& Create );
+
+    // Releases the heap.  The textures placed in it must already be destroyed.
+    void Destroy( void );
+
+    // The last placement.  Interval i is the ith texture allocated.
+    const IntervalAllocator& GetPlacement( void ) const { return m_Placement; }
+
+private:
+
+    struct Scope
+    {
+        uint32_t Begin;
+        uint32_t End;
+    };
+
+    struct Request
+    {
+        GpuResource* Resource;
+        uint32_t Scope;
+        D3D12_RESOURCE_ALLOCATION_INFO AllocationInfo;
+        CreateFunction Create;
+    };
+
+    void CreatePlacedTextures( void );
+
+    uint32_t m_Clock;
+    std::vector<Scope> m_Scopes;
+    std::vector<uint32_t> m_OpenScopes;
+    std::vector<Request> m_Requests;
+
+    IntervalAllocator m_Placement;
+    Microsoft::WRL::ComPtr<ID3D12Heap> m_Heap;
+    std::vector<GpuResource*> m_Placed;
+    std::vector<std::vector<GpuResource*>> m_SharesMemoryWith;     // By texture in m_Placed
 };
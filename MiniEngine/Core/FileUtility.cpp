@@ -13,9 +13,10 @@
 
 #include "pch.h"
 #include "FileUtility.h"
-#include <fstream>
+#include "ChunkedFile.h"
+#include "JobSystem.h"
+#include "ZipStream.h"
 #include <mutex>
-#include <zlib.h> // From NuGet package 
 
 using namespace std;
 using namespace Utility;
@@ -25,30 +26,31 @@ namespace Utility
     ByteArray NullFile = make_shared<vector<byte> > (vector<byte>() );
 }
 
-ByteArray DecompressZippedFile( wstring& fileName );
+ByteArray DecompressZippedFile( const wstring& fileName, const InflateCallback& OnChunk = nullptr );
+ByteArray DecompressChunkedFile( const wstring& fileName );
 
 ByteArray ReadFileHelper(const wstring& fileName)
 {
-    struct _stat64 fileStat;
-    int fileExists = _wstat64(fileName.c_str(), &fileStat);
-    if (fileExists == -1)
-        return NullFile;
-
-    ifstream file( fileName, ios::in | ios::binary );
-    if (!file)
+    // Copying out of a mapping skips the stream buffer and the seeks to find the size
+    MappedFile file;
+    if (!file.Open(fileName))
+    {
+        // An empty file can't be mapped, but it is still there to be read
+        uint64_t size;
+        if (MappedFile::GetFileSize(fileName, size) && size == 0)
+            return make_shared<vector<byte> >();
         return NullFile;
+    }
 
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( file.seekg(0, ios::end).tellg() );
-    file.seekg(0, ios::beg).read( (char*)byteArray->data(), byteArray->size() );
-    file.close();
-
-    ASSERT(byteArray->size() == (size_t)fileStat.st_size);
-
-    return byteArray;
+    return make_shared<vector<byte> >( file.GetData(), file.GetData() + file.GetSize() );
 }
 
 ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
 {
+    ByteArray chunkedFile = DecompressChunkedFile(*fileName + L".cz");
+    if (chunkedFile != NullFile)
+        return chunkedFile;
+
     std::wstring zippedFileName = *fileName + L".gz";
     ByteArray firstTry = DecompressZippedFile(zippedFileName);
     if (firstTry != NullFile)
@@ -57,66 +59,25 @@ ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
     return ReadFileHelper(*fileName);
 }
 
-ByteArray Inflate(ByteArray CompressedSource, int& err, uint32_t ChunkSize = 0x100000 ) 
+// Decompresses a gzip or zlib stream in one pass, straight into the buffer that is returned
+ByteArray Inflate(const byte* CompressedSource, size_t CompressedSize, int& err, const InflateCallback& OnChunk = nullptr)
 {
-    // Create a dynamic buffer to hold compressed blocks
-    vector<unique_ptr<byte> > blocks;
-
-    z_stream strm  = {};
-    strm.data_type = Z_BINARY;
-    strm.total_in  = strm.avail_in  = (uInt)CompressedSource->size();
-    strm.next_in   = CompressedSource->data();
-
-    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
-
-    while (err == Z_OK || err == Z_BUF_ERROR)
-    {
-        strm.avail_out = ChunkSize;
-        strm.next_out = (byte*)malloc(ChunkSize);
-        blocks.emplace_back(strm.next_out);
-        err = inflate(&strm, Z_NO_FLUSH);
-    }
-
-    if (err != Z_STREAM_END) 
-    {
-        inflateEnd(&strm);
+    Utility::ByteArray byteArray = make_shared<vector<byte> >();
+    if (!ZipStream::Inflate(CompressedSource, CompressedSize, *byteArray, err, OnChunk))
         return NullFile;
-    }
-
-    ASSERT(strm.total_out > 0, "Nothing to decompress");
-
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( strm.total_out );
-
-    // Allocate actual memory for this.
-    // copy the bits into that RAM.
-    // Free everything else up!!
-    void* curDest = byteArray->data();
-    size_t remaining = byteArray->size();
-
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-        ASSERT(remaining > 0);
-
-        size_t CopySize = min(remaining, (size_t)ChunkSize);
-
-        memcpy(curDest, blocks[i].get(), CopySize);
-        curDest = (byte*)curDest + CopySize;
-        remaining -= CopySize;
-    }
-
-    inflateEnd(&strm);
 
     return byteArray;
 }
 
-ByteArray DecompressZippedFile( wstring& fileName )
+ByteArray DecompressZippedFile( const wstring& fileName, const InflateCallback& OnChunk )
 {
-    ByteArray CompressedFile = ReadFileHelper(fileName);
-    if (CompressedFile == NullFile)
+    // zlib reads the compressed bytes straight from the mapping
+    MappedFile CompressedFile;
+    if (!CompressedFile.Open(fileName))
         return NullFile;
 
     int error;
-    ByteArray DecompressedFile = Inflate(CompressedFile, error);
+    ByteArray DecompressedFile = Inflate(CompressedFile.GetData(), CompressedFile.GetSize(), error, OnChunk);
     if (DecompressedFile->size() == 0)
     {
         Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
@@ -126,13 +87,60 @@ ByteArray DecompressZippedFile( wstring& fileName )
     return DecompressedFile;
 }
 
+ByteArray DecompressChunkedFile( const wstring& fileName )
+{
+    MappedFile CompressedFile;
+    if (!CompressedFile.Open(fileName))
+        return NullFile;
+
+    const uint64_t UncompressedSize = ChunkedFile::GetUncompressedSize(CompressedFile.GetData(), CompressedFile.GetSize());
+    if (UncompressedSize == 0 || UncompressedSize > SIZE_MAX)
+    {
+        Utility::Printf(L"Not a chunked file:  %s\n", fileName.c_str());
+        return NullFile;
+    }
+
+    Utility::ByteArray byteArray = make_shared<vector<byte> >( (size_t)UncompressedSize );
+    if (!ChunkedFile::Decompress(CompressedFile.GetData(), CompressedFile.GetSize(), byteArray->data(), JobSystem::g_Scheduler))
+    {
+        Utility::Printf(L"Couldn't decompress chunked file %s\n", fileName.c_str());
+        return NullFile;
+    }
+
+    return byteArray;
+}
+
+IoScheduler Utility::g_IoScheduler( []( const wstring& fileName ) { return ReadFileHelperEx(make_shared<wstring>(fileName)); } );
+
 ByteArray Utility::ReadFileSync( const wstring& fileName)
 {
     return ReadFileHelperEx(make_shared<wstring>(fileName));
 }
 
-task<ByteArray> Utility::ReadFileAsync(const wstring& fileName)
+task<ByteArray> Utility::ReadFileAsync(const wstring& fileName, IoScheduler::PriorityClass priority, const IoCancelToken& cancel)
 {
-    shared_ptr<wstring> SharedPtr = make_shared<wstring>(fileName);
-    return create_task( [=] { return ReadFileHelperEx(SharedPtr); } );
+    task_completion_event<ByteArray> Done;
+    g_IoScheduler.Read(fileName, priority, cancel, [Done]( const ByteArray& Data ) { Done.set(Data != nullptr ? Data : NullFile); });
+    return create_task(Done);
+}
+
+ByteView Utility::MapFileSync( const wstring& fileName, const InflateCallback& OnChunk )
+{
+    // The blocks of a chunked file finish in no particular order, so it is handed over whole
+    ByteArray Decompressed = DecompressChunkedFile(fileName + L".cz");
+    if (Decompressed != NullFile)
+    {
+        if (OnChunk)
+            OnChunk(Decompressed->data(), Decompressed->size());
+        return ByteView(Decompressed, Decompressed->data(), Decompressed->size());
+    }
+
+    Decompressed = DecompressZippedFile(fileName + L".gz", OnChunk);
+    if (Decompressed != NullFile)
+        return ByteView(Decompressed, Decompressed->data(), Decompressed->size());
+
+    ByteView File = MappedFile::Map(fileName);
+    if (OnChunk && !File.empty())
+        OnChunk(File.data(), File.size());
+    return File;
 }
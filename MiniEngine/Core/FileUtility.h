@@ -14,8 +14,11 @@
 #pragma once
 
 #include "pch.h"
+#include "MappedFile.h"
+#include "IoScheduler.h"
 #include <vector>
 #include <string>
+#include <functional>
 #include <ppl.h>
 
 namespace Utility
@@ -26,12 +29,29 @@ namespace Utility
     typedef shared_ptr<vector<byte> > ByteArray;
     extern ByteArray NullFile;
 
+    // Receives a file in order, piece by piece, as it is decompressed.  The bytes are only valid during the call.
+    typedef function<void (const byte* data, size_t size)> InflateCallback;
+
     // Reads the entire contents of a binary file.  If the file with the same name except with an additional
-    // ".gz" suffix exists, it will be loaded and decompressed instead.
+    // ".cz" or ".gz" suffix exists, it will be loaded and decompressed instead.  ".cz" files (see ChunkedFile.h)
+    // are decompressed on every core.
     // This operation blocks until the entire file is read.
     ByteArray ReadFileSync(const wstring& fileName);
 
-    // Same as previous except that it does not block but instead returns a task.
-    task<ByteArray> ReadFileAsync(const wstring& fileName);
+    // Reads for ReadFileAsync().  It is started by GameCore, and until then reads happen on the calling thread.
+    extern IoScheduler g_IoScheduler;
+
+    // Same as previous except that it does not block but instead returns a task.  The read waits its turn on
+    // g_IoScheduler, behind more urgent ones, and joins a read of the same file that is already under way.
+    // A read that is cancelled before it starts yields NullFile.
+    task<ByteArray> ReadFileAsync(const wstring& fileName, IoScheduler::PriorityClass priority = IoScheduler::kVisible,
+        const IoCancelToken& cancel = IoCancelToken());
+
+    // Like ReadFileSync(), but the file is mapped rather than copied, so loaders that only read the bytes can
+    // parse them straight from the file cache.  A ".cz" or ".gz" file is decompressed into memory that the view owns.
+    // The view is empty if neither file can be read.  OnChunk, if given, sees the data as it is decompressed,
+    // so that work on the start of the file can overlap inflating the rest.  Uncompressed and chunked files
+    // arrive in one piece.
+    ByteView MapFileSync(const wstring& fileName, const InflateCallback& OnChunk = nullptr);
 
 } // namespace Utility
@@ -0,0 +1,283 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "FrameGraph.h"
+#include "CommandContext.h"
+#include "CommandListManager.h"
+#include "GraphicsCore.h"
+
+using namespace Graphics;
+using namespace std;
+
+uint32_t FrameGraph::Import( const string& Name, GpuResource& Resource, bool IsOutput, D3D12_RESOURCE_STATES FinalState )
+{
+    uint32_t Handle = m_Compiler.ImportResource(Name, Resource.GetUsageState(), IsOutput, FinalState);
+    m_Resources.push_back(&Resource);
+    m_TransientIndex.push_back(FrameGraphCompiler::kInvalidIndex);
+    return Handle;
+}
+
+uint32_t FrameGraph::CreateColorBuffer( const string& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format )
+{
+    return CreateTransient(Name, false, Width, Height, Format);
+}
+
+uint32_t FrameGraph::CreateDepthBuffer( const string& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format )
+{
+    return CreateTransient(Name, true, Width, Height, Format);
+}
+
+uint32_t FrameGraph::CreateTransient( const string& Name, bool IsDepth, uint32_t Width, uint32_t Height, DXGI_FORMAT Format )
+{
+    // Transients are matched to last frame's by the order they are created in
+    if (m_NumTransients == m_Transients.size())
+        m_Transients.emplace_back(new Transient);
+
+    Transient& Entry = *m_Transients[m_NumTransients];
+    if (Entry.Name != Name || Entry.IsDepth != IsDepth || Entry.Width != Width || Entry.Height != Height || Entry.Format != Format)
+    {
+        Entry.Name = Name;
+        Entry.IsDepth = IsDepth;
+        Entry.Width = Width;
+        Entry.Height = Height;
+        Entry.Format = Format;
+        Entry.HeapOffset = FrameGraphCompiler::kUnplaced;
+
+        // Matches the description ColorBuffer and DepthBuffer use.  A typeless format takes the same space.
+        D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Tex2D(Format, Width, Height, 1, 1, 1, 0, IsDepth ?
+            D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL :
+            D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        Entry.AllocationInfo = g_Device->GetResourceAllocationInfo(0, 1, &Desc);
+    }
+
+    D3D12_RESOURCE_STATES InitialState = IsDepth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET;
+    uint32_t Handle = m_Compiler.CreateTransient(Name, Entry.AllocationInfo.SizeInBytes, Entry.AllocationInfo.Alignment, InitialState);
+    m_Resources.push_back(&Entry.GetResource());
+    m_TransientIndex.push_back(m_NumTransients++);
+    return Handle;
+}
+
+ColorBuffer& FrameGraph::GetColorBuffer( uint32_t Resource )
+{
+    ASSERT(m_TransientIndex[Resource] != FrameGraphCompiler::kInvalidIndex && !m_Transients[m_TransientIndex[Resource]]->IsDepth);
+    return m_Transients[m_TransientIndex[Resource]]->Color;
+}
+
+DepthBuffer& FrameGraph::GetDepthBuffer( uint32_t Resource )
+{
+    ASSERT(m_TransientIndex[Resource] != FrameGraphCompiler::kInvalidIndex && m_Transients[m_TransientIndex[Resource]]->IsDepth);
+    return m_Transients[m_TransientIndex[Resource]]->Depth;
+}
+
+uint32_t FrameGraph::AddPass( const string& Name, PassFunction Execute, FrameGraphCompiler::QueueType Queue, bool HasSideEffects )
+{
+    m_PassFunctions.push_back(Execute);
+    return m_Compiler.AddPass(Name, Queue, HasSideEffects);
+}
+
+void FrameGraph::Read( uint32_t Pass, uint32_t Resource, D3D12_RESOURCE_STATES State )
+{
+    m_Compiler.Read(Pass, Resource, State);
+}
+
+void FrameGraph::Write( uint32_t Pass, uint32_t Resource, D3D12_RESOURCE_STATES State )
+{
+    m_Compiler.Write(Pass, Resource, State);
+}
+
+void FrameGraph::Reset( void )
+{
+    m_Compiler.Clear();
+    m_PassFunctions.clear();
+    m_Resources.clear();
+    m_TransientIndex.clear();
+    m_NumTransients = 0;
+}
+
+void FrameGraph::Destroy( void )
+{
+    Reset();
+    m_Transients.clear();
+    m_Heap = nullptr;
+    m_HeapSize = 0;
+}
+
+void FrameGraph::PlaceTransients( void )
+{
+    bool NewHeap = m_Plan.TransientHeapSize > m_HeapSize;
+    bool AnyMoved = NewHeap;
+
+    for (uint32_t Res = 0; Res < (uint32_t)m_Resources.size() && !AnyMoved; ++Res)
+    {
+        const uint64_t Offset = m_Plan.TransientOffsets[Res];
+        if (Offset != FrameGraphCompiler::kUnplaced)
+            AnyMoved = m_Transients[m_TransientIndex[Res]]->HeapOffset != Offset;
+    }
+
+    if (!AnyMoved)
+        return;
+
+    // Placement only changes when the frame's transients do, so waiting for the GPU here is rare
+    g_CommandManager.IdleGPU();
+
+    if (NewHeap)
+    {
+        D3D12_HEAP_DESC HeapDesc = {};
+        HeapDesc.SizeInBytes = m_Plan.TransientHeapSize;
+        HeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        HeapDesc.Alignment = m_Plan.TransientHeapAlignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT ?
+            D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        HeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+        m_Heap = nullptr;
+        ASSERT_SUCCEEDED(g_Device->CreateHeap(&HeapDesc, MY_IID_PPV_ARGS(&m_Heap)));
+        m_HeapSize = m_Plan.TransientHeapSize;
+
+        // Everything in the old heap has to move
+        for (auto& Entry : m_Transients)
+        {
+            Entry->Color.Destroy();
+            Entry->Depth.Destroy();
+            Entry->HeapOffset = FrameGraphCompiler::kUnplaced;
+        }
+    }
+
+    for (uint32_t Res = 0; Res < (uint32_t)m_Resources.size(); ++Res)
+    {
+        const uint64_t Offset = m_Plan.TransientOffsets[Res];
+        if (Offset == FrameGraphCompiler::kUnplaced)
+            continue;
+
+        Transient& Entry = *m_Transients[m_TransientIndex[Res]];
+        if (Entry.HeapOffset == Offset)
+            continue;
+
+        wstring Name = MakeWStr(Entry.Name);
+        if (Entry.IsDepth)
+            Entry.Depth.CreatePlaced(Name, Entry.Width, Entry.Height, Entry.Format, m_Heap.Get(), Offset);
+        else
+            Entry.Color.CreatePlaced(Name, Entry.Width, Entry.Height, Entry.Format, m_Heap.Get(), Offset);
+        Entry.HeapOffset = Offset;
+    }
+}
+
+void FrameGraph::RecordBarriers( CommandContext& Context, const vector<OptimizedBarrier>& Barriers, bool SkipUAVBarriers )
+{
+    uint32_t NumBuffered = 0;
+
+    for (const OptimizedBarrier& Barrier : Barriers)
+    {
+        GpuResource& Resource = *m_Resources[Barrier.Resource];
+
+        switch (Barrier.BarrierType)
+        {
+        case OptimizedBarrier::kTransition:
+        case OptimizedBarrier::kEndSplit:
+            Context.TransitionResource(Resource, (D3D12_RESOURCE_STATES)Barrier.After);
+            break;
+
+        case OptimizedBarrier::kBeginSplit:
+            Context.BeginResourceTransition(Resource, (D3D12_RESOURCE_STATES)Barrier.After);
+            break;
+
+        case OptimizedBarrier::kUAV:
+            if (SkipUAVBarriers)
+                continue;
+            Context.InsertUAVBarrier(Resource);
+            break;
+
+        case OptimizedBarrier::kAlias:
+        {
+            // Take over the memory, then discard so that the GPU doesn't preserve whatever was there.  Both
+            // render targets and depth buffers can be discarded in their initial states.
+            GpuResource& After = *m_Resources[Barrier.OtherResource];
+            if (Barrier.Resource == Barrier.OtherResource)
+                Context.InsertAliasBarrier(After);
+            else
+                Context.InsertAliasBarrier(Resource, After);
+
+            const bool IsDepth = m_Transients[m_TransientIndex[Barrier.OtherResource]]->IsDepth;
+            Context.TransitionResource(After, IsDepth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET, true);
+            Context.GetCommandList()->DiscardResource(After.GetResource(), nullptr);
+            NumBuffered = 0;
+            continue;
+        }
+        }
+
+        // CommandContext buffers at most 16 barriers
+        if (++NumBuffered == 8)
+        {
+            Context.FlushResourceBarriers();
+            NumBuffered = 0;
+        }
+    }
+
+    Context.FlushResourceBarriers();
+}
+
+void FrameGraph::WaitForAsync( GraphicsContext& Context, const vector<uint32_t>& Steps, const vector<uint64_t>& Fences )
+{
+    if (Steps.empty())
+        return;
+
+    // The wait applies to everything submitted after it, so submit what is already recorded first
+    Context.Flush();
+    for (uint32_t Step : Steps)
+        g_CommandManager.GetGraphicsQueue().StallForFence(Fences[Step]);
+}
+
+void FrameGraph::Execute( GraphicsContext& Context, const FrameGraphCompileOptions& Options )
+{
+    string Error;
+    if (!m_Compiler.Compile(Options, m_Plan, &Error))
+    {
+        ERROR("Frame graph failed to compile:  %s", Error.c_str());
+        return;
+    }
+
+    PlaceTransients();
+
+    vector<uint64_t> AsyncFences(m_Plan.Steps.size(), 0);
+
+    for (uint32_t StepIdx = 0; StepIdx < (uint32_t)m_Plan.Steps.size(); ++StepIdx)
+    {
+        const FrameGraphStep& Step = m_Plan.Steps[StepIdx];
+
+        WaitForAsync(Context, Step.Waits, AsyncFences);
+        RecordBarriers(Context, Step.Barriers, Step.Async);
+
+        if (!Step.Async)
+        {
+            m_PassFunctions[Step.Pass](Context);
+            continue;
+        }
+
+        // The compute queue starts once the graphics queue has finished everything before this pass,
+        // including the transitions it needs
+        uint64_t Ready = Context.Flush();
+
+        ComputeContext& Compute = ComputeContext::Begin(MakeWStr(m_Compiler.GetPassName(Step.Pass)), true);
+        g_CommandManager.GetComputeQueue().StallForFence(Ready);
+
+        for (const OptimizedBarrier& Barrier : Step.Barriers)
+        {
+            if (Barrier.BarrierType == OptimizedBarrier::kUAV)
+                Compute.InsertUAVBarrier(*m_Resources[Barrier.Resource]);
+        }
+
+        m_PassFunctions[Step.Pass](Compute);
+        AsyncFences[StepIdx] = Compute.Finish();
+    }
+
+    WaitForAsync(Context, m_Plan.FinalWaits, AsyncFences);
+    RecordBarriers(Context, m_Plan.FinalBarriers, false);
+}
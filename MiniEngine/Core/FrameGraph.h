@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Records a frame as a list of passes that declare what they read and write.  Each frame,
+// add the passes in the order they should run, then Execute().  FrameGraphCompiler decides which passes
+// run, which go to the async compute queue and which barriers go between them, and this class carries that
+// out on a GraphicsContext.
+//
+// Transient color and depth buffers are placed in one heap and share memory wherever their lifetimes
+// allow.  The heap and the buffers in it are kept from frame to frame, and only rebuilt when the transients
+// a frame asks for change.  Passes may still transition resources themselves; the graph works from each
+// resource's tracked state, so the worst case is a wasted barrier.  A pass must set all of its own
+// pipeline state, because the graph may flush the context between passes.
+
+#pragma once
+
+#include "FrameGraphCompiler.h"
+#include "ColorBuffer.h"
+#include "DepthBuffer.h"
+#include <functional>
+#include <memory>
+
+class CommandContext;
+class GraphicsContext;
+
+class FrameGraph
+{
+public:
+
+    typedef std::function<void (CommandContext&)> PassFunction;
+
+    FrameGraph() : m_HeapSize(0), m_NumTransients(0) {}
+    ~FrameGraph() { Destroy(); }
+
+    // Resource handles are valid until Reset()
+    uint32_t Import( const std::string& Name, GpuResource& Resource, bool IsOutput = false,
+        D3D12_RESOURCE_STATES FinalState = (D3D12_RESOURCE_STATES)FrameGraphCompiler::kNoFinalState );
+    uint32_t CreateColorBuffer( const std::string& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format );
+    uint32_t CreateDepthBuffer( const std::string& Name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format );
+
+    // Transients only have memory while their passes run
+    ColorBuffer& GetColorBuffer( uint32_t Resource );
+    DepthBuffer& GetDepthBuffer( uint32_t Resource );
+
+    // Compute passes receive a ComputeContext on the async compute queue when the graph schedules them there
+    uint32_t AddPass( const std::string& Name, PassFunction Execute,
+        FrameGraphCompiler::QueueType Queue = FrameGraphCompiler::kGraphicsQueue, bool HasSideEffects = false );
+    void Read( uint32_t Pass, uint32_t Resource, D3D12_RESOURCE_STATES State );
+    void Write( uint32_t Pass, uint32_t Resource, D3D12_RESOURCE_STATES State );
+
+    // Compiles the graph and records it into Context, which is left open
+    void Execute( GraphicsContext& Context, const FrameGraphCompileOptions& Options = FrameGraphCompileOptions() );
+
+    // Forgets the passes and resources of this frame, but keeps transient memory for the next
+    void Reset( void );
+
+    // Releases transient memory.  The GPU must be idle.
+    void Destroy( void );
+
+    const FrameGraphStats& GetStats( void ) const { return m_Plan.Stats; }
+
+private:
+
+    struct Transient
+    {
+        std::string Name;
+        bool IsDepth;
+        uint32_t Width;
+        uint32_t Height;
+        DXGI_FORMAT Format;
+        D3D12_RESOURCE_ALLOCATION_INFO AllocationInfo;
+        uint64_t HeapOffset;        // Where the resource was last created, or kUnplaced
+        ColorBuffer Color;
+        DepthBuffer Depth;
+
+        GpuResource& GetResource( void ) { return IsDepth ? (GpuResource&)Depth : (GpuResource&)Color; }
+    };
+
+    uint32_t CreateTransient( const std::string& Name, bool IsDepth, uint32_t Width, uint32_t Height, DXGI_FORMAT Format );
+    void PlaceTransients( void );
+    void RecordBarriers( CommandContext& Context, const std::vector<OptimizedBarrier>& Barriers, bool SkipUAVBarriers );
+    void WaitForAsync( GraphicsContext& Context, const std::vector<uint32_t>& Steps, const std::vector<uint64_t>& Fences );
+
+    FrameGraphCompiler m_Compiler;
+    FrameGraphPlan m_Plan;
+
+    std::vector<PassFunction> m_PassFunctions;
+    std::vector<GpuResource*> m_Resources;
+    std::vector<uint32_t> m_TransientIndex;     // By resource, or kInvalidIndex if imported
+
+    Microsoft::WRL::ComPtr<ID3D12Heap> m_Heap;
+    uint64_t m_HeapSize;
+    std::vector<std::unique_ptr<Transient>> m_Transients;     // Kept across frames
+    uint32_t m_NumTransients;                                   // Used this frame
+};
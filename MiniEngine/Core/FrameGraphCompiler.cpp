@@ -0,0 +1,481 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "FrameGraphCompiler.h"
+#include "IntervalAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+uint32_t FrameGraphCompiler::ImportResource( const string& Name, BarrierState InitialState, bool IsOutput,
+    BarrierState FinalState )
+{
+    ResourceDesc Desc = { Name, false, IsOutput, InitialState, FinalState, 0, 1 };
+    m_Resources.push_back(Desc);
+    return (uint32_t)m_Resources.size() - 1;
+}
+
+uint32_t FrameGraphCompiler::CreateTransient( const string& Name, uint64_t SizeInBytes, uint64_t Alignment,
+    BarrierState InitialState )
+{
+    assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0);
+
+    ResourceDesc Desc = { Name, true, false, InitialState, kNoFinalState, SizeInBytes, Alignment };
+    m_Resources.push_back(Desc);
+    return (uint32_t)m_Resources.size() - 1;
+}
+
+uint32_t FrameGraphCompiler::AddPass( const string& Name, QueueType Queue, bool HasSideEffects )
+{
+    PassDesc Desc;
+    Desc.Name = Name;
+    Desc.Queue = Queue;
+    Desc.HasSideEffects = HasSideEffects;
+    m_Passes.push_back(Desc);
+    return (uint32_t)m_Passes.size() - 1;
+}
+
+void FrameGraphCompiler::Read( uint32_t Pass, uint32_t Resource, BarrierState State )
+{
+    AddAccess(Pass, Resource, State, false);
+}
+
+void FrameGraphCompiler::Write( uint32_t Pass, uint32_t Resource, BarrierState State )
+{
+    AddAccess(Pass, Resource, State, true);
+}
+
+void FrameGraphCompiler::AddAccess( uint32_t Pass, uint32_t Resource, BarrierState State, bool IsWrite )
+{
+    assert(Pass < m_Passes.size() && Resource < m_Resources.size());
+
+    vector<Access>& Accesses = m_Passes[Pass].Accesses;
+
+    if (!IsWrite)
+    {
+        for (Access& Existing : Accesses)
+        {
+            if (Existing.Resource == Resource && !Existing.IsWrite)
+            {
+                Existing.State |= State;
+                return;
+            }
+        }
+    }
+
+    // Anything else that names the resource twice is reported by Compile()
+    Access NewAccess = { Resource, State, IsWrite };
+    Accesses.push_back(NewAccess);
+}
+
+void FrameGraphCompiler::Clear( void )
+{
+    m_Resources.clear();
+    m_Passes.clear();
+}
+
+namespace
+{
+    bool Fail( string* Error, const string& Message )
+    {
+        if (Error != nullptr)
+            *Error = Message;
+        return false;
+    }
+
+    bool Contains( const vector<uint32_t>& Sorted, uint32_t Value )
+    {
+        return binary_search(Sorted.begin(), Sorted.end(), Value);
+    }
+}
+
+bool FrameGraphCompiler::Compile( const FrameGraphCompileOptions& Options, FrameGraphPlan& Plan, string* Error ) const
+{
+    const uint32_t NumPasses = (uint32_t)m_Passes.size();
+    const uint32_t NumResources = (uint32_t)m_Resources.size();
+
+    Plan.Steps.clear();
+    Plan.FinalWaits.clear();
+    Plan.FinalBarriers.clear();
+    Plan.TransientOffsets.assign(NumResources, (uint64_t)kUnplaced);
+    Plan.TransientHeapSize = 0;
+    Plan.TransientHeapAlignment = 1;
+    Plan.Stats = FrameGraphStats();
+
+    for (const PassDesc& Pass : m_Passes)
+    {
+        for (size_t i = 0; i < Pass.Accesses.size(); ++i)
+        {
+            for (size_t j = i + 1; j < Pass.Accesses.size(); ++j)
+            {
+                if (Pass.Accesses[i].Resource == Pass.Accesses[j].Resource)
+                {
+                    return Fail(Error, "Pass '" + Pass.Name + "' writes '" +
+                        m_Resources[Pass.Accesses[i].Resource].Name + "' and also accesses it another way");
+                }
+            }
+        }
+    }
+
+    // Cull.  Dependencies only point forward, so one backward sweep finds every pass that something
+    // live depends on.
+    vector<bool> PassAlive(NumPasses, !Options.CullPasses);
+    if (Options.CullPasses)
+    {
+        vector<bool> ResourceNeeded(NumResources);
+        for (uint32_t Res = 0; Res < NumResources; ++Res)
+            ResourceNeeded[Res] = m_Resources[Res].IsOutput;
+
+        for (uint32_t Pass = NumPasses; Pass-- > 0; )
+        {
+            const PassDesc& Desc = m_Passes[Pass];
+
+            bool Keep = Desc.HasSideEffects;
+            for (const Access& Acc : Desc.Accesses)
+                Keep = Keep || (Acc.IsWrite && ResourceNeeded[Acc.Resource]);
+
+            if (!Keep)
+                continue;
+
+            PassAlive[Pass] = true;
+            for (const Access& Acc : Desc.Accesses)
+                ResourceNeeded[Acc.Resource] = true;
+        }
+    }
+
+    // Surviving passes run in the order they were added.  A compute pass goes async only if the compute
+    // queue can use every state it asks for.
+    bool AnyAsync = false;
+    for (uint32_t Pass = 0; Pass < NumPasses; ++Pass)
+    {
+        if (!PassAlive[Pass])
+            continue;
+
+        const PassDesc& Desc = m_Passes[Pass];
+
+        FrameGraphStep Step;
+        Step.Pass = Pass;
+        Step.Async = Options.AsyncCompute && Desc.Queue == kComputeQueue;
+        for (const Access& Acc : Desc.Accesses)
+            Step.Async = Step.Async && (Acc.State & ~kValidComputeStates) == 0;
+
+        AnyAsync = AnyAsync || Step.Async;
+        Plan.Steps.push_back(Step);
+    }
+
+    const uint32_t NumSteps = (uint32_t)Plan.Steps.size();
+
+    // Lifetimes, in steps
+    vector<uint32_t> FirstUse(NumResources, (uint32_t)kInvalidIndex);
+    vector<uint32_t> LastUse(NumResources, (uint32_t)kInvalidIndex);
+
+    for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+    {
+        const PassDesc& Desc = m_Passes[Plan.Steps[StepIdx].Pass];
+        for (const Access& Acc : Desc.Accesses)
+        {
+            if (FirstUse[Acc.Resource] == kInvalidIndex)
+            {
+                if (m_Resources[Acc.Resource].IsTransient && !Acc.IsWrite)
+                {
+                    return Fail(Error, "Pass '" + Desc.Name + "' reads transient '" +
+                        m_Resources[Acc.Resource].Name + "' before anything writes it");
+                }
+                FirstUse[Acc.Resource] = StepIdx;
+            }
+            LastUse[Acc.Resource] = StepIdx;
+        }
+    }
+
+    // Barriers.  A transient is aliased in right before its first use, which also stops the optimizer from
+    // beginning a split transition while its memory may still belong to another resource.  Which resource
+    // that was isn't known until placement, so the aliasing barrier names the transient twice for now.
+    BarrierTrace Trace;
+    vector<BarrierState> TrackedState(NumResources);
+    for (uint32_t Res = 0; Res < NumResources; ++Res)
+        TrackedState[Res] = m_Resources[Res].InitialState;
+
+    for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+    {
+        const PassDesc& Desc = m_Passes[Plan.Steps[StepIdx].Pass];
+
+        for (const Access& Acc : Desc.Accesses)
+        {
+            if (m_Resources[Acc.Resource].IsTransient && FirstUse[Acc.Resource] == StepIdx)
+                Trace.RecordAliasBarrier(Acc.Resource, Acc.Resource);
+        }
+
+        for (const Access& Acc : Desc.Accesses)
+        {
+            Trace.RecordTransition(Acc.Resource, TrackedState[Acc.Resource], Acc.State);
+            TrackedState[Acc.Resource] = Acc.State;
+        }
+
+        Trace.RecordWork();
+    }
+
+    for (uint32_t Res = 0; Res < NumResources; ++Res)
+    {
+        if (m_Resources[Res].FinalState != kNoFinalState)
+            Trace.RecordTransition(Res, TrackedState[Res], m_Resources[Res].FinalState);
+    }
+
+    BarrierOptimizerOptions OptimizerOptions;
+    OptimizerOptions.ExplicitAccesses = true;
+    OptimizerOptions.CombineReads = Options.CombineReads;
+    OptimizerOptions.UseSplitBarriers = Options.UseSplitBarriers;
+
+    // A combined state such as PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE would be invalid on the
+    // compute queue
+    if (AnyAsync)
+        OptimizerOptions.AllowedStates = kValidComputeStates;
+
+    BarrierSchedule Schedule = BarrierOptimizer::Optimize(Trace, OptimizerOptions);
+    Schedule.Batches.resize(NumSteps + 1);
+
+    // Combining reads can leave a resource in more read states than its final state, e.g.
+    // PIXEL_SHADER_RESOURCE | COPY_SOURCE for PIXEL_SHADER_RESOURCE.  Whatever uses it next expects
+    // exactly the final state.
+    for (uint32_t Res = 0; Res < NumResources; ++Res)
+    {
+        const BarrierState Final = m_Resources[Res].FinalState;
+        if (Final != kNoFinalState && Schedule.FinalStates[Res] != Final)
+        {
+            OptimizedBarrier Exact = { OptimizedBarrier::kTransition, Res, 0, Schedule.FinalStates[Res], Final };
+            Schedule.Batches[NumSteps].push_back(Exact);
+            Schedule.FinalStates[Res] = Final;
+        }
+    }
+
+    // Resources each async pass uses, sorted
+    vector<vector<uint32_t>> AsyncResources(NumSteps);
+    for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+    {
+        if (!Plan.Steps[StepIdx].Async)
+            continue;
+
+        for (const Access& Acc : m_Passes[Plan.Steps[StepIdx].Pass].Accesses)
+            AsyncResources[StepIdx].push_back(Acc.Resource);
+        sort(AsyncResources[StepIdx].begin(), AsyncResources[StepIdx].end());
+    }
+
+    // The graphics queue must wait for an async pass before it next touches anything the pass uses, either
+    // by accessing it or by recording a barrier for it.  Split barriers can move, so they are left out here.
+    vector<uint32_t> WaitStep(NumSteps, NumSteps);
+    if (AnyAsync)
+    {
+        vector<vector<uint32_t>> GraphicsTouches(NumSteps + 1);
+        for (uint32_t StepIdx = 0; StepIdx <= NumSteps; ++StepIdx)
+        {
+            const bool StepIsAsync = StepIdx < NumSteps && Plan.Steps[StepIdx].Async;
+
+            if (StepIdx < NumSteps && !StepIsAsync)
+            {
+                for (const Access& Acc : m_Passes[Plan.Steps[StepIdx].Pass].Accesses)
+                    GraphicsTouches[StepIdx].push_back(Acc.Resource);
+            }
+
+            for (const OptimizedBarrier& Barrier : Schedule.Batches[StepIdx])
+            {
+                if (Barrier.BarrierType == OptimizedBarrier::kAlias || Barrier.BarrierType == OptimizedBarrier::kBeginSplit)
+                    continue;
+                if (Barrier.BarrierType == OptimizedBarrier::kUAV && StepIsAsync)
+                    continue;
+                GraphicsTouches[StepIdx].push_back(Barrier.Resource);
+            }
+        }
+
+        for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+        {
+            if (!Plan.Steps[StepIdx].Async)
+                continue;
+
+            for (uint32_t Later = StepIdx + 1; Later <= NumSteps && WaitStep[StepIdx] == NumSteps; ++Later)
+            {
+                for (uint32_t Res : GraphicsTouches[Later])
+                {
+                    if (Contains(AsyncResources[StepIdx], Res))
+                    {
+                        WaitStep[StepIdx] = Later;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Hold back split barriers on resources an async pass used until the graphics queue has waited for
+        // it.  If that leaves no gap, the split becomes an ordinary transition where it used to end.
+        for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+        {
+            vector<OptimizedBarrier>& Batch = Schedule.Batches[StepIdx];
+            for (size_t i = 0; i < Batch.size(); )
+            {
+                OptimizedBarrier Begin = Batch[i];
+                if (Begin.BarrierType != OptimizedBarrier::kBeginSplit)
+                {
+                    ++i;
+                    continue;
+                }
+
+                uint32_t EarliestBegin = StepIdx;
+                for (uint32_t Async = 0; Async < StepIdx; ++Async)
+                {
+                    if (Plan.Steps[Async].Async && WaitStep[Async] > StepIdx && Contains(AsyncResources[Async], Begin.Resource))
+                        EarliestBegin = max(EarliestBegin, WaitStep[Async]);
+                }
+
+                if (EarliestBegin == StepIdx)
+                {
+                    ++i;
+                    continue;
+                }
+
+                Batch.erase(Batch.begin() + i);
+
+                uint32_t EndStep = EarliestBegin;
+                for (; EndStep <= NumSteps; ++EndStep)
+                {
+                    bool Found = false;
+                    for (OptimizedBarrier& End : Schedule.Batches[EndStep])
+                    {
+                        if (End.BarrierType == OptimizedBarrier::kEndSplit && End.Resource == Begin.Resource)
+                        {
+                            if (EndStep == EarliestBegin)
+                                End.BarrierType = OptimizedBarrier::kTransition;
+                            Found = true;
+                            break;
+                        }
+                    }
+                    if (Found)
+                        break;
+                }
+                assert(EndStep <= NumSteps);
+
+                if (EndStep > EarliestBegin)
+                    Schedule.Batches[EarliestBegin].push_back(Begin);
+            }
+        }
+
+        // One wait covers every async pass up to the one waited for, because the compute queue runs them
+        // in order
+        int Covered = -1;
+        for (uint32_t StepIdx = 0; StepIdx <= NumSteps; ++StepIdx)
+        {
+            int Latest = -1;
+            for (uint32_t Async = 0; Async < StepIdx; ++Async)
+            {
+                if (Plan.Steps[Async].Async && WaitStep[Async] == StepIdx && (int)Async > Covered)
+                    Latest = (int)Async;
+            }
+
+            if (Latest < 0)
+                continue;
+
+            if (StepIdx < NumSteps)
+                Plan.Steps[StepIdx].Waits.push_back((uint32_t)Latest);
+            else
+                Plan.FinalWaits.push_back((uint32_t)Latest);
+
+            Covered = Latest;
+            ++Plan.Stats.NumSyncPoints;
+        }
+
+        // Memory an async pass uses stays reserved until the graphics queue has waited for it
+        for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+        {
+            for (uint32_t Res : AsyncResources[StepIdx])
+            {
+                if (m_Resources[Res].IsTransient)
+                    LastUse[Res] = max(LastUse[Res], WaitStep[StepIdx] - 1);
+            }
+        }
+    }
+
+    // Place transients so that those whose lifetimes overlap don't share memory
+    vector<uint32_t> Transients;
+    IntervalAllocator Placement;
+    for (uint32_t Res = 0; Res < NumResources; ++Res)
+    {
+        if (m_Resources[Res].IsTransient && FirstUse[Res] != kInvalidIndex)
+        {
+            Transients.push_back(Res);
+            Placement.AddInterval(FirstUse[Res], LastUse[Res], m_Resources[Res].SizeInBytes, m_Resources[Res].Alignment);
+        }
+    }
+
+    Plan.TransientHeapSize = Placement.Allocate(Options.AliasTransients);
+    Plan.TransientHeapAlignment = Placement.GetHeapAlignment();
+    Plan.Stats.TransientBytes = Placement.GetTotalSize();
+    for (uint32_t i = 0; i < (uint32_t)Transients.size(); ++i)
+        Plan.TransientOffsets[Transients[i]] = Placement.GetOffset(i);
+    assert(Placement.Validate());
+
+    Plan.Stats.NumTransients = (uint32_t)Transients.size();
+    Plan.Stats.TransientHeapSize = Plan.TransientHeapSize;
+
+    // Name the resource each transient takes over from, when exactly one earlier resource used all of its
+    // memory
+    for (uint32_t Res : Transients)
+    {
+        const uint64_t Start = Plan.TransientOffsets[Res];
+        const uint64_t End = Start + m_Resources[Res].SizeInBytes;
+
+        uint32_t Previous = Res;
+        uint32_t NumPrevious = 0;
+        for (uint32_t Other : Transients)
+        {
+            const uint64_t OtherStart = Plan.TransientOffsets[Other];
+            const uint64_t OtherEnd = OtherStart + m_Resources[Other].SizeInBytes;
+            if (Other == Res || LastUse[Other] >= FirstUse[Res] || OtherEnd <= Start || End <= OtherStart)
+                continue;
+
+            ++NumPrevious;
+            if (OtherStart <= Start && End <= OtherEnd)
+                Previous = Other;
+        }
+        if (NumPrevious != 1)
+            Previous = Res;
+
+        for (OptimizedBarrier& Barrier : Schedule.Batches[FirstUse[Res]])
+        {
+            if (Barrier.BarrierType == OptimizedBarrier::kAlias && Barrier.OtherResource == Res)
+                Barrier.Resource = Previous;
+        }
+    }
+
+    assert(BarrierOptimizer::Validate(Trace, Schedule));
+
+    for (uint32_t StepIdx = 0; StepIdx <= NumSteps; ++StepIdx)
+    {
+        for (const OptimizedBarrier& Barrier : Schedule.Batches[StepIdx])
+        {
+            ++Plan.Stats.NumBarriers;
+            if (Barrier.BarrierType == OptimizedBarrier::kBeginSplit)
+                ++Plan.Stats.NumSplitBarriers;
+        }
+
+        if (StepIdx < NumSteps)
+        {
+            Plan.Steps[StepIdx].Barriers.swap(Schedule.Batches[StepIdx]);
+            if (Plan.Steps[StepIdx].Async)
+                ++Plan.Stats.NumAsyncPasses;
+        }
+        else
+            Plan.FinalBarriers.swap(Schedule.Batches[StepIdx]);
+    }
+
+    Plan.Stats.NumPasses = NumSteps;
+    Plan.Stats.NumCulledPasses = NumPasses - NumSteps;
+
+    return true;
+}
@@ -0,0 +1,164 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The planning half of FrameGraph, with no knowledge of D3D.  Passes are added in the order
+// they should run and declare the state each resource must be in while they run.  Compile() then works out:
+//
+//   - Which passes can be culled, because nothing after them and no output depends on what they write.
+//     A write is assumed to read the old contents too, so only a pass with no live consumer is removed.
+//   - Which compute passes can run on the async compute queue, and where the graphics queue must wait for
+//     them.  The graphics queue records every transition, including those for async passes, so the
+//     compute queue only ever sees resources in states it supports.
+//   - Where transient resources live in a shared heap.  Resources whose lifetimes don't overlap share
+//     memory, and each one is aliased in right before its first use.
+//   - The barriers before each pass, through BarrierOptimizer with explicit accesses.
+//
+// Everything here is plain data, so a graph can be compiled and checked on any platform.
+
+#pragma once
+
+#include "BarrierOptimizer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FrameGraphCompileOptions
+{
+    bool CullPasses = true;
+    bool AliasTransients = true;
+    bool AsyncCompute = true;
+    bool UseSplitBarriers = true;
+    bool CombineReads = true;
+};
+
+struct FrameGraphStats
+{
+    uint32_t NumPasses;
+    uint32_t NumCulledPasses;
+    uint32_t NumAsyncPasses;
+    uint32_t NumSyncPoints;         // Times the graphics queue waits for an async pass
+    uint32_t NumTransients;
+    uint64_t TransientBytes;        // What the transients would take without aliasing
+    uint64_t TransientHeapSize;
+    uint32_t NumBarriers;
+    uint32_t NumSplitBarriers;
+};
+
+struct FrameGraphStep
+{
+    uint32_t Pass;
+    bool Async;
+
+    // Async steps the graphics queue must wait for before this step, by step index
+    std::vector<uint32_t> Waits;
+
+    // Recorded on the graphics queue before the pass, except UAV barriers for an async pass, which belong
+    // to the compute queue.  An aliasing barrier whose Resource equals OtherResource may follow any
+    // resource that shares its memory.
+    std::vector<OptimizedBarrier> Barriers;
+};
+
+struct FrameGraphPlan
+{
+    std::vector<FrameGraphStep> Steps;
+
+    // After the last pass, so that outputs end up in their final states
+    std::vector<uint32_t> FinalWaits;
+    std::vector<OptimizedBarrier> FinalBarriers;
+
+    // By resource.  kUnplaced for imported resources and transients that no surviving pass uses.
+    std::vector<uint64_t> TransientOffsets;
+    uint64_t TransientHeapSize;
+    uint64_t TransientHeapAlignment;
+
+    FrameGraphStats Stats;
+};
+
+class FrameGraphCompiler
+{
+public:
+
+    enum QueueType
+    {
+        kGraphicsQueue,
+        kComputeQueue       // Any queue.  Runs asynchronously when the options and its states allow.
+    };
+
+    static const uint32_t kInvalidIndex = ~0u;
+    static const uint64_t kUnplaced = ~0ull;
+    static const BarrierState kNoFinalState = ~0u;
+
+    // Mirrors D3D12_RESOURCE_STATE_COMMON, VERTEX_AND_CONSTANT_BUFFER, UNORDERED_ACCESS,
+    // NON_PIXEL_SHADER_RESOURCE, INDIRECT_ARGUMENT, COPY_DEST and COPY_SOURCE
+    static const BarrierState kValidComputeStates = 0x1 | 0x8 | 0x40 | 0x200 | 0x400 | 0x800;
+
+    FrameGraphCompiler() {}
+
+    // A resource that lives outside the graph and is in InitialState when the graph starts.  Outputs keep
+    // the passes that write them alive, and are left in FinalState if one is given.
+    uint32_t ImportResource( const std::string& Name, BarrierState InitialState, bool IsOutput = false,
+        BarrierState FinalState = kNoFinalState );
+
+    // A resource that only lives within the graph.  It starts each frame in InitialState with undefined
+    // contents, so its first use must be a write.
+    uint32_t CreateTransient( const std::string& Name, uint64_t SizeInBytes, uint64_t Alignment,
+        BarrierState InitialState );
+
+    // Passes with side effects are never culled
+    uint32_t AddPass( const std::string& Name, QueueType Queue, bool HasSideEffects = false );
+
+    // Reads of one resource in one pass combine their states.  A write must be the only access.
+    void Read( uint32_t Pass, uint32_t Resource, BarrierState State );
+    void Write( uint32_t Pass, uint32_t Resource, BarrierState State );
+
+    // Forgets all passes and resources
+    void Clear( void );
+
+    bool Compile( const FrameGraphCompileOptions& Options, FrameGraphPlan& Plan, std::string* Error = nullptr ) const;
+
+    uint32_t GetNumPasses( void ) const { return (uint32_t)m_Passes.size(); }
+    uint32_t GetNumResources( void ) const { return (uint32_t)m_Resources.size(); }
+    const std::string& GetPassName( uint32_t Pass ) const { return m_Passes[Pass].Name; }
+    const std::string& GetResourceName( uint32_t Resource ) const { return m_Resources[Resource].Name; }
+    bool IsTransient( uint32_t Resource ) const { return m_Resources[Resource].IsTransient; }
+
+private:
+
+    struct Access
+    {
+        uint32_t Resource;
+        BarrierState State;
+        bool IsWrite;
+    };
+
+    struct ResourceDesc
+    {
+        std::string Name;
+        bool IsTransient;
+        bool IsOutput;
+        BarrierState InitialState;
+        BarrierState FinalState;
+        uint64_t SizeInBytes;
+        uint64_t Alignment;
+    };
+
+    struct PassDesc
+    {
+        std::string Name;
+        QueueType Queue;
+        bool HasSideEffects;
+        std::vector<Access> Accesses;
+    };
+
+    void AddAccess( uint32_t Pass, uint32_t Resource, BarrierState State, bool IsWrite );
+
+    std::vector<ResourceDesc> m_Resources;
+    std::vector<PassDesc> m_Passes;
+};
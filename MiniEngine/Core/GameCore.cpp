@@ -19,6 +19,9 @@
 #include "BufferManager.h"
 #include "CommandContext.h"
 #include "PostEffects.h"
+#include "JobSystem.h"
+#include "FileUtility.h"
+#include "TextureManager.h"
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     #pragma comment(lib, "runtimeobject.lib")
@@ -45,6 +48,8 @@ namespace GameCore
 
     void InitializeApplication( IGameApp& game )
     {
+        JobSystem::Initialize();
+        Utility::g_IoScheduler.Start();
         Graphics::Initialize();
         SystemTime::Initialize();
         GameInput::Initialize();
@@ -58,6 +63,8 @@ namespace GameCore
         game.Cleanup();
 
         GameInput::Shutdown();
+        Utility::g_IoScheduler.Stop();
+        JobSystem::Shutdown();
     }
 
     bool UpdateApplication( IGameApp& game )
@@ -68,6 +75,7 @@ namespace GameCore
     
         GameInput::Update(DeltaTime);
         EngineTuning::Update(DeltaTime);
+        TextureManager::Update();
         
         game.Update(DeltaTime);
         game.RenderScene();
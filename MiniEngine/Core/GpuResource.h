@@ -18,13 +18,16 @@ class GpuResource
     friend class CommandContext;
     friend class GraphicsContext;
     friend class ComputeContext;
+    friend class EsramAllocator;
 
 public:
     GpuResource() : 
         m_GpuVirtualAddress(D3D12_GPU_VIRTUAL_ADDRESS_NULL),
         m_UserAllocatedMemory(nullptr),
         m_UsageState(D3D12_RESOURCE_STATE_COMMON),
-        m_TransitioningState((D3D12_RESOURCE_STATES)-1)
+        m_TransitioningState((D3D12_RESOURCE_STATES)-1),
+        m_SharesMemoryWith(nullptr),
+        m_OwnsMemory(false)
     {}
 
     GpuResource(ID3D12Resource* pResource, D3D12_RESOURCE_STATES CurrentState) :
@@ -32,7 +35,9 @@ public:
         m_UserAllocatedMemory(nullptr),
         m_pResource(pResource),
         m_UsageState(CurrentState),
-        m_TransitioningState((D3D12_RESOURCE_STATES)-1)
+        m_TransitioningState((D3D12_RESOURCE_STATES)-1),
+        m_SharesMemoryWith(nullptr),
+        m_OwnsMemory(false)
     {
     }
 
@@ -40,6 +45,7 @@ public:
     {
         m_pResource = nullptr;
         m_GpuVirtualAddress = D3D12_GPU_VIRTUAL_ADDRESS_NULL;
+        m_SharesMemoryWith = nullptr;
         if (m_UserAllocatedMemory != nullptr)
         {
             VirtualFree(m_UserAllocatedMemory, 0, MEM_RELEASE);
@@ -55,6 +61,9 @@ public:
 
     D3D12_GPU_VIRTUAL_ADDRESS GetGpuVirtualAddress() const { return m_GpuVirtualAddress; }
 
+    // The state the last recorded barrier left the resource in
+    D3D12_RESOURCE_STATES GetUsageState() const { return m_UsageState; }
+
 protected:
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_pResource;
@@ -65,4 +74,9 @@ protected:
     // When using VirtualAlloc() to allocate memory directly, record the allocation here so that it can be freed.  The
     // GpuVirtualAddress may be offset from the true allocation start.
     void* m_UserAllocatedMemory;
+
+    // Set for resources that EsramAllocator placed in memory other resources also use.  The first transition
+    // after one of those was used makes this resource take the memory back and discard what was there.
+    const std::vector<GpuResource*>* m_SharesMemoryWith;
+    bool m_OwnsMemory;
 };
@@ -26,6 +26,8 @@
 #include "CommandContext.h"
 #include "CommandListManager.h"
 #include "RootSignature.h"
+#include "PipelineState.h"
+#include "PipelineStateCache.h"
 #include "CommandSignature.h"
 #include "ParticleEffectManager.h"
 #include "GraphRenderer.h"
@@ -189,10 +191,10 @@ namespace Graphics
 
     DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES] =
     {
-        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
-        D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+        { D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_RTV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_DSV },
     };
 
     RootSignature s_PresentRS;
@@ -451,6 +453,27 @@ void Graphics::Initialize(void)
         }
     }
 
+    // Start loading compiled PSOs from the last run.  The cache is only valid for the same adapter and
+    // user-mode driver, so tag it with both.
+    {
+        PSOCacheIdentity Identity = {};
+        Microsoft::WRL::ComPtr<IDXGIAdapter1> DeviceAdapter;
+        if (SUCCEEDED(dxgiFactory->EnumAdapterByLuid(g_Device->GetAdapterLuid(), MY_IID_PPV_ARGS(&DeviceAdapter))))
+        {
+            DXGI_ADAPTER_DESC1 desc;
+            DeviceAdapter->GetDesc1(&desc);
+            Identity.VendorId = desc.VendorId;
+            Identity.DeviceId = desc.DeviceId;
+            Identity.SubSysId = desc.SubSysId;
+            Identity.Revision = desc.Revision;
+
+            LARGE_INTEGER UMDVersion = {};
+            if (SUCCEEDED(DeviceAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &UMDVersion)))
+                Identity.DriverVersion = (uint64_t)UMDVersion.QuadPart;
+        }
+        PSO::InitializeCache(L"PSOCache.bin", Identity);
+    }
+
     g_CommandManager.Create(g_Device);
 
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
@@ -575,6 +598,9 @@ void Graphics::Initialize(void)
 
     g_PreDisplayBuffer.Create(L"PreDisplay Buffer", g_DisplayWidth, g_DisplayHeight, 1, SwapChainFormat);
 
+    // Per-frame constants and uploads cycle through a fixed 32 MB ring before touching the page pool
+    LinearAllocator::CreateRingBuffer(kCpuWritable, 16);
+
     GpuTimeManager::Initialize(4096);
     SetNativeResolution();
     TemporalEffects::Initialize();
@@ -601,7 +627,6 @@ void Graphics::Shutdown( void )
     s_SwapChain1->Release();
     PSO::DestroyAll();
     RootSignature::DestroyAll();
-    DescriptorAllocator::DestroyAll();
 
     DestroyCommonState();
     DestroyRenderingBuffers();
@@ -618,6 +643,12 @@ void Graphics::Shutdown( void )
 
     g_PreDisplayBuffer.Destroy();
 
+    // Last, because everything above frees its descriptors on the way out, and whatever is still
+    // allocated now is reported as leaked
+    for (uint32_t i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; ++i)
+        g_DescriptorAllocator[i].Destroy();
+    DescriptorAllocator::DestroyAll();
+
 #if defined(_DEBUG)
     ID3D12DebugDevice* debugInterface;
     if (SUCCEEDED(g_Device->QueryInterface(&debugInterface)))
@@ -815,6 +846,7 @@ void Graphics::Present(void)
 
     ++s_FrameIndex;
     TemporalEffects::Update((uint32_t)s_FrameIndex);
+    LinearAllocator::EndFrame();
 
     SetNativeResolution();
 }
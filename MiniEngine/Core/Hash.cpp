@@ -0,0 +1,217 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "Hash.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #define HASH_X64 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define CRC32_TARGET
+    #else
+        #include <cpuid.h>
+        #include <nmmintrin.h>
+        #define CRC32_TARGET __attribute__((target("sse4.2")))
+    #endif
+#else
+    #define HASH_X64 0
+#endif
+
+namespace
+{
+    // Seeds for the second and third lanes so that a buffer of repeated words doesn't produce three
+    // identical lane values that cancel when folded.
+    const uint32_t kLane1Seed = 0x9E3779B9u;
+    const uint32_t kLane2Seed = 0x85EBCA6Bu;
+
+    // CRC is linear, so folding the lanes together with more CRC steps would let a change in one lane
+    // cancel a correspondingly shifted change in another.  Multiplying by odd constants first breaks
+    // that relationship.
+    const uint64_t kLane1Mix = 0x9E3779B97F4A7C15ull;
+    const uint64_t kLane2Mix = 0xC2B2AE3D27D4EB4Full;
+
+    // Slicing-by-8 tables for the reflected CRC32-C (Castagnoli) polynomial, which is the one the
+    // SSE4.2 crc32 instruction implements.
+    struct Crc32Tables
+    {
+        uint32_t Table[8][256];
+
+        Crc32Tables()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t Crc = i;
+                for (int Bit = 0; Bit < 8; ++Bit)
+                    Crc = (Crc >> 1) ^ (0x82F63B78u & (0u - (Crc & 1)));
+                Table[0][i] = Crc;
+            }
+
+            for (int Slice = 1; Slice < 8; ++Slice)
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t Prev = Table[Slice - 1][i];
+                    Table[Slice][i] = (Prev >> 8) ^ Table[0][Prev & 0xFF];
+                }
+            }
+        }
+    };
+
+    // Built on first use rather than as a global so that hashes computed during other modules'
+    // static initialization are still correct.
+    const Crc32Tables& GetCrc32Tables( void )
+    {
+        static const Crc32Tables s_Tables;
+        return s_Tables;
+    }
+
+    inline uint32_t SoftwareCrc32_u32( const Crc32Tables& Tables, uint32_t Crc, uint32_t Value )
+    {
+        const uint32_t (&T)[8][256] = Tables.Table;
+        Value ^= Crc;
+        return T[3][Value & 0xFF] ^ T[2][(Value >> 8) & 0xFF] ^ T[1][(Value >> 16) & 0xFF] ^ T[0][Value >> 24];
+    }
+
+    inline uint32_t SoftwareCrc32_u64( const Crc32Tables& Tables, uint32_t Crc, uint64_t Value )
+    {
+        const uint32_t (&T)[8][256] = Tables.Table;
+        Value ^= Crc;
+        return T[7][Value & 0xFF] ^ T[6][(Value >> 8) & 0xFF] ^ T[5][(Value >> 16) & 0xFF] ^ T[4][(Value >> 24) & 0xFF] ^
+            T[3][(Value >> 32) & 0xFF] ^ T[2][(Value >> 40) & 0xFF] ^ T[1][(Value >> 48) & 0xFF] ^ T[0][Value >> 56];
+    }
+
+    inline uint64_t LoadWord( const uint32_t* Ptr )
+    {
+        uint64_t Word;
+        memcpy(&Word, Ptr, sizeof(Word));
+        return Word;
+    }
+
+    size_t SoftwareHashSingle( const uint32_t* Iter, const uint32_t* End, size_t Hash )
+    {
+        const Crc32Tables& Tables = GetCrc32Tables();
+        uint32_t Crc = (uint32_t)Hash;
+
+        for (; Iter + 2 <= End; Iter += 2)
+            Crc = SoftwareCrc32_u64(Tables, Crc, LoadWord(Iter));
+
+        if (Iter < End)
+            Crc = SoftwareCrc32_u32(Tables, Crc, *Iter);
+
+        return Crc;
+    }
+
+    size_t SoftwareHashInterleaved( const uint32_t* Iter, const uint32_t* End, size_t Hash )
+    {
+        const Crc32Tables& Tables = GetCrc32Tables();
+        uint32_t Crc0 = (uint32_t)Hash;
+        uint32_t Crc1 = Crc0 ^ kLane1Seed;
+        uint32_t Crc2 = Crc0 ^ kLane2Seed;
+
+        for (; Iter + 6 <= End; Iter += 6)
+        {
+            Crc0 = SoftwareCrc32_u64(Tables, Crc0, LoadWord(Iter));
+            Crc1 = SoftwareCrc32_u64(Tables, Crc1, LoadWord(Iter + 2));
+            Crc2 = SoftwareCrc32_u64(Tables, Crc2, LoadWord(Iter + 4));
+        }
+
+        for (; Iter + 2 <= End; Iter += 2)
+            Crc0 = SoftwareCrc32_u64(Tables, Crc0, LoadWord(Iter));
+
+        if (Iter < End)
+            Crc0 = SoftwareCrc32_u32(Tables, Crc0, *Iter);
+
+        Crc0 = SoftwareCrc32_u64(Tables, Crc0, Crc1 * kLane1Mix);
+        return SoftwareCrc32_u64(Tables, Crc0, Crc2 * kLane2Mix);
+    }
+
+#if HASH_X64
+
+    bool DetectCrc32( void )
+    {
+#if defined(_MSC_VER)
+        int CpuInfo[4];
+        __cpuid(CpuInfo, 1);
+        return (CpuInfo[2] & (1 << 20)) != 0;
+#else
+        unsigned int Eax, Ebx, Ecx, Edx;
+        return __get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx) && (Ecx & bit_SSE4_2) != 0;
+#endif
+    }
+
+    CRC32_TARGET size_t HardwareHashSingle( const uint32_t* Iter, const uint32_t* End, size_t Hash )
+    {
+        for (; Iter + 2 <= End; Iter += 2)
+            Hash = (size_t)_mm_crc32_u64((uint32_t)Hash, LoadWord(Iter));
+
+        if (Iter < End)
+            Hash = _mm_crc32_u32((uint32_t)Hash, *Iter);
+
+        return Hash;
+    }
+
+    // Three crc32 instructions are in flight per iteration, hiding the latency of each one
+    CRC32_TARGET size_t HardwareHashInterleaved( const uint32_t* Iter, const uint32_t* End, size_t Hash )
+    {
+        uint64_t Crc0 = (uint32_t)Hash;
+        uint64_t Crc1 = Crc0 ^ kLane1Seed;
+        uint64_t Crc2 = Crc0 ^ kLane2Seed;
+
+        for (; Iter + 6 <= End; Iter += 6)
+        {
+            Crc0 = _mm_crc32_u64(Crc0, LoadWord(Iter));
+            Crc1 = _mm_crc32_u64(Crc1, LoadWord(Iter + 2));
+            Crc2 = _mm_crc32_u64(Crc2, LoadWord(Iter + 4));
+        }
+
+        for (; Iter + 2 <= End; Iter += 2)
+            Crc0 = _mm_crc32_u64(Crc0, LoadWord(Iter));
+
+        if (Iter < End)
+            Crc0 = _mm_crc32_u32((uint32_t)Crc0, *Iter);
+
+        Crc0 = _mm_crc32_u64(Crc0, Crc1 * kLane1Mix);
+        return (size_t)_mm_crc32_u64(Crc0, Crc2 * kLane2Mix);
+    }
+
+#else
+
+    bool DetectCrc32( void ) { return false; }
+
+#endif
+}
+
+namespace Utility
+{
+    namespace HashInternal
+    {
+        bool g_CpuHasCrc32 = DetectCrc32();
+
+        size_t HashRangeSingle( const uint32_t* Begin, const uint32_t* End, size_t Hash )
+        {
+#if HASH_X64
+            if (g_CpuHasCrc32)
+                return HardwareHashSingle(Begin, End, Hash);
+#endif
+            return SoftwareHashSingle(Begin, End, Hash);
+        }
+
+        size_t HashRangeInterleaved( const uint32_t* Begin, const uint32_t* End, size_t Hash )
+        {
+#if HASH_X64
+            if (g_CpuHasCrc32)
+                return HardwareHashInterleaved(Begin, End, Hash);
+#endif
+            return SoftwareHashInterleaved(Begin, End, Hash);
+        }
+    }
+}
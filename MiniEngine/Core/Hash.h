@@ -8,18 +8,30 @@
 //
 // Developed by Minigraph
 //
-// Author:  James Stanard 
+// Author:  James Stanard
 
 #pragma once
 
-#include "Math/Common.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
-// This requires SSE4.2 which is present on Intel Nehalem (Nov. 2008)
-// and AMD Bulldozer (Oct. 2011) processors.  I could put a runtime
-// check for this, but I'm just going to assume people playing with
-// DirectX 12 on Windows 10 have fairly recent machines.
-#ifdef _M_X64
+// The hash is CRC32-C over 64-bit words.  SSE4.2 computes that in one instruction, but it is only
+// present on Intel Nehalem (Nov. 2008) and AMD Bulldozer (Oct. 2011) and later, so it is detected
+// at runtime.  Machines without it (and non-x86 builds) run a table-driven implementation that
+// produces bit-identical results, which matters because these hashes are persisted in the PSO
+// disk cache.
+//
+// A single CRC chain is limited by the 3-cycle latency of the crc32 instruction.  Ranges of
+// kInterleavedHashMinWords or more are hashed as three independent chains over interleaved words,
+// which are folded together at the end.  This triples throughput on large blobs such as shader
+// bytecode and full pipeline state descriptions.
+//
+// Only MSVC can use the SSE4.2 intrinsics inline without compiling the whole file for SSE4.2, so
+// the inline fast path is MSVC x64 only.  Other compilers call into Hash.cpp for every range.
+#if defined(_MSC_VER) && defined(_M_X64)
 #define ENABLE_SSE_CRC32 1
+#include <intrin.h>
 #else
 #define ENABLE_SSE_CRC32 0
 #endif
@@ -31,30 +43,45 @@
 
 namespace Utility
 {
+    namespace HashInternal
+    {
+        // Set at static initialization time.  Until then the software path is used, which is fine
+        // because both paths produce the same values.
+        extern bool g_CpuHasCrc32;
+
+        static const size_t kInterleavedHashMinWords = 64;    // 256 bytes
+
+        size_t HashRangeInterleaved( const uint32_t* Begin, const uint32_t* End, size_t Hash );
+        size_t HashRangeSingle( const uint32_t* Begin, const uint32_t* End, size_t Hash );
+    }
+
     inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
     {
-#if ENABLE_SSE_CRC32
-        const uint64_t* Iter64 = (const uint64_t*)Math::AlignUp(Begin, 8);
-        const uint64_t* const End64 = (const uint64_t* const)Math::AlignDown(End, 8);
+        if ((size_t)(End - Begin) >= HashInternal::kInterleavedHashMinWords)
+            return HashInternal::HashRangeInterleaved(Begin, End, Hash);
 
-        // If not 64-bit aligned, start with a single u32
-        if ((uint32_t*)Iter64 > Begin)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *Begin);
+#if ENABLE_SSE_CRC32
+        if (HashInternal::g_CpuHasCrc32)
+        {
+            // Iterate over consecutive u64 values.  Unaligned loads are free on any CPU with SSE4.2,
+            // and reading by value keeps the result independent of where the data lives.
+            const uint32_t* Iter = Begin;
+            for (; Iter + 2 <= End; Iter += 2)
+            {
+                uint64_t Word;
+                memcpy(&Word, Iter, sizeof(Word));
+                Hash = _mm_crc32_u64((uint64_t)Hash, Word);
+            }
 
-        // Iterate over consecutive u64 values
-        while (Iter64 < End64)
-            Hash = _mm_crc32_u64((uint64_t)Hash, *Iter64++);
+            // If there is a 32-bit remainder, accumulate that
+            if (Iter < End)
+                Hash = _mm_crc32_u32((uint32_t)Hash, *Iter);
 
-        // If there is a 32-bit remainder, accumulate that
-        if ((uint32_t*)Iter64 < End)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *(uint32_t*)Iter64);
-#else
-        // An inexpensive hash for CPUs lacking SSE4.2
-        for (const uint32_t* Iter = Begin; Iter < End; ++Iter)
-            Hash = 16777619U * Hash ^ *Iter;
+            return Hash;
+        }
 #endif
 
-        return Hash;
+        return HashInternal::HashRangeSingle(Begin, End, Hash);
     }
 
     template <typename T> inline size_t HashState( const T* StateDesc, size_t Count = 1, size_t Hash = 2166136261U )
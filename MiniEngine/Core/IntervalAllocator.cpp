@@ -0,0 +1,158 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "IntervalAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace
+{
+    uint64_t AlignUp( uint64_t Value, uint64_t Alignment )
+    {
+        return (Value + Alignment - 1) & ~(Alignment - 1);
+    }
+}
+
+uint32_t IntervalAllocator::AddInterval( uint32_t Begin, uint32_t End, uint64_t SizeInBytes, uint64_t Alignment )
+{
+    assert(Begin <= End);
+    assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0);
+
+    Interval NewInterval = { Begin, End, SizeInBytes, Alignment, 0 };
+    m_Intervals.push_back(NewInterval);
+    return (uint32_t)m_Intervals.size() - 1;
+}
+
+void IntervalAllocator::Clear( void )
+{
+    m_Intervals.clear();
+    m_HeapSize = 0;
+    m_HeapAlignment = 1;
+}
+
+uint64_t IntervalAllocator::Allocate( bool Alias )
+{
+    const uint32_t NumIntervals = (uint32_t)m_Intervals.size();
+
+    vector<uint32_t> Order(NumIntervals);
+    for (uint32_t i = 0; i < NumIntervals; ++i)
+        Order[i] = i;
+
+    // Largest first, then earliest.  The stable sort keeps exact ties in the order they were added.
+    stable_sort(Order.begin(), Order.end(), [&]( uint32_t A, uint32_t B )
+    {
+        if (m_Intervals[A].SizeInBytes != m_Intervals[B].SizeInBytes)
+            return m_Intervals[A].SizeInBytes > m_Intervals[B].SizeInBytes;
+        return m_Intervals[A].Begin < m_Intervals[B].Begin;
+    });
+
+    m_HeapSize = 0;
+    m_HeapAlignment = 1;
+
+    vector<uint32_t> Placed;
+    vector<pair<uint64_t, uint64_t>> Occupied;
+    Placed.reserve(NumIntervals);
+
+    for (uint32_t Idx : Order)
+    {
+        Interval& Block = m_Intervals[Idx];
+        m_HeapAlignment = max(m_HeapAlignment, Block.Alignment);
+
+        Occupied.clear();
+        for (uint32_t Other : Placed)
+        {
+            if (!Alias || LifetimesOverlap(Idx, Other))
+                Occupied.push_back(make_pair(m_Intervals[Other].Offset, m_Intervals[Other].Offset + m_Intervals[Other].SizeInBytes));
+        }
+        sort(Occupied.begin(), Occupied.end());
+
+        uint64_t Offset = 0;
+        for (const pair<uint64_t, uint64_t>& Range : Occupied)
+        {
+            if (Offset + Block.SizeInBytes <= Range.first)
+                break;
+            Offset = max(Offset, AlignUp(Range.second, Block.Alignment));
+        }
+
+        Block.Offset = Offset;
+        m_HeapSize = max(m_HeapSize, Offset + Block.SizeInBytes);
+        Placed.push_back(Idx);
+    }
+
+    m_HeapSize = AlignUp(m_HeapSize, m_HeapAlignment);
+    return m_HeapSize;
+}
+
+uint64_t IntervalAllocator::GetTotalSize( void ) const
+{
+    uint64_t Total = 0;
+    for (const Interval& Block : m_Intervals)
+        Total += AlignUp(Block.SizeInBytes, Block.Alignment);
+    return Total;
+}
+
+uint64_t IntervalAllocator::GetPeakLiveSize( void ) const
+{
+    // Sweep the interval ends in time order.  A block is live from Begin through End, so at equal times
+    // it starts before any block ending there is let go.
+    vector<pair<uint64_t, int64_t>> Events;
+    Events.reserve(m_Intervals.size() * 2);
+    for (const Interval& Block : m_Intervals)
+    {
+        Events.push_back(make_pair((uint64_t)Block.Begin * 2, (int64_t)Block.SizeInBytes));
+        Events.push_back(make_pair((uint64_t)Block.End * 2 + 1, -(int64_t)Block.SizeInBytes));
+    }
+    sort(Events.begin(), Events.end());
+
+    int64_t Live = 0;
+    int64_t Peak = 0;
+    for (const pair<uint64_t, int64_t>& Event : Events)
+    {
+        Live += Event.second;
+        Peak = max(Peak, Live);
+    }
+    return (uint64_t)Peak;
+}
+
+bool IntervalAllocator::LifetimesOverlap( uint32_t A, uint32_t B ) const
+{
+    return m_Intervals[A].Begin <= m_Intervals[B].End && m_Intervals[B].Begin <= m_Intervals[A].End;
+}
+
+bool IntervalAllocator::MemoryOverlaps( uint32_t A, uint32_t B ) const
+{
+    const Interval& BlockA = m_Intervals[A];
+    const Interval& BlockB = m_Intervals[B];
+    return BlockA.Offset < BlockB.Offset + BlockB.SizeInBytes && BlockB.Offset < BlockA.Offset + BlockA.SizeInBytes;
+}
+
+bool IntervalAllocator::Validate( void ) const
+{
+    const uint32_t NumIntervals = (uint32_t)m_Intervals.size();
+
+    for (uint32_t A = 0; A < NumIntervals; ++A)
+    {
+        const Interval& Block = m_Intervals[A];
+        if (Block.Offset % Block.Alignment != 0 || Block.Offset + Block.SizeInBytes > m_HeapSize)
+            return false;
+
+        for (uint32_t B = A + 1; B < NumIntervals; ++B)
+        {
+            if (LifetimesOverlap(A, B) && MemoryOverlaps(A, B))
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Places blocks of memory that are each only needed for a range of time, such that blocks
+// whose ranges overlap never overlap in memory.  This is colouring of the interval graph where each
+// block is a vertex weighted by its size and the colours are byte ranges.  Blocks are taken largest
+// first and each is given the lowest aligned offset clear of every block already placed that is live at
+// the same time.  First-fit decreasing is not always optimal, so GetPeakLiveSize() gives the lower bound
+// to compare against.
+//
+// Everything here is plain data, so it can be exercised on any platform.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class IntervalAllocator
+{
+public:
+
+    IntervalAllocator() : m_HeapSize(0), m_HeapAlignment(1) {}
+
+    // Begin and End are inclusive and in any unit of time.  Alignment must be a power of two.
+    uint32_t AddInterval( uint32_t Begin, uint32_t End, uint64_t SizeInBytes, uint64_t Alignment );
+
+    void Clear( void );
+
+    // Places every interval, or every interval at its own memory when Alias is false.  Returns the heap size.
+    uint64_t Allocate( bool Alias = true );
+
+    uint32_t GetNumIntervals( void ) const { return (uint32_t)m_Intervals.size(); }
+    uint64_t GetOffset( uint32_t Interval ) const { return m_Intervals[Interval].Offset; }
+
+    // Valid after Allocate().  The heap size is a multiple of the heap alignment, which is the largest
+    // alignment asked for.
+    uint64_t GetHeapSize( void ) const { return m_HeapSize; }
+    uint64_t GetHeapAlignment( void ) const { return m_HeapAlignment; }
+
+    // What the intervals would take with nothing shared
+    uint64_t GetTotalSize( void ) const;
+
+    // The most memory live at any one time.  No placement can use less.
+    uint64_t GetPeakLiveSize( void ) const;
+
+    bool LifetimesOverlap( uint32_t A, uint32_t B ) const;
+    bool MemoryOverlaps( uint32_t A, uint32_t B ) const;
+
+    // Checks that no two intervals that are live together share memory, and that all are aligned and fit
+    bool Validate( void ) const;
+
+private:
+
+    struct Interval
+    {
+        uint32_t Begin;
+        uint32_t End;
+        uint64_t SizeInBytes;
+        uint64_t Alignment;
+        uint64_t Offset;
+    };
+
+    std::vector<Interval> m_Intervals;
+    uint64_t m_HeapSize;
+    uint64_t m_HeapAlignment;
+};
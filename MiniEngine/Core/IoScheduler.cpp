@@ -0,0 +1,350 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "IoScheduler.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace
+{
+    const uint32_t kRecentRequests = 256;
+
+    double Milliseconds( chrono::steady_clock::duration Duration )
+    {
+        return chrono::duration<double, milli>(Duration).count();
+    }
+}
+
+IoScheduler::IoScheduler( ReadFunction Read ) :
+    m_Read(move(Read)),
+    m_Stopping(false),
+    m_ReadsInFlight(0),
+    m_PrefetchesInFlight(0),
+    m_MaxPrefetchesInFlight(1),
+    m_NextRecent(0)
+{
+    ResetStats();
+}
+
+IoScheduler::~IoScheduler()
+{
+    Stop();
+}
+
+void IoScheduler::Start( uint32_t NumThreads )
+{
+    assert(m_Workers.empty() && NumThreads > 0);
+
+    lock_guard<mutex> Guard(m_Mutex);
+    m_MaxPrefetchesInFlight = NumThreads > 1 ? NumThreads - 1 : 1;
+
+    m_Workers.reserve(NumThreads);
+    for (uint32_t i = 0; i < NumThreads; ++i)
+        m_Workers.emplace_back(&IoScheduler::WorkerLoop, this);
+}
+
+void IoScheduler::Stop( void )
+{
+    // Retired here rather than after the workers finish, so that a request made meanwhile starts a new read
+    // rather than joining one that is being dropped
+    vector<vector<Waiter>> DroppedWaiters;
+    vector<vector<bool>> DroppedCancelled;
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        m_Stopping = true;
+
+        const Clock::time_point StopTime = Clock::now();
+        for (deque<PendingReadPtr>& Queue : m_Queues)
+        {
+            for (PendingReadPtr& Pending : Queue)
+            {
+                if (!Pending->Started)
+                {
+                    DroppedWaiters.emplace_back();
+                    DroppedCancelled.emplace_back();
+                    BeginRead(*Pending);
+                    Retire(*Pending, nullptr, false, StopTime, DroppedWaiters.back(), DroppedCancelled.back());
+                }
+            }
+            Queue.clear();
+        }
+    }
+    m_WakeUp.notify_all();
+
+    for (thread& Worker : m_Workers)
+        Worker.join();
+    m_Workers.clear();
+
+    for (size_t i = 0; i < DroppedWaiters.size(); ++i)
+        Notify(DroppedWaiters[i], DroppedCancelled[i], nullptr);
+
+    lock_guard<mutex> Guard(m_Mutex);
+    m_Stopping = false;
+}
+
+void IoScheduler::Read( const wstring& Path, PriorityClass Priority, const IoCancelToken& Cancel, CompletionFunction OnComplete )
+{
+    Schedule(Path, Priority, Cancel, nullptr, move(OnComplete));
+}
+
+void IoScheduler::Schedule( const wstring& Path, PriorityClass Priority, const IoCancelToken& Cancel,
+    CustomReadFunction ReadData, CompletionFunction OnComplete )
+{
+    assert(Priority < kNumPriorities);
+
+    Waiter NewWaiter = { move(OnComplete), Cancel, Priority, Clock::now(), false };
+
+    unique_lock<mutex> Lock(m_Mutex);
+
+    auto Existing = m_Pending.find(Path);
+    if (Existing != m_Pending.end())
+    {
+        PendingReadPtr& Pending = Existing->second;
+        NewWaiter.Coalesced = true;
+        Pending->Waiters.push_back(move(NewWaiter));
+
+        if (!Pending->Started && Priority < Pending->Priority)
+        {
+            Pending->Priority = Priority;
+            m_Queues[Priority].push_back(Pending);
+            Lock.unlock();
+            m_WakeUp.notify_one();
+        }
+        return;
+    }
+
+    PendingReadPtr Pending = make_shared<PendingRead>();
+    Pending->Path = Path;
+    Pending->ReadData = move(ReadData);
+    Pending->Priority = Priority;
+    Pending->Started = false;
+    Pending->Waiters.push_back(move(NewWaiter));
+    m_Pending.emplace(Path, Pending);
+
+    if (m_Workers.empty() || m_Stopping)
+    {
+        BeginRead(*Pending);
+        Lock.unlock();
+        ReadNow(*Pending);
+        return;
+    }
+
+    m_Queues[Priority].push_back(move(Pending));
+    Lock.unlock();
+    m_WakeUp.notify_one();
+}
+
+shared_future<IoScheduler::Buffer> IoScheduler::Read( const wstring& Path, PriorityClass Priority, const IoCancelToken& Cancel )
+{
+    // The future has to exist before the read is made, because without workers it completes right here
+    shared_ptr<promise<Buffer>> Result = make_shared<promise<Buffer>>();
+    shared_future<Buffer> Future = Result->get_future().share();
+
+    Read(Path, Priority, Cancel, [Result]( const Buffer& Data ) { Result->set_value(Data); });
+    return Future;
+}
+
+IoScheduler::Stats IoScheduler::GetStats( void ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    return m_Stats;
+}
+
+void IoScheduler::ResetStats( void )
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    m_Stats = Stats();
+    m_Recent.clear();
+    m_NextRecent = 0;
+}
+
+vector<IoScheduler::RequestStats> IoScheduler::GetRecentRequests( void ) const
+{
+    lock_guard<mutex> Guard(m_Mutex);
+    vector<RequestStats> Recent(m_Recent.begin() + m_NextRecent, m_Recent.end());
+    Recent.insert(Recent.end(), m_Recent.begin(), m_Recent.begin() + m_NextRecent);
+    return Recent;
+}
+
+void IoScheduler::WorkerLoop( void )
+{
+    unique_lock<mutex> Lock(m_Mutex);
+
+    for (;;)
+    {
+        PendingReadPtr Next;
+        m_WakeUp.wait(Lock, [&]( void ) { return m_Stopping || TakeRead(Next); });
+        if (Next == nullptr)
+            break;
+
+        Lock.unlock();
+        ReadNow(*Next);
+        Lock.lock();
+    }
+}
+
+bool IoScheduler::TakeRead( PendingReadPtr& Found )
+{
+    for (uint32_t Priority = 0; Priority < kNumPriorities; ++Priority)
+    {
+        if (Priority == kPrefetch && m_PrefetchesInFlight >= m_MaxPrefetchesInFlight)
+            break;
+
+        deque<PendingReadPtr>& Queue = m_Queues[Priority];
+        while (!Queue.empty())
+        {
+            PendingReadPtr Pending = move(Queue.front());
+            Queue.pop_front();
+
+            // Left behind when the read was promoted
+            if (Pending->Started || Pending->Priority != Priority)
+                continue;
+
+            BeginRead(*Pending);
+            Found = move(Pending);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void IoScheduler::BeginRead( PendingRead& Pending )
+{
+    Pending.Started = true;
+
+    ++m_ReadsInFlight;
+    m_Stats.MaxReadsInFlight = max(m_Stats.MaxReadsInFlight, m_ReadsInFlight);
+
+    if (Pending.Priority == kPrefetch)
+        ++m_PrefetchesInFlight;
+}
+
+bool IoScheduler::AllCancelled( const PendingRead& Pending ) const
+{
+    for (const Waiter& Waiting : Pending.Waiters)
+    {
+        if (!Waiting.Cancel.IsCancelled())
+            return false;
+    }
+    return true;
+}
+
+void IoScheduler::ReadNow( PendingRead& Pending )
+{
+    const Clock::time_point StartTime = Clock::now();
+
+    // Dropping the read has to happen under the same lock as the check.  Otherwise a request could join it
+    // in between and be dropped with it, though it was never cancelled.
+    vector<Waiter> Waiters;
+    vector<bool> Cancelled;
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        if (AllCancelled(Pending))
+            Retire(Pending, nullptr, false, StartTime, Waiters, Cancelled);
+    }
+
+    if (!Waiters.empty())
+        Notify(Waiters, Cancelled, nullptr);
+    else
+        Complete(Pending, Pending.ReadData ? Pending.ReadData() : m_Read(Pending.Path), true, StartTime);
+}
+
+void IoScheduler::Complete( PendingRead& Pending, const Buffer& Data, bool WasRead, Clock::time_point StartTime )
+{
+    vector<Waiter> Waiters;
+    vector<bool> Cancelled;
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        Retire(Pending, Data, WasRead, StartTime, Waiters, Cancelled);
+    }
+
+    Notify(Waiters, Cancelled, Data);
+}
+
+void IoScheduler::Retire( PendingRead& Pending, const Buffer& Data, bool WasRead, Clock::time_point StartTime,
+    vector<Waiter>& Waiters, vector<bool>& Cancelled )
+{
+    const Clock::time_point EndTime = Clock::now();
+    const uint64_t Bytes = Data != nullptr ? Data->size() : 0;
+
+    // Nobody can join the read once it leaves m_Pending, so these are all of its waiters
+    m_Pending.erase(Pending.Path);
+    Waiters.swap(Pending.Waiters);
+
+    --m_ReadsInFlight;
+    if (Pending.Priority == kPrefetch)
+        --m_PrefetchesInFlight;
+
+    if (WasRead)
+        ++m_Stats.ByPriority[Pending.Priority].Reads;
+
+    for (const Waiter& Done : Waiters)
+    {
+        Cancelled.push_back(!WasRead || Done.Cancel.IsCancelled());
+        Record(Done, Pending.Path, Cancelled.back(), StartTime, EndTime, Bytes);
+    }
+}
+
+void IoScheduler::Notify( vector<Waiter>& Waiters, const vector<bool>& Cancelled, const Buffer& Data )
+{
+    // A prefetch may have been held back for this thread
+    m_WakeUp.notify_one();
+
+    for (size_t i = 0; i < Waiters.size(); ++i)
+    {
+        if (Waiters[i].OnComplete)
+            Waiters[i].OnComplete(Cancelled[i] ? nullptr : Data);
+    }
+}
+
+void IoScheduler::Record( const Waiter& Done, const wstring& Path, bool Cancelled, Clock::time_point StartTime,
+    Clock::time_point EndTime, uint64_t Bytes )
+{
+    RequestStats Request;
+    Request.Path = Path;
+    Request.Priority = Done.Priority;
+    Request.Coalesced = Done.Coalesced;
+    Request.Cancelled = Cancelled;
+    Request.QueuedMs = Milliseconds(StartTime > Done.RequestTime ? StartTime - Done.RequestTime : Clock::duration::zero());
+    Request.ReadMs = Milliseconds(EndTime - max(StartTime, Done.RequestTime));
+    Request.Bytes = Cancelled ? 0 : Bytes;
+
+    PriorityStats& Totals = m_Stats.ByPriority[Done.Priority];
+    ++Totals.Requests;
+    if (Done.Coalesced)
+        ++Totals.Coalesced;
+
+    if (Cancelled)
+    {
+        ++Totals.Cancelled;
+    }
+    else
+    {
+        const double LatencyMs = Request.QueuedMs + Request.ReadMs;
+        Totals.Bytes += Request.Bytes;
+        Totals.TotalLatencyMs += LatencyMs;
+        Totals.MaxLatencyMs = max(Totals.MaxLatencyMs, LatencyMs);
+    }
+
+    if (m_Recent.size() < kRecentRequests)
+    {
+        m_Recent.push_back(move(Request));
+    }
+    else
+    {
+        m_Recent[m_NextRecent] = move(Request);
+        m_NextRecent = (m_NextRecent + 1) % kRecentRequests;
+    }
+}
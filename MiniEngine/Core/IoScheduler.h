@@ -0,0 +1,186 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Queues file reads for a small, fixed pool of threads, so that a level load or a burst of
+// texture streaming can't put more reads in flight than the disk serves well.  Reads come out of the queue
+// highest priority first, and in order of arrival within a priority.  A read for a path that is already
+// queued or in flight joins that read instead of starting another, and the shared read is promoted to the
+// most urgent priority among those waiting for it.  A read that is cancelled before it starts is dropped.
+//
+// The scheduler doesn't know how to read a file:  it is given a function that does.  Nothing here touches
+// Windows, so it can be driven and timed on any platform, e.g.
+//
+//     IoScheduler Scheduler(ReadWholeFile);
+//     Scheduler.Start(2);
+//     std::shared_future<IoScheduler::Buffer> Data = Scheduler.Read(L"Textures/sky.dds", IoScheduler::kVisible);
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Shared by every copy, so whoever holds one can cancel the reads it was passed to
+class IoCancelToken
+{
+public:
+    IoCancelToken() : m_Cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel( void ) const { m_Cancelled->store(true); }
+    bool IsCancelled( void ) const { return m_Cancelled->load(); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_Cancelled;
+};
+
+class IoScheduler
+{
+public:
+
+    enum PriorityClass
+    {
+        kCritical,          // Something is blocked on it:  startup, a level load
+        kVisible,           // On screen now with a placeholder standing in
+        kPrefetch,          // May be needed soon
+        kNumPriorities
+    };
+
+    // The same type as Utility::ByteArray.  A cancelled request yields a null buffer, and a failed read
+    // whatever the read function returns for one.
+    typedef std::shared_ptr<std::vector<unsigned char>> Buffer;
+    typedef std::function<Buffer (const std::wstring& Path)> ReadFunction;
+    typedef std::function<Buffer (void)> CustomReadFunction;
+    typedef std::function<void (const Buffer& Data)> CompletionFunction;
+
+    // How long one request took.  A request that joined another shares its read, but waits from when it
+    // was made.
+    struct RequestStats
+    {
+        std::wstring Path;
+        PriorityClass Priority;
+        bool Coalesced;             // Joined a read that was already queued or in flight
+        bool Cancelled;
+        double QueuedMs;            // From the request until a thread started reading
+        double ReadMs;              // Reading, or the part of it this request waited for
+        uint64_t Bytes;
+    };
+
+    struct PriorityStats
+    {
+        uint64_t Requests;
+        uint64_t Reads;             // Requests that reached the disk rather than joining another
+        uint64_t Coalesced;
+        uint64_t Cancelled;
+        uint64_t Bytes;
+        double TotalLatencyMs;      // Queued plus read, over the requests that weren't cancelled
+        double MaxLatencyMs;
+    };
+
+    struct Stats
+    {
+        PriorityStats ByPriority[kNumPriorities];
+        uint32_t MaxReadsInFlight;
+    };
+
+    explicit IoScheduler( ReadFunction Read );
+    ~IoScheduler();
+
+    IoScheduler( const IoScheduler& ) = delete;
+    IoScheduler& operator=( const IoScheduler& ) = delete;
+
+    // Until Start(), and after Stop(), reads happen on the thread that asks for them.  With more than one
+    // thread, prefetches never take the last of them, so a more urgent read can always start right away.
+    void Start( uint32_t NumThreads = 2 );
+
+    // Cancels whatever is still queued and waits for the reads in flight
+    void Stop( void );
+
+    // OnComplete is called on the thread that did the read, or on this one if the read happened here
+    void Read( const std::wstring& Path, PriorityClass Priority, const IoCancelToken& Cancel, CompletionFunction OnComplete );
+    std::shared_future<Buffer> Read( const std::wstring& Path, PriorityClass Priority = kVisible,
+        const IoCancelToken& Cancel = IoCancelToken() );
+
+    // Like Read(), but ReadData does the reading, e.g. of part of a file.  Requests share a read when their
+    // keys match, so the key has to name the data and not just the file.
+    void Schedule( const std::wstring& Key, PriorityClass Priority, const IoCancelToken& Cancel,
+        CustomReadFunction ReadData, CompletionFunction OnComplete );
+
+    Stats GetStats( void ) const;
+    void ResetStats( void );
+
+    // The most recent requests to finish, oldest first
+    std::vector<RequestStats> GetRecentRequests( void ) const;
+
+private:
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Waiter
+    {
+        CompletionFunction OnComplete;
+        IoCancelToken Cancel;
+        PriorityClass Priority;
+        Clock::time_point RequestTime;
+        bool Coalesced;
+    };
+
+    // Every request for one path, from the first until the read completes
+    struct PendingRead
+    {
+        std::wstring Path;          // Or the key of a custom read
+        CustomReadFunction ReadData;
+        PriorityClass Priority;     // The most urgent of the waiters, and the queue it is taken from
+        bool Started;
+        std::vector<Waiter> Waiters;
+    };
+
+    typedef std::shared_ptr<PendingRead> PendingReadPtr;
+
+    void WorkerLoop( void );
+    bool TakeRead( PendingReadPtr& Found );
+    bool AllCancelled( const PendingRead& Pending ) const;
+    void Complete( PendingRead& Pending, const Buffer& Data, bool WasRead, Clock::time_point StartTime );
+    void Retire( PendingRead& Pending, const Buffer& Data, bool WasRead, Clock::time_point StartTime,
+        std::vector<Waiter>& Waiters, std::vector<bool>& Cancelled );
+    void Notify( std::vector<Waiter>& Waiters, const std::vector<bool>& Cancelled, const Buffer& Data );
+    void ReadNow( PendingRead& Pending );
+    void Record( const Waiter& Done, const std::wstring& Path, bool Cancelled, Clock::time_point StartTime,
+        Clock::time_point EndTime, uint64_t Bytes );
+    void BeginRead( PendingRead& Pending );
+
+    ReadFunction m_Read;
+
+    std::vector<std::thread> m_Workers;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    bool m_Stopping;
+
+    // A read is promoted by queueing it again at the higher priority.  The entry left behind is skipped
+    // when it comes up, because the read's priority no longer matches the queue.
+    std::deque<PendingReadPtr> m_Queues[kNumPriorities];
+    std::unordered_map<std::wstring, PendingReadPtr> m_Pending;
+    uint32_t m_ReadsInFlight;
+    uint32_t m_PrefetchesInFlight;
+    uint32_t m_MaxPrefetchesInFlight;
+
+    Stats m_Stats;
+    std::vector<RequestStats> m_Recent;     // A ring of the last kRecentRequests
+    uint32_t m_NextRecent;
+};
@@ -0,0 +1,348 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace
+{
+    // Yields before a worker with nothing to do goes to sleep.  Jobs tend to arrive in bursts, and waking
+    // a sleeping thread costs more than a few yields.
+    const uint32_t kSpinCount = 64;
+
+    // Ranges per thread in ParallelFor.  More than one lets stealing even out ranges of uneven cost.
+    const uint32_t kRangesPerThread = 4;
+
+    thread_local const JobScheduler* t_Scheduler = nullptr;
+    thread_local uint32_t t_QueueIndex = 0;
+}
+
+JobScheduler JobSystem::g_Scheduler;
+
+void JobSystem::Initialize( void )
+{
+    g_Scheduler.Start();
+}
+
+void JobSystem::Shutdown( void )
+{
+    g_Scheduler.Stop();
+}
+
+JobScheduler::JobScheduler() :
+    m_NumQueues(0),
+    m_QueuedJobs(0),
+    m_NumSleeping(0),
+    m_Stopping(false),
+    m_JobsHeld(0),
+    m_Sleeps(0)
+{
+    // Until Start(), jobs wait in the shared queue and run on whoever waits for them
+    CreateQueues(1);
+}
+
+void JobScheduler::CreateQueues( uint32_t NumQueues )
+{
+    m_Queues.clear();
+    for (uint32_t i = 0; i < NumQueues; ++i)
+        m_Queues.emplace_back(new WorkQueue);
+    m_NumQueues = NumQueues;
+    ResetStats();
+}
+
+JobScheduler::~JobScheduler()
+{
+    Stop();
+}
+
+void JobScheduler::Start( uint32_t NumWorkers )
+{
+    assert(m_Workers.empty() && m_QueuedJobs.load() == 0);
+
+    if (NumWorkers == 0)
+    {
+        const uint32_t NumThreads = thread::hardware_concurrency();
+        NumWorkers = NumThreads > 1 ? NumThreads - 1 : 0;
+    }
+
+    CreateQueues(NumWorkers + 1);
+
+    m_Workers.reserve(NumWorkers);
+    for (uint32_t i = 0; i < NumWorkers; ++i)
+        m_Workers.emplace_back(&JobScheduler::WorkerLoop, this, i);
+}
+
+void JobScheduler::Stop( void )
+{
+    {
+        lock_guard<mutex> Guard(m_SleepMutex);
+        m_Stopping = true;
+    }
+    m_WakeUp.notify_all();
+
+    for (thread& Worker : m_Workers)
+        Worker.join();
+    m_Workers.clear();
+
+    // With no workers, whatever is left runs here
+    Job Next;
+    while (FindJob(GetSharedQueue(), Next))
+        Run(GetSharedQueue(), Next);
+
+    m_Stopping = false;
+}
+
+void JobScheduler::Submit( JobFunction Function, JobCounter* Signal, JobCounter* DependsOn )
+{
+    if (Signal != nullptr)
+        Signal->m_Pending.fetch_add(1);
+
+    if (DependsOn != nullptr)
+    {
+        // The counter only reaches zero while its lock is held, so it can't be missed
+        lock_guard<mutex> Guard(DependsOn->m_Mutex);
+        if (DependsOn->m_Pending.load() > 0)
+        {
+            JobCounter::HeldJob Held = { move(Function), Signal };
+            DependsOn->m_Dependents.push_back(move(Held));
+            m_JobsHeld.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    Job NewJob = { move(Function), Signal };
+    Push(GetQueueIndex(), move(NewJob));
+}
+
+void JobScheduler::Wait( JobCounter& Counter )
+{
+    const uint32_t QueueIndex = GetQueueIndex();
+
+    while (Counter.m_Pending.load() > 0)
+    {
+        Job Next;
+        if (FindJob(QueueIndex, Next))
+            Run(QueueIndex, Next);
+        else
+            this_thread::yield();
+    }
+
+    // The last job to finish may still be releasing the counter.  Once it lets go of the lock, the
+    // caller is free to destroy the counter.
+    lock_guard<mutex> Guard(Counter.m_Mutex);
+}
+
+void JobScheduler::ParallelFor( uint32_t Begin, uint32_t End, uint32_t Grain, const RangeFunction& Body )
+{
+    if (Begin >= End)
+        return;
+
+    const uint32_t Count = End - Begin;
+    Grain = max(Grain, 1u);
+
+    const uint32_t MaxRanges = (GetNumWorkers() + 1) * kRangesPerThread;
+    const uint32_t NumRanges = min((Count + Grain - 1) / Grain, MaxRanges);
+    if (NumRanges <= 1)
+    {
+        Body(Begin, End);
+        return;
+    }
+
+    JobCounter Done;
+    for (uint32_t i = 1; i < NumRanges; ++i)
+    {
+        const uint32_t RangeBegin = Begin + (uint32_t)((uint64_t)Count * i / NumRanges);
+        const uint32_t RangeEnd = Begin + (uint32_t)((uint64_t)Count * (i + 1) / NumRanges);
+        Submit([&Body, RangeBegin, RangeEnd]( void ) { Body(RangeBegin, RangeEnd); }, &Done);
+    }
+
+    Body(Begin, Begin + Count / NumRanges);
+    Wait(Done);
+}
+
+JobSchedulerStats JobScheduler::GetStats( void ) const
+{
+    JobSchedulerStats Stats = {};
+    for (uint32_t i = 0; i < m_NumQueues; ++i)
+    {
+        Stats.JobsRun += m_Queues[i]->JobsRun.load(memory_order_relaxed);
+        Stats.JobsStolen += m_Queues[i]->JobsStolen.load(memory_order_relaxed);
+    }
+    Stats.JobsHeld = m_JobsHeld.load(memory_order_relaxed);
+    Stats.Sleeps = m_Sleeps.load(memory_order_relaxed);
+    return Stats;
+}
+
+void JobScheduler::ResetStats( void )
+{
+    for (uint32_t i = 0; i < m_NumQueues; ++i)
+    {
+        m_Queues[i]->JobsRun = 0;
+        m_Queues[i]->JobsStolen = 0;
+    }
+    m_JobsHeld = 0;
+    m_Sleeps = 0;
+}
+
+void JobScheduler::WorkerLoop( uint32_t QueueIndex )
+{
+    t_Scheduler = this;
+    t_QueueIndex = QueueIndex;
+
+    uint32_t Spins = 0;
+
+    for (;;)
+    {
+        Job Next;
+        if (FindJob(QueueIndex, Next))
+        {
+            Run(QueueIndex, Next);
+            Spins = 0;
+            continue;
+        }
+
+        if (++Spins < kSpinCount)
+        {
+            this_thread::yield();
+            continue;
+        }
+        Spins = 0;
+
+        // A pusher that sees no sleepers is ordered before the increment below, so the queued job is
+        // seen by the predicate.  One that sees a sleeper takes the lock before notifying.
+        unique_lock<mutex> Lock(m_SleepMutex);
+        m_NumSleeping.fetch_add(1);
+        if (m_QueuedJobs.load() == 0 && !m_Stopping)
+            m_Sleeps.fetch_add(1, memory_order_relaxed);
+        m_WakeUp.wait(Lock, [this]( void ) { return m_QueuedJobs.load() > 0 || m_Stopping; });
+        m_NumSleeping.fetch_sub(1);
+
+        if (m_Stopping && m_QueuedJobs.load() == 0)
+            break;
+    }
+
+    t_Scheduler = nullptr;
+}
+
+void JobScheduler::Push( uint32_t QueueIndex, Job&& NewJob )
+{
+    WorkQueue& Queue = *m_Queues[QueueIndex];
+    {
+        lock_guard<mutex> Guard(Queue.Mutex);
+        Queue.Jobs.push_back(move(NewJob));
+    }
+
+    m_QueuedJobs.fetch_add(1);
+
+    if (m_NumSleeping.load() > 0)
+    {
+        { lock_guard<mutex> Guard(m_SleepMutex); }
+        m_WakeUp.notify_one();
+    }
+}
+
+bool JobScheduler::FindJob( uint32_t QueueIndex, Job& Found )
+{
+    if (m_QueuedJobs.load() == 0)
+        return false;
+
+    const uint32_t SharedQueue = GetSharedQueue();
+
+    // A worker's own jobs come off the back, newest first.  Everything else comes off the front, oldest
+    // first:  the shared queue, then the other workers starting with the next one along, so that thieves
+    // spread out over their victims.
+    if (QueueIndex != SharedQueue && TakeJob(QueueIndex, true, Found))
+        return true;
+
+    if (TakeJob(SharedQueue, false, Found))
+        return true;
+
+    const uint32_t NumWorkers = SharedQueue;
+    for (uint32_t i = 1; i <= NumWorkers; ++i)
+    {
+        const uint32_t Victim = (QueueIndex + i) % NumWorkers;
+        if (Victim != QueueIndex && TakeJob(Victim, false, Found))
+        {
+            m_Queues[QueueIndex]->JobsStolen.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobScheduler::TakeJob( uint32_t QueueIndex, bool FromBack, Job& Found )
+{
+    WorkQueue& Queue = *m_Queues[QueueIndex];
+    lock_guard<mutex> Guard(Queue.Mutex);
+    if (Queue.Jobs.empty())
+        return false;
+
+    if (FromBack)
+    {
+        Found = move(Queue.Jobs.back());
+        Queue.Jobs.pop_back();
+    }
+    else
+    {
+        Found = move(Queue.Jobs.front());
+        Queue.Jobs.pop_front();
+    }
+
+    m_QueuedJobs.fetch_sub(1);
+    return true;
+}
+
+void JobScheduler::Run( uint32_t QueueIndex, Job& ToRun )
+{
+    ToRun.Function();
+    ToRun.Function = nullptr;
+    m_Queues[QueueIndex]->JobsRun.fetch_add(1, memory_order_relaxed);
+
+    if (ToRun.Signal != nullptr)
+        Release(*ToRun.Signal);
+}
+
+void JobScheduler::Release( JobCounter& Counter )
+{
+    // Jobs that aren't last only decrement.  The last one takes the lock to reach zero and collect the
+    // jobs that were held back, and Wait() takes the same lock before returning, so the counter can't be
+    // destroyed while it is still in use here.
+    uint32_t Pending = Counter.m_Pending.load();
+    while (Pending > 1)
+    {
+        if (Counter.m_Pending.compare_exchange_weak(Pending, Pending - 1))
+            return;
+    }
+
+    vector<JobCounter::HeldJob> Ready;
+    {
+        lock_guard<mutex> Guard(Counter.m_Mutex);
+        if (Counter.m_Pending.fetch_sub(1) == 1)
+            Ready.swap(Counter.m_Dependents);
+    }
+
+    const uint32_t QueueIndex = GetQueueIndex();
+    for (JobCounter::HeldJob& Held : Ready)
+    {
+        Job NewJob = { move(Held.Function), Held.Signal };
+        Push(QueueIndex, move(NewJob));
+    }
+}
+
+uint32_t JobScheduler::GetQueueIndex( void ) const
+{
+    return t_Scheduler == this ? t_QueueIndex : GetSharedQueue();
+}
@@ -0,0 +1,159 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A work-stealing job scheduler on plain std::threads.  Each worker owns a deque of jobs.
+// It pushes and pops its own jobs at the back, so the most recently split work stays in its cache, and
+// when it runs dry it steals from the front of another worker's deque, where the oldest and largest pieces
+// of work are.  Threads that aren't workers submit to a shared queue.
+//
+// Completion is tracked with JobCounters.  A job can be held back until a counter reaches zero, which is
+// how dependencies between jobs are expressed.  Waiting on a counter runs other jobs in the meantime, so a
+// job may wait on the jobs it spawned without tying up a thread.  Nothing here touches D3D, so the
+// scheduler can be driven and timed on any platform, e.g.
+//
+//     JobScheduler Scheduler;
+//     Scheduler.Start(7);
+//     Scheduler.ParallelFor(0, NumDraws, 64, [&]( uint32_t Begin, uint32_t End ) { ... });
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobScheduler;
+
+// Counts the jobs that signal it and have not yet finished.  A counter must outlive every job that
+// signals it or depends on it.
+class JobCounter
+{
+public:
+    JobCounter() : m_Pending(0) {}
+
+    JobCounter( const JobCounter& ) = delete;
+    JobCounter& operator=( const JobCounter& ) = delete;
+
+    bool IsDone( void ) const { return m_Pending.load() == 0; }
+    uint32_t GetPending( void ) const { return m_Pending.load(); }
+
+private:
+    friend class JobScheduler;
+
+    struct HeldJob
+    {
+        std::function<void (void)> Function;
+        JobCounter* Signal;
+    };
+
+    std::atomic<uint32_t> m_Pending;
+    std::mutex m_Mutex;                     // Taken to go from one pending job to none
+    std::vector<HeldJob> m_Dependents;      // Jobs waiting for m_Pending to reach zero
+};
+
+struct JobSchedulerStats
+{
+    uint64_t JobsRun;
+    uint64_t JobsStolen;        // Taken from another worker's deque
+    uint64_t JobsHeld;          // Submitted with a dependency that wasn't done yet
+    uint64_t Sleeps;            // A worker found nothing to do and blocked
+};
+
+class JobScheduler
+{
+public:
+
+    typedef std::function<void (void)> JobFunction;
+    typedef std::function<void (uint32_t Begin, uint32_t End)> RangeFunction;
+
+    JobScheduler();
+    ~JobScheduler();
+
+    JobScheduler( const JobScheduler& ) = delete;
+    JobScheduler& operator=( const JobScheduler& ) = delete;
+
+    // With NumWorkers zero, starts a worker for every hardware thread but the calling one.  With no
+    // workers at all, jobs run on whichever thread waits for them.
+    void Start( uint32_t NumWorkers = 0 );
+
+    // Runs every job still queued, then joins the workers
+    void Stop( void );
+
+    uint32_t GetNumWorkers( void ) const { return (uint32_t)m_Workers.size(); }
+
+    // Runs Job on some thread.  Signal, if given, counts the job as pending until it returns.  If
+    // DependsOn is given, the job doesn't start until that counter reaches zero.
+    void Submit( JobFunction Job, JobCounter* Signal = nullptr, JobCounter* DependsOn = nullptr );
+
+    // Runs other jobs on this thread until Counter reaches zero
+    void Wait( JobCounter& Counter );
+
+    // Splits [Begin, End) into ranges of at least Grain items and runs Body on each.  The calling thread
+    // takes part, and the call returns when every range is done.
+    void ParallelFor( uint32_t Begin, uint32_t End, uint32_t Grain, const RangeFunction& Body );
+
+    JobSchedulerStats GetStats( void ) const;
+    void ResetStats( void );
+
+private:
+
+    struct Job
+    {
+        JobFunction Function;
+        JobCounter* Signal;
+    };
+
+    // One per worker plus one shared by every other thread.  Each is allocated on its own so that
+    // neighbouring queues are unlikely to share a cache line.
+    struct WorkQueue
+    {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+        std::atomic<uint64_t> JobsRun;
+        std::atomic<uint64_t> JobsStolen;
+    };
+
+    void CreateQueues( uint32_t NumQueues );
+    void WorkerLoop( uint32_t QueueIndex );
+    void Push( uint32_t QueueIndex, Job&& NewJob );
+    bool FindJob( uint32_t QueueIndex, Job& Found );
+    bool TakeJob( uint32_t QueueIndex, bool FromBack, Job& Found );
+    void Run( uint32_t QueueIndex, Job& ToRun );
+    void Release( JobCounter& Counter );
+    uint32_t GetQueueIndex( void ) const;
+    uint32_t GetSharedQueue( void ) const { return m_NumQueues - 1; }
+
+    std::vector<std::thread> m_Workers;
+    std::vector<std::unique_ptr<WorkQueue>> m_Queues;     // Workers first, then the shared queue
+    uint32_t m_NumQueues;
+
+    std::atomic<uint32_t> m_QueuedJobs;         // Pushed and not yet popped, across all queues
+    std::atomic<uint32_t> m_NumSleeping;
+    std::mutex m_SleepMutex;
+    std::condition_variable m_WakeUp;
+    bool m_Stopping;
+
+    std::atomic<uint64_t> m_JobsHeld;
+    std::atomic<uint64_t> m_Sleeps;
+};
+
+namespace JobSystem
+{
+    // The scheduler the engine records and loads with.  It is started by GameCore.
+    extern JobScheduler g_Scheduler;
+
+    void Initialize( void );
+    void Shutdown( void );
+}
@@ -23,65 +23,200 @@ using namespace std;
 
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
 
-LinearAllocatorPageManager::LinearAllocatorPageManager()
+namespace
+{
+    // Idle pooled large pages are released at the end of each frame once they add up to more than this
+    // many standard pages:  1 MB for GPU-exclusive and 32 MB for CPU-writable memory.  A count per size
+    // class would let a single class hold on to hundreds of MB of upload pages.
+    const size_t kIdleLargePageBudget = 16;
+
+    bool IsFenceComplete( uint64_t FenceValue )
+    {
+        return g_CommandManager.IsFenceComplete(FenceValue);
+    }
+}
+
+LinearAllocatorPageManager::LinearAllocatorPageManager() :
+    m_PageRecycler(
+        [this]( void ) { CountChurn(kPagesCreated); return CreateNewPage(); },
+        IsFenceComplete)
 {
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
     ASSERT(sm_AutoType <= kNumAllocatorTypes);
+
+    m_PageSize = m_AllocationType == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize;
+
+    for (uint32_t SizeClass = 0; SizeClass < kNumLargePageClasses; ++SizeClass)
+    {
+        auto CreateLargePage = [this, SizeClass]( void )
+        {
+            CountChurn(kLargePagesCreated);
+            LinearAllocationPage* NewPage = CreateNewPage(m_PageSize << (SizeClass + 1));
+            NewPage->m_SizeClass = SizeClass;
+            return NewPage;
+        };
+
+        // A magazine of one keeps idle threads from sitting on big pages
+        m_LargePagePools[SizeClass].reset(new PagePool(CreateLargePage, IsFenceComplete, 1));
+    }
+
+    for (auto& Counter : m_Churn)
+        Counter = 0;
+    m_LastFrameChurn = {};
 }
 
 LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
+    CountChurn(kPagesRequested);
 
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
+    if (m_Ring.GetNumSlots() > 0)
     {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
+        uint32_t Slot = m_Ring.Acquire(IsFenceComplete);
+        if (Slot != PageRing::kNoSlot)
+        {
+            CountChurn(kRingPagesUsed);
+            return m_RingPages[Slot].get();
+        }
+        CountChurn(kRingFallbacks);
     }
 
-    LinearAllocationPage* PagePtr = nullptr;
+    return m_PageRecycler.RequestPage();
+}
 
-    if (!m_AvailablePages.empty())
+void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
+{
+    if (m_Ring.GetNumSlots() == 0)
     {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
+        m_PageRecycler.DiscardPages(FenceValue, UsedPages);
+        return;
     }
-    else
+
+    vector<LinearAllocationPage*> PooledPages;
+    for (LinearAllocationPage* Page : UsedPages)
     {
-        PagePtr = CreateNewPage();
-        m_PagePool.emplace_back(PagePtr);
+        if (Page->m_RingSlot != LinearAllocationPage::kNoRingSlot)
+            m_Ring.Release(Page->m_RingSlot, FenceValue);
+        else
+            PooledPages.push_back(Page);
     }
-
-    return PagePtr;
+    m_PageRecycler.DiscardPages(FenceValue, PooledPages);
 }
 
-void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
+LinearAllocationPage* LinearAllocatorPageManager::RequestLargePage( size_t PageSize )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+    CountChurn(kLargePagesRequested);
+
+    // Smallest class holding PageSize, where class N holds the page size << (N + 1)
+    uint32_t SizeClass = 0;
+    while (SizeClass < kNumLargePageClasses && (m_PageSize << (SizeClass + 1)) < PageSize)
+        ++SizeClass;
+
+    if (SizeClass < kNumLargePageClasses)
+        return m_LargePagePools[SizeClass]->RequestPage();
+
+    CountChurn(kOneOffPagesCreated);
+    return CreateNewPage(PageSize);
 }
 
 void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
 {
+    vector<LinearAllocationPage*> PooledPages[kNumLargePageClasses];
+    vector<LinearAllocationPage*> OneOffPages;
+
+    for (LinearAllocationPage* Page : LargePages)
+    {
+        if (Page->m_SizeClass != LinearAllocationPage::kNoSizeClass)
+            PooledPages[Page->m_SizeClass].push_back(Page);
+        else
+            OneOffPages.push_back(Page);
+    }
+
+    for (uint32_t SizeClass = 0; SizeClass < kNumLargePageClasses; ++SizeClass)
+        m_LargePagePools[SizeClass]->DiscardPages(FenceValue, PooledPages[SizeClass]);
+
     lock_guard<mutex> LockGuard(m_Mutex);
 
     while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
     {
+        CountChurn(kOneOffPagesDestroyed);
         delete m_DeletionQueue.front().second;
         m_DeletionQueue.pop();
     }
 
-    for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
+    for (auto iter = OneOffPages.begin(); iter != OneOffPages.end(); ++iter)
     {
         (*iter)->Unmap();
         m_DeletionQueue.push(make_pair(FenceValue, *iter));
     }
 }
 
+void LinearAllocatorPageManager::CreateRingBuffer( uint32_t NumPages )
+{
+    ASSERT(m_RingPages.empty(), "Ring buffer already created");
+
+    // One resource backs every slot.  Each slot page holds its own reference and mapping.
+    unique_ptr<LinearAllocationPage> Backing(CreateNewPage(m_PageSize * NumPages));
+    ID3D12Resource* pResource = Backing->GetResource();
+    D3D12_RESOURCE_STATES Usage = m_AllocationType == kGpuExclusive ?
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_GENERIC_READ;
+
+    for (uint32_t Slot = 0; Slot < NumPages; ++Slot)
+    {
+        pResource->AddRef();
+        LinearAllocationPage* SlotPage = new LinearAllocationPage(pResource, Usage);
+        SlotPage->m_BaseOffset = m_PageSize * Slot;
+        SlotPage->m_PageSize = m_PageSize;
+        SlotPage->m_CpuVirtualAddress = (uint8_t*)SlotPage->m_CpuVirtualAddress + SlotPage->m_BaseOffset;
+        SlotPage->m_GpuVirtualAddress += SlotPage->m_BaseOffset;
+        SlotPage->m_RingSlot = Slot;
+        m_RingPages.emplace_back(SlotPage);
+    }
+
+    m_Ring.Init(NumPages);
+}
+
+void LinearAllocatorPageManager::EndFrame( void )
+{
+    // Smaller pages are cheaper to keep, so they get first claim on the budget
+    size_t BudgetLeft = kIdleLargePageBudget * m_PageSize;
+    size_t NumTrimmed = 0;
+    for (uint32_t SizeClass = 0; SizeClass < kNumLargePageClasses; ++SizeClass)
+    {
+        PagePool& Pool = *m_LargePagePools[SizeClass];
+        const size_t PageBytes = m_PageSize << (SizeClass + 1);
+
+        Pool.Reclaim();
+        NumTrimmed += Pool.Trim(BudgetLeft / PageBytes);
+
+        const size_t KeptBytes = Pool.GetNumDepotPages() * PageBytes;
+        BudgetLeft -= KeptBytes < BudgetLeft ? KeptBytes : BudgetLeft;
+    }
+    CountChurn(kLargePagesTrimmed, (uint32_t)NumTrimmed);
+
+    for (uint32_t i = 0; i < kNumChurnCounters; ++i)
+        m_LastFrameChurn.Count[i] = m_Churn[i].exchange(0, memory_order_relaxed);
+}
+
+void LinearAllocatorPageManager::Destroy( void )
+{
+    m_PageRecycler.Destroy();
+    for (auto& Pool : m_LargePagePools)
+        Pool->Destroy();
+
+    m_RingPages.clear();
+    m_Ring.Init(0);
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    while (!m_DeletionQueue.empty())
+    {
+        delete m_DeletionQueue.front().second;
+        m_DeletionQueue.pop();
+    }
+}
+
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
 {
     D3D12_HEAP_PROPERTIES HeapProps;
@@ -141,16 +276,26 @@ void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
 
     sm_PageManager[m_AllocationType].FreeLargePages(FenceID, m_LargePageList);
     m_LargePageList.clear();
+    m_CurLargePage = nullptr;
 }
 
-DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes)
+DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes, size_t Alignment)
 {
-    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].CreateNewPage(SizeInBytes);
-    m_LargePageList.push_back(OneOff);
+    size_t Offset = Math::AlignUp(m_LargePageOffset, Alignment);
+
+    // Pooled pages are rounded up to a power of two, so there is often room left for the next one
+    if (m_CurLargePage == nullptr || Offset + SizeInBytes > m_CurLargePage->m_PageSize)
+    {
+        m_CurLargePage = sm_PageManager[m_AllocationType].RequestLargePage(SizeInBytes);
+        m_LargePageList.push_back(m_CurLargePage);
+        Offset = 0;
+    }
+
+    m_LargePageOffset = Offset + SizeInBytes;
 
-    DynAlloc ret(*OneOff, 0, SizeInBytes);
-    ret.DataPtr = OneOff->m_CpuVirtualAddress;
-    ret.GpuAddress = OneOff->m_GpuVirtualAddress;
+    DynAlloc ret(*m_CurLargePage, Offset, SizeInBytes);
+    ret.DataPtr = (uint8_t*)m_CurLargePage->m_CpuVirtualAddress + Offset;
+    ret.GpuAddress = m_CurLargePage->m_GpuVirtualAddress + Offset;
 
     return ret;
 }
@@ -166,7 +311,7 @@ DynAlloc LinearAllocator::Allocate(size_t SizeInBytes, size_t Alignment)
     const size_t AlignedSize = Math::AlignUpWithMask(SizeInBytes, AlignmentMask);
 
     if (AlignedSize > m_PageSize)
-        return AllocateLargePage(AlignedSize);
+        return AllocateLargePage(AlignedSize, Alignment);
 
     m_CurOffset = Math::AlignUp(m_CurOffset, Alignment);
 
@@ -183,7 +328,7 @@ DynAlloc LinearAllocator::Allocate(size_t SizeInBytes, size_t Alignment)
         m_CurOffset = 0;
     }
 
-    DynAlloc ret(*m_CurPage, m_CurOffset, AlignedSize);
+    DynAlloc ret(*m_CurPage, m_CurPage->m_BaseOffset + m_CurOffset, AlignedSize);
     ret.DataPtr = (uint8_t*)m_CurPage->m_CpuVirtualAddress + m_CurOffset;
     ret.GpuAddress = m_CurPage->m_GpuVirtualAddress + m_CurOffset;
 
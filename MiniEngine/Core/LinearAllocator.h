@@ -13,8 +13,8 @@
 // Description:  This is a dynamic graphics memory allocator for DX12.  It's designed to work in concert
 // with the CommandContext class and to do so in a thread-safe manner.  There may be many command contexts,
 // each with its own linear allocators.  They act as windows into a global memory pool by reserving a
-// context-local memory page.  Requesting a new page is done in a thread-safe manner by guarding accesses
-// with a mutex lock.
+// context-local memory page.  Pages are recycled through a PageRecycler, which keeps a small cache of
+// pages per thread so that contexts recording in parallel rarely contend for a lock.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
@@ -23,6 +23,8 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "PageRecycler.h"
+#include <atomic>
 #include <vector>
 #include <queue>
 #include <mutex>
@@ -52,6 +54,10 @@ public:
         m_UsageState = Usage;
         m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
         m_pResource->Map(0, nullptr, &m_CpuVirtualAddress);
+        m_BaseOffset = 0;
+        m_PageSize = (size_t)m_pResource->GetDesc().Width;
+        m_SizeClass = kNoSizeClass;
+        m_RingSlot = kNoRingSlot;
     }
 
     ~LinearAllocationPage()
@@ -76,8 +82,17 @@ public:
         }
     }
 
+    static const uint32_t kNoSizeClass = ~0u;
+    static const uint32_t kNoRingSlot = ~0u;
+
+    // The addresses include m_BaseOffset, which is non-zero when the page is a slot of a ring buffer
     void* m_CpuVirtualAddress;
     D3D12_GPU_VIRTUAL_ADDRESS m_GpuVirtualAddress;
+    size_t m_BaseOffset;
+    size_t m_PageSize;
+
+    uint32_t m_SizeClass;   // Which large page pool the page belongs to, if any
+    uint32_t m_RingSlot;    // Which ring buffer slot the page is, if any
 };
 
 enum LinearAllocatorType
@@ -96,6 +111,31 @@ enum
     kCpuAllocatorPageSize = 0x200000    // 2MB
 };
 
+// Large pages are pooled in power-of-two multiples of the page size from 2x up to 2^kNumLargePageClasses
+// times.  Anything bigger is created for one use and destroyed afterwards.
+enum { kNumLargePageClasses = 6 };
+
+// Page turnover counters, reported per frame
+enum LinearAllocatorChurnCounter
+{
+    kPagesRequested,
+    kPagesCreated,
+    kRingPagesUsed,
+    kRingFallbacks,         // The ring was full, so a pooled page was used instead
+    kLargePagesRequested,
+    kLargePagesCreated,
+    kLargePagesTrimmed,     // Idle pooled large pages released
+    kOneOffPagesCreated,    // Too big for any pool
+    kOneOffPagesDestroyed,
+
+    kNumChurnCounters
+};
+
+struct LinearAllocatorChurnStats
+{
+    uint32_t Count[kNumChurnCounters];
+};
+
 class LinearAllocatorPageManager
 {
 public:
@@ -107,29 +147,60 @@ public:
     // Discarded pages will get recycled.  This is for fixed size pages.
     void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
 
-    // Freed pages will be destroyed once their fence has passed.  This is for single-use,
-    // "large" pages.
+    // Returns a page of at least PageSize bytes from the pool for its size class, or a one-off page
+    // if it is too large to pool
+    LinearAllocationPage* RequestLargePage( size_t PageSize );
+
+    // Pooled pages will be recycled and one-off pages destroyed once their fence has passed
     void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    // Carves NumPages standard pages out of one persistent resource and hands them out in ring
+    // order before falling back to the page pool.  Only worthwhile for kCpuWritable, where per-frame
+    // constants and uploads churn through pages at a steady rate.
+    void CreateRingBuffer( uint32_t NumPages );
+
+    // Releases idle large pages and latches this frame's churn counters
+    void EndFrame( void );
+
+    void Destroy( void );
+
+    PageRecyclerStats GetStats( void ) const { return m_PageRecycler.GetStats(); }
+    const LinearAllocatorChurnStats& GetLastFrameChurn( void ) const { return m_LastFrameChurn; }
 
 private:
 
+    typedef PageRecycler<LinearAllocationPage> PagePool;
+
     static LinearAllocatorType sm_AutoType;
 
     LinearAllocatorType m_AllocationType;
-    std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
+    size_t m_PageSize;
+    PagePool m_PageRecycler;
+    std::unique_ptr<PagePool> m_LargePagePools[kNumLargePageClasses];
+
+    PageRing m_Ring;
+    std::vector<std::unique_ptr<LinearAllocationPage>> m_RingPages;
+
+    // One-off pages are rare enough that a plain mutex is fine
     std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
     std::mutex m_Mutex;
+
+    // Counters for the frame in progress
+    std::atomic<uint32_t> m_Churn[kNumChurnCounters];
+    LinearAllocatorChurnStats m_LastFrameChurn;
+
+    void CountChurn( LinearAllocatorChurnCounter Counter, uint32_t Amount = 1 )
+    {
+        m_Churn[Counter].fetch_add(Amount, std::memory_order_relaxed);
+    }
 };
 
 class LinearAllocator
 {
 public:
 
-    LinearAllocator(LinearAllocatorType Type) : m_AllocationType(Type), m_PageSize(0), m_CurOffset(~(size_t)0), m_CurPage(nullptr)
+    LinearAllocator(LinearAllocatorType Type) : m_AllocationType(Type), m_PageSize(0), m_CurOffset(~(size_t)0), m_CurPage(nullptr),
+        m_CurLargePage(nullptr), m_LargePageOffset(0)
     {
         ASSERT(Type > kInvalidAllocator && Type < kNumAllocatorTypes);
         m_PageSize = (Type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize);
@@ -145,9 +216,31 @@ public:
         sm_PageManager[1].Destroy();
     }
 
+    static PageRecyclerStats GetPageStats( LinearAllocatorType Type )
+    {
+        return sm_PageManager[Type].GetStats();
+    }
+
+    static void CreateRingBuffer( LinearAllocatorType Type, uint32_t NumPages )
+    {
+        sm_PageManager[Type].CreateRingBuffer(NumPages);
+    }
+
+    // Call once per frame
+    static void EndFrame( void )
+    {
+        sm_PageManager[0].EndFrame();
+        sm_PageManager[1].EndFrame();
+    }
+
+    static const LinearAllocatorChurnStats& GetLastFrameChurn( LinearAllocatorType Type )
+    {
+        return sm_PageManager[Type].GetLastFrameChurn();
+    }
+
 private:
 
-    DynAlloc AllocateLargePage( size_t SizeInBytes );
+    DynAlloc AllocateLargePage( size_t SizeInBytes, size_t Alignment );
 
     static LinearAllocatorPageManager sm_PageManager[2];
 
@@ -157,4 +250,8 @@ private:
     LinearAllocationPage* m_CurPage;
     std::vector<LinearAllocationPage*> m_RetiredPages;
     std::vector<LinearAllocationPage*> m_LargePageList;
+
+    // Large requests share the unused tail of the last large page
+    LinearAllocationPage* m_CurLargePage;
+    size_t m_LargePageOffset;
 };
@@ -0,0 +1,264 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "MappedFile.h"
+
+ByteView MappedFile::Map( const std::wstring& FileName )
+{
+    std::shared_ptr<MappedFile> File = std::make_shared<MappedFile>();
+    if (!File->Open(FileName))
+        return ByteView();
+
+    return ByteView(File, File->GetData(), File->GetSize());
+}
+
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#include <windows.h>
+
+MappedFile::MappedFile() : m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr), m_Data(nullptr), m_Size(0)
+{
+}
+
+bool MappedFile::Open( const std::wstring& FileName )
+{
+    Close();
+
+    // Other processes may still write, rename or delete the file.  The mapping keeps the bytes it has.
+    m_File = CreateFile2(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        OPEN_EXISTING, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize = {};
+    if (!GetFileSizeEx(m_File, &FileSize) || FileSize.QuadPart == 0 || (uint64_t)FileSize.QuadPart > SIZE_MAX)
+    {
+        Close();
+        return false;
+    }
+
+    m_Mapping = CreateFileMapping(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_Data == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_Size = (size_t)FileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::Close( void )
+{
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping != nullptr)
+        CloseHandle(m_Mapping);
+    if (m_File != INVALID_HANDLE_VALUE)
+        CloseHandle(m_File);
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::GetFileSize( const std::wstring& FileName, uint64_t& Size )
+{
+    WIN32_FILE_ATTRIBUTE_DATA Attributes;
+    if (!GetFileAttributesEx(FileName.c_str(), GetFileExInfoStandard, &Attributes) ||
+        (Attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+    {
+        return false;
+    }
+
+    Size = ((uint64_t)Attributes.nFileSizeHigh << 32) | Attributes.nFileSizeLow;
+    return true;
+}
+
+bool MappedFile::WriteAtomic( const std::wstring& FileName, const void* Data, size_t Size )
+{
+    std::wstring TempFileName = FileName + L".tmp";
+
+    HANDLE File = CreateFile2(TempFileName.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool Success = true;
+    const uint8_t* Source = (const uint8_t*)Data;
+    while (Success && Size > 0)
+    {
+        DWORD Chunk = Size > 0x40000000 ? 0x40000000 : (DWORD)Size;
+        DWORD Written = 0;
+        Success = WriteFile(File, Source, Chunk, &Written, nullptr) && Written == Chunk;
+        Source += Chunk;
+        Size -= Chunk;
+    }
+
+    Success = Success && FlushFileBuffers(File);
+    CloseHandle(File);
+
+    if (!Success || !MoveFileEx(TempFileName.c_str(), FileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DeleteFile(TempFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+#else // POSIX
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File names are carried around as wide strings to match the rest of the engine.  POSIX wants UTF-8.
+static std::string NarrowFileName( const std::wstring& FileName )
+{
+    std::string Result;
+    Result.reserve(FileName.size());
+    for (wchar_t wc : FileName)
+    {
+        uint32_t c = (uint32_t)wc;
+        if (c < 0x80)
+            Result += (char)c;
+        else if (c < 0x800)
+        {
+            Result += (char)(0xC0 | (c >> 6));
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            Result += (char)(0xE0 | (c >> 12));
+            Result += (char)(0x80 | ((c >> 6) & 0x3F));
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            Result += (char)(0xF0 | (c >> 18));
+            Result += (char)(0x80 | ((c >> 12) & 0x3F));
+            Result += (char)(0x80 | ((c >> 6) & 0x3F));
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return Result;
+}
+
+MappedFile::MappedFile() : m_File(-1), m_Data(nullptr), m_Size(0)
+{
+}
+
+bool MappedFile::Open( const std::wstring& FileName )
+{
+    Close();
+
+    m_File = open(NarrowFileName(FileName).c_str(), O_RDONLY);
+    if (m_File < 0)
+        return false;
+
+    struct stat FileStat;
+    if (fstat(m_File, &FileStat) != 0 || FileStat.st_size <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* Address = mmap(nullptr, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, m_File, 0);
+    if (Address == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    m_Data = (const uint8_t*)Address;
+    m_Size = (size_t)FileStat.st_size;
+    return true;
+}
+
+void MappedFile::Close( void )
+{
+    if (m_Data != nullptr)
+        munmap((void*)m_Data, m_Size);
+    if (m_File >= 0)
+        close(m_File);
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_File = -1;
+}
+
+bool MappedFile::GetFileSize( const std::wstring& FileName, uint64_t& Size )
+{
+    struct stat FileStat;
+    if (stat(NarrowFileName(FileName).c_str(), &FileStat) != 0 || !S_ISREG(FileStat.st_mode))
+        return false;
+
+    Size = (uint64_t)FileStat.st_size;
+    return true;
+}
+
+bool MappedFile::WriteAtomic( const std::wstring& FileName, const void* Data, size_t Size )
+{
+    std::string FinalName = NarrowFileName(FileName);
+    std::string TempName = FinalName + ".tmp";
+
+    int File = open(TempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (File < 0)
+        return false;
+
+    bool Success = true;
+    const uint8_t* Source = (const uint8_t*)Data;
+    while (Success && Size > 0)
+    {
+        ssize_t Written = write(File, Source, Size);
+        Success = Written > 0;
+        if (Success)
+        {
+            Source += Written;
+            Size -= (size_t)Written;
+        }
+    }
+
+    Success = Success && fsync(File) == 0;
+    Success = (close(File) == 0) && Success;
+
+    if (!Success || rename(TempName.c_str(), FinalName.c_str()) != 0)
+    {
+        unlink(TempName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
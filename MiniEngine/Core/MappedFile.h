@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A read-only memory mapping of a whole file, plus the atomic "write a temporary file
+// and rename it into place" operation that goes with it.  This uses Win32 file mappings on Windows
+// and mmap() elsewhere, and depends on nothing else in the engine so that the file formats built on
+// top of it can be compiled and exercised without D3D.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+// A read-only range of bytes that keeps whatever holds them alive, be it a file mapping or a buffer.
+// Copies share ownership, so a view can be handed to another thread and outlive the code that made it.
+class ByteView
+{
+public:
+
+    ByteView() : m_Data(nullptr), m_Size(0) {}
+    ByteView( std::shared_ptr<const void> Owner, const uint8_t* Data, size_t Size ) :
+        m_Owner(std::move(Owner)), m_Data(Data), m_Size(Size) {}
+
+    const uint8_t* data( void ) const { return m_Data; }
+    size_t size( void ) const { return m_Size; }
+    bool empty( void ) const { return m_Size == 0; }
+
+    const uint8_t* begin( void ) const { return m_Data; }
+    const uint8_t* end( void ) const { return m_Data + m_Size; }
+
+    // Part of this view, sharing its owner.  The range is clamped to the view.
+    ByteView SubView( size_t Offset, size_t Size ) const
+    {
+        Offset = Offset < m_Size ? Offset : m_Size;
+        Size = Size < m_Size - Offset ? Size : m_Size - Offset;
+        return ByteView(m_Owner, m_Data + Offset, Size);
+    }
+
+private:
+
+    std::shared_ptr<const void> m_Owner;
+    const uint8_t* m_Data;
+    size_t m_Size;
+};
+
+class MappedFile
+{
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    // Maps the entire file for reading.  Fails for missing or empty files.
+    bool Open( const std::wstring& FileName );
+    void Close( void );
+
+    // Maps the entire file and returns a view that keeps the mapping open.  The view is empty if Open() fails.
+    static ByteView Map( const std::wstring& FileName );
+
+    // Fails if FileName is missing or isn't a regular file.  Tells an empty file, which Open() can't map,
+    // from a missing one.
+    static bool GetFileSize( const std::wstring& FileName, uint64_t& Size );
+
+    bool IsOpen( void ) const { return m_Data != nullptr; }
+    const uint8_t* GetData( void ) const { return m_Data; }
+    size_t GetSize( void ) const { return m_Size; }
+
+    // Writes the buffer to "<FileName>.tmp", flushes it to disk and then renames it over FileName, so
+    // that readers only ever see the old file or the complete new one.  Any mapping of FileName must
+    // be closed first because Windows won't replace a mapped file.
+    static bool WriteAtomic( const std::wstring& FileName, const void* Data, size_t Size );
+
+private:
+
+#ifdef _WIN32
+    void* m_File;
+    void* m_Mapping;
+#else
+    int m_File;
+#endif
+    const uint8_t* m_Data;
+    size_t m_Size;
+};
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "MipChainLayout.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+bool MipChainLayout::Create( uint64_t DataOffset, uint64_t FileSize, uint32_t Width, uint32_t Height, uint32_t NumMips,
+    uint32_t BlockWidth, uint32_t BlockHeight, uint32_t BytesPerBlock )
+{
+    m_Mips.clear();
+
+    if (Width == 0 || Height == 0 || NumMips == 0 || NumMips > 32 || BlockWidth == 0 || BlockHeight == 0 || BytesPerBlock == 0)
+        return false;
+
+    uint64_t Offset = DataOffset;
+    for (uint32_t Mip = 0; Mip < NumMips; ++Mip)
+    {
+        MipLevel Level;
+        Level.Width = max(Width >> Mip, 1u);
+        Level.Height = max(Height >> Mip, 1u);
+        Level.RowBytes = (Level.Width + BlockWidth - 1) / BlockWidth * BytesPerBlock;
+        Level.NumRows = (Level.Height + BlockHeight - 1) / BlockHeight;
+        Level.FileOffset = Offset;
+        Level.Size = (uint64_t)Level.RowBytes * Level.NumRows;
+
+        Offset += Level.Size;
+        m_Mips.push_back(Level);
+    }
+
+    if (Offset > FileSize)
+    {
+        m_Mips.clear();
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t MipChainLayout::SelectTail( uint32_t MaxDimension, uint32_t FirstPackedMip ) const
+{
+    assert(!m_Mips.empty());
+
+    uint32_t FirstMip = GetNumMips() - 1;
+    while (FirstMip > 0 && max(m_Mips[FirstMip - 1].Width, m_Mips[FirstMip - 1].Height) <= MaxDimension)
+        --FirstMip;
+
+    return min(FirstMip, FirstPackedMip);
+}
+
+uint32_t MipChainLayout::SelectMipForSize( uint32_t Width, uint32_t Height ) const
+{
+    assert(!m_Mips.empty());
+
+    uint32_t Mip = 0;
+    while (Mip + 1 < GetNumMips() && m_Mips[Mip + 1].Width >= Width && m_Mips[Mip + 1].Height >= Height)
+        ++Mip;
+
+    return Mip;
+}
+
+void MipChainLayout::GetFileRange( uint32_t FirstMip, uint32_t EndMip, uint64_t& Offset, uint64_t& Size ) const
+{
+    assert(FirstMip < EndMip && EndMip <= GetNumMips());
+
+    const MipLevel& Last = m_Mips[EndMip - 1];
+    Offset = m_Mips[FirstMip].FileOffset;
+    Size = Last.FileOffset + Last.Size - Offset;
+}
@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Where each mip of a 2D texture lives in a DDS file, and which mips a streaming texture should
+// have.  A DDS stores its mips finest first, so the small mips at the end of the file (the tail) can be read
+// on their own, and any run of mips is one contiguous range of the file.
+//
+// Formats are described by their blocks:  4x4 for BC formats, 2x1 for packed formats like YUY2, and 1x1 for
+// the rest.  Nothing here touches D3D, so the layout and the mip choices can be checked on any platform.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class MipChainLayout
+{
+public:
+
+    struct MipLevel
+    {
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t RowBytes;      // One row of blocks
+        uint32_t NumRows;       // Rows of blocks
+        uint64_t FileOffset;
+        uint64_t Size;
+    };
+
+    MipChainLayout() {}
+
+    // DataOffset is where the first mip starts, just past the headers.  Fails if the file is too short to
+    // hold every mip or the block description makes no sense.
+    bool Create( uint64_t DataOffset, uint64_t FileSize, uint32_t Width, uint32_t Height, uint32_t NumMips,
+        uint32_t BlockWidth, uint32_t BlockHeight, uint32_t BytesPerBlock );
+
+    uint32_t GetNumMips( void ) const { return (uint32_t)m_Mips.size(); }
+    const MipLevel& GetMip( uint32_t Mip ) const { return m_Mips[Mip]; }
+
+    // The first mip of the tail that is loaded up front:  the finest no larger than MaxDimension on either side.
+    // The tail always includes FirstPackedMip, from which a tiled texture's mips share tiles and have to be
+    // loaded together.
+    uint32_t SelectTail( uint32_t MaxDimension, uint32_t FirstPackedMip = UINT32_MAX ) const;
+
+    // The coarsest mip that still has Width x Height texels, which is the finest one that a surface covering
+    // that many pixels would sample.
+    uint32_t SelectMipForSize( uint32_t Width, uint32_t Height ) const;
+
+    // The part of the file that holds mips FirstMip up to, but not including, EndMip
+    void GetFileRange( uint32_t FirstMip, uint32_t EndMip, uint64_t& Offset, uint64_t& Size ) const;
+
+private:
+
+    std::vector<MipLevel> m_Mips;
+};
@@ -0,0 +1,608 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Recycles fixed-size pages whose reuse is gated on a GPU fence, from many threads at once,
+// without a global lock on the common paths.
+//
+// Every thread keeps a small magazine of ready pages.  Taking a page is a pop from the calling thread's
+// magazine.  When it runs dry, the magazine is refilled with a batch of pages from a shared depot, so the
+// depot lock is taken once per batch rather than once per page.
+//
+// Retired pages are pushed, one batch per fence, onto a lock-free list.  Whichever thread next needs
+// pages (and isn't racing another thread doing the same) drains that list into per-queue, fence-ordered
+// queues and moves everything whose fence has completed into the depot in one go.
+//
+// The page type and the fence are supplied by the owner, so the recycler has no dependency on D3D.  See
+// PageRecyclerMock.h for a CPU-only page and fence that can be used to stress test it.  A "page" can be
+// anything whose reuse waits on a fence; CommandAllocatorPool recycles command allocators with it.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PageRecyclerStats
+{
+    // Occupancy.  Pages that are in none of these are in use by an allocator.
+    size_t TotalPages;
+    size_t DepotPages;
+    size_t MagazinePages;
+    size_t RetiredPages;
+
+    // Throughput
+    uint64_t MagazineHits;
+    uint64_t MagazineRefills;
+    uint64_t PagesCreated;
+    uint64_t ReclaimPasses;
+    uint64_t PagesReclaimed;
+
+    // Contention
+    uint64_t DepotLockWaits;        // The depot lock was held by another thread
+    uint64_t ReclaimSkips;          // Another thread was already reclaiming
+    uint64_t RetirePushRetries;     // Lost a race pushing onto the retire list
+
+    // Sizing
+    uint64_t PagesReused;           // Requests served without creating a page
+    size_t PagesInUse;              // Handed out and not yet discarded
+    size_t PeakPagesInUse;
+    uint64_t PagesTrimmed;
+    uint64_t CapWaits;              // Requests that waited on a fence instead of growing past the cap
+};
+
+template <typename PageType, typename PageDeleter = std::default_delete<PageType>>
+class PageRecycler
+{
+public:
+
+    static const size_t kMagazineSize = 8;
+
+    // Pools of big pages should use a small MagazineSize so that idle threads don't hoard memory
+    PageRecycler( std::function<PageType*(void)> CreatePage, std::function<bool(uint64_t)> IsFenceComplete,
+        size_t MagazineSize = kMagazineSize ) :
+        m_CreatePage(CreatePage),
+        m_IsFenceComplete(IsFenceComplete),
+        m_MagazineCapacity(MagazineSize < kMagazineSize ? MagazineSize : kMagazineSize),
+        m_Id(sm_NextId++),
+        m_MaxPages(0),
+        m_MinDepotPages(0),
+        m_RetireHead(nullptr)
+    {
+        ResetCounters();
+    }
+
+    ~PageRecycler()
+    {
+        Destroy();
+    }
+
+    // Once MaxPages exist, a request with nothing to recycle waits for the oldest retired page instead of
+    // creating one.  The cap is soft:  when every page is in use, a new one is still created.
+    void SetMaxPages( size_t MaxPages, std::function<void(uint64_t)> WaitForFence )
+    {
+        m_MaxPages = MaxPages;
+        m_WaitForFence = WaitForFence;
+    }
+
+    PageType* RequestPage( void )
+    {
+        Magazine& Mag = GetMagazine();
+
+        if (Mag.Count == 0)
+            RefillMagazine(Mag);
+        else
+            m_MagazineHits.fetch_add(1, std::memory_order_relaxed);
+
+        // Another thread may take what the wait freed, so keep waiting while anything is retired
+        while (Mag.Count == 0 && m_MaxPages > 0 && GetTotalPages() >= m_MaxPages && WaitForOldestRetired())
+            RefillMagazine(Mag);
+
+        if (Mag.Count > 0)
+        {
+            m_MagazinePages.fetch_sub(1, std::memory_order_relaxed);
+            m_PagesReused.fetch_add(1, std::memory_order_relaxed);
+            CountPagesInUse(1);
+            return Mag.Pages[--Mag.Count];
+        }
+
+        // Nothing to recycle
+        PageType* NewPage = m_CreatePage();
+        {
+            std::lock_guard<std::mutex> Guard(m_DepotMutex);
+            m_PagePool.emplace_back(NewPage);
+        }
+        m_PagesCreated.fetch_add(1, std::memory_order_relaxed);
+        CountPagesInUse(1);
+        return NewPage;
+    }
+
+    // The pages will be handed out again once FenceValue has completed.  Fence values encode the queue
+    // in their top byte (as the CommandListManager's do), and are only compared within a queue.
+    void DiscardPages( uint64_t FenceValue, const std::vector<PageType*>& Pages )
+    {
+        if (Pages.empty())
+            return;
+
+        RetiredBatch* Batch = new RetiredBatch;
+        Batch->FenceValue = FenceValue;
+        Batch->Pages = Pages;
+        m_RetiredPages.fetch_add(Pages.size(), std::memory_order_relaxed);
+        CountPagesInUse(-(int64_t)Pages.size());
+
+        Batch->Next = m_RetireHead.load(std::memory_order_relaxed);
+        while (!m_RetireHead.compare_exchange_weak(Batch->Next, Batch, std::memory_order_release, std::memory_order_relaxed))
+            m_RetirePushRetries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Moves every retired page whose fence has completed to the depot.  Called automatically when a
+    // magazine runs dry.  Unless Wait is set, returns immediately if another thread is already doing it.
+    void Reclaim( bool Wait = false )
+    {
+        std::unique_lock<std::mutex> ReclaimLock(m_ReclaimMutex, std::try_to_lock);
+        if (!ReclaimLock.owns_lock())
+        {
+            m_ReclaimSkips.fetch_add(1, std::memory_order_relaxed);
+            if (!Wait)
+                return;
+            ReclaimLock.lock();
+        }
+
+        m_ReclaimPasses.fetch_add(1, std::memory_order_relaxed);
+
+        DrainRetireList();
+
+        m_ReclaimBuffer.clear();
+        for (auto& Queue : m_FenceQueues)
+        {
+            while (!Queue.empty() && m_IsFenceComplete(Queue.front()->FenceValue))
+            {
+                RetiredBatch* Batch = Queue.front();
+                m_ReclaimBuffer.insert(m_ReclaimBuffer.end(), Batch->Pages.begin(), Batch->Pages.end());
+                Queue.pop_front();
+                delete Batch;
+            }
+        }
+
+        if (m_ReclaimBuffer.empty())
+            return;
+
+        LockDepot();
+        m_Depot.insert(m_Depot.end(), m_ReclaimBuffer.begin(), m_ReclaimBuffer.end());
+        m_DepotMutex.unlock();
+
+        m_RetiredPages.fetch_sub(m_ReclaimBuffer.size(), std::memory_order_relaxed);
+        m_PagesReclaimed.fetch_add(m_ReclaimBuffer.size(), std::memory_order_relaxed);
+    }
+
+    // Destroys ready pages in the depot beyond MaxDepotPages and returns how many were released.  Pages
+    // in thread magazines are not touched.
+    size_t Trim( size_t MaxDepotPages )
+    {
+        std::lock_guard<std::mutex> Guard(m_DepotMutex);
+        if (m_Depot.size() <= MaxDepotPages)
+            return 0;
+
+        size_t NumReleased = m_Depot.size() - MaxDepotPages;
+        ReleaseDepotPages(MaxDepotPages, NumReleased);
+        return NumReleased;
+    }
+
+    // Destroys the depot pages that nobody took since the last call and returns how many were released.
+    // Called at a steady rate, it releases pages that sat idle for a whole period.
+    size_t TrimIdle( void )
+    {
+        std::lock_guard<std::mutex> Guard(m_DepotMutex);
+
+        // The depot is taken from and refilled at the back, so the untouched pages are at the front
+        size_t NumIdle = m_MinDepotPages < m_Depot.size() ? m_MinDepotPages : m_Depot.size();
+        ReleaseDepotPages(0, NumIdle);
+        m_MinDepotPages = m_Depot.size();
+        return NumIdle;
+    }
+
+    // Releases every page.  The caller must ensure the GPU is idle and no thread is using the recycler.
+    void Destroy( void )
+    {
+        RetiredBatch* List = m_RetireHead.exchange(nullptr);
+        while (List != nullptr)
+        {
+            RetiredBatch* Next = List->Next;
+            delete List;
+            List = Next;
+        }
+
+        for (auto& Queue : m_FenceQueues)
+        {
+            for (RetiredBatch* Batch : Queue)
+                delete Batch;
+            Queue.clear();
+        }
+
+        for (auto& Mag : m_Magazines)
+            Mag->Count = 0;
+
+        m_Depot.clear();
+        m_PagePool.clear();
+        m_MinDepotPages = 0;
+        ResetCounters();
+    }
+
+    PageRecyclerStats GetStats( void ) const
+    {
+        PageRecyclerStats Stats;
+        {
+            std::lock_guard<std::mutex> Guard(m_DepotMutex);
+            Stats.TotalPages = m_PagePool.size();
+            Stats.DepotPages = m_Depot.size();
+        }
+        Stats.MagazinePages = m_MagazinePages.load(std::memory_order_relaxed);
+        Stats.RetiredPages = m_RetiredPages.load(std::memory_order_relaxed);
+        Stats.MagazineHits = m_MagazineHits.load(std::memory_order_relaxed);
+        Stats.MagazineRefills = m_MagazineRefills.load(std::memory_order_relaxed);
+        Stats.PagesCreated = m_PagesCreated.load(std::memory_order_relaxed);
+        Stats.ReclaimPasses = m_ReclaimPasses.load(std::memory_order_relaxed);
+        Stats.PagesReclaimed = m_PagesReclaimed.load(std::memory_order_relaxed);
+        Stats.DepotLockWaits = m_DepotLockWaits.load(std::memory_order_relaxed);
+        Stats.ReclaimSkips = m_ReclaimSkips.load(std::memory_order_relaxed);
+        Stats.RetirePushRetries = m_RetirePushRetries.load(std::memory_order_relaxed);
+        Stats.PagesReused = m_PagesReused.load(std::memory_order_relaxed);
+        Stats.PagesInUse = (size_t)m_PagesInUse.load(std::memory_order_relaxed);
+        Stats.PeakPagesInUse = (size_t)m_PeakPagesInUse.load(std::memory_order_relaxed);
+        Stats.PagesTrimmed = m_PagesTrimmed.load(std::memory_order_relaxed);
+        Stats.CapWaits = m_CapWaits.load(std::memory_order_relaxed);
+        return Stats;
+    }
+
+    size_t GetTotalPages( void ) const
+    {
+        std::lock_guard<std::mutex> Guard(m_DepotMutex);
+        return m_PagePool.size();
+    }
+
+    size_t GetNumDepotPages( void ) const
+    {
+        std::lock_guard<std::mutex> Guard(m_DepotMutex);
+        return m_Depot.size();
+    }
+
+private:
+
+    struct Magazine
+    {
+        PageType* Pages[kMagazineSize];
+        size_t Count;
+        std::thread::id Owner;
+    };
+
+    struct RetiredBatch
+    {
+        uint64_t FenceValue;
+        std::vector<PageType*> Pages;
+        RetiredBatch* Next;
+    };
+
+    // Each thread caches pointers to the magazines it has used, tagged with the owning recycler's id.
+    // Ids are never reused, so a stale entry left by a destroyed recycler can't be mistaken for a live
+    // one.  The cache is only a shortcut:  a thread has exactly one magazine per recycler, which the
+    // recycler keeps, so an evicted entry is found again rather than replaced and its pages aren't lost.
+    struct MagazineSlot
+    {
+        uint64_t OwnerId;
+        Magazine* Mag;
+    };
+
+    // Enough for every recycler the engine creates, so eviction is rare
+    static const size_t kMagazineSlotsPerThread = 32;
+
+    Magazine& GetMagazine( void )
+    {
+        static thread_local MagazineSlot s_Slots[kMagazineSlotsPerThread] = {};
+        static thread_local size_t s_NextSlot = 0;
+
+        for (MagazineSlot& Slot : s_Slots)
+        {
+            if (Slot.OwnerId == m_Id && Slot.Mag != nullptr)
+                return *Slot.Mag;
+        }
+
+        // The recycler owns the magazine so that it outlives the thread.  Pages left in the magazine of
+        // a thread that exits stay idle until Destroy().
+        const std::thread::id ThisThread = std::this_thread::get_id();
+        Magazine* Mag = nullptr;
+        {
+            std::lock_guard<std::mutex> Guard(m_DepotMutex);
+            for (auto& Existing : m_Magazines)
+            {
+                if (Existing->Owner == ThisThread)
+                {
+                    Mag = Existing.get();
+                    break;
+                }
+            }
+
+            if (Mag == nullptr)
+            {
+                Mag = new Magazine;
+                Mag->Count = 0;
+                Mag->Owner = ThisThread;
+                m_Magazines.emplace_back(Mag);
+            }
+        }
+
+        MagazineSlot& Slot = s_Slots[s_NextSlot++ % kMagazineSlotsPerThread];
+        Slot.OwnerId = m_Id;
+        Slot.Mag = Mag;
+        return *Mag;
+    }
+
+    void RefillMagazine( Magazine& Mag )
+    {
+        Reclaim();
+
+        size_t NumPages = TakeFromDepot(Mag);
+
+        // If another thread was reclaiming, its pages may not have reached the depot yet.  Wait for it
+        // rather than creating pages that aren't needed.
+        if (NumPages == 0)
+        {
+            Reclaim(true);
+            NumPages = TakeFromDepot(Mag);
+        }
+
+        Mag.Count = NumPages;
+        if (NumPages > 0)
+        {
+            m_MagazinePages.fetch_add(NumPages, std::memory_order_relaxed);
+            m_MagazineRefills.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t TakeFromDepot( Magazine& Mag )
+    {
+        LockDepot();
+        size_t NumPages = m_Depot.size() < m_MagazineCapacity ? m_Depot.size() : m_MagazineCapacity;
+        for (size_t i = 0; i < NumPages; ++i)
+            Mag.Pages[i] = m_Depot[m_Depot.size() - NumPages + i];
+        m_Depot.resize(m_Depot.size() - NumPages);
+        if (m_Depot.size() < m_MinDepotPages)
+            m_MinDepotPages = m_Depot.size();
+        m_DepotMutex.unlock();
+        return NumPages;
+    }
+
+    // Requires m_DepotMutex
+    void ReleaseDepotPages( size_t First, size_t Count )
+    {
+        for (size_t i = First; i < First + Count; ++i)
+        {
+            for (size_t j = 0; j < m_PagePool.size(); ++j)
+            {
+                if (m_PagePool[j].get() == m_Depot[i])
+                {
+                    m_PagePool[j].swap(m_PagePool.back());
+                    m_PagePool.pop_back();
+                    break;
+                }
+            }
+        }
+        m_Depot.erase(m_Depot.begin() + First, m_Depot.begin() + First + Count);
+        m_PagesTrimmed.fetch_add(Count, std::memory_order_relaxed);
+    }
+
+    // Requires m_ReclaimMutex.  Takes the whole retire list at once and restores submission order, which is
+    // reversed on the stack.
+    void DrainRetireList( void )
+    {
+        RetiredBatch* List = m_RetireHead.exchange(nullptr, std::memory_order_acquire);
+        RetiredBatch* Reversed = nullptr;
+        while (List != nullptr)
+        {
+            RetiredBatch* Next = List->Next;
+            List->Next = Reversed;
+            Reversed = List;
+            List = Next;
+        }
+
+        for (RetiredBatch* Batch = Reversed; Batch != nullptr; )
+        {
+            RetiredBatch* Next = Batch->Next;
+            InsertInFenceOrder(Batch);
+            Batch = Next;
+        }
+    }
+
+    // Blocks until the oldest retired batch can be reused.  Returns false if nothing is retired.
+    bool WaitForOldestRetired( void )
+    {
+        uint64_t OldestFence = 0;
+        {
+            std::lock_guard<std::mutex> ReclaimLock(m_ReclaimMutex);
+            DrainRetireList();
+
+            for (auto& Queue : m_FenceQueues)
+            {
+                if (!Queue.empty())
+                {
+                    OldestFence = Queue.front()->FenceValue;
+                    break;
+                }
+            }
+        }
+
+        if (OldestFence == 0)
+            return false;
+
+        m_CapWaits.fetch_add(1, std::memory_order_relaxed);
+        m_WaitForFence(OldestFence);
+        return true;
+    }
+
+    void CountPagesInUse( int64_t Delta )
+    {
+        int64_t InUse = m_PagesInUse.fetch_add(Delta, std::memory_order_relaxed) + Delta;
+        int64_t Peak = m_PeakPagesInUse.load(std::memory_order_relaxed);
+        while (InUse > Peak && !m_PeakPagesInUse.compare_exchange_weak(Peak, InUse, std::memory_order_relaxed))
+            ;
+    }
+
+    void LockDepot( void )
+    {
+        if (!m_DepotMutex.try_lock())
+        {
+            m_DepotLockWaits.fetch_add(1, std::memory_order_relaxed);
+            m_DepotMutex.lock();
+        }
+    }
+
+    // Batches from different threads can arrive slightly out of order, so walk back from the end
+    void InsertInFenceOrder( RetiredBatch* Batch )
+    {
+        std::deque<RetiredBatch*>& Queue = m_FenceQueues[(size_t)(Batch->FenceValue >> 56) & (kNumFenceQueues - 1)];
+        auto Iter = Queue.end();
+        while (Iter != Queue.begin() && (*(Iter - 1))->FenceValue > Batch->FenceValue)
+            --Iter;
+        Queue.insert(Iter, Batch);
+    }
+
+    void ResetCounters( void )
+    {
+        m_MagazinePages = 0;
+        m_RetiredPages = 0;
+        m_MagazineHits = 0;
+        m_MagazineRefills = 0;
+        m_PagesCreated = 0;
+        m_ReclaimPasses = 0;
+        m_PagesReclaimed = 0;
+        m_DepotLockWaits = 0;
+        m_ReclaimSkips = 0;
+        m_RetirePushRetries = 0;
+        m_PagesReused = 0;
+        m_PagesInUse = 0;
+        m_PeakPagesInUse = 0;
+        m_PagesTrimmed = 0;
+        m_CapWaits = 0;
+    }
+
+    static const size_t kNumFenceQueues = 4;
+    static std::atomic<uint64_t> sm_NextId;
+
+    std::function<PageType*(void)> m_CreatePage;
+    std::function<bool(uint64_t)> m_IsFenceComplete;
+    std::function<void(uint64_t)> m_WaitForFence;
+    const size_t m_MagazineCapacity;
+    const uint64_t m_Id;
+    size_t m_MaxPages;
+
+    // Guarded by m_DepotMutex
+    mutable std::mutex m_DepotMutex;
+    std::vector<std::unique_ptr<PageType, PageDeleter>> m_PagePool;
+    std::vector<PageType*> m_Depot;
+    std::vector<std::unique_ptr<Magazine>> m_Magazines;
+    size_t m_MinDepotPages;     // Since the last TrimIdle()
+
+    // Lock-free
+    std::atomic<RetiredBatch*> m_RetireHead;
+
+    // Guarded by m_ReclaimMutex
+    std::mutex m_ReclaimMutex;
+    std::deque<RetiredBatch*> m_FenceQueues[kNumFenceQueues];
+    std::vector<PageType*> m_ReclaimBuffer;
+
+    std::atomic<size_t> m_MagazinePages;
+    std::atomic<size_t> m_RetiredPages;
+    std::atomic<uint64_t> m_MagazineHits;
+    std::atomic<uint64_t> m_MagazineRefills;
+    std::atomic<uint64_t> m_PagesCreated;
+    std::atomic<uint64_t> m_ReclaimPasses;
+    std::atomic<uint64_t> m_PagesReclaimed;
+    std::atomic<uint64_t> m_DepotLockWaits;
+    std::atomic<uint64_t> m_ReclaimSkips;
+    std::atomic<uint64_t> m_RetirePushRetries;
+    std::atomic<uint64_t> m_PagesReused;
+    std::atomic<int64_t> m_PagesInUse;
+    std::atomic<int64_t> m_PeakPagesInUse;
+    std::atomic<uint64_t> m_PagesTrimmed;
+    std::atomic<uint64_t> m_CapWaits;
+};
+
+template <typename PageType, typename PageDeleter>
+std::atomic<uint64_t> PageRecycler<PageType, PageDeleter>::sm_NextId(1);
+
+// Hands out the slots of a fixed ring in order and takes them back in the same order, each once its
+// fence has completed.  A slot that is held for a long time stalls reuse of everything after it, at
+// which point Acquire() fails and the caller is expected to fall back to another source.
+class PageRing
+{
+public:
+
+    static const uint32_t kNoSlot = ~0u;
+
+    PageRing() : m_Head(0), m_Tail(0), m_Count(0) {}
+
+    void Init( uint32_t NumSlots )
+    {
+        std::lock_guard<std::mutex> Guard(m_Mutex);
+        m_SlotFences.assign(NumSlots, (uint64_t)kFree);
+        m_Head = m_Tail = m_Count = 0;
+    }
+
+    uint32_t GetNumSlots( void ) const { return (uint32_t)m_SlotFences.size(); }
+
+    template <typename FenceTest>
+    uint32_t Acquire( FenceTest IsFenceComplete )
+    {
+        std::lock_guard<std::mutex> Guard(m_Mutex);
+
+        const uint32_t NumSlots = (uint32_t)m_SlotFences.size();
+        while (m_Count > 0 && m_SlotFences[m_Tail] != kInUse && IsFenceComplete(m_SlotFences[m_Tail]))
+        {
+            m_SlotFences[m_Tail] = kFree;
+            m_Tail = (m_Tail + 1) % NumSlots;
+            --m_Count;
+        }
+
+        if (m_Count == NumSlots)
+            return kNoSlot;
+
+        uint32_t Slot = m_Head;
+        m_SlotFences[Slot] = kInUse;
+        m_Head = (m_Head + 1) % NumSlots;
+        ++m_Count;
+        return Slot;
+    }
+
+    void Release( uint32_t Slot, uint64_t FenceValue )
+    {
+        std::lock_guard<std::mutex> Guard(m_Mutex);
+        m_SlotFences[Slot] = FenceValue;
+    }
+
+    uint32_t GetNumOutstanding( void ) const
+    {
+        std::lock_guard<std::mutex> Guard(m_Mutex);
+        return m_Count;
+    }
+
+private:
+
+    static const uint64_t kInUse = ~0ull;
+    static const uint64_t kFree = ~0ull - 1;
+
+    mutable std::mutex m_Mutex;
+    std::vector<uint64_t> m_SlotFences;
+    uint32_t m_Head;
+    uint32_t m_Tail;
+    uint32_t m_Count;   // Slots from m_Tail to m_Head that are in use or waiting on a fence
+};
@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  CPU-only stand-ins for a linear allocator page and a command queue fence.  They let a
+// PageRecycler be driven from many threads with no device, e.g.
+//
+//     MockFence Fence;
+//     PageRecycler<MockPage> Pages([]{ return new MockPage(kCpuAllocatorPageSize); },
+//         [&Fence]( uint64_t Value ){ return Fence.IsFenceComplete(Value); });
+//
+// A page handed out twice without passing through its fence will show up as a torn Owner tag.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Mirrors the members of LinearAllocationPage that allocators touch
+class MockPage
+{
+public:
+    explicit MockPage( size_t PageSize ) : Owner(0), m_Memory(PageSize)
+    {
+        m_CpuVirtualAddress = m_Memory.data();
+        m_GpuVirtualAddress = (uint64_t)(uintptr_t)m_Memory.data();
+    }
+
+    void Map( void ) {}
+    void Unmap( void ) {}
+
+    void* m_CpuVirtualAddress;
+    uint64_t m_GpuVirtualAddress;
+
+    // Set by whoever holds the page so that tests can detect double handouts
+    std::atomic<uint64_t> Owner;
+
+private:
+    std::vector<uint8_t> m_Memory;
+};
+
+// A monotonic fence for a single queue.  Values carry the queue type in their top byte like the
+// CommandListManager's.  Signal() stands in for ExecuteCommandLists and Complete() for the GPU.
+class MockFence
+{
+public:
+    explicit MockFence( uint64_t QueueType = 0 ) :
+        m_NextValue((QueueType << 56) | 1), m_CompletedValue(QueueType << 56) {}
+
+    uint64_t Signal( void ) { return m_NextValue++; }
+    void Complete( uint64_t Value )
+    {
+        uint64_t Current = m_CompletedValue.load();
+        while (Value > Current && !m_CompletedValue.compare_exchange_weak(Current, Value))
+            ;
+    }
+    void CompleteAll( void ) { Complete(m_NextValue.load() - 1); }
+
+    bool IsFenceComplete( uint64_t Value ) const { return Value <= m_CompletedValue.load(); }
+    uint64_t GetNextValue( void ) const { return m_NextValue.load(); }
+
+private:
+    std::atomic<uint64_t> m_NextValue;
+    std::atomic<uint64_t> m_CompletedValue;
+};
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "ParallelGraphicsContext.h"
+#include "JobSystem.h"
+
+void ParallelGraphicsContext::Record( uint32_t NumDraws, const RecordFunction& Record )
+{
+    JobScheduler& Scheduler = JobSystem::g_Scheduler;
+
+    uint32_t NumContexts = NumDraws / std::max(m_MinDrawsPerContext, 1u);
+    NumContexts = std::min(NumContexts, Scheduler.GetNumWorkers() + 1);
+    NumContexts = std::min(NumContexts, (uint32_t)kMaxContexts);
+
+    m_NumContexts = std::max(NumContexts, 1u);
+
+    if (NumContexts <= 1)
+    {
+        Record(m_Parent, 0, NumDraws);
+        return;
+    }
+
+    // The parent's commands so far, and its pending barriers, have to reach the queue ahead of the ranges
+    m_Parent.Flush();
+
+    // Contexts are handed out under a lock and profiled blocks aren't thread safe, so they are begun here
+    GraphicsContext* Contexts[kMaxContexts];
+    for (uint32_t i = 0; i < NumContexts; ++i)
+        Contexts[i] = &GraphicsContext::Begin();
+
+    JobCounter Recorded;
+    for (uint32_t i = 0; i < NumContexts; ++i)
+    {
+        const uint32_t Begin = (uint32_t)((uint64_t)NumDraws * i / NumContexts);
+        const uint32_t End = (uint32_t)((uint64_t)NumDraws * (i + 1) / NumContexts);
+        GraphicsContext& Context = *Contexts[i];
+        Scheduler.Submit([&Record, &Context, Begin, End]( void ) { Record(Context, Begin, End); }, &Recorded);
+    }
+    Scheduler.Wait(Recorded);
+
+    // The queue runs command lists in the order they are executed
+    for (uint32_t i = 0; i < NumContexts; ++i)
+        Contexts[i]->Finish();
+}
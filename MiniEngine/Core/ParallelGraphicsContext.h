@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Records a long run of draws on several command lists at once.  The draws are split into
+// contiguous ranges, each range is recorded into a context of its own on the job system, and the contexts
+// are submitted in range order, so the GPU sees the draws in the same order as if one thread had recorded
+// them.  Whatever the parent context recorded beforehand is submitted first, and the parent carries on
+// recording after the ranges.
+//
+// Each range starts on a fresh command list, so the record function must set every piece of state it
+// depends on:  root signature, pipeline state, targets, viewport, buffers and root parameters.  It must
+// not transition resources, because resource states are tracked per resource rather than per command
+// list.  Do the transitions on the parent before recording.
+
+#pragma once
+
+#include "CommandContext.h"
+#include <functional>
+
+class ParallelGraphicsContext : NonCopyable
+{
+public:
+
+    static const uint32_t kMaxContexts = 16;
+    static const uint32_t kMinDrawsPerContext = 64;
+
+    typedef std::function<void (GraphicsContext& Context, uint32_t Begin, uint32_t End)> RecordFunction;
+
+    explicit ParallelGraphicsContext( GraphicsContext& Parent, uint32_t MinDrawsPerContext = kMinDrawsPerContext ) :
+        m_Parent(Parent), m_MinDrawsPerContext(MinDrawsPerContext), m_NumContexts(0) {}
+
+    // Calls Record on ranges of [0, NumDraws) and returns once they are all submitted.  When there are too
+    // few draws to be worth splitting, or no worker threads, the parent records them all itself.
+    void Record( uint32_t NumDraws, const RecordFunction& Record );
+
+    // How many command lists the last Record() used
+    uint32_t GetNumContexts( void ) const { return m_NumContexts; }
+
+private:
+
+    GraphicsContext& m_Parent;
+    uint32_t m_MinDrawsPerContext;
+    uint32_t m_NumContexts;
+};
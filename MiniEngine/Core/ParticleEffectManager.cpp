@@ -189,10 +189,10 @@ namespace
         UINT TextureID = (UINT)(TextureNameArray.size() - 1);
         effectProperties.EmitProperties.TextureID = TextureID;
 
-        const ManagedTexture* managedTex = TextureManager::LoadDDSFromFile(name.c_str(), true);
-        managedTex->WaitForLoad();
+        // The slice is a copy, so the texture itself can be evicted once this returns
+        TextureRef managedTex = TextureManager::LoadDDSFromFile(name.c_str(), true);
 
-        GpuResource& ParticleTexture = *const_cast<ManagedTexture*>(managedTex);
+        GpuResource& ParticleTexture = *const_cast<ManagedTexture*>(managedTex.Get());
         CommandContext::InitializeTextureArraySlice(TextureArray, TextureID, ParticleTexture);
     }
 
@@ -15,6 +15,8 @@
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "Hash.h"
+#include "PipelineStateCache.h"
+#include "JobSystem.h"
 #include <map>
 #include <thread>
 #include <mutex>
@@ -26,11 +28,178 @@ using namespace std;
 
 static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
 static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static PipelineStateCache s_DiskCache;
+static JobCounter s_PendingCreates;     // PSOs still being created from cached blobs on the job system
+
+namespace
+{
+    BoolVar s_EnableDiskCache("Graphics/PSO Disk Cache", true);
+
+    size_t HashShader( const D3D12_SHADER_BYTECODE& Shader, size_t Hash )
+    {
+        // DXBC and DXIL containers are always a whole number of dwords
+        const uint32_t* Begin = (const uint32_t*)Shader.pShaderBytecode;
+        return Utility::HashRange(Begin, Begin + Shader.BytecodeLength / 4, Hash);
+    }
+
+    // The in-memory hash codes fold in pointers to shader bytecode, input element names and the root
+    // signature, none of which survive a restart.  The disk cache key replaces each of those with a
+    // hash of what they point to.  The upper half is the state hash and the lower half is the hash of
+    // all bytecode so that a shader edit is easy to tell apart from a state change when debugging.
+    uint64_t ComputeDiskCacheKey( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, const RootSignature& RootSig )
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC StableDesc = Desc;
+        StableDesc.pRootSignature = nullptr;
+        StableDesc.VS.pShaderBytecode = StableDesc.PS.pShaderBytecode = StableDesc.DS.pShaderBytecode = nullptr;
+        StableDesc.HS.pShaderBytecode = StableDesc.GS.pShaderBytecode = nullptr;
+        StableDesc.StreamOutput.pSODeclaration = nullptr;
+        StableDesc.StreamOutput.pBufferStrides = nullptr;
+        StableDesc.InputLayout.pInputElementDescs = nullptr;
+        StableDesc.CachedPSO = {};
+
+        const size_t RootSigHash = RootSig.GetHashCode();
+        size_t StateHash = Utility::HashState(&StableDesc);
+        StateHash = Utility::HashState(&RootSigHash, 1, StateHash);
+
+        for (UINT i = 0; i < Desc.InputLayout.NumElements; ++i)
+        {
+            D3D12_INPUT_ELEMENT_DESC Element = Desc.InputLayout.pInputElementDescs[i];
+            const size_t NameHash = std::hash<string>()(Element.SemanticName);
+            StateHash = Utility::HashState(&NameHash, 1, StateHash);
+            Element.SemanticName = nullptr;
+            StateHash = Utility::HashState(&Element, 1, StateHash);
+        }
+
+        size_t ShaderHash = HashShader(Desc.VS, 2166136261U);
+        ShaderHash = HashShader(Desc.PS, ShaderHash);
+        ShaderHash = HashShader(Desc.DS, ShaderHash);
+        ShaderHash = HashShader(Desc.HS, ShaderHash);
+        ShaderHash = HashShader(Desc.GS, ShaderHash);
+
+        return (uint64_t)StateHash << 32 | (uint32_t)ShaderHash;
+    }
+
+    uint64_t ComputeDiskCacheKey( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, const RootSignature& RootSig )
+    {
+        D3D12_COMPUTE_PIPELINE_STATE_DESC StableDesc = Desc;
+        StableDesc.pRootSignature = nullptr;
+        StableDesc.CS.pShaderBytecode = nullptr;
+        StableDesc.CachedPSO = {};
+
+        const size_t RootSigHash = RootSig.GetHashCode();
+        size_t StateHash = Utility::HashState(&StableDesc);
+        StateHash = Utility::HashState(&RootSigHash, 1, StateHash);
+
+        return (uint64_t)StateHash << 32 | (uint32_t)HashShader(Desc.CS, 2166136261U);
+    }
+
+    // Creates the PSO, seeding the driver with a cached blob when there is one.  New blobs are added to
+    // the cache, and blobs the driver rejects are dropped from it.
+    template <typename DESC>
+    ID3D12PipelineState* CreatePipelineState( DESC Desc, bool UseCache, uint64_t CacheKey, const vector<uint8_t>& CachedBlob,
+        HRESULT (STDMETHODCALLTYPE ID3D12Device::*CreateFunc)(const DESC*, REFIID, void**) )
+    {
+        ID3D12PipelineState* PSO = nullptr;
+
+        if (!CachedBlob.empty())
+        {
+            Desc.CachedPSO.pCachedBlob = CachedBlob.data();
+            Desc.CachedPSO.CachedBlobSizeInBytes = CachedBlob.size();
+
+            HRESULT hr = (g_Device->*CreateFunc)(&Desc, MY_IID_PPV_ARGS(&PSO));
+            Desc.CachedPSO = {};
+
+            if (SUCCEEDED(hr))
+                return PSO;
+
+            // D3D12_ERROR_ADAPTER_NOT_FOUND, D3D12_ERROR_DRIVER_VERSION_MISMATCH, or E_INVALIDARG when
+            // the blob doesn't match the description (e.g. a key collision).  Recompile from scratch.
+            s_DiskCache.Invalidate(CacheKey);
+        }
+
+        ASSERT_SUCCEEDED( (g_Device->*CreateFunc)(&Desc, MY_IID_PPV_ARGS(&PSO)) );
+
+        ComPtr<ID3DBlob> Blob;
+        if (UseCache && SUCCEEDED(PSO->GetCachedBlob(&Blob)))
+            s_DiskCache.Store(CacheKey, Blob->GetBufferPointer(), Blob->GetBufferSize());
+
+        return PSO;
+    }
+
+    // Fills the hash map slot at PSORef.  A PSO that misses the disk cache is compiled here, because the
+    // caller is about to need it and compiling is slow wherever it happens.  One that hits only has to be
+    // rebuilt from its blob, so that is handed to the job system and the render thread carries on until
+    // the PSO is first used.  Whatever Desc points to (shaders, input layout, root signature) must outlive
+    // the job, which is why the caller passes in anything it owns.
+    template <typename DESC>
+    void StartPipelineState( const DESC& Desc, const RootSignature& RootSig, ID3D12PipelineState** PSORef,
+        HRESULT (STDMETHODCALLTYPE ID3D12Device::*CreateFunc)(const DESC*, REFIID, void**),
+        shared_ptr<const void> KeepAlive = nullptr )
+    {
+        const bool UseCache = s_EnableDiskCache && s_DiskCache.IsOpen();
+        uint64_t CacheKey = 0;
+        vector<uint8_t> CachedBlob;
+
+        if (UseCache)
+        {
+            CacheKey = ComputeDiskCacheKey(Desc, RootSig);
+            if (s_DiskCache.Find(CacheKey, CachedBlob))
+            {
+                JobSystem::g_Scheduler.Submit([=]( void )
+                {
+                    (void)KeepAlive;
+                    *PSORef = CreatePipelineState(Desc, UseCache, CacheKey, CachedBlob, CreateFunc);
+                }, &s_PendingCreates);
+                return;
+            }
+        }
+
+        *PSORef = CreatePipelineState(Desc, UseCache, CacheKey, CachedBlob, CreateFunc);
+    }
+}
+
+ID3D12PipelineState* PSO::WaitForPipelineState( void ) const
+{
+    ASSERT(m_PSORef != nullptr, "PSO used before it was finalized");
+
+    // Waiting on the counter runs queued jobs on this thread, so a PSO is never stuck behind a worker
+    // that is itself waiting on one.  It may also be another thread's synchronous compile, though.
+    while (*m_PSORef == nullptr)
+    {
+        JobSystem::g_Scheduler.Wait(s_PendingCreates);
+        if (*m_PSORef == nullptr)
+            this_thread::yield();
+    }
+
+    // Threads recording with the same PSO may race to store this, but they all store the same pointer
+    m_PSO = *m_PSORef;
+    return m_PSO;
+}
+
+void PSO::InitializeCache( const std::wstring& FileName, const PSOCacheIdentity& Identity )
+{
+    if (s_EnableDiskCache)
+        s_DiskCache.Open(FileName, Identity);
+}
 
 void PSO::DestroyAll(void)
 {
+    JobSystem::g_Scheduler.Wait(s_PendingCreates);
+
     s_GraphicsPSOHashMap.clear();
     s_ComputePSOHashMap.clear();
+
+    if (s_DiskCache.IsOpen())
+    {
+        static const char* s_StatusNames[] = { "closed", "new", "loaded", "rebuilt (old format)", "rebuilt (new device)", "rebuilt (corrupt)" };
+        Utility::Printf("PSO disk cache %s:  %u hits, %u misses, %u entries\n", s_StatusNames[s_DiskCache.GetStatus()],
+            s_DiskCache.GetNumHits(), s_DiskCache.GetNumMisses(), (uint32_t)s_DiskCache.GetNumEntries());
+
+        // Every PSO this run needed has been created by now, so anything else in the file is stale
+        if (!s_DiskCache.Commit(false, true))
+            Utility::Print("Failed to write the PSO disk cache\n");
+        s_DiskCache.Close();
+    }
 }
 
 
@@ -135,16 +304,11 @@ void GraphicsPSO::Finalize()
     }
 
     if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        StartPipelineState(m_PSODesc, *m_RootSignature, PSORef, &ID3D12Device::CreateGraphicsPipelineState, m_InputLayouts);
+
+    // May still be null.  GetPipelineStateObject() waits for it.
+    m_PSORef = PSORef;
+    m_PSO = *PSORef;
 }
 
 void ComputePSO::Finalize()
@@ -173,16 +337,10 @@ void ComputePSO::Finalize()
     }
 
     if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        StartPipelineState(m_PSODesc, *m_RootSignature, PSORef, &ID3D12Device::CreateComputePipelineState);
+
+    m_PSORef = PSORef;
+    m_PSO = *PSORef;
 }
 
 ComputePSO::ComputePSO()
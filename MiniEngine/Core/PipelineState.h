@@ -23,15 +23,20 @@ class HullShader;
 class DomainShader;
 class PixelShader;
 class ComputeShader;
+struct PSOCacheIdentity;
 
 class PSO
 {
 public:
 
-    PSO() : m_RootSignature(nullptr) {}
+    PSO() : m_RootSignature(nullptr), m_PSO(nullptr), m_PSORef(nullptr) {}
 
     static void DestroyAll( void );
 
+    // Opens the on-disk cache of compiled PSOs for this adapter and driver.  Call once the device
+    // exists and before any PSO is finalized.  DestroyAll() writes it back out.
+    static void InitializeCache( const std::wstring& FileName, const PSOCacheIdentity& Identity );
+
     void SetRootSignature( const RootSignature& BindMappings )
     {
         m_RootSignature = &BindMappings;
@@ -43,13 +48,18 @@ public:
         return *m_RootSignature;
     }
 
-    ID3D12PipelineState* GetPipelineStateObject( void ) const { return m_PSO; }
+    // A PSO found in the disk cache is created on the job system, so Finalize() may return before it
+    // exists.  The first call here waits for it.
+    ID3D12PipelineState* GetPipelineStateObject( void ) const { return m_PSO != nullptr ? m_PSO : WaitForPipelineState(); }
 
 protected:
 
+    ID3D12PipelineState* WaitForPipelineState( void ) const;
+
     const RootSignature* m_RootSignature;
 
-    ID3D12PipelineState* m_PSO;
+    mutable ID3D12PipelineState* m_PSO;
+    ID3D12PipelineState* const* m_PSORef;   // Slot in the shared hash map that receives the PSO
 };
 
 class GraphicsPSO : public PSO
@@ -0,0 +1,381 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "PipelineStateCache.h"
+#include <cstring>
+
+using namespace std;
+
+static const uint32_t kCacheMagic = 0x4353504D;    // "MPSC" on disk
+
+static inline uint64_t AlignBlob( uint64_t Size, uint32_t Alignment ) { return (Size + Alignment - 1) & ~(uint64_t)(Alignment - 1); }
+
+// The keys are already hashes, but the low bits of the state half are often shared by related PSOs
+static inline size_t SlotIndex( uint64_t Key, uint32_t Capacity ) { return (size_t)((Key ^ (Key >> 32)) & (Capacity - 1)); }
+
+PipelineStateCache::PipelineStateCache() :
+    CompactionThreshold(0.5f),
+    m_Status(kClosed),
+    m_Header(nullptr),
+    m_BlobData(nullptr),
+    m_Index(nullptr),
+    m_NumMappedEntries(0),
+    m_DeadBytes(0),
+    m_IsDirty(false),
+    m_NumHits(0),
+    m_NumMisses(0)
+{
+    memset(&m_Identity, 0, sizeof(m_Identity));
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+    Close();
+}
+
+void PipelineStateCache::Open( const wstring& FileName, const PSOCacheIdentity& Identity )
+{
+    Close();
+
+    m_FileName = FileName;
+    m_Identity = Identity;
+    m_IsDirty = false;
+    m_NumHits = 0;
+    m_NumMisses = 0;
+    m_Used.clear();
+
+    m_Status = m_File.Open(FileName) ? kLoaded : kNoFile;
+
+    // Validating and paging in a few hundred MB of blobs is slow enough that we don't want it on the
+    // critical path.  The engine creates its swap chain and buffers while this runs.
+    if (m_Status == kLoaded)
+        m_PrefetchThread = thread(&PipelineStateCache::ValidateAndPrefetch, this);
+}
+
+void PipelineStateCache::WaitForPrefetch( void )
+{
+    lock_guard<mutex> Guard(m_PrefetchMutex);
+    if (m_PrefetchThread.joinable())
+        m_PrefetchThread.join();
+}
+
+const PipelineStateCache::IndexSlot* PipelineStateCache::FindMapped( uint64_t Key ) const
+{
+    if (m_Header == nullptr)
+        return nullptr;
+
+    const uint32_t Capacity = m_Header->IndexCapacity;
+    for (size_t Slot = SlotIndex(Key, Capacity), Probe = 0; Probe < Capacity; Slot = (Slot + 1) & (Capacity - 1), ++Probe)
+    {
+        if (m_Index[Slot].Size == 0)
+            return nullptr;
+        if (m_Index[Slot].Key == Key)
+            return &m_Index[Slot];
+    }
+    return nullptr;
+}
+
+bool PipelineStateCache::Find( uint64_t Key, vector<uint8_t>& Blob )
+{
+    if (!IsOpen())
+        return false;
+
+    WaitForPrefetch();
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    auto PendingIter = m_Pending.find(Key);
+    if (PendingIter != m_Pending.end())
+    {
+        ++m_NumHits;
+        m_Used.insert(Key);
+        Blob = PendingIter->second;
+        return true;
+    }
+
+    const IndexSlot* Slot = FindMapped(Key);
+    if (Slot == nullptr || m_Invalidated.count(Key) > 0)
+    {
+        ++m_NumMisses;
+        return false;
+    }
+
+    ++m_NumHits;
+    m_Used.insert(Key);
+    Blob.assign(m_BlobData + Slot->Offset, m_BlobData + Slot->Offset + Slot->Size);
+    return true;
+}
+
+void PipelineStateCache::Store( uint64_t Key, const void* Blob, size_t Size )
+{
+    if (!IsOpen() || Blob == nullptr || Size == 0 || Size > UINT32_MAX)
+        return;
+
+    WaitForPrefetch();
+
+    vector<uint8_t> Copy((const uint8_t*)Blob, (const uint8_t*)Blob + Size);
+
+    lock_guard<mutex> Guard(m_Mutex);
+    if (FindMapped(Key) != nullptr)
+        m_Invalidated.insert(Key);
+    m_Pending[Key] = move(Copy);
+    m_Used.insert(Key);
+    m_IsDirty = true;
+}
+
+void PipelineStateCache::Invalidate( uint64_t Key )
+{
+    if (!IsOpen())
+        return;
+
+    WaitForPrefetch();
+
+    lock_guard<mutex> Guard(m_Mutex);
+    if (m_Pending.erase(Key) > 0)
+        m_IsDirty = true;
+    if (FindMapped(Key) != nullptr && m_Invalidated.insert(Key).second)
+        m_IsDirty = true;
+}
+
+bool PipelineStateCache::Commit( bool ForceCompaction, bool PruneUnused )
+{
+    if (!IsOpen())
+        return false;
+
+    WaitForPrefetch();
+
+    lock_guard<mutex> Guard(m_Mutex);
+
+    // Entries nobody asked for this run are treated as invalidated.  Their bytes count as dead and are
+    // reclaimed by the next compaction.
+    if (PruneUnused && m_Header != nullptr)
+    {
+        for (uint32_t i = 0; i < m_Header->IndexCapacity; ++i)
+        {
+            const IndexSlot& Slot = m_Index[i];
+            if (Slot.Size != 0 && m_Used.count(Slot.Key) == 0 && m_Invalidated.insert(Slot.Key).second)
+                m_IsDirty = true;
+        }
+    }
+
+    if (!m_IsDirty && !ForceCompaction)
+        return true;
+
+    // Work out how much of the existing blob region is dead after this run's invalidations
+    uint64_t OldDataSize = m_Header ? m_Header->DataSize : 0;
+    uint64_t DeadBytes = m_DeadBytes;
+    for (uint64_t Key : m_Invalidated)
+        DeadBytes += AlignBlob(FindMapped(Key)->Size, kBlobAlignment);
+
+    const bool Compact = ForceCompaction || (OldDataSize > 0 && DeadBytes > OldDataSize * CompactionThreshold);
+
+    uint64_t NewBlobBytes = 0;
+    for (auto& Iter : m_Pending)
+        NewBlobBytes += AlignBlob(Iter.second.size(), kBlobAlignment);
+
+    const size_t NumEntries = GetNumEntries();
+    uint32_t Capacity = 64;
+    while (Capacity < NumEntries * 2)
+        Capacity *= 2;
+
+    // Lay out the new file.  Without compaction the old blob region is carried over byte for byte so
+    // existing offsets stay valid, and new blobs are appended after it.
+    uint64_t CarriedBytes = Compact ? (OldDataSize - DeadBytes) : OldDataSize;
+    uint64_t DataSize = CarriedBytes + NewBlobBytes;
+    uint64_t IndexOffset = sizeof(FileHeader) + DataSize;
+
+    vector<uint8_t> Image((size_t)(IndexOffset + Capacity * sizeof(IndexSlot)), 0);
+    FileHeader& Header = *(FileHeader*)Image.data();
+    uint8_t* DataOut = Image.data() + sizeof(FileHeader);
+    IndexSlot* IndexOut = (IndexSlot*)(Image.data() + IndexOffset);
+
+    Header.Magic = kCacheMagic;
+    Header.Version = kFormatVersion;
+    Header.Identity = m_Identity;
+    Header.DataSize = DataSize;
+    Header.DeadBytes = Compact ? 0 : DeadBytes;
+    Header.IndexCapacity = Capacity;
+    Header.NumEntries = (uint32_t)NumEntries;
+
+    auto Insert = [&]( uint64_t Key, uint64_t Offset, uint32_t Size )
+    {
+        size_t Slot = SlotIndex(Key, Capacity);
+        while (IndexOut[Slot].Size != 0)
+            Slot = (Slot + 1) & (Capacity - 1);
+        IndexOut[Slot].Key = Key;
+        IndexOut[Slot].Offset = Offset;
+        IndexOut[Slot].Size = Size;
+    };
+
+    uint64_t WriteOffset = 0;
+
+    if (m_Header != nullptr)
+    {
+        if (!Compact)
+        {
+            memcpy(DataOut, m_BlobData, (size_t)OldDataSize);
+            WriteOffset = OldDataSize;
+        }
+
+        for (uint32_t i = 0; i < m_Header->IndexCapacity; ++i)
+        {
+            const IndexSlot& Slot = m_Index[i];
+            if (Slot.Size == 0 || m_Invalidated.count(Slot.Key) > 0)
+                continue;
+
+            if (Compact)
+            {
+                memcpy(DataOut + WriteOffset, m_BlobData + Slot.Offset, Slot.Size);
+                Insert(Slot.Key, WriteOffset, Slot.Size);
+                WriteOffset += AlignBlob(Slot.Size, kBlobAlignment);
+            }
+            else
+                Insert(Slot.Key, Slot.Offset, Slot.Size);
+        }
+    }
+
+    for (auto& Iter : m_Pending)
+    {
+        memcpy(DataOut + WriteOffset, Iter.second.data(), Iter.second.size());
+        Insert(Iter.first, WriteOffset, (uint32_t)Iter.second.size());
+        WriteOffset += AlignBlob(Iter.second.size(), kBlobAlignment);
+    }
+
+    // Release the old mapping before replacing the file underneath it
+    m_Header = nullptr;
+    m_File.Close();
+
+    bool Success = MappedFile::WriteAtomic(m_FileName, Image.data(), Image.size());
+
+    m_Pending.clear();
+    m_Invalidated.clear();
+    m_IsDirty = false;
+
+    // Map whatever is on disk now.  If the write failed that is the old file, which is still intact.
+    RemapFile();
+
+    return Success;
+}
+
+void PipelineStateCache::Close( void )
+{
+    if (!IsOpen())
+        return;
+
+    Commit();
+
+    lock_guard<mutex> Guard(m_Mutex);
+    m_Header = nullptr;
+    m_BlobData = nullptr;
+    m_Index = nullptr;
+    m_NumMappedEntries = 0;
+    m_DeadBytes = 0;
+    m_File.Close();
+    m_Pending.clear();
+    m_Invalidated.clear();
+    m_Used.clear();
+    m_Status = kClosed;
+}
+
+void PipelineStateCache::RemapFile( void )
+{
+    m_Status = m_File.Open(m_FileName) ? kLoaded : kNoFile;
+    if (m_Status == kLoaded)
+        ValidateAndPrefetch();
+}
+
+void PipelineStateCache::ValidateAndPrefetch( void )
+{
+    m_Header = nullptr;
+    m_BlobData = nullptr;
+    m_Index = nullptr;
+    m_NumMappedEntries = 0;
+    m_DeadBytes = 0;
+
+    const uint8_t* FileData = m_File.GetData();
+    const uint64_t FileSize = m_File.GetSize();
+
+    if (FileSize < sizeof(FileHeader))
+    {
+        m_Status = kCorrupt;
+        m_IsDirty = true;
+        return;
+    }
+
+    const FileHeader& Header = *(const FileHeader*)FileData;
+    if (Header.Magic != kCacheMagic || Header.Version != kFormatVersion)
+    {
+        m_Status = kIncompatible;
+        m_IsDirty = true;
+        return;
+    }
+
+    if (!(Header.Identity == m_Identity))
+    {
+        m_Status = kWrongDevice;
+        m_IsDirty = true;
+        return;
+    }
+
+    const uint32_t Capacity = Header.IndexCapacity;
+    const bool SizesValid = Capacity != 0 && (Capacity & (Capacity - 1)) == 0 &&
+        Header.NumEntries < Capacity && Header.DeadBytes <= Header.DataSize &&
+        Header.DataSize <= FileSize - sizeof(FileHeader) &&
+        (FileSize - sizeof(FileHeader) - Header.DataSize) == (uint64_t)Capacity * sizeof(IndexSlot);
+
+    if (!SizesValid)
+    {
+        m_Status = kCorrupt;
+        m_IsDirty = true;
+        return;
+    }
+
+    const uint8_t* BlobData = FileData + sizeof(FileHeader);
+    const IndexSlot* Index = (const IndexSlot*)(BlobData + Header.DataSize);
+
+    // Volatile so the page touches below are not optimized away
+    volatile uint8_t Touch = 0;
+
+    uint32_t NumEntries = 0;
+    for (uint32_t i = 0; i < Capacity; ++i)
+    {
+        const IndexSlot& Slot = Index[i];
+        if (Slot.Size == 0)
+            continue;
+
+        if (Slot.Offset > Header.DataSize || Slot.Size > Header.DataSize - Slot.Offset)
+        {
+            m_Status = kCorrupt;
+            m_IsDirty = true;
+            return;
+        }
+
+        // Fault in every page of the blob now so that PSO creation doesn't stall on disk I/O later
+        for (uint64_t Page = 0; Page < Slot.Size; Page += 4096)
+            Touch += BlobData[Slot.Offset + Page];
+
+        ++NumEntries;
+    }
+
+    if (NumEntries != Header.NumEntries)
+    {
+        m_Status = kCorrupt;
+        m_IsDirty = true;
+        return;
+    }
+
+    m_BlobData = BlobData;
+    m_Index = Index;
+    m_NumMappedEntries = NumEntries;
+    m_DeadBytes = Header.DeadBytes;
+    m_Header = &Header;
+}
@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A persistent, on-disk cache of driver-compiled PSO blobs.  Entries are keyed by a
+// 64-bit value made from the pipeline state description hash and the hash of the shader bytecode
+// it references, so a cache file stays valid across runs even though the pointers inside the
+// descriptions do not.  The file is tagged with the identity of the adapter and user-mode driver
+// that produced it and is discarded wholesale when either changes.
+//
+// All entries live in a single file:
+//
+//     [FileHeader][blob data ...][IndexSlot x IndexCapacity]
+//
+// The blob region is append-only.  Each commit copies it forward unchanged, appends the blobs that
+// were compiled this run, and writes a fresh open-addressed hash index behind it.  Lookups probe the
+// index directly in the mapping, so opening the cache costs nothing proportional to its size.  Blobs
+// that were replaced or rejected by the driver, or that no PSO asked for during a whole run, become
+// dead space until a compaction rewrites only the live ones.  Every commit is written to a temporary file and renamed into place.
+//
+// The store itself never touches a D3D device or the engine headers.  It deals only in keys and
+// opaque byte blobs, which lets the file format and index be exercised with a fake identity and
+// hand-made blobs on any platform.
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Everything that must match for a cached blob to be accepted by the driver.
+struct PSOCacheIdentity
+{
+    uint32_t VendorId;
+    uint32_t DeviceId;
+    uint32_t SubSysId;
+    uint32_t Revision;
+    uint64_t DriverVersion;
+
+    bool operator==( const PSOCacheIdentity& rhs ) const
+    {
+        return VendorId == rhs.VendorId && DeviceId == rhs.DeviceId && SubSysId == rhs.SubSysId &&
+            Revision == rhs.Revision && DriverVersion == rhs.DriverVersion;
+    }
+};
+
+class PipelineStateCache
+{
+public:
+
+    // Bump whenever the key derivation or file layout changes
+    static const uint32_t kFormatVersion = 4;
+
+    enum Status
+    {
+        kClosed,
+        kNoFile,            // Nothing on disk yet
+        kLoaded,            // Header and index validated
+        kIncompatible,      // Different format version
+        kWrongDevice,       // Different adapter or driver
+        kCorrupt            // Failed validation.  Will be rewritten.
+    };
+
+    PipelineStateCache();
+    ~PipelineStateCache();
+
+    // Memory maps the cache file and starts validating and paging in its contents on a worker
+    // thread.  A file that is missing, corrupt, from another format version, or from a different
+    // adapter or driver is ignored and will be replaced by the next commit.
+    void Open( const std::wstring& FileName, const PSOCacheIdentity& Identity );
+
+    // Blocks until the background prefetch has finished.  Find() calls this implicitly.
+    void WaitForPrefetch( void );
+
+    // Returns true and a copy of the cached blob for this key.  The blob is copied under the lock
+    // because a concurrent Store() or Commit() may free or unmap the memory it lives in.
+    bool Find( uint64_t Key, std::vector<uint8_t>& Blob );
+
+    // Records a freshly compiled blob.  It is written to disk on the next commit.
+    void Store( uint64_t Key, const void* Blob, size_t Size );
+
+    // Forgets an entry that the driver rejected so that it is recompiled and replaced
+    void Invalidate( uint64_t Key );
+
+    // Writes pending changes to disk.  The file is compacted when dead blobs take up more than
+    // CompactionThreshold of the blob region, or always when ForceCompaction is set.  PruneUnused
+    // drops every entry that was neither found nor stored since Open(), so pass it only once the
+    // run has created all the PSOs it is going to.
+    bool Commit( bool ForceCompaction = false, bool PruneUnused = false );
+
+    // Commits and releases the mapping
+    void Close( void );
+
+    bool IsOpen( void ) const { return m_Status != kClosed; }
+    Status GetStatus( void ) const { return m_Status; }
+
+    size_t GetNumEntries( void ) const { return m_NumMappedEntries - m_Invalidated.size() + m_Pending.size(); }
+    uint32_t GetNumHits( void ) const { return m_NumHits; }
+    uint32_t GetNumMisses( void ) const { return m_NumMisses; }
+    uint64_t GetFileSize( void ) const { return m_File.GetSize(); }
+    uint64_t GetDeadBytes( void ) const { return m_DeadBytes; }
+
+    float CompactionThreshold;
+
+private:
+
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        PSOCacheIdentity Identity;
+        uint64_t DataSize;          // Blob region immediately follows the header
+        uint64_t DeadBytes;         // Bytes in the blob region no longer referenced by the index
+        uint32_t IndexCapacity;     // Power of two
+        uint32_t NumEntries;
+        uint32_t Reserved[2];       // Pads the header to 64 bytes
+    };
+
+    // An empty slot has a Size of zero
+    struct IndexSlot
+    {
+        uint64_t Key;
+        uint64_t Offset;            // Relative to the start of the blob region
+        uint32_t Size;
+        uint32_t Reserved;
+    };
+
+    static const uint32_t kBlobAlignment = 16;
+
+    const IndexSlot* FindMapped( uint64_t Key ) const;
+    void ValidateAndPrefetch( void );
+    void RemapFile( void );
+
+    std::wstring m_FileName;
+    PSOCacheIdentity m_Identity;
+    Status m_Status;
+
+    MappedFile m_File;
+    const FileHeader* m_Header;     // Null unless the mapped file passed validation
+    const uint8_t* m_BlobData;
+    const IndexSlot* m_Index;
+    size_t m_NumMappedEntries;
+    uint64_t m_DeadBytes;
+
+    std::thread m_PrefetchThread;
+    std::mutex m_PrefetchMutex;
+
+    std::mutex m_Mutex;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_Pending;
+    std::unordered_set<uint64_t> m_Invalidated;    // Keys in the mapped index that must be ignored
+    std::unordered_set<uint64_t> m_Used;           // Keys found or stored since Open()
+    bool m_IsDirty;
+    uint32_t m_NumHits;
+    uint32_t m_NumMisses;
+};
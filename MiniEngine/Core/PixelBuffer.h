@@ -46,6 +46,10 @@ protected:
     void CreateTextureResource( ID3D12Device* Device, const std::wstring& Name, const D3D12_RESOURCE_DESC& ResourceDesc,
         D3D12_CLEAR_VALUE ClearValue, EsramAllocator& Allocator );
 
+    // Places the texture at HeapOffset within Heap, where it may share memory with other placed resources
+    void CreateTextureResource( ID3D12Device* Device, const std::wstring& Name, const D3D12_RESOURCE_DESC& ResourceDesc,
+        D3D12_CLEAR_VALUE ClearValue, ID3D12Heap* Heap, uint64_t HeapOffset, D3D12_RESOURCE_STATES InitialState );
+
     static DXGI_FORMAT GetBaseFormat( DXGI_FORMAT Format );
     static DXGI_FORMAT GetUAVFormat( DXGI_FORMAT Format );
     static DXGI_FORMAT GetDSVFormat( DXGI_FORMAT Format );
@@ -170,5 +170,6 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
         m_Signature = *RSRef;
     }
 
+    m_HashCode = HashCode;
     m_Finalized = TRUE;
 }
@@ -22,8 +22,11 @@ class RootParameter
     friend class RootSignature;
 public:
 
+    // The parameter is hashed as raw bytes, so the padding and the unused part of the union must not
+    // hold garbage or the hash (and the PSO disk cache keys built on it) changes from run to run.
     RootParameter() 
     {
+        ZeroMemory(&m_RootParam, sizeof(m_RootParam));
         m_RootParam.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)0xFFFFFFFF;
     }
 
@@ -37,6 +40,7 @@ public:
         if (m_RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
             delete [] m_RootParam.DescriptorTable.pDescriptorRanges;
 
+        ZeroMemory(&m_RootParam, sizeof(m_RootParam));
         m_RootParam.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)0xFFFFFFFF;
     }
 
@@ -162,6 +166,10 @@ public:
 
     ID3D12RootSignature* GetSignature() const { return m_Signature; }
 
+    // A hash of the signature's contents.  Unlike the ID3D12RootSignature pointer, this is stable
+    // from one run to the next.
+    size_t GetHashCode() const { ASSERT(m_Finalized); return m_HashCode; }
+
 protected:
 
     BOOL m_Finalized;
@@ -174,4 +182,5 @@ protected:
     std::unique_ptr<RootParameter[]> m_ParamArray;
     std::unique_ptr<D3D12_STATIC_SAMPLER_DESC[]> m_SamplerArray;
     ID3D12RootSignature* m_Signature;
+    size_t m_HashCode;
 };
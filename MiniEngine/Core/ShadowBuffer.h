@@ -33,6 +33,10 @@ public:
     void BeginRendering( GraphicsContext& context );
     void EndRendering( GraphicsContext& context );
 
+    // Binds the buffer and its viewport without transitioning or clearing it.  Command lists recorded in
+    // parallel after BeginRendering() each need this.
+    void SetAsTarget( GraphicsContext& context ) const;
+
 private:
     D3D12_VIEWPORT m_Viewport;
     D3D12_RECT m_Scissor;
@@ -0,0 +1,369 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "StreamingTexture.h"
+#include "DDSTextureLoader.h"
+#include "FileUtility.h"
+#include "GraphicsCore.h"
+#include "CommandContext.h"
+#include "CommandListManager.h"
+#include <algorithm>
+
+using namespace std;
+using namespace Graphics;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Every texture that is streaming, for UpdateAll()
+    mutex s_TexturesMutex;
+    vector<StreamingTexture*> s_Textures;
+
+    const uint32_t kNoMip = UINT32_MAX;
+}
+
+StreamingTexture::StreamingTexture() :
+    m_Format(DXGI_FORMAT_UNKNOWN),
+    m_TailMip(0),
+    m_ResidentMip(0),
+    m_WantedMip(0),
+    m_Priority(IoScheduler::kVisible),
+    m_IsTiled(false),
+    m_FirstPackedMip(kNoMip),
+    m_NumPackedTiles(0)
+{
+}
+
+StreamingTexture::StreamingTexture( D3D12_CPU_DESCRIPTOR_HANDLE View ) :
+    Texture(View),
+    m_Format(DXGI_FORMAT_UNKNOWN),
+    m_TailMip(0),
+    m_ResidentMip(0),
+    m_WantedMip(0),
+    m_Priority(IoScheduler::kVisible),
+    m_IsTiled(false),
+    m_FirstPackedMip(kNoMip),
+    m_NumPackedTiles(0)
+{
+}
+
+bool StreamingTexture::Create( const wstring& FileName, bool sRGB, uint32_t MaxTailDimension )
+{
+    // Destroy() lets go of the view, but a view that belongs to the caller is written into again
+    const D3D12_CPU_DESCRIPTOR_HANDLE View = m_hCpuDescriptorHandle;
+    const bool OwnsView = m_OwnsDescriptor;
+    Destroy();
+    if (!OwnsView)
+        m_hCpuDescriptorHandle = View;
+
+    // Mapping reads nothing yet.  Parsing the headers and copying the tail pages in just those parts of the file.
+    m_File = MappedFile::Map(FileName);
+    if (m_File.empty() || FAILED(GetDDSMipChain(m_File.data(), m_File.size(), sRGB, &m_Format, m_Layout)))
+    {
+        m_File = ByteView();
+        return false;
+    }
+
+    m_FileName = FileName;
+    const uint32_t NumMips = m_Layout.GetNumMips();
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS Options = {};
+    g_Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &Options, sizeof(Options));
+    m_IsTiled = Options.TiledResourcesTier != D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED;
+
+    D3D12_RESOURCE_DESC Desc = {};
+    Desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    Desc.Width = m_Layout.GetMip(0).Width;
+    Desc.Height = m_Layout.GetMip(0).Height;
+    Desc.DepthOrArraySize = 1;
+    Desc.MipLevels = (UINT16)NumMips;
+    Desc.Format = m_Format;
+    Desc.SampleDesc.Count = 1;
+    Desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT hr;
+    if (m_IsTiled)
+    {
+        Desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+        hr = g_Device->CreateReservedResource(&Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+            MY_IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf()));
+    }
+    else
+    {
+        D3D12_HEAP_PROPERTIES HeapProps = {};
+        HeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+        HeapProps.CreationNodeMask = 1;
+        HeapProps.VisibleNodeMask = 1;
+
+        Desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+        hr = g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &Desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf()));
+    }
+
+    if (FAILED(hr))
+    {
+        m_File = ByteView();
+        return false;
+    }
+
+    m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
+    m_pResource->SetName(FileName.c_str());
+
+    uint32_t FirstPackedMip = kNoMip;
+    if (m_IsTiled)
+    {
+        UINT NumTiles = 0;
+        UINT NumTilings = NumMips;
+        D3D12_PACKED_MIP_INFO PackedMips;
+        D3D12_TILE_SHAPE TileShape;
+        m_Tilings.resize(NumMips);
+        g_Device->GetResourceTiling(m_pResource.Get(), &NumTiles, &PackedMips, &TileShape, &NumTilings, 0, m_Tilings.data());
+
+        m_FirstPackedMip = PackedMips.NumStandardMips;
+        m_NumPackedTiles = PackedMips.NumTilesForPackedMips;
+        m_MipHeaps.resize(NumMips);
+        FirstPackedMip = m_FirstPackedMip;
+    }
+
+    m_TailMip = m_Layout.SelectTail(MaxTailDimension, FirstPackedMip);
+    m_ResidentMip = m_TailMip;
+    m_WantedMip = m_TailMip;
+
+    // The tail goes in with the other uploads of the frame, and draws that are recorded later wait for it
+    // on the queue.
+    vector<D3D12_SUBRESOURCE_DATA> Tail;
+    for (uint32_t Mip = m_TailMip; Mip < NumMips; ++Mip)
+    {
+        const MipChainLayout::MipLevel& Level = m_Layout.GetMip(Mip);
+
+        D3D12_SUBRESOURCE_DATA Subresource;
+        Subresource.pData = m_File.data() + Level.FileOffset;
+        Subresource.RowPitch = Level.RowBytes;
+        Subresource.SlicePitch = (LONG_PTR)Level.Size;
+        Tail.push_back(Subresource);
+
+        if (m_IsTiled && Mip <= m_FirstPackedMip)
+            MapTiles(Mip);
+    }
+
+    CommandContext& UploadContext = CommandContext::Begin(L"Mip Tail Upload");
+    UploadContext.WriteTexture(*this, (UINT)Tail.size(), Tail.data(), m_TailMip);
+    UploadContext.Finish();
+
+    CreateView();
+
+    lock_guard<mutex> Guard(s_TexturesMutex);
+    s_Textures.push_back(this);
+    return true;
+}
+
+void StreamingTexture::RequestSize( uint32_t Width, uint32_t Height, IoScheduler::PriorityClass Priority )
+{
+    if (m_File.empty())
+        return;
+
+    RequestMip(m_Layout.SelectMipForSize(Width, Height), Priority);
+}
+
+void StreamingTexture::RequestMip( uint32_t Mip, IoScheduler::PriorityClass Priority )
+{
+    if (m_File.empty())
+        return;
+
+    m_WantedMip = min(Mip, m_TailMip);
+    m_Priority = Priority;
+}
+
+void StreamingTexture::Destroy()
+{
+    {
+        lock_guard<mutex> Guard(s_TexturesMutex);
+        s_Textures.erase(remove(s_Textures.begin(), s_Textures.end(), this), s_Textures.end());
+    }
+
+    m_CancelReads.Cancel();
+    m_CancelReads = IoCancelToken();
+    m_Read = nullptr;
+
+    Texture::Destroy();
+
+    m_MipHeaps.clear();
+    m_RetiredHeaps.clear();
+    m_Tilings.clear();
+    m_File = ByteView();
+}
+
+void StreamingTexture::UpdateAll( void )
+{
+    CommandContext* UploadContext = nullptr;
+    vector<StreamingTexture*> Updated;
+    {
+        lock_guard<mutex> Guard(s_TexturesMutex);
+        for (StreamingTexture* Texture : s_Textures)
+        {
+            const uint32_t ResidentMip = Texture->m_ResidentMip;
+            Texture->Update(UploadContext);
+            if (Texture->m_ResidentMip != ResidentMip)
+                Updated.push_back(Texture);
+        }
+    }
+
+    if (UploadContext != nullptr)
+        UploadContext->Finish();
+
+    // The new mips can be sampled by whatever is recorded from here on
+    for (StreamingTexture* Texture : Updated)
+        Texture->CreateView();
+}
+
+void StreamingTexture::Update( CommandContext*& UploadContext )
+{
+    // Memory for mips that were let go, once nothing in flight can sample them
+    while (!m_RetiredHeaps.empty() && g_CommandManager.IsFenceComplete(m_RetiredHeaps.front().FenceValue))
+        m_RetiredHeaps.erase(m_RetiredHeaps.begin());
+
+    if (m_Read != nullptr)
+    {
+        IoScheduler::Buffer Data;
+        uint32_t Mip;
+        {
+            lock_guard<mutex> Guard(m_Read->Mutex);
+            if (!m_Read->Done)
+                return;
+
+            Data = move(m_Read->Data);
+            Mip = m_Read->Mip;
+        }
+        m_Read = nullptr;
+
+        // A mip that is no longer wanted by the time it arrives is dropped
+        if (Data != nullptr && Mip + 1 == m_ResidentMip && Mip >= m_WantedMip)
+        {
+            const MipChainLayout::MipLevel& Level = m_Layout.GetMip(Mip);
+
+            D3D12_SUBRESOURCE_DATA Subresource;
+            Subresource.pData = Data->data();
+            Subresource.RowPitch = Level.RowBytes;
+            Subresource.SlicePitch = (LONG_PTR)Level.Size;
+
+            if (m_IsTiled)
+                MapTiles(Mip);
+
+            if (UploadContext == nullptr)
+                UploadContext = &CommandContext::Begin(L"Mip Streaming");
+
+            UploadContext->WriteTexture(*this, 1, &Subresource, Mip);
+            m_ResidentMip = Mip;
+        }
+    }
+
+    if (m_WantedMip < m_ResidentMip)
+        ReadMip(m_ResidentMip - 1);
+    else if (m_WantedMip > m_ResidentMip && m_IsTiled)
+        ReleaseMips(m_WantedMip);
+}
+
+void StreamingTexture::ReadMip( uint32_t Mip )
+{
+    uint64_t Offset, Size;
+    m_Layout.GetFileRange(Mip, Mip + 1, Offset, Size);
+
+    // Copying out of the mapping is what reads the mip from disk, so it happens on the I/O thread
+    ByteView MipData = m_File.SubView((size_t)Offset, (size_t)Size);
+    shared_ptr<ReadState> State = make_shared<ReadState>();
+    State->Mip = Mip;
+    State->Done = false;
+    m_Read = State;
+
+    Utility::g_IoScheduler.Schedule(m_FileName + L"#mip" + to_wstring(Mip), m_Priority, m_CancelReads,
+        [MipData]( void ) { return make_shared<vector<unsigned char>>(MipData.begin(), MipData.end()); },
+        [State]( const IoScheduler::Buffer& Data )
+        {
+            lock_guard<mutex> Guard(State->Mutex);
+            State->Data = Data;
+            State->Done = true;
+        });
+}
+
+void StreamingTexture::MapTiles( uint32_t Mip )
+{
+    ASSERT(m_IsTiled && Mip <= m_FirstPackedMip && m_MipHeaps[Mip] == nullptr);
+
+    D3D12_TILED_RESOURCE_COORDINATE Start = {};
+    Start.Subresource = Mip;
+
+    D3D12_TILE_REGION_SIZE Region = {};
+    Region.UseBox = FALSE;
+    if (Mip == m_FirstPackedMip)
+        Region.NumTiles = m_NumPackedTiles;
+    else
+        Region.NumTiles = m_Tilings[Mip].WidthInTiles * m_Tilings[Mip].HeightInTiles * m_Tilings[Mip].DepthInTiles;
+
+    if (Region.NumTiles == 0)
+        return;
+
+    D3D12_HEAP_DESC HeapDesc = {};
+    HeapDesc.SizeInBytes = (UINT64)Region.NumTiles * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    HeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    HeapDesc.Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+    ASSERT_SUCCEEDED(g_Device->CreateHeap(&HeapDesc, MY_IID_PPV_ARGS(&m_MipHeaps[Mip])));
+
+    // Mapping is a queue operation, so it happens before the upload that is submitted after it
+    const D3D12_TILE_RANGE_FLAGS RangeFlags = D3D12_TILE_RANGE_FLAG_NONE;
+    const UINT HeapOffset = 0;
+    const UINT RangeTiles = Region.NumTiles;
+    g_CommandManager.GetCommandQueue()->UpdateTileMappings(m_pResource.Get(), 1, &Start, &Region,
+        m_MipHeaps[Mip].Get(), 1, &RangeFlags, &HeapOffset, &RangeTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+void StreamingTexture::ReleaseMips( uint32_t NewResidentMip )
+{
+    // Everything that could sample the finer mips has been submitted, and the unmapping is queued behind it,
+    // so their memory is free to go once the queue signals its next fence.
+    const uint64_t FenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+
+    for (uint32_t Mip = m_ResidentMip; Mip < NewResidentMip; ++Mip)
+    {
+        if (m_MipHeaps[Mip] == nullptr)
+            continue;
+
+        D3D12_TILED_RESOURCE_COORDINATE Start = {};
+        Start.Subresource = Mip;
+
+        D3D12_TILE_REGION_SIZE Region = {};
+        Region.NumTiles = m_Tilings[Mip].WidthInTiles * m_Tilings[Mip].HeightInTiles * m_Tilings[Mip].DepthInTiles;
+
+        const D3D12_TILE_RANGE_FLAGS RangeFlags = D3D12_TILE_RANGE_FLAG_NULL;
+        g_CommandManager.GetCommandQueue()->UpdateTileMappings(m_pResource.Get(), 1, &Start, &Region,
+            nullptr, 1, &RangeFlags, nullptr, nullptr, D3D12_TILE_MAPPING_FLAG_NONE);
+
+        RetiredHeap Retired = { FenceValue, move(m_MipHeaps[Mip]) };
+        m_RetiredHeaps.push_back(move(Retired));
+    }
+
+    m_ResidentMip = NewResidentMip;
+}
+
+void StreamingTexture::CreateView( void )
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
+    SRVDesc.Format = m_Format;
+    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    SRVDesc.Texture2D.MostDetailedMip = 0;
+    SRVDesc.Texture2D.MipLevels = m_Layout.GetNumMips();
+    SRVDesc.Texture2D.ResourceMinLODClamp = (float)m_ResidentMip;
+
+    // The descriptor is rewritten in place, so whoever holds it sees the new mips
+    AllocateSRV();
+    g_Device->CreateShaderResourceView(m_pResource.Get(), &SRVDesc, m_hCpuDescriptorHandle);
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A DDS texture that is loaded a few mips at a time.  Creating it maps the file and uploads only
+// the small mips at the end (the tail), so a large texture costs next to nothing until something close to the
+// camera asks for more.  Finer mips are read on the I/O threads one at a time, coarsest first, and the view's
+// MinLOD clamp keeps the GPU from sampling mips that haven't arrived.
+//
+// Where the hardware supports tiled resources, the texture is reserved and each mip is backed by a heap of
+// its own only while it is wanted, as in the D3D12ReservedResources sample.  Elsewhere every mip is allocated
+// up front and streaming only spreads out the reads and uploads.
+
+#pragma once
+
+#include "pch.h"
+#include "TextureManager.h"
+#include "MipChainLayout.h"
+#include "MappedFile.h"
+#include <mutex>
+
+class CommandContext;
+
+class StreamingTexture : public Texture
+{
+public:
+
+    StreamingTexture();
+
+    // Writes its view into View, which stays the caller's, rather than allocating one.  TextureManager uses
+    // this to stream into a descriptor it has already handed out.
+    explicit StreamingTexture( D3D12_CPU_DESCRIPTOR_HANDLE View );
+
+    ~StreamingTexture() { Destroy(); }
+
+    // Loads the mip tail, the mips no larger than MaxTailDimension, and returns without waiting for the GPU.
+    // Fails for files that can't be streamed (see GetDDSMipChain()), which have to be loaded whole.
+    bool Create( const std::wstring& FileName, bool sRGB, uint32_t MaxTailDimension = 256 );
+
+    // Asks for the finest mip that a surface covering Width x Height pixels would sample.  Asking for less than
+    // is loaded lets a tiled texture give back the memory of the finer mips.
+    void RequestSize( uint32_t Width, uint32_t Height, IoScheduler::PriorityClass Priority = IoScheduler::kVisible );
+    void RequestMip( uint32_t Mip, IoScheduler::PriorityClass Priority = IoScheduler::kVisible );
+
+    // The finest mip that can be sampled
+    uint32_t GetResidentMip( void ) const { return m_ResidentMip; }
+    uint32_t GetNumMips( void ) const { return m_Layout.GetNumMips(); }
+    bool IsTiled( void ) const { return m_IsTiled; }
+
+    virtual void Destroy() override;
+
+    // Uploads the mips read since the last call, starts the next reads, and releases mips that are no longer
+    // wanted.  TextureManager::Update() calls it once a frame.
+    static void UpdateAll( void );
+
+private:
+
+    // What an I/O thread hands back.  It is shared so that a read can finish after the texture is destroyed.
+    struct ReadState
+    {
+        std::mutex Mutex;
+        IoScheduler::Buffer Data;
+        uint32_t Mip;
+        bool Done;
+    };
+
+    // A mip's memory, kept until the GPU has finished the frames that could have sampled it
+    struct RetiredHeap
+    {
+        uint64_t FenceValue;
+        Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+    };
+
+    void Update( CommandContext*& UploadContext );
+    void ReadMip( uint32_t Mip );
+    void MapTiles( uint32_t Mip );
+    void ReleaseMips( uint32_t NewResidentMip );
+    void CreateView( void );
+
+    std::wstring m_FileName;
+    ByteView m_File;
+    MipChainLayout m_Layout;
+    DXGI_FORMAT m_Format;
+
+    uint32_t m_TailMip;                 // Never released
+    uint32_t m_ResidentMip;
+    uint32_t m_WantedMip;
+    IoScheduler::PriorityClass m_Priority;
+
+    std::shared_ptr<ReadState> m_Read;  // Null when no read is in flight
+    IoCancelToken m_CancelReads;
+
+    // Tiled textures only.  The packed mips, which share tiles, have one heap between them, in the slot of the
+    // first of them.
+    bool m_IsTiled;
+    uint32_t m_FirstPackedMip;
+    std::vector<D3D12_SUBRESOURCE_TILING> m_Tilings;
+    uint32_t m_NumPackedTiles;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> m_MipHeaps;
+    std::vector<RetiredHeap> m_RetiredHeaps;
+};
@@ -0,0 +1,406 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "TGAFile.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #define TGA_X64 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define SSSE3_TARGET
+        #define AVX2_TARGET
+    #else
+        #include <cpuid.h>
+        #define SSSE3_TARGET __attribute__((target("ssse3")))
+        #define AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+#else
+    #define TGA_X64 0
+#endif
+
+using namespace std;
+
+namespace
+{
+    const size_t kHeaderSize = 18;
+
+    // Smaller images aren't worth sharing out
+    const size_t kParallelPixels = 1024 * 1024;
+    const uint32_t kPixelsPerBand = 256 * 1024;
+
+    typedef void (*ConvertFunction)( const uint8_t* Source, uint32_t* Dest, size_t Count );
+
+    void ConvertBGR_Scalar( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        for (size_t i = 0; i < Count; ++i, Source += 3)
+            Dest[i] = 0xFF000000 | Source[0] << 16 | Source[1] << 8 | Source[2];
+    }
+
+    void ConvertBGRA_Scalar( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        for (size_t i = 0; i < Count; ++i, Source += 4)
+            Dest[i] = (uint32_t)Source[3] << 24 | Source[0] << 16 | Source[1] << 8 | Source[2];
+    }
+
+    void ConvertGray( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        for (size_t i = 0; i < Count; ++i)
+            Dest[i] = 0xFF000000 | Source[i] * 0x010101u;
+    }
+
+#if TGA_X64
+
+    bool DetectSSSE3( void )
+    {
+#if defined(_MSC_VER)
+        int CpuInfo[4];
+        __cpuid(CpuInfo, 1);
+        return (CpuInfo[2] & (1 << 9)) != 0;
+#else
+        unsigned int Eax, Ebx, Ecx, Edx;
+        return __get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx) && (Ecx & bit_SSSE3) != 0;
+#endif
+    }
+
+    bool DetectAVX2( void )
+    {
+#if defined(_MSC_VER)
+        int CpuInfo[4];
+        __cpuid(CpuInfo, 1);
+        const bool OSSavesYMM = (CpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(CpuInfo, 7, 0);
+        return OSSavesYMM && (CpuInfo[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    // Four BGR pixels from the low 12 bytes of each 16 loaded.  The loop stops while the loads are still inside
+    // the source.
+    SSSE3_TARGET void ConvertBGR_SSSE3( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+        const __m128i Alpha = _mm_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 6 <= Count; i += 4)
+        {
+            __m128i BGR = _mm_loadu_si128((const __m128i*)(Source + i * 3));
+            _mm_storeu_si128((__m128i*)(Dest + i), _mm_or_si128(_mm_shuffle_epi8(BGR, Shuffle), Alpha));
+        }
+        ConvertBGR_Scalar(Source + i * 3, Dest + i, Count - i);
+    }
+
+    SSSE3_TARGET void ConvertBGRA_SSSE3( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        size_t i = 0;
+        for (; i + 4 <= Count; i += 4)
+        {
+            __m128i BGRA = _mm_loadu_si128((const __m128i*)(Source + i * 4));
+            _mm_storeu_si128((__m128i*)(Dest + i), _mm_shuffle_epi8(BGRA, Shuffle));
+        }
+        ConvertBGRA_Scalar(Source + i * 4, Dest + i, Count - i);
+    }
+
+    // Eight BGR pixels from 24 of 32 bytes loaded.  Shuffles don't cross the 128-bit lanes, so the dwords are
+    // first spread to start each lane at the 12 bytes it converts.
+    AVX2_TARGET void ConvertBGR_AVX2( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        const __m256i Spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+        const __m256i Shuffle = _mm256_setr_epi8(
+            2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+            2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+        const __m256i Alpha = _mm256_set1_epi32((int)0xFF000000);
+
+        size_t i = 0;
+        for (; i + 11 <= Count; i += 8)
+        {
+            __m256i BGR = _mm256_loadu_si256((const __m256i*)(Source + i * 3));
+            BGR = _mm256_permutevar8x32_epi32(BGR, Spread);
+            _mm256_storeu_si256((__m256i*)(Dest + i), _mm256_or_si256(_mm256_shuffle_epi8(BGR, Shuffle), Alpha));
+        }
+        ConvertBGR_SSSE3(Source + i * 3, Dest + i, Count - i);
+    }
+
+    AVX2_TARGET void ConvertBGRA_AVX2( const uint8_t* Source, uint32_t* Dest, size_t Count )
+    {
+        const __m256i Shuffle = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+        size_t i = 0;
+        for (; i + 8 <= Count; i += 8)
+        {
+            __m256i BGRA = _mm256_loadu_si256((const __m256i*)(Source + i * 4));
+            _mm256_storeu_si256((__m256i*)(Dest + i), _mm256_shuffle_epi8(BGRA, Shuffle));
+        }
+        ConvertBGRA_SSSE3(Source + i * 4, Dest + i, Count - i);
+    }
+
+    const bool s_HasSSSE3 = DetectSSSE3();
+    const bool s_HasAVX2 = s_HasSSSE3 && DetectAVX2();
+
+#endif // TGA_X64
+
+    TGAFile::Kernel Resolve( TGAFile::Kernel Use )
+    {
+        if (Use != TGAFile::kBestKernel)
+            return Use;
+
+#if TGA_X64
+        if (s_HasAVX2)
+            return TGAFile::kAVX2;
+        if (s_HasSSSE3)
+            return TGAFile::kSSSE3;
+#endif
+        return TGAFile::kScalar;
+    }
+
+    ConvertFunction GetConverter( uint32_t BytesPerPixel, TGAFile::Kernel Use )
+    {
+        if (BytesPerPixel == 1)
+            return ConvertGray;
+
+        switch (Resolve(Use))
+        {
+#if TGA_X64
+        case TGAFile::kAVX2:
+            return BytesPerPixel == 3 ? ConvertBGR_AVX2 : ConvertBGRA_AVX2;
+        case TGAFile::kSSSE3:
+            return BytesPerPixel == 3 ? ConvertBGR_SSSE3 : ConvertBGRA_SSSE3;
+#endif
+        default:
+            return BytesPerPixel == 3 ? ConvertBGR_Scalar : ConvertBGRA_Scalar;
+        }
+    }
+
+    // Where a row starts in an RLE stream:  a packet, and how many of its pixels earlier rows took
+    struct RLECursor
+    {
+        size_t Offset;
+        uint32_t Taken;
+    };
+
+    // A packet is a byte giving its kind and pixel count, and then one pixel to repeat or that many pixels
+    inline uint32_t GetPacketPixels( uint8_t Packet )
+    {
+        return (Packet & 0x7F) + 1u;
+    }
+
+    inline size_t GetPacketSize( uint8_t Packet, uint32_t BytesPerPixel )
+    {
+        return 1 + (Packet & 0x80 ? 1 : GetPacketPixels(Packet)) * (size_t)BytesPerPixel;
+    }
+
+    // Walks the packets without decoding them, recording where each row starts.  Packets may run from one row
+    // into the next.  Fails if the stream ends early.
+    bool ScanRLE( const uint8_t* Data, size_t Size, const TGAFile::Header& Image, vector<RLECursor>& RowStarts )
+    {
+        RowStarts.resize(Image.Height);
+
+        RLECursor Cursor = { Image.PixelOffset, 0 };
+        for (uint32_t Row = 0; Row < Image.Height; ++Row)
+        {
+            RowStarts[Row] = Cursor;
+
+            uint32_t Left = Image.Width;
+            while (Left > 0)
+            {
+                if (Cursor.Offset >= Size)
+                    return false;
+
+                const uint8_t Packet = Data[Cursor.Offset];
+                const size_t PacketSize = GetPacketSize(Packet, Image.BytesPerPixel);
+                if (PacketSize > Size - Cursor.Offset)
+                    return false;
+
+                const uint32_t Count = GetPacketPixels(Packet);
+                const uint32_t Take = min(Count - Cursor.Taken, Left);
+                Left -= Take;
+                Cursor.Taken += Take;
+                if (Cursor.Taken == Count)
+                {
+                    Cursor.Offset += PacketSize;
+                    Cursor.Taken = 0;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // The stream has been checked by ScanRLE()
+    void DecodeRLERow( const uint8_t* Data, const TGAFile::Header& Image, RLECursor Cursor, uint32_t* Dest,
+        ConvertFunction Convert )
+    {
+        uint32_t Left = Image.Width;
+        while (Left > 0)
+        {
+            const uint8_t Packet = Data[Cursor.Offset];
+            const uint32_t Count = GetPacketPixels(Packet);
+            const uint32_t Take = min(Count - Cursor.Taken, Left);
+            const uint8_t* Pixels = Data + Cursor.Offset + 1;
+
+            if (Packet & 0x80)
+            {
+                uint32_t Pixel;
+                Convert(Pixels, &Pixel, 1);
+                fill(Dest, Dest + Take, Pixel);
+            }
+            else
+            {
+                Convert(Pixels + Cursor.Taken * (size_t)Image.BytesPerPixel, Dest, Take);
+            }
+
+            Dest += Take;
+            Left -= Take;
+            Cursor.Taken += Take;
+            if (Cursor.Taken == Count)
+            {
+                Cursor.Offset += GetPacketSize(Packet, Image.BytesPerPixel);
+                Cursor.Taken = 0;
+            }
+        }
+    }
+}
+
+bool TGAFile::IsKernelSupported( Kernel Use )
+{
+    switch (Use)
+    {
+#if TGA_X64
+    case kSSSE3:
+        return s_HasSSSE3;
+    case kAVX2:
+        return s_HasAVX2;
+#endif
+    case kScalar:
+    case kBestKernel:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void TGAFile::ConvertBGR( const uint8_t* Source, uint32_t* Dest, size_t Count, Kernel Use )
+{
+    assert(IsKernelSupported(Use));
+    GetConverter(3, Use)(Source, Dest, Count);
+}
+
+void TGAFile::ConvertBGRA( const uint8_t* Source, uint32_t* Dest, size_t Count, Kernel Use )
+{
+    assert(IsKernelSupported(Use));
+    GetConverter(4, Use)(Source, Dest, Count);
+}
+
+bool TGAFile::ReadHeader( const uint8_t* Data, size_t Size, Header& Out )
+{
+    if (Size < kHeaderSize)
+        return false;
+
+    const uint8_t IDLength = Data[0];
+    const uint8_t ColorMapType = Data[1];
+    const uint8_t ImageType = Data[2];
+    const uint16_t ColorMapLength = (uint16_t)(Data[5] | Data[6] << 8);
+    const uint8_t ColorMapEntryBits = Data[7];
+
+    Out.Width = (uint32_t)(Data[12] | Data[13] << 8);
+    Out.Height = (uint32_t)(Data[14] | Data[15] << 8);
+    Out.BytesPerPixel = Data[16] / 8u;
+    Out.IsRLE = ImageType >= 8;
+
+    // The color map is skipped even for true-color images that carry one
+    Out.PixelOffset = kHeaderSize + IDLength;
+    if (ColorMapType != 0)
+        Out.PixelOffset += ColorMapLength * (size_t)((ColorMapEntryBits + 7) / 8);
+
+    switch (ImageType)
+    {
+    case 2:
+    case 10:
+        if (Data[16] != 24 && Data[16] != 32)
+            return false;
+        break;
+
+    case 3:
+    case 11:
+        if (Data[16] != 8)
+            return false;
+        break;
+
+    default:
+        return false;
+    }
+
+    return Out.Width > 0 && Out.Height > 0 && Out.PixelOffset <= Size;
+}
+
+bool TGAFile::Decode( const uint8_t* Data, size_t Size, vector<uint32_t>& Pixels, uint32_t& Width, uint32_t& Height,
+    JobScheduler* Scheduler )
+{
+    Pixels.clear();
+    Width = Height = 0;
+
+    Header Image;
+    if (!ReadHeader(Data, Size, Image))
+        return false;
+
+    const size_t NumPixels = (size_t)Image.Width * Image.Height;
+    vector<RLECursor> RowStarts;
+
+    if (Image.IsRLE)
+    {
+        if (!ScanRLE(Data, Size, Image, RowStarts))
+            return false;
+    }
+    else if (NumPixels * Image.BytesPerPixel > Size - Image.PixelOffset)
+    {
+        return false;
+    }
+
+    Pixels.resize(NumPixels);
+    Width = Image.Width;
+    Height = Image.Height;
+
+    const ConvertFunction Convert = GetConverter(Image.BytesPerPixel, kBestKernel);
+
+    auto ConvertRows = [&]( uint32_t Begin, uint32_t End )
+    {
+        uint32_t* Dest = Pixels.data() + (size_t)Begin * Image.Width;
+
+        if (!Image.IsRLE)
+        {
+            const uint8_t* Source = Data + Image.PixelOffset + (size_t)Begin * Image.Width * Image.BytesPerPixel;
+            Convert(Source, Dest, (size_t)(End - Begin) * Image.Width);
+            return;
+        }
+
+        for (uint32_t Row = Begin; Row < End; ++Row, Dest += Image.Width)
+            DecodeRLERow(Data, Image, RowStarts[Row], Dest, Convert);
+    };
+
+    if (Scheduler != nullptr && NumPixels >= kParallelPixels)
+        Scheduler->ParallelFor(0, Image.Height, max(kPixelsPerBand / Image.Width, 1u), ConvertRows);
+    else
+        ConvertRows(0, Image.Height);
+
+    return true;
+}
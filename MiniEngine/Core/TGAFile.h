@@ -0,0 +1,59 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Decodes TGA images to RGBA8, one uint32_t per pixel with red in the low byte.  Uncompressed
+// and run-length encoded true-color (24- and 32-bit) and grayscale (8-bit) images are supported.  Rows keep
+// their order in the file, as they always have in the engine, whichever corner the header says is first.
+//
+// Most of the time goes to swizzling BGR(A) to RGBA.  That is done with SSSE3 or AVX2 byte shuffles when the
+// CPU has them, which is detected at runtime, and the rows of a large image are split over the job scheduler.
+// An RLE image is first scanned for where each row starts, which is cheap, so its rows can be split too.
+// Nothing here touches D3D, so the kernels can be checked against each other and timed on any platform.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobScheduler;
+
+namespace TGAFile
+{
+    struct Header
+    {
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t BytesPerPixel;     // 1, 3 or 4
+        bool IsRLE;
+        size_t PixelOffset;         // Where the pixels start, past the ID field and any color map
+    };
+
+    // Fails for color-mapped images and pixel sizes other than those above
+    bool ReadHeader( const uint8_t* Data, size_t Size, Header& Out );
+
+    // Fails, leaving Pixels empty, if the file is malformed or too short.  Images of more than a million
+    // pixels are converted in bands of rows on Scheduler's threads, and the calling thread helps.
+    bool Decode( const uint8_t* Data, size_t Size, std::vector<uint32_t>& Pixels, uint32_t& Width, uint32_t& Height,
+        JobScheduler* Scheduler = nullptr );
+
+    // The conversion kernels, which Decode() uses the best of.  Each converts Count pixels.
+    enum Kernel
+    {
+        kScalar,
+        kSSSE3,
+        kAVX2,
+        kBestKernel
+    };
+
+    bool IsKernelSupported( Kernel Use );
+    void ConvertBGR( const uint8_t* Source, uint32_t* Dest, size_t Count, Kernel Use = kBestKernel );
+    void ConvertBGRA( const uint8_t* Source, uint32_t* Dest, size_t Count, Kernel Use = kBestKernel );
+}
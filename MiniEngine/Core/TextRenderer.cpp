@@ -103,15 +103,15 @@ namespace TextRenderer
 
         bool Load( const wstring& fileName )
         {
-            Utility::ByteArray ba = Utility::ReadFileSync( fileName );
+            ByteView File = Utility::MapFileSync( fileName );
 
-            if (ba->size() == 0)
+            if (File.empty())
             {
                 ERROR( "Cannot open file %ls", fileName.c_str() );
                 return false;
             }
 
-            LoadFromBinary( fileName.c_str(), ba->data(), ba->size() );
+            LoadFromBinary( fileName.c_str(), File.data(), File.size() );
 
             return true;
         }
@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "TextureCache.h"
+#include <cassert>
+
+using namespace std;
+
+uint64_t TextureCache::HashPath( const wstring& Path )
+{
+    uint64_t Hash = 14695981039346656037ull;
+    for (wchar_t Char : Path)
+    {
+        // Two bytes a character, so the hash is the same whatever the size of wchar_t
+        Hash = (Hash ^ (Char & 0xFF)) * 1099511628211ull;
+        Hash = (Hash ^ ((Char >> 8) & 0xFF)) * 1099511628211ull;
+    }
+    return Hash;
+}
+
+TextureCache::TextureCache( uint64_t BudgetBytes ) :
+    m_Budget(BudgetBytes),
+    m_ResidentBytes(0),
+    m_UnreferencedBytes(0)
+{
+    ResetStats();
+}
+
+bool TextureCache::Acquire( uint64_t Key )
+{
+    auto Found = m_Entries.find(Key);
+    if (Found == m_Entries.end())
+    {
+        Entry NewEntry;
+        NewEntry.RefCount = 1;
+        NewEntry.Size = 0;
+        m_Entries.emplace(Key, NewEntry);
+        ++m_Misses;
+        return false;
+    }
+
+    ++m_Hits;
+    AddRef(Key);
+    return true;
+}
+
+void TextureCache::AddRef( uint64_t Key )
+{
+    auto Found = m_Entries.find(Key);
+    assert(Found != m_Entries.end());
+
+    Entry& Texture = Found->second;
+    if (Texture.RefCount++ == 0)
+    {
+        m_Unreferenced.erase(Texture.LruPosition);
+        m_UnreferencedBytes -= Texture.Size;
+    }
+}
+
+void TextureCache::Release( uint64_t Key )
+{
+    auto Found = m_Entries.find(Key);
+    if (Found == m_Entries.end())
+        return;
+
+    Entry& Texture = Found->second;
+    assert(Texture.RefCount > 0);
+    if (--Texture.RefCount == 0)
+    {
+        Texture.LruPosition = m_Unreferenced.insert(m_Unreferenced.end(), Key);
+        m_UnreferencedBytes += Texture.Size;
+    }
+}
+
+void TextureCache::SetSize( uint64_t Key, uint64_t Bytes )
+{
+    auto Found = m_Entries.find(Key);
+    if (Found == m_Entries.end())
+        return;
+
+    Entry& Texture = Found->second;
+    m_ResidentBytes = m_ResidentBytes - Texture.Size + Bytes;
+    if (Texture.RefCount == 0)
+        m_UnreferencedBytes = m_UnreferencedBytes - Texture.Size + Bytes;
+    Texture.Size = Bytes;
+}
+
+uint32_t TextureCache::GetRefCount( uint64_t Key ) const
+{
+    auto Found = m_Entries.find(Key);
+    return Found == m_Entries.end() ? 0 : Found->second.RefCount;
+}
+
+void TextureCache::Evict( vector<uint64_t>& Evicted )
+{
+    while (m_ResidentBytes > m_Budget && !m_Unreferenced.empty())
+    {
+        const uint64_t Key = m_Unreferenced.front();
+        m_Unreferenced.pop_front();
+
+        auto Found = m_Entries.find(Key);
+        const uint64_t Size = Found->second.Size;
+        m_ResidentBytes -= Size;
+        m_UnreferencedBytes -= Size;
+        m_Entries.erase(Found);
+
+        ++m_Evictions;
+        m_EvictedBytes += Size;
+        Evicted.push_back(Key);
+    }
+}
+
+void TextureCache::Clear( void )
+{
+    m_Entries.clear();
+    m_Unreferenced.clear();
+    m_ResidentBytes = 0;
+    m_UnreferencedBytes = 0;
+}
+
+TextureCacheStats TextureCache::GetStats( void ) const
+{
+    TextureCacheStats Stats;
+    Stats.Hits = m_Hits;
+    Stats.Misses = m_Misses;
+    Stats.Evictions = m_Evictions;
+    Stats.EvictedBytes = m_EvictedBytes;
+    Stats.ResidentBytes = m_ResidentBytes;
+    Stats.UnreferencedBytes = m_UnreferencedBytes;
+    Stats.NumTextures = (uint32_t)m_Entries.size();
+    Stats.NumUnreferenced = (uint32_t)m_Unreferenced.size();
+    return Stats;
+}
+
+void TextureCache::ResetStats( void )
+{
+    m_Hits = 0;
+    m_Misses = 0;
+    m_Evictions = 0;
+    m_EvictedBytes = 0;
+}
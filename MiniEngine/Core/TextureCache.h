@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Decides which textures TextureManager keeps.  Textures are known by a hash of their path, and
+// each one counts the references held to it.  One that nobody references stays cached in case it is asked for
+// again, but once the cache holds more than its budget, the unreferenced textures go, least recently released
+// first.  Referenced textures never go, so the budget can be overrun by what is in use.
+//
+// This is only the bookkeeping.  The caller owns the textures and destroys the ones Evict() names, which keeps
+// the policy free of D3D so that it can be driven and checked on any platform.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TextureCacheStats
+{
+    uint64_t Hits;              // Acquired and already cached
+    uint64_t Misses;            // Acquired and had to be loaded
+    uint64_t Evictions;
+    uint64_t EvictedBytes;
+    uint64_t ResidentBytes;     // Every cached texture, referenced or not
+    uint64_t UnreferencedBytes;
+    uint32_t NumTextures;
+    uint32_t NumUnreferenced;
+};
+
+class TextureCache
+{
+public:
+
+    // 64-bit FNV-1a of the path
+    static uint64_t HashPath( const std::wstring& Path );
+
+    explicit TextureCache( uint64_t BudgetBytes );
+
+    void SetBudget( uint64_t BudgetBytes ) { m_Budget = BudgetBytes; }
+    uint64_t GetBudget( void ) const { return m_Budget; }
+
+    // Adds a reference, and the texture itself if it isn't cached.  Returns true if it was.
+    bool Acquire( uint64_t Key );
+
+    // Adds a reference to a cached texture
+    void AddRef( uint64_t Key );
+
+    // A texture that loses its last reference becomes the most recently used of those that can be evicted.
+    // Releasing a texture that isn't cached does nothing.
+    void Release( uint64_t Key );
+
+    // How much memory the texture takes.  Its size is zero until it has loaded.
+    void SetSize( uint64_t Key, uint64_t Bytes );
+
+    bool Contains( uint64_t Key ) const { return m_Entries.find(Key) != m_Entries.end(); }
+    uint32_t GetRefCount( uint64_t Key ) const;
+
+    // Removes unreferenced textures, least recently used first, until the cache fits its budget or only
+    // referenced textures are left.  Appends the keys of those removed.
+    void Evict( std::vector<uint64_t>& Evicted );
+
+    // Forgets every texture without counting evictions
+    void Clear( void );
+
+    TextureCacheStats GetStats( void ) const;
+    void ResetStats( void );
+
+private:
+
+    struct Entry
+    {
+        uint32_t RefCount;
+        uint64_t Size;
+        std::list<uint64_t>::iterator LruPosition;     // Valid while RefCount is zero
+    };
+
+    uint64_t m_Budget;
+    uint64_t m_ResidentBytes;
+    uint64_t m_UnreferencedBytes;
+    std::unordered_map<uint64_t, Entry> m_Entries;
+    std::list<uint64_t> m_Unreferenced;                 // Least recently released first
+
+    uint64_t m_Hits;
+    uint64_t m_Misses;
+    uint64_t m_Evictions;
+    uint64_t m_EvictedBytes;
+};
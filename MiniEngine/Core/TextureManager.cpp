@@ -18,8 +18,14 @@
 #include "DDSTextureLoader.h"
 #include "GraphicsCore.h"
 #include "CommandContext.h"
-#include <map>
+#include "StreamingTexture.h"
+#include "TGAFile.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <thread>
+#include <unordered_map>
 
 using namespace std;
 using namespace Graphics;
@@ -29,10 +35,29 @@ static UINT BytesPerPixel( DXGI_FORMAT Format )
     return (UINT)BitsPerPixel(Format) / 8;
 };
 
-void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+void Texture::AllocateSRV( void )
 {
-    m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
+    // A destroyed texture has a null handle rather than an unknown one
+    if (m_hCpuDescriptorHandle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN && m_hCpuDescriptorHandle.ptr != 0)
+        return;
+
+    m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_OwnsDescriptor = true;
+}
+
+void Texture::ReleaseSRV( void )
+{
+    if (m_OwnsDescriptor)
+    {
+        FreeDescriptor(m_hCpuDescriptorHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_OwnsDescriptor = false;
+    }
+}
 
+// Creates a 1-level 2D texture in the copy destination state.  The device is free-threaded, so this is
+// safe on any thread.
+static HRESULT CreateTexture2DResource( size_t Width, size_t Height, DXGI_FORMAT Format, ID3D12Resource** Resource )
+{
     D3D12_RESOURCE_DESC texDesc = {};
     texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
     texDesc.Width = Width;
@@ -52,8 +77,15 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
     HeapProps.CreationNodeMask = 1;
     HeapProps.VisibleNodeMask = 1;
 
-    ASSERT_SUCCEEDED(g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &texDesc,
-        m_UsageState, nullptr, MY_IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf())));
+    return g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &texDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(Resource));
+}
+
+void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+{
+    m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
+
+    ASSERT_SUCCEEDED(CreateTexture2DResource(Width, Height, Format, m_pResource.ReleaseAndGetAddressOf()));
 
     m_pResource->SetName(L"Texture");
 
@@ -64,67 +96,24 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
 
     CommandContext::InitializeTexture(*this, 1, &texResource);
 
-    if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    AllocateSRV();
     g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
 }
 
-void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
+bool Texture::CreateTGAFromMemory( const void* _filePtr, size_t fileSize, bool sRGB )
 {
-    const uint8_t* filePtr = (const uint8_t*)_filePtr;
-
-    // Skip first two bytes
-    filePtr += 2;
-
-    /*uint8_t imageTypeCode =*/ *filePtr++;
-
-    // Ignore another 9 bytes
-    filePtr += 9;
-
-    uint16_t imageWidth = *(uint16_t*)filePtr;
-    filePtr += sizeof(uint16_t);
-    uint16_t imageHeight = *(uint16_t*)filePtr;
-    filePtr += sizeof(uint16_t);
-    uint8_t bitCount = *filePtr++;
-
-    // Ignore another byte
-    filePtr++;
+    vector<uint32_t> formattedData;
+    uint32_t imageWidth, imageHeight;
+    if (!TGAFile::Decode((const uint8_t*)_filePtr, fileSize, formattedData, imageWidth, imageHeight, &JobSystem::g_Scheduler))
+        return false;
 
-    uint32_t* formattedData = new uint32_t[imageWidth * imageHeight];
-    uint32_t* iter = formattedData;
-
-    uint8_t numChannels = bitCount / 8;
-    uint32_t numBytes = imageWidth * imageHeight * numChannels;
-
-    switch (numChannels)
-    {
-    default:
-        break;
-    case 3:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 3)
-        {
-            *iter++ = 0xff000000 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 3;
-        }
-        break;
-    case 4:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 4)
-        {
-            *iter++ = filePtr[3] << 24 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 4;
-        }
-        break;
-    }
-
-    Create( imageWidth, imageHeight, sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM, formattedData );
-
-    delete [] formattedData;
+    Create( imageWidth, imageHeight, sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM, formattedData.data() );
+    return true;
 }
 
 bool Texture::CreateDDSFromMemory( const void* filePtr, size_t fileSize, bool sRGB )
 {
-    if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    AllocateSRV();
 
     HRESULT hr = CreateDDSTextureFromMemory( Graphics::g_Device,
         (const uint8_t*)filePtr, fileSize, 0, sRGB, &m_pResource, m_hCpuDescriptorHandle );
@@ -152,186 +141,697 @@ void Texture::CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize )
 namespace TextureManager
 {
     wstring s_RootPath = L"";
-    map< wstring, unique_ptr<ManagedTexture> > s_TextureCache;
+
+    // The textures, keyed by a hash of their path, and the policy that decides which of them to keep.  A
+    // texture that is evicted is retired until the GPU has finished the frames that could have drawn with it.
+    mutex s_CacheMutex;
+    unordered_map< uint64_t, unique_ptr<ManagedTexture> > s_TextureCache;
+    TextureCache s_CachePolicy(1024ull * 1024 * 1024);
+
+    struct RetiredTexture
+    {
+        uint64_t FenceValue;                    // Zero until the next Update()
+        unique_ptr<ManagedTexture> Texture;
+    };
+    vector<RetiredTexture> s_Retired;
+
+    // Uploads are capped so that a burst of loads doesn't stall one frame.  A texture larger than the cap
+    // still goes, on its own.
+    const size_t kUploadBytesPerFrame = 32 * 1024 * 1024;
+
+    // A texture that an I/O thread has read and decoded, waiting to be uploaded, or a DDS file that it has
+    // found can be streamed
+    struct DecodedTexture
+    {
+        ManagedTexture* Texture;
+        GpuResource Resource;                   // In the copy destination state.  Null if the load failed.
+        D3D12_CPU_DESCRIPTOR_HANDLE View;       // Made beside the resource and copied to the texture's own
+        vector<D3D12_SUBRESOURCE_DATA> Subresources;
+        shared_ptr<const void> Contents;        // What the subresources point into
+        size_t UploadSize;
+
+        // A streamed texture has no resource yet.  Update() creates it from the file, and reads the file
+        // whole if that fails.
+        bool Streams;
+        wstring FileName;
+        bool sRGB;
+        IoScheduler::PriorityClass Priority;
+    };
+
+    // Guards every texture's load state and the decoded textures.  Waiters sleep on s_LoadEvent, which is
+    // signaled when a load finishes and when a texture is decoded.
+    mutex s_LoadMutex;
+    condition_variable s_LoadEvent;
+    deque<DecodedTexture> s_Decoded;
+    uint32_t s_NumDecoding = 0;
+    IoCancelToken s_CancelLoads;
+    thread::id s_UpdateThread;
 
     void Initialize( const std::wstring& TextureLibRoot )
     {
         s_RootPath = TextureLibRoot;
+        s_UpdateThread = this_thread::get_id();
     }
 
     void Shutdown( void )
     {
+        // The reads still in flight refer to textures in the cache
+        s_CancelLoads.Cancel();
+        {
+            unique_lock<mutex> Lock(s_LoadMutex);
+            s_LoadEvent.wait(Lock, []( void ) { return s_NumDecoding == 0; });
+
+            for (DecodedTexture& Decoded : s_Decoded)
+            {
+                if (Decoded.Resource.GetResource() != nullptr)
+                    FreeDescriptor(Decoded.View, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            }
+            s_Decoded.clear();
+        }
+        s_CancelLoads = IoCancelToken();
+
+        for (auto& Default : s_DefaultTextures)
+            Default = nullptr;
+
+        lock_guard<mutex> Guard(s_CacheMutex);
+        for (auto& Cached : s_TextureCache)
+            Cached.second->Destroy();
         s_TextureCache.clear();
+        s_CachePolicy.Clear();
+
+        for (RetiredTexture& Retired : s_Retired)
+            Retired.Texture->Destroy();
+        s_Retired.clear();
     }
 
+    // Takes a reference to the texture for the caller, which the loaders hand over as a TextureRef
     pair<ManagedTexture*, bool> FindOrLoadTexture( const wstring& fileName )
     {
-        static mutex s_Mutex;
-        lock_guard<mutex> Guard(s_Mutex);
+        const uint64_t Key = TextureCache::HashPath(fileName);
 
-        auto iter = s_TextureCache.find(fileName);
+        lock_guard<mutex> Guard(s_CacheMutex);
 
         // If it's found, it has already been loaded or the load process has begun
-        if (iter != s_TextureCache.end())
-            return make_pair(iter->second.get(), false);
+        if (s_CachePolicy.Acquire(Key))
+        {
+            ManagedTexture* Found = s_TextureCache[Key].get();
+            ASSERT(Found->GetPath() == fileName, "Texture paths collide in the cache");
+            return make_pair(Found, false);
+        }
 
         ManagedTexture* NewTexture = new ManagedTexture(fileName);
-        s_TextureCache[fileName].reset( NewTexture );
+        s_TextureCache[Key].reset( NewTexture );
 
         // This was the first time it was requested, so indicate that the caller must read the file
         return make_pair(NewTexture, true);
     }
 
-    const Texture& GetBlackTex2D(void)
+    // The cache holds one reference to each default texture from its first request until Shutdown().  These
+    // are looked up every frame, and going through FindOrLoadTexture() each time would add a reference each time.
+    enum { kBlackTex2D, kWhiteTex2D, kMagentaTex2D, kNumDefaultTextures };
+    atomic<ManagedTexture*> s_DefaultTextures[kNumDefaultTextures];
+
+    const Texture& GetDefaultTexture( uint32_t Which, const wchar_t* Name, uint32_t Pixel )
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultBlackTexture");
+        ManagedTexture* ManTex = s_DefaultTextures[Which].load(memory_order_acquire);
+        if (ManTex != nullptr)
+        {
+            ManTex->WaitForLoad();
+            return *ManTex;
+        }
 
-        ManagedTexture* ManTex = ManagedTex.first;
+        auto ManagedTex = FindOrLoadTexture(Name);
+
+        ManTex = ManagedTex.first;
         const bool RequestsLoad = ManagedTex.second;
 
-        if (!RequestsLoad)
+        if (RequestsLoad)
         {
-            ManTex->WaitForLoad();
-            return *ManTex;
+            ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &Pixel);
+            ManTex->FinishLoad();
         }
+        else
+            ManTex->WaitForLoad();
+
+        // Threads that raced here each took a reference, and only the first one keeps it
+        ManagedTexture* Expected = nullptr;
+        if (!s_DefaultTextures[Which].compare_exchange_strong(Expected, ManTex, memory_order_acq_rel))
+            Release(ManTex);
 
-        uint32_t BlackPixel = 0;
-        ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &BlackPixel);
         return *ManTex;
     }
 
+    const Texture& GetBlackTex2D(void)
+    {
+        return GetDefaultTexture(kBlackTex2D, L"DefaultBlackTexture", 0);
+    }
+
     const Texture& GetWhiteTex2D(void)
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultWhiteTexture");
+        return GetDefaultTexture(kWhiteTex2D, L"DefaultWhiteTexture", 0xFFFFFFFFul);
+    }
 
-        ManagedTexture* ManTex = ManagedTex.first;
-        const bool RequestsLoad = ManagedTex.second;
+    const Texture& GetMagentaTex2D(void)
+    {
+        return GetDefaultTexture(kMagentaTex2D, L"DefaultMagentaTexture", 0x00FF00FF);
+    }
 
-        if (!RequestsLoad)
+    // Runs on an I/O thread.  The resource and its view are created here, where the device is free-threaded,
+    // so that the frame only pays for the copy.
+    bool DecodeDDSFile( const IoScheduler::Buffer& File, bool sRGB, DecodedTexture& Decoded )
+    {
+        Decoded.View = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        ID3D12Resource* Resource = nullptr;
+        HRESULT hr = CreateDDSTextureFromMemory( Graphics::g_Device, File->data(), File->size(), 0, sRGB,
+            &Resource, Decoded.View, nullptr, &Decoded.Subresources );
+
+        if (FAILED(hr))
         {
-            ManTex->WaitForLoad();
-            return *ManTex;
+            if (Resource != nullptr)
+                Resource->Release();
+            FreeDescriptor(Decoded.View, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            return false;
         }
 
-        uint32_t WhitePixel = 0xFFFFFFFFul;
-        ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &WhitePixel);
-        return *ManTex;
+        Decoded.Resource = GpuResource(Resource, D3D12_RESOURCE_STATE_COPY_DEST);
+        Resource->Release();
+        Decoded.Contents = File;
+        return true;
     }
 
-    const Texture& GetMagentaTex2D(void)
+    bool DecodeTGAFile( const IoScheduler::Buffer& File, bool sRGB, DecodedTexture& Decoded )
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultMagentaTexture");
+        shared_ptr<vector<uint32_t>> Pixels = make_shared<vector<uint32_t>>();
+        uint32_t Width, Height;
+        if (!TGAFile::Decode(File->data(), File->size(), *Pixels, Width, Height, &JobSystem::g_Scheduler))
+            return false;
+
+        const DXGI_FORMAT Format = sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        ID3D12Resource* Resource = nullptr;
+        if (FAILED(CreateTexture2DResource(Width, Height, Format, &Resource)))
+            return false;
+
+        Decoded.Resource = GpuResource(Resource, D3D12_RESOURCE_STATE_COPY_DEST);
+        Resource->Release();
+
+        Decoded.View = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        g_Device->CreateShaderResourceView(Decoded.Resource.GetResource(), nullptr, Decoded.View);
+
+        D3D12_SUBRESOURCE_DATA Subresource;
+        Subresource.pData = Pixels->data();
+        Subresource.RowPitch = Width * sizeof(uint32_t);
+        Subresource.SlicePitch = Subresource.RowPitch * Height;
+        Decoded.Subresources.push_back(Subresource);
+        Decoded.Contents = Pixels;
+        return true;
+    }
 
-        ManagedTexture* ManTex = ManagedTex.first;
-        const bool RequestsLoad = ManagedTex.second;
+    void PushDecoded( DecodedTexture&& Decoded )
+    {
+        {
+            lock_guard<mutex> Guard(s_LoadMutex);
+            s_Decoded.push_back(move(Decoded));
+            --s_NumDecoding;
+        }
+        s_LoadEvent.notify_all();
+    }
 
-        if (!RequestsLoad)
+    void ReadAsync( ManagedTexture* ManTex, const wstring& fileName, bool sRGB, IoScheduler::PriorityClass Priority, bool IsTGA )
+    {
+        const wstring FilePath = s_RootPath + fileName + (IsTGA ? L".tga" : L".dds");
+        Utility::g_IoScheduler.Read(FilePath, Priority, s_CancelLoads, [=]( const IoScheduler::Buffer& File )
         {
-            ManTex->WaitForLoad();
-            return *ManTex;
+            DecodedTexture Decoded;
+            Decoded.Texture = ManTex;
+            Decoded.UploadSize = 0;
+            Decoded.Streams = false;
+
+            const bool Loaded = File != nullptr && File->size() > 0 &&
+                (IsTGA ? DecodeTGAFile(File, sRGB, Decoded) : DecodeDDSFile(File, sRGB, Decoded));
+
+            // Like LoadFromFile(), fall back from the DDS to the TGA
+            if (!Loaded && !IsTGA && !s_CancelLoads.IsCancelled())
+            {
+                ReadAsync(ManTex, fileName, sRGB, Priority, true);
+                return;
+            }
+
+            if (Loaded)
+            {
+                Decoded.Resource->SetName(fileName.c_str());
+                Decoded.UploadSize = (size_t)GetRequiredIntermediateSize(Decoded.Resource.GetResource(), 0,
+                    (UINT)Decoded.Subresources.size());
+            }
+
+            PushDecoded(move(Decoded));
+        });
+    }
+
+    // Finds out on an I/O thread whether the DDS file can be streamed, which reads its headers and nothing
+    // else.  A file that can't be is read whole by ReadAsync().
+    void ReadStreamingAsync( ManagedTexture* ManTex, const wstring& fileName, bool sRGB, IoScheduler::PriorityClass Priority )
+    {
+        const wstring FilePath = s_RootPath + fileName + L".dds";
+
+        // An empty buffer says the file can be streamed, and a null one that it can't
+        auto CheckFile = [=]( void ) -> IoScheduler::Buffer
+        {
+            ByteView File = MappedFile::Map(FilePath);
+            DXGI_FORMAT Format;
+            MipChainLayout Layout;
+            if (File.empty() || FAILED(GetDDSMipChain(File.data(), File.size(), sRGB, &Format, Layout)))
+                return nullptr;
+            return make_shared<vector<unsigned char>>();
+        };
+
+        Utility::g_IoScheduler.Schedule(FilePath + L"#stream", Priority, s_CancelLoads, CheckFile,
+            [=]( const IoScheduler::Buffer& Streams )
+        {
+            if (Streams == nullptr && !s_CancelLoads.IsCancelled())
+            {
+                ReadAsync(ManTex, fileName, sRGB, Priority, false);
+                return;
+            }
+
+            // The tail is uploaded on its own, so it doesn't count against the frame's budget
+            DecodedTexture Decoded;
+            Decoded.Texture = ManTex;
+            Decoded.UploadSize = 0;
+            Decoded.Streams = Streams != nullptr;
+            Decoded.FileName = fileName;
+            Decoded.sRGB = sRGB;
+            Decoded.Priority = Priority;
+            PushDecoded(move(Decoded));
+        });
+    }
+
+    void UploadDecodedTextures( size_t MaxBytes )
+    {
+        vector<DecodedTexture> Batch;
+        {
+            lock_guard<mutex> Guard(s_LoadMutex);
+
+            size_t BatchBytes = 0;
+            while (!s_Decoded.empty() && (Batch.empty() || BatchBytes + s_Decoded.front().UploadSize <= MaxBytes))
+            {
+                BatchBytes += s_Decoded.front().UploadSize;
+                Batch.push_back(move(s_Decoded.front()));
+                s_Decoded.pop_front();
+            }
         }
 
-        uint32_t MagentaPixel = 0x00FF00FF;
-        ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &MagentaPixel);
-        return *ManTex;
+        if (Batch.empty())
+            return;
+
+        // One command list for the lot, and no waiting on it:  whatever draws with these textures is submitted
+        // to the same queue afterwards.
+        CommandContext* UploadContext = nullptr;
+        for (DecodedTexture& Decoded : Batch)
+        {
+            if (Decoded.Resource.GetResource() == nullptr)
+                continue;
+
+            if (UploadContext == nullptr)
+                UploadContext = &CommandContext::Begin(L"Texture Uploads");
+
+            UploadContext->WriteTexture(Decoded.Resource, (UINT)Decoded.Subresources.size(), Decoded.Subresources.data());
+        }
+
+        if (UploadContext != nullptr)
+            UploadContext->Finish();
+
+        for (DecodedTexture& Decoded : Batch)
+        {
+            if (Decoded.Streams)
+            {
+                // E.g. when the resource can't be created.  The load keeps its reference.
+                if (!Decoded.Texture->CreateStreaming(s_RootPath + Decoded.FileName + L".dds", Decoded.sRGB))
+                {
+                    {
+                        lock_guard<mutex> Guard(s_LoadMutex);
+                        ++s_NumDecoding;
+                    }
+                    ReadAsync(Decoded.Texture, Decoded.FileName, Decoded.sRGB, Decoded.Priority, false);
+                    continue;
+                }
+            }
+            else
+            {
+                Decoded.Texture->FinishAsyncLoad(Decoded.Resource.GetResource(), Decoded.View);
+                if (Decoded.Resource.GetResource() != nullptr)
+                    FreeDescriptor(Decoded.View, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            }
+            Decoded.Texture->FinishLoad();
+
+            // The load's own reference, which kept the texture from being evicted while it was in flight
+            Release(Decoded.Texture);
+        }
+    }
+
+    // Call with s_CacheMutex held
+    void EvictTextures( void )
+    {
+        vector<uint64_t> Evicted;
+        s_CachePolicy.Evict(Evicted);
+
+        for (uint64_t Key : Evicted)
+        {
+            auto Found = s_TextureCache.find(Key);
+            RetiredTexture Retired = { 0, move(Found->second) };
+            s_Retired.push_back(move(Retired));
+            s_TextureCache.erase(Found);
+        }
+    }
+
+    void DestroyRetiredTextures( void )
+    {
+        vector<unique_ptr<ManagedTexture>> Finished;
+        {
+            lock_guard<mutex> Guard(s_CacheMutex);
+
+            // Every command list that could use the textures retired since the last frame has been submitted
+            // by now, so the GPU is done with them once it reaches the last fence signaled.
+            const uint64_t LastFenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue() - 1;
+
+            for (size_t i = 0; i < s_Retired.size(); )
+            {
+                RetiredTexture& Retired = s_Retired[i];
+                if (Retired.FenceValue == 0)
+                {
+                    Retired.FenceValue = LastFenceValue;
+                    ++i;
+                }
+                else if (g_CommandManager.IsFenceComplete(Retired.FenceValue))
+                {
+                    Finished.push_back(move(Retired.Texture));
+                    Retired = move(s_Retired.back());
+                    s_Retired.pop_back();
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        for (unique_ptr<ManagedTexture>& Texture : Finished)
+            Texture->Destroy();
+    }
+
+    void Update( void )
+    {
+        s_UpdateThread = this_thread::get_id();
+        UploadDecodedTextures(kUploadBytesPerFrame);
+        StreamingTexture::UpdateAll();
+        DestroyRetiredTextures();
+    }
+
+    void AddRef( const ManagedTexture* Texture )
+    {
+        lock_guard<mutex> Guard(s_CacheMutex);
+        s_CachePolicy.AddRef(Texture->GetCacheKey());
+    }
+
+    void Release( const ManagedTexture* Texture )
+    {
+        lock_guard<mutex> Guard(s_CacheMutex);
+        s_CachePolicy.Release(Texture->GetCacheKey());
+        EvictTextures();
+    }
+
+    void SetTextureSize( ManagedTexture& Texture )
+    {
+        uint64_t Size = 0;
+        // A streamed texture is counted at its full size, however many of its mips are resident
+        if (Texture.GetResource() != nullptr)
+        {
+            D3D12_RESOURCE_DESC Desc = Texture.GetResource()->GetDesc();
+            Size = g_Device->GetResourceAllocationInfo(0, 1, &Desc).SizeInBytes;
+        }
+
+        lock_guard<mutex> Guard(s_CacheMutex);
+        s_CachePolicy.SetSize(Texture.GetCacheKey(), Size);
+        EvictTextures();
+    }
+
+    void SetCacheBudget( uint64_t BudgetBytes )
+    {
+        lock_guard<mutex> Guard(s_CacheMutex);
+        s_CachePolicy.SetBudget(BudgetBytes);
+        EvictTextures();
+    }
+
+    TextureCacheStats GetCacheStats( void )
+    {
+        lock_guard<mutex> Guard(s_CacheMutex);
+        return s_CachePolicy.GetStats();
     }
 
 } // namespace TextureManager
 
+TextureRef::TextureRef( const ManagedTexture* Texture ) : m_Texture(Texture)
+{
+    if (m_Texture != nullptr)
+        TextureManager::AddRef(m_Texture);
+}
+
+TextureRef::~TextureRef()
+{
+    if (m_Texture != nullptr)
+        TextureManager::Release(m_Texture);
+}
+
 void ManagedTexture::WaitForLoad( void ) const
 {
-    volatile D3D12_CPU_DESCRIPTOR_HANDLE& VolHandle = (volatile D3D12_CPU_DESCRIPTOR_HANDLE&)m_hCpuDescriptorHandle;
-    volatile bool& VolValid = (volatile bool&)m_IsValid;
-    while (VolHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN && VolValid)
-        this_thread::yield();
+    using namespace TextureManager;
+
+    unique_lock<mutex> Lock(s_LoadMutex);
+    while (m_IsLoading)
+    {
+        // Nobody else would upload while the thread that calls Update() is waiting here
+        if (this_thread::get_id() == s_UpdateThread && !s_Decoded.empty())
+        {
+            Lock.unlock();
+            UploadDecodedTextures(SIZE_MAX);
+            Lock.lock();
+        }
+        else
+        {
+            s_LoadEvent.wait(Lock);
+        }
+    }
+}
+
+bool ManagedTexture::IsLoaded( void ) const
+{
+    lock_guard<mutex> Guard(TextureManager::s_LoadMutex);
+    return !m_IsLoading;
+}
+
+void ManagedTexture::WhenLoaded( const LoadCallback& OnLoaded ) const
+{
+    {
+        lock_guard<mutex> Guard(TextureManager::s_LoadMutex);
+        if (m_IsLoading)
+        {
+            m_OnLoaded.push_back(OnLoaded);
+            return;
+        }
+    }
+    OnLoaded(*this);
+}
+
+void ManagedTexture::FinishLoad( void )
+{
+    TextureManager::SetTextureSize(*this);
+
+    vector<LoadCallback> Callbacks;
+    {
+        lock_guard<mutex> Guard(TextureManager::s_LoadMutex);
+        m_IsLoading = false;
+        Callbacks.swap(m_OnLoaded);
+    }
+    TextureManager::s_LoadEvent.notify_all();
+
+    for (LoadCallback& OnLoaded : Callbacks)
+        OnLoaded(*this);
+}
+
+void ManagedTexture::ShowTexture( const Texture& Other )
+{
+    AllocateSRV();
+    g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, Other.GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void ManagedTexture::FinishAsyncLoad( ID3D12Resource* Resource, D3D12_CPU_DESCRIPTOR_HANDLE View )
+{
+    // The descriptor has been handed out, so it is overwritten rather than replaced
+    if (Resource == nullptr)
+    {
+        ShowTexture(TextureManager::GetMagentaTex2D());
+        m_IsValid = false;
+        return;
+    }
+
+    m_pResource = Resource;
+    m_UsageState = D3D12_RESOURCE_STATE_GENERIC_READ;
+    g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, View, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+ManagedTexture::~ManagedTexture()
+{
+}
+
+void ManagedTexture::Destroy()
+{
+    m_Streaming = nullptr;
+    Texture::Destroy();
+}
+
+bool ManagedTexture::CreateStreaming( const wstring& FilePath, bool sRGB )
+{
+    // The descriptor may have been handed out, so the streamed views are written into it
+    AllocateSRV();
+    unique_ptr<StreamingTexture> Streaming(new StreamingTexture(m_hCpuDescriptorHandle));
+    if (!Streaming->Create(FilePath, sRGB))
+        return false;
+
+    m_pResource = Streaming->GetResource();
+    m_UsageState = D3D12_RESOURCE_STATE_GENERIC_READ;
+    m_Streaming = move(Streaming);
+    return true;
 }
 
 void ManagedTexture::SetToInvalidTexture( void )
 {
+    // A failed load may already have allocated a descriptor
+    ReleaseSRV();
     m_hCpuDescriptorHandle = TextureManager::GetMagentaTex2D().GetSRV();
     m_IsValid = false;
 }
 
-const ManagedTexture* TextureManager::LoadFromFile( const std::wstring& fileName, bool sRGB )
+TextureRef TextureManager::LoadFromFile( const std::wstring& fileName, bool sRGB )
 {
-    std::wstring CatPath = fileName;
-
-    const ManagedTexture* Tex = LoadDDSFromFile( CatPath + L".dds", sRGB );
+    // Replacing a DDS that failed to load drops its reference, so it can be evicted like any other
+    TextureRef Tex = LoadDDSFromFile( fileName + L".dds", sRGB );
     if (!Tex->IsValid())
-        Tex = LoadTGAFromFile( CatPath + L".tga", sRGB );
+        Tex = LoadTGAFromFile( fileName + L".tga", sRGB );
 
     return Tex;
 }
 
-const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileName, bool sRGB )
+TextureRef TextureManager::LoadFromFileAsync( const std::wstring& fileName, bool sRGB,
+    const ManagedTexture::LoadCallback& OnLoaded, IoScheduler::PriorityClass Priority, const Texture* Placeholder )
 {
     auto ManagedTex = FindOrLoadTexture(fileName);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
 
+    TextureRef Ref(ManTex);
+
+    // A load keeps the reference FindOrLoadTexture() took until the texture is uploaded
+    if (!RequestsLoad)
+        Release(ManTex);
+    else
+    {
+        ManTex->ShowTexture(Placeholder != nullptr ? *Placeholder : GetBlackTex2D());
+
+        {
+            lock_guard<mutex> Guard(s_LoadMutex);
+            ++s_NumDecoding;
+        }
+        ReadStreamingAsync(ManTex, fileName, sRGB, Priority);
+    }
+
+    if (OnLoaded)
+        ManTex->WhenLoaded(OnLoaded);
+
+    return Ref;
+}
+
+TextureRef TextureManager::LoadDDSFromFile( const std::wstring& fileName, bool sRGB )
+{
+    auto ManagedTex = FindOrLoadTexture(fileName);
+
+    ManagedTexture* ManTex = ManagedTex.first;
+    const bool RequestsLoad = ManagedTex.second;
+
+    // The caller's reference stands in for the one FindOrLoadTexture() took
+    TextureRef Ref(ManTex);
+    Release(ManTex);
+
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() == 0 || !ManTex->CreateDDSFromMemory( ba->data(), ba->size(), sRGB ))
+    ByteView File = Utility::MapFileSync( s_RootPath + fileName );
+    if (File.empty() || !ManTex->CreateDDSFromMemory( File.data(), File.size(), sRGB ))
         ManTex->SetToInvalidTexture();
     else
         ManTex->GetResource()->SetName(fileName.c_str());
 
-    return ManTex;
+    ManTex->FinishLoad();
+    return Ref;
 }
 
-const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileName, bool sRGB )
+TextureRef TextureManager::LoadTGAFromFile( const std::wstring& fileName, bool sRGB )
 {
     auto ManagedTex = FindOrLoadTexture(fileName);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
 
+    // The caller's reference stands in for the one FindOrLoadTexture() took
+    TextureRef Ref(ManTex);
+    Release(ManTex);
+
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
-    {
-        ManTex->CreateTGAFromMemory( ba->data(), ba->size(), sRGB );
-        ManTex->GetResource()->SetName(fileName.c_str());
-    }
-    else
+    ByteView File = Utility::MapFileSync( s_RootPath + fileName );
+    if (File.empty() || !ManTex->CreateTGAFromMemory( File.data(), File.size(), sRGB ))
         ManTex->SetToInvalidTexture();
+    else
+        ManTex->GetResource()->SetName(fileName.c_str());
 
-    return ManTex;
+    ManTex->FinishLoad();
+    return Ref;
 }
 
 
-const ManagedTexture* TextureManager::LoadPIXImageFromFile( const std::wstring& fileName )
+TextureRef TextureManager::LoadPIXImageFromFile( const std::wstring& fileName )
 {
     auto ManagedTex = FindOrLoadTexture(fileName);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
 
+    // The caller's reference stands in for the one FindOrLoadTexture() took
+    TextureRef Ref(ManTex);
+    Release(ManTex);
+
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
+    ByteView File = Utility::MapFileSync( s_RootPath + fileName );
+    if (!File.empty())
     {
-        ManTex->CreatePIXImageFromMemory(ba->data(), ba->size());
+        ManTex->CreatePIXImageFromMemory(File.data(), File.size());
         ManTex->GetResource()->SetName(fileName.c_str());
     }
     else
         ManTex->SetToInvalidTexture();
 
-    return ManTex;
+    ManTex->FinishLoad();
+    return Ref;
 }
@@ -17,6 +17,12 @@
 #include "pch.h"
 #include "GpuResource.h"
 #include "Utility.h"
+#include "IoScheduler.h"
+#include "TextureCache.h"
+#include <functional>
+#include <memory>
+
+class StreamingTexture;
 
 class Texture : public GpuResource
 {
@@ -24,8 +30,8 @@ class Texture : public GpuResource
 
 public:
 
-    Texture() { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
-    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle) {}
+    Texture() : m_OwnsDescriptor(false) { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
+    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle), m_OwnsDescriptor(false) {}
 
     // Create a 1-level 2D texture
     void Create(size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitData );
@@ -34,13 +40,14 @@ public:
         Create(Width, Width, Height, Format, InitData);
     }
 
-    void CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
+    bool CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     bool CreateDDSFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     void CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize );
 
     virtual void Destroy() override
     {
         GpuResource::Destroy();
+        ReleaseSRV();
         m_hCpuDescriptorHandle.ptr = 0;
     }
 
@@ -50,25 +57,87 @@ public:
 
 protected:
 
+    // Allocates a descriptor unless the texture already has one
+    void AllocateSRV( void );
+
+    // Returns the descriptor to the allocator if this texture allocated it
+    void ReleaseSRV( void );
+
     D3D12_CPU_DESCRIPTOR_HANDLE m_hCpuDescriptorHandle;
+    bool m_OwnsDescriptor;
 };
 
 class ManagedTexture : public Texture
 {
 public:
-    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true) {}
+    ManagedTexture( const std::wstring& FileName ) :
+        m_MapKey(FileName), m_CacheKey(TextureCache::HashPath(FileName)), m_IsValid(true), m_IsLoading(true) {}
+    ~ManagedTexture();
+
+    typedef std::function<void (const ManagedTexture& Texture)> LoadCallback;
 
     void operator= ( const Texture& Texture );
 
+    // Blocks until the texture has loaded or failed to load.  On the thread that calls TextureManager::Update(),
+    // waiting uploads whatever has been decoded rather than waiting for the next frame.
     void WaitForLoad(void) const;
     void Unload(void);
 
+    // Calls OnLoaded on the thread that finishes loading the texture, which is the one that calls
+    // TextureManager::Update() for an asynchronous load.  If the texture is already loaded, it is called now.
+    void WhenLoaded( const LoadCallback& OnLoaded ) const;
+
     void SetToInvalidTexture(void);
     bool IsValid(void) const { return m_IsValid; }
+    bool IsLoaded(void) const;
+
+    const std::wstring& GetPath(void) const { return m_MapKey; }
+    uint64_t GetCacheKey(void) const { return m_CacheKey; }
+
+    // Null unless the texture was loaded from a DDS file that can be streamed (see StreamingTexture).  Ask it
+    // for mips only on the thread that calls TextureManager::Update().
+    StreamingTexture* GetStreamingTexture(void) const { return m_Streaming.get(); }
+
+    virtual void Destroy() override;
+
+    // Used by TextureManager.  An asynchronous load hands out the texture's own descriptor straight away, and it
+    // shows another texture until the load is finished.  A null Resource means the load failed.
+    void ShowTexture( const Texture& Other );
+    void FinishAsyncLoad( ID3D12Resource* Resource, D3D12_CPU_DESCRIPTOR_HANDLE View );
+    void FinishLoad(void);
+
+    // Used by TextureManager.  Loads the mip tail of a DDS file that can be streamed and streams the rest into
+    // the texture's own descriptor.  Fails, leaving the texture as it was, for any other file.
+    bool CreateStreaming( const std::wstring& FilePath, bool sRGB );
 
 private:
-    std::wstring m_MapKey;        // For deleting from the map later
+    std::wstring m_MapKey;        // The cache knows the texture by a hash of this
+    uint64_t m_CacheKey;
     bool m_IsValid;
+    bool m_IsLoading;                               // Guarded by the texture manager's lock
+    mutable std::vector<LoadCallback> m_OnLoaded;   // Likewise
+    std::unique_ptr<StreamingTexture> m_Streaming;  // Shares the resource and the descriptor with this texture
+};
+
+// Keeps a managed texture in the cache while it is held.  A texture that nothing refers to can be evicted
+// once the cache is over budget (see TextureManager::SetCacheBudget()).
+class TextureRef
+{
+public:
+    TextureRef() : m_Texture(nullptr) {}
+    explicit TextureRef( const ManagedTexture* Texture );
+    TextureRef( const TextureRef& Ref ) : TextureRef(Ref.m_Texture) {}
+    TextureRef( TextureRef&& Ref ) : m_Texture(Ref.m_Texture) { Ref.m_Texture = nullptr; }
+    ~TextureRef();
+
+    TextureRef& operator=( TextureRef Ref ) { std::swap(m_Texture, Ref.m_Texture); return *this; }
+
+    const ManagedTexture* Get( void ) const { return m_Texture; }
+    const ManagedTexture* operator->( void ) const { return m_Texture; }
+    explicit operator bool( void ) const { return m_Texture != nullptr; }
+
+private:
+    const ManagedTexture* m_Texture;
 };
 
 namespace TextureManager
@@ -76,31 +145,64 @@ namespace TextureManager
     void Initialize( const std::wstring& TextureLibRoot );
     void Shutdown(void);
 
-    const ManagedTexture* LoadFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadDDSFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadTGAFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadPIXImageFromFile( const std::wstring& fileName );
+    // These return once the texture has loaded or failed to.  The texture stays cached at least as long as
+    // the reference is held.  LoadFromFile() tries the ".dds" and then the ".tga" file.  DDS files are loaded
+    // whole, with every mip resident.
+    TextureRef LoadFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadDDSFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadTGAFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadPIXImageFromFile( const std::wstring& fileName );
 
-    inline const ManagedTexture* LoadFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadDDSFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadDDSFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadDDSFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadTGAFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadTGAFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadTGAFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadPIXImageFromFile( const std::string& fileName )
+    inline TextureRef LoadPIXImageFromFile( const std::string& fileName )
     {
         return LoadPIXImageFromFile(MakeWStr(fileName));
     }
 
+    // Returns at once with a texture that shows Placeholder (black by default) until the ".dds" or else the
+    // ".tga" file has been read, decoded on an I/O thread and uploaded by Update().  A texture that fails to
+    // load shows magenta.  OnLoaded is as for ManagedTexture::WhenLoaded().  The texture stays cached at least
+    // as long as the reference is held.  A DDS file that can be streamed loads only its mip tail, and
+    // ManagedTexture::GetStreamingTexture() asks for the rest.
+    TextureRef LoadFromFileAsync( const std::wstring& fileName, bool sRGB = false,
+        const ManagedTexture::LoadCallback& OnLoaded = nullptr, IoScheduler::PriorityClass Priority = IoScheduler::kVisible,
+        const Texture* Placeholder = nullptr );
+
+    inline TextureRef LoadFromFileAsync( const std::string& fileName, bool sRGB = false,
+        const ManagedTexture::LoadCallback& OnLoaded = nullptr, IoScheduler::PriorityClass Priority = IoScheduler::kVisible,
+        const Texture* Placeholder = nullptr )
+    {
+        return LoadFromFileAsync(MakeWStr(fileName), sRGB, OnLoaded, Priority, Placeholder);
+    }
+
+    // Uploads the textures decoded since the last call in one command list, up to a per-frame budget, and
+    // finishes their loads.  Also streams the mips of StreamingTextures and destroys evicted textures once the
+    // GPU is done with them.  GameCore calls it once a frame.
+    void Update( void );
+
+    // Used by TextureRef
+    void AddRef( const ManagedTexture* Texture );
+    void Release( const ManagedTexture* Texture );
+
+    // How much memory unreferenced textures may keep taking up.  The default is 1 GB.
+    void SetCacheBudget( uint64_t BudgetBytes );
+    TextureCacheStats GetCacheStats( void );
+
     const Texture& GetBlackTex2D(void);
     const Texture& GetWhiteTex2D(void);
+    const Texture& GetMagentaTex2D(void);
 }
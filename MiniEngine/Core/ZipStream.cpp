@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "ZipStream.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <zlib.h>
+
+using namespace std;
+
+bool ZipStream::Inflate( const uint8_t* Source, size_t SourceSize, vector<uint8_t>& Dest, int& Error,
+    const ChunkCallback& OnChunk, uint32_t ChunkSize )
+{
+    assert(SourceSize <= UINT_MAX && "zlib takes 32-bit sizes");
+
+    Dest.clear();
+
+    // A gzip stream ends with the size of its data modulo 2^32, which makes the first allocation the only
+    // one.  A zlib stream doesn't record its size, so that starts with a guess and grows.
+    size_t ExpectedSize = SourceSize * 4;
+    if (SourceSize >= 18 && Source[0] == 0x1F && Source[1] == 0x8B)
+    {
+        const uint8_t* Trailer = Source + SourceSize - 4;
+        ExpectedSize = (size_t)Trailer[0] | (size_t)Trailer[1] << 8 | (size_t)Trailer[2] << 16 | (size_t)Trailer[3] << 24;
+    }
+
+    // Deflate can't do better than about 1032:1, so a larger size is a corrupt trailer
+    ExpectedSize = min(ExpectedSize, SourceSize * 1032);
+
+    // One byte more than expected lets inflate() reach the end of the stream without running out of room
+    Dest.resize(ExpectedSize + 1);
+
+    z_stream Stream = {};
+    Stream.data_type = Z_BINARY;
+    Stream.total_in = Stream.avail_in = (uInt)SourceSize;
+    Stream.next_in = (Bytef*)Source;
+
+    // 15 window bits, and the +32 tells zlib to detect whether it is gzip or zlib
+    Error = inflateInit2(&Stream, 15 + 32);
+    if (Error != Z_OK)
+    {
+        Dest.clear();
+        return false;
+    }
+
+    size_t TotalOut = 0;
+
+    while (Error == Z_OK)
+    {
+        // The size was wrong:  a zlib stream, several gzip members, or more than 4 GB
+        if (TotalOut == Dest.size())
+            Dest.resize(Dest.size() * 2);
+
+        size_t Room = Dest.size() - TotalOut;
+        if (OnChunk)
+            Room = min(Room, (size_t)ChunkSize);
+        Room = min(Room, (size_t)UINT_MAX);
+
+        Stream.next_out = Dest.data() + TotalOut;
+        Stream.avail_out = (uInt)Room;
+        Error = inflate(&Stream, Z_NO_FLUSH);
+
+        const size_t Produced = Room - Stream.avail_out;
+        if (Produced > 0 && OnChunk)
+            OnChunk(Dest.data() + TotalOut, Produced);
+        TotalOut += Produced;
+    }
+
+    inflateEnd(&Stream);
+
+    // With room to spare, Z_BUF_ERROR means the input ran out before the end of the stream
+    if (Error != Z_STREAM_END || TotalOut == 0)
+    {
+        Dest.clear();
+        return false;
+    }
+
+    Dest.resize(TotalOut);
+    return true;
+}
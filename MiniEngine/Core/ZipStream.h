@@ -0,0 +1,32 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Inflates a whole gzip or zlib stream, such as a "<file>.gz" mapped by ReadFileSync(), in one
+// pass on one thread.  Chunked files (see ChunkedFile.h) are the parallel alternative.  This knows nothing
+// of the engine's file helpers, so it builds and can be checked on any platform.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ZipStream
+{
+    // Receives the output in order, piece by piece.  The bytes stay where they are in Dest.
+    typedef std::function<void (const uint8_t* Data, size_t Size)> ChunkCallback;
+
+    // Decompresses straight into Dest, which is sized from the gzip trailer up front so that it is usually
+    // allocated once.  OnChunk, if given, sees each ChunkSize piece of output as soon as it has been inflated.
+    // Returns false, with the zlib error code in Error, if the stream is corrupt or truncated.
+    bool Inflate( const uint8_t* Source, size_t SourceSize, std::vector<uint8_t>& Dest, int& Error,
+        const ChunkCallback& OnChunk = nullptr, uint32_t ChunkSize = 0x40000 );
+}
@@ -0,0 +1,131 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// This file is deliberately free of pch.h so that it builds on any platform.
+#include "H3DFile.h"
+#include "Hash.h"
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+
+static_assert(sizeof(H3DFile::Header) == 32, "The header is read straight from the file");
+static_assert(sizeof(H3DFile::Section) == 24, "Sections are read straight from the file");
+
+namespace
+{
+    uint64_t AlignUp( uint64_t Value )
+    {
+        return (Value + H3DFile::kSectionAlignment - 1) & ~(uint64_t)(H3DFile::kSectionAlignment - 1);
+    }
+
+    // Everything after the header.  The file is a whole number of pages, so this is a whole number of words.
+    uint64_t HashContents( const uint8_t* Data, uint64_t FileSize )
+    {
+        const uint32_t* Begin = (const uint32_t*)(Data + sizeof(H3DFile::Header));
+        const uint32_t* End = (const uint32_t*)(Data + FileSize);
+        return (uint64_t)Utility::HashRange(Begin, End, 2166136261U);
+    }
+}
+
+bool H3DFile::IsH3DFile( const uint8_t* Data, size_t Size )
+{
+    uint32_t Magic;
+    if (Size < sizeof(Magic))
+        return false;
+
+    memcpy(&Magic, Data, sizeof(Magic));
+    return Magic == kMagic;
+}
+
+bool H3DFile::Parse( const uint8_t* Data, size_t Size, SectionView Sections[kNumSectionTypes], bool VerifyHash )
+{
+    assert(((uintptr_t)Data & 3) == 0);
+
+    memset(Sections, 0, sizeof(SectionView) * kNumSectionTypes);
+
+    if (Size < sizeof(Header))
+        return false;
+
+    Header FileHeader;
+    memcpy(&FileHeader, Data, sizeof(Header));
+
+    if (FileHeader.Magic != kMagic || FileHeader.Version != kVersion || FileHeader.FileSize != Size ||
+        Size % kSectionAlignment != 0 || FileHeader.NumSections > kNumSectionTypes)
+    {
+        return false;
+    }
+
+    const uint64_t TableEnd = sizeof(Header) + FileHeader.NumSections * sizeof(Section);
+    if (TableEnd > Size)
+        return false;
+
+    for (uint32_t i = 0; i < FileHeader.NumSections; ++i)
+    {
+        Section Entry;
+        memcpy(&Entry, Data + sizeof(Header) + i * sizeof(Section), sizeof(Section));
+
+        if (Entry.Type >= kNumSectionTypes || Sections[Entry.Type].Data != nullptr || Entry.ElementSize == 0 ||
+            Entry.Offset % kSectionAlignment != 0 || Entry.Offset < TableEnd || Entry.Offset > Size ||
+            Entry.Size > Size - Entry.Offset || Entry.Size % Entry.ElementSize != 0)
+        {
+            return false;
+        }
+
+        Sections[Entry.Type].Data = Data + Entry.Offset;
+        Sections[Entry.Type].Size = (size_t)Entry.Size;
+        Sections[Entry.Type].ElementSize = Entry.ElementSize;
+    }
+
+    if (VerifyHash && HashContents(Data, Size) != FileHeader.ContentHash)
+        return false;
+
+    return true;
+}
+
+void H3DFile::Write( const SectionView Sections[kNumSectionTypes], vector<uint8_t>& File )
+{
+    uint32_t NumSections = 0;
+    for (uint32_t Type = 0; Type < kNumSectionTypes; ++Type)
+    {
+        if (Sections[Type].Size > 0)
+            ++NumSections;
+    }
+
+    // Lay the sections out behind the table of contents
+    Section Table[kNumSectionTypes];
+    uint64_t Offset = AlignUp(sizeof(Header) + NumSections * sizeof(Section));
+    for (uint32_t Type = 0, i = 0; Type < kNumSectionTypes; ++Type)
+    {
+        const SectionView& Source = Sections[Type];
+        if (Source.Size == 0)
+            continue;
+
+        assert(Source.Data != nullptr && Source.ElementSize > 0 && Source.Size % Source.ElementSize == 0);
+
+        Table[i].Type = Type;
+        Table[i].ElementSize = Source.ElementSize;
+        Table[i].Offset = Offset;
+        Table[i].Size = Source.Size;
+        ++i;
+
+        Offset = AlignUp(Offset + Source.Size);
+    }
+
+    File.assign((size_t)Offset, 0);
+
+    memcpy(File.data() + sizeof(Header), Table, NumSections * sizeof(Section));
+    for (uint32_t i = 0; i < NumSections; ++i)
+        memcpy(File.data() + Table[i].Offset, Sections[Table[i].Type].Data, (size_t)Table[i].Size);
+
+    Header FileHeader = { kMagic, kVersion, NumSections, 0, Offset, HashContents(File.data(), Offset) };
+    memcpy(File.data(), &FileHeader, sizeof(Header));
+}
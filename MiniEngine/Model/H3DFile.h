@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The container of version 2 H3D models, which are loaded by mapping the file and handing the
+// mapped ranges straight to the GPU buffers.  The layout, all little-endian, is
+//
+//     [Header][Section x NumSections][padding]  [section data][padding]  [section data][padding] ...
+//
+// Each section starts on a 4K boundary and is zero-padded to the next one, so every section is page-aligned
+// in a mapping and can be read in whole 16-byte blocks, as SIMDMemCopy() does.  ContentHash covers every
+// byte after the header, table of contents included.  Sections hold the same structs and streams as a
+// version 1 file, whose element sizes are recorded so that a file from a different build of Model is
+// rejected rather than misread.
+//
+// This knows nothing of the Model class, only of sections, so it builds and can be checked on any platform.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace H3DFile
+{
+    static const uint32_t kMagic = 0x32443348;     // "H3D2"
+    static const uint32_t kVersion = 2;
+    static const uint32_t kSectionAlignment = 4096;
+
+    enum SectionType
+    {
+        kModelHeader,
+        kMeshes,
+        kMaterials,
+        kVertexData,
+        kIndexData,
+        kVertexDataDepth,
+        kIndexDataDepth,        // Left out when it would repeat kIndexData
+
+        kNumSectionTypes
+    };
+
+    struct Header
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t NumSections;
+        uint32_t Reserved;
+        uint64_t FileSize;
+        uint64_t ContentHash;
+    };
+
+    struct Section
+    {
+        uint32_t Type;
+        uint32_t ElementSize;   // Of the structs in the section, or 1 for a byte stream
+        uint64_t Offset;        // From the start of the file
+        uint64_t Size;
+    };
+
+    // A section of a file in memory.  Data is null for sections the file doesn't have.
+    struct SectionView
+    {
+        const uint8_t* Data;
+        size_t Size;
+        uint32_t ElementSize;
+    };
+
+    // Whether Data starts like a version 2 file.  Version 1 files have no header, so anything else is taken
+    // to be one of those.
+    bool IsH3DFile( const uint8_t* Data, size_t Size );
+
+    // Checks the header, that every section lies within the file and appears at most once, and, when
+    // VerifyHash is set, the content hash.  Fills Sections, indexed by SectionType.  Data must be 4-byte
+    // aligned, as a mapping is.
+    bool Parse( const uint8_t* Data, size_t Size, SectionView Sections[kNumSectionTypes], bool VerifyHash = true );
+
+    // Lays out the sections in SectionType order and fills in the hash.  Empty sections are left out.
+    void Write( const SectionView Sections[kNumSectionTypes], std::vector<uint8_t>& File );
+}
@@ -22,7 +22,7 @@ Model::Model()
     , m_pIndexData(nullptr)
     , m_pVertexDataDepth(nullptr)
     , m_pIndexDataDepth(nullptr)
-    , m_SRVs(nullptr)
+    , m_Textures(nullptr)
 {
     Clear();
 }
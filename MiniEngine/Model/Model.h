@@ -97,6 +97,14 @@ public:
         attrib_formats
     };
 
+    enum
+    {
+        index_format_uint16 = 0,
+        index_format_uint32,
+
+        index_formats
+    };
+
     struct BoundingBox
     {
         Vector3 min;
@@ -141,6 +149,16 @@ public:
 
         unsigned int vertexDataByteOffsetDepth;
         unsigned int vertexCountDepth;
+
+        // Meshes with more vertices than 16-bit indices can address use 32-bit ones, starting on a 4-byte
+        // boundary.  Both index streams use the same format.  This takes what used to be padding, which was
+        // zero in every file written before it, so older files read as 16-bit.
+        unsigned int indexFormat;
+
+        uint32_t indexSize() const
+        {
+            return indexFormat == index_format_uint32 ? sizeof(uint32_t) : sizeof(uint16_t);
+        }
     };
     Mesh *m_pMesh;
 
@@ -175,13 +193,19 @@ public:
     ByteAddressBuffer m_IndexBuffer;
     uint32_t m_VertexStride;
 
-    // optimized for depth-only rendering
+    // optimized for depth-only rendering.  m_IndexBufferDepth is only created when its indices differ from
+    // m_IndexBuffer's, so draw with GetDepthIndexBuffer().
     unsigned char *m_pVertexDataDepth;
     unsigned char *m_pIndexDataDepth;
     StructuredBuffer m_VertexBufferDepth;
     ByteAddressBuffer m_IndexBufferDepth;
     uint32_t m_VertexStrideDepth;
 
+    const ByteAddressBuffer& GetDepthIndexBuffer() const
+    {
+        return m_IndexBufferDepth.GetResource() != nullptr ? m_IndexBufferDepth : m_IndexBuffer;
+    }
+
     virtual bool Load(const char* filename)
     {
         return LoadH3D(filename);
@@ -192,21 +216,47 @@ public:
         return m_Header.boundingBox;
     }
 
+    // Six SRVs per material, the texture in each slot, and the textures they come from, which stay cached
+    // while the model has them
+    struct TextureTable
+    {
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> SRVs;
+        std::vector<const ManagedTexture*> SlotTextures;
+        std::vector<TextureRef> Textures;
+    };
+
     D3D12_CPU_DESCRIPTOR_HANDLE* GetSRVs( uint32_t materialIdx ) const
     {
-        return m_SRVs + materialIdx * 6;
+        return m_Textures->SRVs.data() + materialIdx * 6;
     }
 
+    // Asks the streamed textures of each material for the mips that a surface MaterialPixels[i] pixels across
+    // would sample, taking the largest size where materials share a texture.  Call it on the thread that calls
+    // TextureManager::Update().
+    void RequestTextureSizes( const std::vector<uint32_t>& MaterialPixels ) const;
+
 protected:
 
+    // Loads either version of H3D file and uploads it, keeping only the meshes and materials in memory.  A
+    // version 2 file is mapped and uploaded from the mapping.
     bool LoadH3D(const char *filename);
+
+    // Reads either version of H3D file into memory without touching the GPU, for tools
+    bool ReadH3D(const char *filename);
+
+    // Always writes version 2 (see H3DFile.h)
     bool SaveH3D(const char *filename) const;
 
+    bool ValidateMeshes();
+    void CreateBuffers(const void* vertexData, const void* indexData, const void* vertexDataDepth, const void* indexDataDepth);
+
     void ComputeMeshBoundingBox(unsigned int meshIndex, BoundingBox &bbox) const;
     void ComputeGlobalBoundingBox(BoundingBox &bbox) const;
     void ComputeAllBoundingBoxes();
 
     void ReleaseTextures();
     void LoadTextures();
-    D3D12_CPU_DESCRIPTOR_HANDLE* m_SRVs;
+
+    // Textures still loading update their slots when they finish, unless the table has been released by then
+    std::shared_ptr<TextureTable> m_Textures;
 };
@@ -14,13 +14,135 @@
 #include "Model.h"
 #include "Utility.h"
 #include "TextureManager.h"
+#include "StreamingTexture.h"
 #include "GraphicsCore.h"
 #include "DescriptorHeap.h"
 #include "CommandContext.h"
+#include "MappedFile.h"
+#include "H3DFile.h"
 #include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+static_assert(sizeof(Model::Mesh) == 336, "Meshes are read straight from the file");
+
+namespace
+{
+    // Checks that the sections of a version 2 file hold what the header says they do
+    bool ValidateSections( const H3DFile::SectionView* Sections )
+    {
+        using namespace H3DFile;
+
+        if (Sections[kModelHeader].Size != sizeof(Model::Header) || Sections[kModelHeader].ElementSize != sizeof(Model::Header))
+            return false;
+
+        Model::Header Header;
+        memcpy(&Header, Sections[kModelHeader].Data, sizeof(Model::Header));
+
+        return Sections[kMeshes].Size == Header.meshCount * sizeof(Model::Mesh) &&
+            (Header.meshCount == 0 || Sections[kMeshes].ElementSize == sizeof(Model::Mesh)) &&
+            Sections[kMaterials].Size == Header.materialCount * sizeof(Model::Material) &&
+            (Header.materialCount == 0 || Sections[kMaterials].ElementSize == sizeof(Model::Material)) &&
+            Sections[kVertexData].Size == Header.vertexDataByteSize &&
+            Sections[kIndexData].Size == Header.indexDataByteSize &&
+            Sections[kVertexDataDepth].Size == Header.vertexDataByteSizeDepth &&
+            (Sections[kIndexDataDepth].Data == nullptr || Sections[kIndexDataDepth].Size == Header.indexDataByteSize);
+    }
+}
 
 bool Model::LoadH3D(const char *filename)
 {
+    ByteView File = MappedFile::Map(MakeWStr(filename));
+    if (File.empty())
+        return false;
+
+    // Version 1 files are read into memory and uploaded from there
+    if (!H3DFile::IsH3DFile(File.data(), File.size()))
+    {
+        File = ByteView();
+
+        if (!ReadH3D(filename))
+            return false;
+
+        CreateBuffers(m_pVertexData, m_pIndexData, m_pVertexDataDepth,
+            memcmp(m_pIndexData, m_pIndexDataDepth, m_Header.indexDataByteSize) == 0 ? nullptr : m_pIndexDataDepth);
+
+        delete [] m_pVertexData;
+        m_pVertexData = nullptr;
+        delete [] m_pIndexData;
+        m_pIndexData = nullptr;
+        delete [] m_pVertexDataDepth;
+        m_pVertexDataDepth = nullptr;
+        delete [] m_pIndexDataDepth;
+        m_pIndexDataDepth = nullptr;
+
+        LoadTextures();
+        return true;
+    }
+
+    H3DFile::SectionView Sections[H3DFile::kNumSectionTypes];
+    if (!H3DFile::Parse(File.data(), File.size(), Sections) || !ValidateSections(Sections))
+        return false;
+
+    Clear();
+
+    // Only the descriptions are copied.  The vertices and indices go straight from the mapping to the GPU.
+    memcpy(&m_Header, Sections[H3DFile::kModelHeader].Data, sizeof(Header));
+    m_pMesh = new Mesh [m_Header.meshCount];
+    m_pMaterial = new Material [m_Header.materialCount];
+    memcpy(m_pMesh, Sections[H3DFile::kMeshes].Data, Sections[H3DFile::kMeshes].Size);
+    memcpy(m_pMaterial, Sections[H3DFile::kMaterials].Data, Sections[H3DFile::kMaterials].Size);
+
+    if (!ValidateMeshes())
+        return false;
+
+    CreateBuffers(Sections[H3DFile::kVertexData].Data, Sections[H3DFile::kIndexData].Data,
+        Sections[H3DFile::kVertexDataDepth].Data, Sections[H3DFile::kIndexDataDepth].Data);
+
+    LoadTextures();
+
+    return true;
+}
+
+bool Model::ReadH3D(const char *filename)
+{
+    Clear();
+
+    ByteView File = MappedFile::Map(MakeWStr(filename));
+    if (File.empty())
+        return false;
+
+    if (H3DFile::IsH3DFile(File.data(), File.size()))
+    {
+        H3DFile::SectionView Sections[H3DFile::kNumSectionTypes];
+        if (!H3DFile::Parse(File.data(), File.size(), Sections) || !ValidateSections(Sections))
+            return false;
+
+        // Without a section of their own, the depth-only indices are the same as the others
+        if (Sections[H3DFile::kIndexDataDepth].Data == nullptr)
+            Sections[H3DFile::kIndexDataDepth] = Sections[H3DFile::kIndexData];
+
+        memcpy(&m_Header, Sections[H3DFile::kModelHeader].Data, sizeof(Header));
+        m_pMesh = new Mesh [m_Header.meshCount];
+        m_pMaterial = new Material [m_Header.materialCount];
+        m_pVertexData = new unsigned char[ m_Header.vertexDataByteSize ];
+        m_pIndexData = new unsigned char[ m_Header.indexDataByteSize ];
+        m_pVertexDataDepth = new unsigned char[ m_Header.vertexDataByteSizeDepth ];
+        m_pIndexDataDepth = new unsigned char[ m_Header.indexDataByteSize ];
+
+        memcpy(m_pMesh, Sections[H3DFile::kMeshes].Data, Sections[H3DFile::kMeshes].Size);
+        memcpy(m_pMaterial, Sections[H3DFile::kMaterials].Data, Sections[H3DFile::kMaterials].Size);
+        memcpy(m_pVertexData, Sections[H3DFile::kVertexData].Data, m_Header.vertexDataByteSize);
+        memcpy(m_pIndexData, Sections[H3DFile::kIndexData].Data, m_Header.indexDataByteSize);
+        memcpy(m_pVertexDataDepth, Sections[H3DFile::kVertexDataDepth].Data, m_Header.vertexDataByteSizeDepth);
+        memcpy(m_pIndexDataDepth, Sections[H3DFile::kIndexDataDepth].Data, m_Header.indexDataByteSize);
+
+        return ValidateMeshes();
+    }
+
+    // A version 1 file is the header followed by each of the arrays in turn
+    File = ByteView();
+
     FILE *file = nullptr;
     if (0 != fopen_s(&file, filename, "rb"))
         return false;
@@ -37,6 +159,40 @@ bool Model::LoadH3D(const char *filename)
     if (m_Header.materialCount > 0)
         if (1 != fread(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_load_fail;
 
+    // Version 1 only had 16-bit indices
+    for (uint32_t meshIndex = 0; meshIndex < m_Header.meshCount; ++meshIndex)
+        m_pMesh[meshIndex].indexFormat = index_format_uint16;
+
+    m_pVertexData = new unsigned char[ m_Header.vertexDataByteSize ];
+    m_pIndexData = new unsigned char[ m_Header.indexDataByteSize ];
+    m_pVertexDataDepth = new unsigned char[ m_Header.vertexDataByteSizeDepth ];
+    m_pIndexDataDepth = new unsigned char[ m_Header.indexDataByteSize ];
+
+    if (m_Header.vertexDataByteSize > 0)
+        if (1 != fread(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_load_fail;
+    if (m_Header.indexDataByteSize > 0)
+        if (1 != fread(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
+
+    if (m_Header.vertexDataByteSizeDepth > 0)
+        if (1 != fread(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_load_fail;
+    if (m_Header.indexDataByteSize > 0)
+        if (1 != fread(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
+
+    ok = ValidateMeshes();
+
+h3d_load_fail:
+
+    if (EOF == fclose(file))
+        ok = false;
+
+    return ok;
+}
+
+bool Model::ValidateMeshes()
+{
+    if (m_Header.meshCount == 0)
+        return false;
+
     m_VertexStride = m_pMesh[0].vertexStride;
     m_VertexStrideDepth = m_pMesh[0].vertexStrideDepth;
 #if _DEBUG
@@ -64,150 +220,161 @@ bool Model::LoadH3D(const char *filename)
     }
 #endif
 
-    m_pVertexData = new unsigned char[ m_Header.vertexDataByteSize ];
-    m_pIndexData = new unsigned char[ m_Header.indexDataByteSize ];
-    m_pVertexDataDepth = new unsigned char[ m_Header.vertexDataByteSizeDepth ];
-    m_pIndexDataDepth = new unsigned char[ m_Header.indexDataByteSize ];
-
-    if (m_Header.vertexDataByteSize > 0)
-        if (1 != fread(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_load_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fread(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
-
-    if (m_Header.vertexDataByteSizeDepth > 0)
-        if (1 != fread(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_load_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fread(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
+    if (m_VertexStride == 0 || m_VertexStrideDepth == 0)
+        return false;
 
-    m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, m_pVertexData);
-    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
-    delete [] m_pVertexData;
-    m_pVertexData = nullptr;
-    delete [] m_pIndexData;
-    m_pIndexData = nullptr;
+    // The index and vertex ranges must lie within their streams, and the material must exist.  The vertex
+    // ranges are checked in 64 bits because a count times a stride can overflow 32.
+    for (uint32_t meshIndex = 0; meshIndex < m_Header.meshCount; ++meshIndex)
+    {
+        const Mesh& mesh = m_pMesh[meshIndex];
+        if (mesh.indexFormat >= index_formats || mesh.indexDataByteOffset % mesh.indexSize() != 0 ||
+            mesh.indexDataByteOffset > m_Header.indexDataByteSize ||
+            mesh.indexCount > (m_Header.indexDataByteSize - mesh.indexDataByteOffset) / mesh.indexSize())
+        {
+            return false;
+        }
 
-    m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
-    m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
-    delete [] m_pVertexDataDepth;
-    m_pVertexDataDepth = nullptr;
-    delete [] m_pIndexDataDepth;
-    m_pIndexDataDepth = nullptr;
+        if ((uint64_t)mesh.vertexDataByteOffset + (uint64_t)mesh.vertexCount * mesh.vertexStride > m_Header.vertexDataByteSize ||
+            (uint64_t)mesh.vertexDataByteOffsetDepth + (uint64_t)mesh.vertexCountDepth * mesh.vertexStrideDepth > m_Header.vertexDataByteSizeDepth)
+        {
+            return false;
+        }
 
-    LoadTextures();
+        if (mesh.materialIndex >= m_Header.materialCount)
+            return false;
+    }
 
-    ok = true;
+    return true;
+}
 
-h3d_load_fail:
+void Model::CreateBuffers(const void* vertexData, const void* indexData, const void* vertexDataDepth, const void* indexDataDepth)
+{
+    m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, vertexData);
+    // The index buffers hold meshes of both index formats.  Views of them pick the format for each mesh.
+    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), indexData);
 
-    if (EOF == fclose(file))
-        ok = false;
+    m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, vertexDataDepth);
 
-    return ok;
+    // Depth-only draws share the index buffer unless their indices differ
+    if (indexDataDepth != nullptr)
+        m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), indexDataDepth);
 }
 
 bool Model::SaveH3D(const char *filename) const
 {
-    FILE *file = nullptr;
-    if (0 != fopen_s(&file, filename, "wb"))
-        return false;
-
-    bool ok = false;
-
-    if (1 != fwrite(&m_Header, sizeof(Header), 1, file)) goto h3d_save_fail;
-
-    if (m_Header.meshCount > 0)
-        if (1 != fwrite(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_save_fail;
-    if (m_Header.materialCount > 0)
-        if (1 != fwrite(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_save_fail;
+    using namespace H3DFile;
 
-    if (m_Header.vertexDataByteSize > 0)
-        if (1 != fwrite(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
+    SectionView Sections[kNumSectionTypes] =
+    {
+        { (const uint8_t*)&m_Header, sizeof(m_Header), sizeof(m_Header) },
+        { (const uint8_t*)m_pMesh, sizeof(Mesh) * m_Header.meshCount, sizeof(Mesh) },
+        { (const uint8_t*)m_pMaterial, sizeof(Material) * m_Header.materialCount, sizeof(Material) },
+        { m_pVertexData, m_Header.vertexDataByteSize, 1 },
+        { m_pIndexData, m_Header.indexDataByteSize, 1 },
+        { m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1 },
+        { m_pIndexDataDepth, m_Header.indexDataByteSize, 1 },
+    };
+
+    // Only store the depth-only indices when they aren't a copy of the others
+    if (m_Header.indexDataByteSize == 0 || memcmp(m_pIndexData, m_pIndexDataDepth, m_Header.indexDataByteSize) == 0)
+        Sections[kIndexDataDepth].Size = 0;
+
+    std::vector<uint8_t> File;
+    H3DFile::Write(Sections, File);
+
+    return MappedFile::WriteAtomic(MakeWStr(filename), File.data(), File.size());
+}
 
-    if (m_Header.vertexDataByteSizeDepth > 0)
-        if (1 != fwrite(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
+void Model::ReleaseTextures()
+{
+    // The textures stay cached until the cache needs the room
+    m_Textures = nullptr;
+}
 
-    ok = true;
+namespace
+{
+    typedef std::weak_ptr<Model::TextureTable> TextureTableRef;
 
-h3d_save_fail:
+    // Points SRV slots at the first of Names, from the Attempt'th, that loads.  The slots show a placeholder
+    // straight away, and each texture that fails to load hands over to the next name.
+    void LoadTextureWithFallbacks( TextureTableRef Table, std::vector<uint32_t> Slots, std::vector<std::string> Names,
+        size_t Attempt, bool sRGB )
+    {
+        std::shared_ptr<Model::TextureTable> Textures = Table.lock();
+        if (Textures == nullptr)
+            return;
 
-    if (EOF == fclose(file))
-        ok = false;
+        TextureRef Texture = TextureManager::LoadFromFileAsync(Names[Attempt], sRGB);
 
-    return ok;
-}
+        for (uint32_t Slot : Slots)
+        {
+            Textures->SRVs[Slot] = Texture->GetSRV();
+            Textures->SlotTextures[Slot] = Texture.Get();
+        }
 
-void Model::ReleaseTextures()
-{
-    /*
-    if (m_Textures != nullptr)
-    {
-        for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
+        if (Attempt + 1 < Names.size())
         {
-            for (int n = 0; n < Material::texCount; n++)
+            Texture->WhenLoaded([=]( const ManagedTexture& Loaded )
             {
-                if (m_Textures[materialIdx * Material::texCount + n])
-                    m_Textures[materialIdx * Material::texCount + n]->Release();
-                m_Textures[materialIdx * Material::texCount + n] = nullptr;
-            }
+                if (!Loaded.IsValid())
+                    LoadTextureWithFallbacks(Table, Slots, Names, Attempt + 1, sRGB);
+            });
         }
-        delete [] m_Textures;
+
+        Textures->Textures.push_back(std::move(Texture));
     }
-    */
 }
 
 void Model::LoadTextures(void)
 {
     ReleaseTextures();
 
-    m_SRVs = new D3D12_CPU_DESCRIPTOR_HANDLE[m_Header.materialCount * 6];
-
-    const ManagedTexture* MatTextures[6] = {};
+    m_Textures = std::make_shared<TextureTable>();
+    m_Textures->SRVs.resize(m_Header.materialCount * 6);
+    m_Textures->SlotTextures.resize(m_Header.materialCount * 6, nullptr);
 
+    // Every texture is read and decoded at once on the I/O threads, and uploaded a frame's worth at a time.
+    // The materials draw with placeholders until then.
     for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
     {
         const Material& pMaterial = m_pMaterial[materialIdx];
+        const uint32_t FirstSlot = materialIdx * 6;
+        const std::string DiffusePath = pMaterial.texDiffusePath;
 
-        // Load diffuse
-        MatTextures[0] = TextureManager::LoadFromFile(pMaterial.texDiffusePath, true);
-        if (!MatTextures[0]->IsValid())
-            MatTextures[0] = TextureManager::LoadFromFile("default", true);
+        // Load diffuse, which also stands in for emissive, lightmap and reflection
+        LoadTextureWithFallbacks(m_Textures, { FirstSlot + 0, FirstSlot + 2, FirstSlot + 4, FirstSlot + 5 },
+            { DiffusePath, "default" }, 0, true);
 
         // Load specular
-        MatTextures[1] = TextureManager::LoadFromFile(pMaterial.texSpecularPath, true);
-        if (!MatTextures[1]->IsValid())
-        {
-            MatTextures[1] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_specular", true);
-            if (!MatTextures[1]->IsValid())
-                MatTextures[1] = TextureManager::LoadFromFile("default_specular", true);
-        }
-
-        // Load emissive
-        //MatTextures[2] = TextureManager::LoadFromFile(pMaterial.texEmissivePath, true);
+        LoadTextureWithFallbacks(m_Textures, { FirstSlot + 1 },
+            { pMaterial.texSpecularPath, DiffusePath + "_specular", "default_specular" }, 0, true);
 
         // Load normal
-        MatTextures[3] = TextureManager::LoadFromFile(pMaterial.texNormalPath, false);
-        if (!MatTextures[3]->IsValid())
-        {
-            MatTextures[3] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_normal", false);
-            if (!MatTextures[3]->IsValid())
-                MatTextures[3] = TextureManager::LoadFromFile("default_normal", false);
-        }
+        LoadTextureWithFallbacks(m_Textures, { FirstSlot + 3 },
+            { pMaterial.texNormalPath, DiffusePath + "_normal", "default_normal" }, 0, false);
+    }
+}
 
-        // Load lightmap
-        //MatTextures[4] = TextureManager::LoadFromFile(pMaterial.texLightmapPath, true);
+void Model::RequestTextureSizes( const std::vector<uint32_t>& MaterialPixels ) const
+{
+    if (m_Textures == nullptr)
+        return;
 
-        // Load reflection
-        //MatTextures[5] = TextureManager::LoadFromFile(pMaterial.texReflectionPath, true);
+    std::unordered_map<StreamingTexture*, uint32_t> Sizes;
 
-        m_SRVs[materialIdx * 6 + 0] = MatTextures[0]->GetSRV();
-        m_SRVs[materialIdx * 6 + 1] = MatTextures[1]->GetSRV();
-        m_SRVs[materialIdx * 6 + 2] = MatTextures[0]->GetSRV();
-        m_SRVs[materialIdx * 6 + 3] = MatTextures[3]->GetSRV();
-        m_SRVs[materialIdx * 6 + 4] = MatTextures[0]->GetSRV();
-        m_SRVs[materialIdx * 6 + 5] = MatTextures[0]->GetSRV();
+    const uint32_t NumMaterials = std::min(m_Header.materialCount, (uint32_t)MaterialPixels.size());
+    for (uint32_t materialIdx = 0; materialIdx < NumMaterials; ++materialIdx)
+    {
+        for (uint32_t Slot = materialIdx * 6; Slot < materialIdx * 6 + 6; ++Slot)
+        {
+            const ManagedTexture* Texture = m_Textures->SlotTextures[Slot];
+            StreamingTexture* Streaming = Texture != nullptr ? Texture->GetStreamingTexture() : nullptr;
+            if (Streaming != nullptr)
+                Sizes[Streaming] = std::max(Sizes[Streaming], MaterialPixels[materialIdx]);
+        }
     }
+
+    for (auto& Size : Sizes)
+        Size.first->RequestSize(Size.second, Size.second);
 }
@@ -54,7 +54,8 @@ bool AssimpModel::Load(const char *filename)
         break;
 
     case format_h3d:
-        rval = LoadH3D(filename);
+        // Either version, which makes converting an H3D to an H3D upgrade it to version 2
+        rval = ReadH3D(filename);
         needToOptimize = false;
         break;
     }
@@ -87,6 +88,19 @@ bool AssimpModel::Save(const char *filename) const
 }
 
 
+template <typename IndexType>
+static void CopyIndices(const aiMesh *srcMesh, IndexType *dstIndex)
+{
+    for (unsigned int f = 0; f < srcMesh->mNumFaces; f++)
+    {
+        assert(srcMesh->mFaces[f].mNumIndices == 3);
+
+        *dstIndex++ = (IndexType)srcMesh->mFaces[f].mIndices[0];
+        *dstIndex++ = (IndexType)srcMesh->mFaces[f].mIndices[1];
+        *dstIndex++ = (IndexType)srcMesh->mFaces[f].mIndices[2];
+    }
+}
+
 bool AssimpModel::LoadAssimp(const char *filename)
 {
     Assimp::Importer importer;
@@ -95,9 +109,10 @@ bool AssimpModel::LoadAssimp(const char *filename)
     importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, 
         aiComponent_COLORS | aiComponent_LIGHTS | aiComponent_CAMERAS);
 
-    // max triangles and vertices per mesh, splits above this threshold
+    // max triangles and vertices per mesh, splits above this threshold.  Meshes too large for 16-bit indices
+    // get 32-bit ones instead of being split.
     importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, INT_MAX);
-    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, 0xfffe); // avoid the primitive restart index
+    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, INT_MAX);
 
     // remove points and lines
     importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
@@ -276,11 +291,22 @@ bool AssimpModel::LoadAssimp(const char *filename)
         dstMesh->vertexDataByteOffset = m_Header.vertexDataByteSize;
         dstMesh->vertexCount = srcMesh->mNumVertices;
 
+        // 16-bit indices up to 0xfffe, which avoids the primitive restart index
+        if (dstMesh->vertexCount <= 0xffff)
+        {
+            dstMesh->indexFormat = index_format_uint16;
+        }
+        else
+        {
+            dstMesh->indexFormat = index_format_uint32;
+            m_Header.indexDataByteSize = (m_Header.indexDataByteSize + 3) & ~3u;
+        }
+
         dstMesh->indexDataByteOffset = m_Header.indexDataByteSize;
         dstMesh->indexCount = srcMesh->mNumFaces * 3;
 
         m_Header.vertexDataByteSize += dstMesh->vertexStride * dstMesh->vertexCount;
-        m_Header.indexDataByteSize += sizeof(uint16_t) * dstMesh->indexCount;
+        m_Header.indexDataByteSize += dstMesh->indexSize() * dstMesh->indexCount;
 
         // depth-only rendering
         dstMesh->vertexDataByteOffsetDepth = m_Header.vertexDataByteSizeDepth;
@@ -293,6 +319,9 @@ bool AssimpModel::LoadAssimp(const char *filename)
     m_pIndexData = new unsigned char [m_Header.indexDataByteSize];
     m_pVertexDataDepth = new unsigned char [m_Header.vertexDataByteSizeDepth];
     m_pIndexDataDepth = new unsigned char [m_Header.indexDataByteSize];
+    // the padding in front of 32-bit indices is saved too
+    memset(m_pIndexData, 0, m_Header.indexDataByteSize);
+    memset(m_pIndexDataDepth, 0, m_Header.indexDataByteSize);
     // second pass, fill in vertex and index data
     for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++)
     {
@@ -384,19 +413,15 @@ bool AssimpModel::LoadAssimp(const char *filename)
             dstBitangent = (float*)((unsigned char*)dstBitangent + dstMesh->vertexStride);
         }
 
-        uint16_t *dstIndex = (uint16_t*)(m_pIndexData + dstMesh->indexDataByteOffset);
-        uint16_t *dstIndexDepth = (uint16_t*)(m_pIndexDataDepth + dstMesh->indexDataByteOffset);
-        for (unsigned int f = 0; f < srcMesh->mNumFaces; f++)
+        if (dstMesh->indexFormat == index_format_uint32)
         {
-            assert(srcMesh->mFaces[f].mNumIndices == 3);
-
-            *dstIndex++ = srcMesh->mFaces[f].mIndices[0];
-            *dstIndex++ = srcMesh->mFaces[f].mIndices[1];
-            *dstIndex++ = srcMesh->mFaces[f].mIndices[2];
-
-            *dstIndexDepth++ = srcMesh->mFaces[f].mIndices[0];
-            *dstIndexDepth++ = srcMesh->mFaces[f].mIndices[1];
-            *dstIndexDepth++ = srcMesh->mFaces[f].mIndices[2];
+            CopyIndices(srcMesh, (uint32_t*)(m_pIndexData + dstMesh->indexDataByteOffset));
+            CopyIndices(srcMesh, (uint32_t*)(m_pIndexDataDepth + dstMesh->indexDataByteOffset));
+        }
+        else
+        {
+            CopyIndices(srcMesh, (uint16_t*)(m_pIndexData + dstMesh->indexDataByteOffset));
+            CopyIndices(srcMesh, (uint16_t*)(m_pIndexDataDepth + dstMesh->indexDataByteOffset));
         }
     }
 
@@ -27,16 +27,25 @@ public:
     static const char *s_FormatString[];
     static int FormatFromFilename(const char *filename);
 
+    AssimpModel() : m_WeldEpsilon(0.0f) {}
+
     virtual bool Load(const char* filename) override;
     bool Save(const char* filename) const;
 
+    // Vertices whose float attributes match to within about this much are merged when a model is optimized.
+    // Zero, the default, only merges identical vertices.
+    void SetWeldEpsilon(float epsilon) { m_WeldEpsilon = epsilon; }
+
 private:
 
     bool LoadAssimp(const char *filename);
 
     void Optimize();
     void OptimizeRemoveDuplicateVertices(bool depth);
+    void OptimizeIndexFormats();
     void OptimizePostTransform(bool depth);
     void OptimizePreTransform(bool depth);
+
+    float m_WeldEpsilon;
 };
 
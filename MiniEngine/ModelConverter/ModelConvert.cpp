@@ -12,15 +12,21 @@
 //
 
 #include "ModelAssimp.h"
+#include "JobSystem.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 
 void PrintHelp()
 {
     printf("model_convert\n");
 
     printf("usage:\n");
-    printf("model_convert input_file output_file\n");
+    printf("model_convert [-weld epsilon] input_file output_file\n");
+    printf("-weld merges vertices whose float attributes are within about epsilon of each other\n");
+    printf("an .h3d input_file from an older version is rewritten in the current one\n");
 }
 
 void PrintModelStats(const Model *model)
@@ -71,6 +77,7 @@ void PrintModelStats(const Model *model)
         printf("mesh %u\n", meshIndex);
         printf("vertices: %u\n", mesh->vertexCount);
         printf("indices: %u\n", mesh->indexCount);
+        printf("index size: %u\n", mesh->indexSize() * 8);
         printf("vertex stride: %u\n", mesh->vertexStride);
         for (int n = 0; n < Model::maxAttribs; n++)
         {
@@ -110,35 +117,60 @@ void PrintModelStats(const Model *model)
     printf("\n");
 }
 
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    float weld_epsilon = 0.0f;
+    int arg = 1;
+
+    if (argc == 5 && strcmp(argv[1], "-weld") == 0)
+    {
+        weld_epsilon = (float)atof(argv[2]);
+        arg = 3;
+    }
+    else if (argc != 3)
     {
         PrintHelp();
         return -1;
     }
 
-    const char *input_file = argv[1];
-    const char *output_file = argv[2];
+    const char *input_file = argv[arg];
+    const char *output_file = argv[arg + 1];
 
     printf("input file %s\n", input_file);
     printf("output file %s\n", output_file);
 
+    // The optimizer welds meshes in parallel
+    JobSystem::Initialize();
+
     AssimpModel model;
+    model.SetWeldEpsilon(weld_epsilon);
 
     printf("loading...\n");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     if (!model.Load(input_file))
     {
         printf("failed to load model: %s\n", input_file);
+        JobSystem::Shutdown();
         return -1;
     }
+    printf("loaded and optimized in %.2f s\n", SecondsSince(start));
 
     printf("saving...\n");
+    start = std::chrono::steady_clock::now();
     if (!model.Save(output_file))
     {
         printf("failed to save model: %s\n", output_file);
+        JobSystem::Shutdown();
         return -1;
     }
+    printf("saved in %.2f s\n", SecondsSince(start));
+
+    JobSystem::Shutdown();
 
     printf("done\n");
 
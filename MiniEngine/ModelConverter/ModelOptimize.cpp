@@ -13,63 +13,136 @@
 
 #include "ModelAssimp.h"
 #include "IndexOptimizePostTransform.h"
+#include "VertexWeld.h"
+#include "JobSystem.h"
 
 #include <string.h>
 
-void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
+namespace
 {
-    unsigned char *deduplicatedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
-    uint32_t deduplicatedVertexDataSize = 0;
+    // The passes below work on one mesh's indices at a time, in whichever format the mesh uses
 
-    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    template <typename IndexType>
+    void RemapIndices(unsigned char *indexData, unsigned int indexCount, const uint32_t *vertexRemap)
     {
-        Mesh *mesh = m_pMesh + meshIndex;
-        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
-        unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
+        IndexType *indexArray = (IndexType*)indexData;
+        for (unsigned int n = 0; n < indexCount; n++)
+        {
+            indexArray[n] = (IndexType)vertexRemap[indexArray[n]];
+        }
+    }
 
-        unsigned char *meshDeduplicatedVertexData = deduplicatedVertexData + deduplicatedVertexDataSize;
-        unsigned int deduplicatedCount = 0;
+    template <typename IndexType>
+    void OptimizeFacesInPlace(unsigned char *indexData, unsigned int indexCount, uint16_t lruCacheSize)
+    {
+        IndexType *srcIndices = new IndexType [indexCount];
+        IndexType *dstIndices = (IndexType*)indexData;
+        memcpy(srcIndices, dstIndices, sizeof(IndexType) * indexCount);
 
-        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
-        uint32_t *vertexRemap = new uint32_t [vertexCount];
-        memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
-        assert(vertexCount <= (uint32_t)-1);
+        OptimizeFaces<IndexType>(srcIndices, indexCount, dstIndices, lruCacheSize);
 
-        for (unsigned int v1 = 0; v1 < vertexCount; v1++)
+        delete [] srcIndices;
+    }
+
+    template <typename SrcIndexType, typename DstIndexType>
+    void ConvertIndices(const unsigned char *srcData, unsigned char *dstData, unsigned int indexCount)
+    {
+        const SrcIndexType *src = (const SrcIndexType*)srcData;
+        DstIndexType *dst = (DstIndexType*)dstData;
+        for (unsigned int n = 0; n < indexCount; n++)
         {
-            if (vertexRemap[v1] != (uint32_t)-1)
-                continue; // this was already found to be a duplicate
+            dst[n] = (DstIndexType)src[n];
+        }
+    }
 
-            const unsigned char *v1Data = meshVertexData + v1 * vertexStride;
+    // The float attributes, which welding with an epsilon rounds.  Returns how many there are.
+    unsigned int GetFloatRanges(const Model::Attrib *attribs, VertexWeld::FloatRange *floatRanges)
+    {
+        unsigned int floatRangeCount = 0;
+        for (unsigned int n = 0; n < Model::maxAttribs; n++)
+        {
+            if (attribs[n].format != Model::attrib_format_float)
+                continue;
 
-            // this is a new unique vertex
-            uint32_t remappedSlot = deduplicatedCount++;
-            vertexRemap[v1] = remappedSlot;
-            memcpy(meshDeduplicatedVertexData + remappedSlot * vertexStride, v1Data, vertexStride);
+            floatRanges[floatRangeCount].offset = attribs[n].offset;
+            floatRanges[floatRangeCount].count = attribs[n].components;
+            floatRangeCount++;
+        }
+        return floatRangeCount;
+    }
 
-            // scan for duplicates
-            for (unsigned int v2 = v1 + 1; v2 < vertexCount; v2++)
-            {
-                if (vertexRemap[v2] != (uint32_t)-1)
-                    continue; // this was already found to be a duplicate of another vertex
+    // Copies vertices in the order the indices first use them, and renumbers the indices to match
+    template <typename IndexType>
+    void ReorderVertices(unsigned char *indexData, unsigned int indexCount, const unsigned char *meshVertexData,
+        unsigned char *meshReorderedVertexData, unsigned int vertexStride, uint32_t *vertexRemap)
+    {
+        IndexType *indexArray = (IndexType*)indexData;
+        unsigned int reorderedCount = 0;
 
-                const unsigned char *v2Data = meshVertexData + v2 * vertexStride;
+        for (unsigned int n = 0; n < indexCount; n++)
+        {
+            IndexType index = indexArray[n];
+            if (vertexRemap[index] == (uint32_t)-1)
+            {
+                // not relocated yet
+                const unsigned char *vSrc = meshVertexData + index * vertexStride;
+                unsigned char *vDst = meshReorderedVertexData + reorderedCount * vertexStride;
+                memcpy(vDst, vSrc, vertexStride);
 
-                if (0 == memcmp(v1Data, v2Data, vertexStride))
-                {
-                    vertexRemap[v2] = remappedSlot;
-                }
+                vertexRemap[index] = reorderedCount;
+                reorderedCount++;
             }
+            indexArray[n] = (IndexType)vertexRemap[index];
         }
+    }
+}
 
-        unsigned int indexCount = mesh->indexCount;
-        uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
-        for (unsigned int n = 0; n < indexCount; n++)
+void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
+{
+    unsigned char *deduplicatedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
+    uint32_t *deduplicatedCounts = new uint32_t [m_Header.meshCount];
+
+    // Each mesh is welded into the space it had, so the meshes can go in parallel
+    JobSystem::g_Scheduler.ParallelFor(0, m_Header.meshCount, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t meshIndex = begin; meshIndex < end; meshIndex++)
         {
-            indexArray[n] = vertexRemap[indexArray[n]];
+            const Mesh *mesh = m_pMesh + meshIndex;
+            unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+            unsigned int vertexDataByteOffset = depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset;
+            unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
+
+            uint32_t *vertexRemap = new uint32_t [vertexCount];
+
+            VertexWeld::FloatRange floatRanges[maxAttribs];
+            unsigned int floatRangeCount = GetFloatRanges(depth ? mesh->attribDepth : mesh->attrib, floatRanges);
+
+            deduplicatedCounts[meshIndex] = VertexWeld::WeldVertices(
+                (depth ? m_pVertexDataDepth : m_pVertexData) + vertexDataByteOffset,
+                deduplicatedVertexData + vertexDataByteOffset, vertexCount, vertexStride,
+                floatRanges, floatRangeCount, m_WeldEpsilon, vertexRemap);
+
+            unsigned char *indexData = (depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset;
+            if (mesh->indexFormat == index_format_uint32)
+                RemapIndices<uint32_t>(indexData, mesh->indexCount, vertexRemap);
+            else
+                RemapIndices<uint16_t>(indexData, mesh->indexCount, vertexRemap);
+
+            delete [] vertexRemap;
         }
+    });
 
-        delete [] vertexRemap;
+    // Close up the gaps the welded vertices left
+    uint32_t deduplicatedVertexDataSize = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+        unsigned int deduplicatedCount = deduplicatedCounts[meshIndex];
+
+        memmove(deduplicatedVertexData + deduplicatedVertexDataSize,
+            deduplicatedVertexData + (depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset),
+            deduplicatedCount * vertexStride);
 
         if (depth)
         {
@@ -84,6 +157,8 @@ void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
         deduplicatedVertexDataSize += deduplicatedCount * vertexStride;
     }
 
+    delete [] deduplicatedCounts;
+
     if (depth)
     {
         delete [] m_pVertexDataDepth;
@@ -106,13 +181,11 @@ void AssimpModel::OptimizePostTransform(bool depth)
     {
         Mesh *mesh = m_pMesh + meshIndex;
 
-        uint16_t *srcIndices = new uint16_t [mesh->indexCount];
-        uint16_t *dstIndices = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
-        memcpy(srcIndices, dstIndices, sizeof(uint16_t) * mesh->indexCount);
-
-        OptimizeFaces<uint16_t>(srcIndices, mesh->indexCount, dstIndices, lruCacheSize);
-
-        delete [] srcIndices;
+        unsigned char *indexData = (depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset;
+        if (mesh->indexFormat == index_format_uint32)
+            OptimizeFacesInPlace<uint32_t>(indexData, mesh->indexCount, lruCacheSize);
+        else
+            OptimizeFacesInPlace<uint16_t>(indexData, mesh->indexCount, lruCacheSize);
     }
 }
 
@@ -123,34 +196,21 @@ void AssimpModel::OptimizePreTransform(bool depth)
     for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
     {
         Mesh *mesh = m_pMesh + meshIndex;
-        unsigned int indexCount = mesh->indexCount;
         unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
         unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
 
         unsigned char *meshReorderedVertexData = reorderedVertexData + (depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset);
-        unsigned int reorderedCount = 0;
 
         unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
         uint32_t *vertexRemap = new uint32_t [vertexCount];
         memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
         assert(vertexCount <= (uint32_t)-1);
 
-        uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
-        for (unsigned int n = 0; n < indexCount; n++)
-        {
-            uint16_t index = indexArray[n];
-            if (vertexRemap[index] == (uint32_t)-1)
-            {
-                // not relocated yet
-                const unsigned char *vSrc = meshVertexData + index * vertexStride;
-                unsigned char *vDst = meshReorderedVertexData + reorderedCount * vertexStride;
-                memcpy(vDst, vSrc, vertexStride);
-
-                vertexRemap[index] = reorderedCount;
-                reorderedCount++;
-            }
-            indexArray[n] = vertexRemap[index];
-        }
+        unsigned char *indexData = (depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset;
+        if (mesh->indexFormat == index_format_uint32)
+            ReorderVertices<uint32_t>(indexData, mesh->indexCount, meshVertexData, meshReorderedVertexData, vertexStride, vertexRemap);
+        else
+            ReorderVertices<uint16_t>(indexData, mesh->indexCount, meshVertexData, meshReorderedVertexData, vertexStride, vertexRemap);
 
         delete [] vertexRemap;
     }
@@ -167,12 +227,69 @@ void AssimpModel::OptimizePreTransform(bool depth)
     }
 }
 
+void AssimpModel::OptimizeIndexFormats()
+{
+    // Meshes whose vertices now fit in 16-bit indices are narrowed, and the index streams repacked to suit
+    uint32_t indexDataByteSize = 0;
+    unsigned int *indexFormat = new unsigned int [m_Header.meshCount];
+    uint32_t *indexDataByteOffset = new uint32_t [m_Header.meshCount];
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+
+        // The depth-only vertices are welded at least as much, so the color ones decide
+        indexFormat[meshIndex] = mesh->vertexCount <= 0xffff ? index_format_uint16 : index_format_uint32;
+        if (indexFormat[meshIndex] == index_format_uint32)
+            indexDataByteSize = (indexDataByteSize + 3) & ~3u;
+
+        indexDataByteOffset[meshIndex] = indexDataByteSize;
+        indexDataByteSize += mesh->indexCount * (indexFormat[meshIndex] == index_format_uint32 ? sizeof(uint32_t) : sizeof(uint16_t));
+    }
+
+    unsigned char *indexData = new unsigned char [indexDataByteSize];
+    unsigned char *indexDataDepth = new unsigned char [indexDataByteSize];
+    memset(indexData, 0, indexDataByteSize);
+    memset(indexDataDepth, 0, indexDataByteSize);
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+
+        for (int depth = 0; depth < 2; depth++)
+        {
+            const unsigned char *src = (depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset;
+            unsigned char *dst = (depth ? indexDataDepth : indexData) + indexDataByteOffset[meshIndex];
+
+            if (mesh->indexFormat == indexFormat[meshIndex])
+                memcpy(dst, src, mesh->indexCount * mesh->indexSize());
+            else if (mesh->indexFormat == index_format_uint32)
+                ConvertIndices<uint32_t, uint16_t>(src, dst, mesh->indexCount);
+            else
+                ConvertIndices<uint16_t, uint32_t>(src, dst, mesh->indexCount);
+        }
+
+        mesh->indexFormat = indexFormat[meshIndex];
+        mesh->indexDataByteOffset = indexDataByteOffset[meshIndex];
+    }
+
+    delete [] indexFormat;
+    delete [] indexDataByteOffset;
+
+    delete [] m_pIndexData;
+    m_pIndexData = indexData;
+    delete [] m_pIndexDataDepth;
+    m_pIndexDataDepth = indexDataDepth;
+    m_Header.indexDataByteSize = indexDataByteSize;
+}
+
 void AssimpModel::Optimize()
 {
     // TODO: quantize/compress vertex data
 
     OptimizeRemoveDuplicateVertices(false);
     OptimizeRemoveDuplicateVertices(true);
+    OptimizeIndexFormats();
 
     // re-order indices for post transform cache
     OptimizePostTransform(false);
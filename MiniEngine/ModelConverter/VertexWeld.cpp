@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// This file is deliberately free of pch.h so that it builds on any platform.
+
+#include "VertexWeld.h"
+#include "Hash.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+uint32_t VertexWeld::WeldVertices(const unsigned char *vertexData, unsigned char *deduplicatedData,
+    unsigned int vertexCount, unsigned int vertexStride, const FloatRange *floatRanges, unsigned int floatRangeCount,
+    float weldEpsilon, uint32_t *vertexRemap)
+{
+    assert(vertexStride % 4 == 0);
+
+    const unsigned char *keys = vertexData;
+    std::vector<unsigned char> roundedKeys;
+
+    if (weldEpsilon > 0.0f && floatRangeCount > 0)
+    {
+        roundedKeys.assign(vertexData, vertexData + (size_t)vertexCount * vertexStride);
+        const float scale = 1.0f / weldEpsilon;
+
+        for (unsigned int n = 0; n < floatRangeCount; n++)
+        {
+            assert(floatRanges[n].offset + floatRanges[n].count * sizeof(float) <= vertexStride);
+
+            for (unsigned int v = 0; v < vertexCount; v++)
+            {
+                float *component = (float*)(roundedKeys.data() + (size_t)v * vertexStride + floatRanges[n].offset);
+                for (unsigned int c = 0; c < floatRanges[n].count; c++)
+                {
+                    // Adding zero turns -0 into +0, which memcmp would otherwise tell apart
+                    component[c] = roundf(component[c] * scale) + 0.0f;
+                }
+            }
+        }
+
+        keys = roundedKeys.data();
+    }
+
+    // Open addressing, at most half full.  Each slot holds the first vertex with its key.
+    uint32_t tableSize = 16;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+
+    const uint32_t emptySlot = (uint32_t)-1;
+    std::vector<uint32_t> table(tableSize, emptySlot);
+    uint32_t deduplicatedCount = 0;
+
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        const unsigned char *key = keys + (size_t)v * vertexStride;
+        size_t hash = Utility::HashRange((const uint32_t*)key, (const uint32_t*)(key + vertexStride), 2166136261U);
+
+        uint32_t slot = (uint32_t)hash & (tableSize - 1);
+        while (table[slot] != emptySlot && 0 != memcmp(keys + (size_t)table[slot] * vertexStride, key, vertexStride))
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] != emptySlot)
+        {
+            vertexRemap[v] = vertexRemap[table[slot]];
+            continue;
+        }
+
+        // this is a new unique vertex
+        table[slot] = v;
+        vertexRemap[v] = deduplicatedCount;
+        memcpy(deduplicatedData + (size_t)deduplicatedCount * vertexStride, vertexData + (size_t)v * vertexStride,
+            vertexStride);
+        deduplicatedCount++;
+    }
+
+    return deduplicatedCount;
+}
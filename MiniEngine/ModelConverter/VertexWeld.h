@@ -0,0 +1,39 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Welds the identical vertices of one mesh, as the model converter does before optimizing its
+// indices.  Vertices are raw bytes here, with the float attributes given as ranges, so nothing depends on
+// Model or Assimp and the welding can be checked on any platform.
+
+#pragma once
+
+#include <cstdint>
+
+namespace VertexWeld
+{
+    // A run of floats at the same place in every vertex
+    struct FloatRange
+    {
+        uint32_t offset;    // In bytes from the start of the vertex
+        uint32_t count;
+    };
+
+    // Copies the first of each set of identical vertices to deduplicatedData, and fills vertexRemap with where
+    // every vertex went.  Returns how many were copied.  The vertices are found in a hash table of the ones
+    // copied so far, keyed on their bytes, which takes linear time where comparing every pair took minutes
+    // on large meshes.
+    //
+    // With a weldEpsilon above zero, the floats in floatRanges are compared after rounding to multiples of it.
+    // That welds vertices that differ only by rounding error in the source, but since the rounding is to a
+    // grid, two vertices closer than weldEpsilon either side of a grid line are kept apart.
+    uint32_t WeldVertices(const unsigned char *vertexData, unsigned char *deduplicatedData, unsigned int vertexCount,
+        unsigned int vertexStride, const FloatRange *floatRanges, unsigned int floatRangeCount, float weldEpsilon,
+        uint32_t *vertexRemap);
+}
@@ -69,6 +69,7 @@ namespace Lighting
     void InitializeResources(void);
     void CreateRandomLights(const Vector3 minBound, const Vector3 maxBound);
     void FillLightGrid(GraphicsContext& gfxContext, const Camera& camera);
+    void FillLightGrid(ComputeContext& Context, const Camera& camera);
     void Shutdown(void);
 }
 
@@ -269,6 +270,22 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
 
     ComputeContext& Context = gfxContext.GetComputeContext();
 
+    ColorBuffer& LinearDepth = g_LinearDepth[ Graphics::GetFrameCount() % 2 ];
+
+    Context.TransitionResource(m_LightBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    Context.TransitionResource(LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    Context.TransitionResource(g_SceneDepthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    Context.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    Context.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    FillLightGrid(Context, camera);
+
+    Context.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    Context.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+void Lighting::FillLightGrid(ComputeContext& Context, const Camera& camera)
+{
     Context.SetRootSignature(m_FillLightRootSig);
 
     switch ((int)LightGridDim)
@@ -282,12 +299,6 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
 
     ColorBuffer& LinearDepth = g_LinearDepth[ Graphics::GetFrameCount() % 2 ];
 
-    Context.TransitionResource(m_LightBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    Context.TransitionResource(LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    Context.TransitionResource(g_SceneDepthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    Context.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    Context.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
     Context.SetDynamicDescriptor(1, 0, m_LightBuffer.GetSRV());
     Context.SetDynamicDescriptor(1, 1, LinearDepth.GetSRV());
     //Context.SetDynamicDescriptor(1, 1, g_SceneDepthBuffer.GetDepthSRV());
@@ -320,7 +331,4 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
     Context.SetDynamicConstantBufferView(0, sizeof(CSConstants), &csConstants);
 
     Context.Dispatch(tileCountX, tileCountY, 1);
-
-    Context.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    Context.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 }
@@ -23,6 +23,7 @@ class ByteAddressBuffer;
 class ColorBuffer;
 class ShadowBuffer;
 class GraphicsContext;
+class ComputeContext;
 class IntVar;
 namespace Math
 {
@@ -52,5 +53,9 @@ namespace Lighting
     void InitializeResources(void);
     void CreateRandomLights(const Math::Vector3 minBound, const Math::Vector3 maxBound);
     void FillLightGrid(GraphicsContext& gfxContext, const Math::Camera& camera);
+
+    // Dispatch only, so that it can run on the async compute queue.  The caller must have m_LightBuffer and
+    // the current linear depth buffer in NON_PIXEL_SHADER_RESOURCE, and both grids in UNORDERED_ACCESS.
+    void FillLightGrid(ComputeContext& Context, const Math::Camera& camera);
     void Shutdown(void);
 }
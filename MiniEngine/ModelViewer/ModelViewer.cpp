@@ -32,6 +32,8 @@
 #include "ShadowCamera.h"
 #include "ParticleEffectManager.h"
 #include "GameInput.h"
+#include "FrameGraph.h"
+#include "ParallelGraphicsContext.h"
 #include "./ForwardPlusLighting.h"
 
 // To enable wave intrinsics, uncomment this macro and #define DXIL in Core/GraphcisCore.cpp.
@@ -70,8 +72,12 @@ private:
     void RenderLightShadows(GraphicsContext& gfxContext);
 
     enum eObjectFilter { kOpaque = 0x1, kCutout = 0x2, kTransparent = 0x4, kAll = 0xF, kNone = 0x0 };
-    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll );
+    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll,
+        uint32_t FirstMesh = 0, uint32_t EndMesh = 0xFFFFFFFFul );
+    void RenderObjectsInParallel( GraphicsContext& Context, const std::function<void (GraphicsContext&)>& SetupState,
+        const Matrix4& ViewProjMat, eObjectFilter Filter );
     void CreateParticleEffects();
+    void RequestTextureDetail( void );
     Camera m_Camera;
     std::auto_ptr<CameraController> m_CameraController;
     Matrix4 m_ViewProjMatrix;
@@ -101,6 +107,8 @@ private:
 
     Vector3 m_SunDirection;
     ShadowCamera m_SunShadow;
+
+    FrameGraph m_FrameGraph;
 };
 
 CREATE_APPLICATION( ModelViewer )
@@ -114,6 +122,9 @@ NumVar ShadowDimY("Application/Lighting/Shadow Dim Y", 3000, 1000, 10000, 100 );
 NumVar ShadowDimZ("Application/Lighting/Shadow Dim Z", 3000, 1000, 10000, 100 );
 
 BoolVar ShowWaveTileCounts("Application/Forward+/Show Wave Tile Counts", false);
+BoolVar AsyncLightGrid("Application/Forward+/Async Light Grid", false);
+BoolVar ParallelRecording("Application/Parallel Recording", true);
+NumVar TexelsPerPixel("Application/Textures/Texels Per Pixel", 2.0f, 0.25f, 16.0f, 0.25f);
 #ifdef _WAVE_OP
 BoolVar EnableWaveOps("Application/Forward+/Enable Wave Ops", true);
 #endif
@@ -255,6 +266,7 @@ void ModelViewer::Startup( void )
 
 void ModelViewer::Cleanup( void )
 {
+    m_FrameGraph.Destroy();
     m_Model.Clear();
     Lighting::Shutdown();
 }
@@ -301,9 +313,37 @@ void ModelViewer::Update( float deltaT )
     m_MainScissor.top = 0;
     m_MainScissor.right = (LONG)g_SceneColorBuffer.GetWidth();
     m_MainScissor.bottom = (LONG)g_SceneColorBuffer.GetHeight();
+
+    RequestTextureDetail();
 }
 
-void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter )
+void ModelViewer::RequestTextureDetail( void )
+{
+    // Each mesh asks for enough texels to cover its bounding sphere as it would look from the camera at the
+    // sphere's nearest point.  There is no frustum test, so turning around doesn't wait on mips.  Textures
+    // tile across a mesh, which this can't see, so every pixel gets a few texels.
+    const float Scale = (float)g_SceneColorBuffer.GetHeight() * TexelsPerPixel / tanf(m_Camera.GetFOV() * 0.5f);
+    const float MaxPixels = (float)D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+    const Vector3 Eye = m_Camera.GetPosition();
+
+    std::vector<uint32_t> MaterialPixels(m_Model.m_Header.materialCount, 0);
+    for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; ++meshIndex)
+    {
+        const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
+        const Vector3 Center = (mesh.boundingBox.min + mesh.boundingBox.max) * 0.5f;
+        const float Radius = Length(mesh.boundingBox.max - mesh.boundingBox.min) * 0.5f;
+        const float Distance = Length(Center - Eye) - Radius;
+
+        const float Pixels = Distance > 0.0f ? std::min(Scale * Radius / Distance, MaxPixels) : MaxPixels;
+        uint32_t& Needed = MaterialPixels[mesh.materialIndex];
+        Needed = std::max(Needed, (uint32_t)Pixels);
+    }
+
+    m_Model.RequestTextureSizes(MaterialPixels);
+}
+
+void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter,
+    uint32_t FirstMesh, uint32_t EndMesh )
 {
     struct VSConstants
     {
@@ -318,15 +358,18 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
     gfxContext.SetDynamicConstantBufferView(0, sizeof(vsConstants), &vsConstants);
 
     uint32_t materialIdx = 0xFFFFFFFFul;
+    uint32_t indexFormat = 0xFFFFFFFFul;
 
     uint32_t VertexStride = m_Model.m_VertexStride;
 
-    for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
+    EndMesh = std::min(EndMesh, m_Model.m_Header.meshCount);
+
+    for (uint32_t meshIndex = FirstMesh; meshIndex < EndMesh; meshIndex++)
     {
         const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
 
         uint32_t indexCount = mesh.indexCount;
-        uint32_t startIndex = mesh.indexDataByteOffset / sizeof(uint16_t);
+        uint32_t startIndex = mesh.indexDataByteOffset / mesh.indexSize();
         uint32_t baseVertex = mesh.vertexDataByteOffset / VertexStride;
 
         if (mesh.materialIndex != materialIdx)
@@ -339,12 +382,41 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
             gfxContext.SetDynamicDescriptors(2, 0, 6, m_Model.GetSRVs(materialIdx) );
         }
 
+        // Meshes are indexed with 16 or 32 bits, so the view is rebound when that changes
+        if (mesh.indexFormat != indexFormat)
+        {
+            indexFormat = mesh.indexFormat;
+            const ByteAddressBuffer& IndexBuffer = m_Model.m_IndexBuffer;
+            gfxContext.SetIndexBuffer(IndexBuffer.IndexBufferView(0, (uint32_t)IndexBuffer.GetBufferSize(),
+                indexFormat == Model::index_format_uint32));
+        }
+
         gfxContext.SetConstants(4, baseVertex, materialIdx);
 
         gfxContext.DrawIndexed(indexCount, startIndex, baseVertex);
     }
 }
 
+// Splits the meshes among the job system's workers, each recording into a command list of its own.
+// SetupState runs at the start of every command list, since none of them inherit the parent's state.
+void ModelViewer::RenderObjectsInParallel( GraphicsContext& gfxContext, const std::function<void (GraphicsContext&)>& SetupState,
+    const Matrix4& ViewProjMat, eObjectFilter Filter )
+{
+    if (!ParallelRecording)
+    {
+        SetupState(gfxContext);
+        RenderObjects(gfxContext, ViewProjMat, Filter);
+        return;
+    }
+
+    ParallelGraphicsContext Parallel(gfxContext);
+    Parallel.Record(m_Model.m_Header.meshCount, [&]( GraphicsContext& Context, uint32_t Begin, uint32_t End )
+    {
+        SetupState(Context);
+        RenderObjects(Context, ViewProjMat, Filter, Begin, End);
+    });
+}
+
 void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
 {
     using namespace Lighting;
@@ -394,8 +466,6 @@ void ModelViewer::RenderScene( void )
 
     GraphicsContext& gfxContext = GraphicsContext::Begin(L"Scene Render");
 
-    ParticleEffects::Update(gfxContext.GetComputeContext(), Graphics::GetFrameTime());
-
     uint32_t FrameIndex = TemporalEffects::GetFrameIndexMod2();
 
     __declspec(align(16)) struct
@@ -423,123 +493,225 @@ void ModelViewer::RenderScene( void )
     psConstants.FirstLightIndex[1] = Lighting::m_FirstConeShadowedLight;
     psConstants.FrameIndexMod2 = FrameIndex;
 
-    // Set the default state for command lists
-    auto& pfnSetupGraphicsState = [&](void)
+    // Set the default state for command lists.  The frame graph may flush between passes, and draws recorded
+    // in parallel land on command lists of their own, so each of those starts with this.  RenderObjects() binds
+    // the index buffer, whose format depends on the mesh.
+    auto& pfnSetupGraphicsState = [&](GraphicsContext& Context)
     {
-        gfxContext.SetRootSignature(m_RootSig);
-        gfxContext.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        gfxContext.SetIndexBuffer(m_Model.m_IndexBuffer.IndexBufferView());
-        gfxContext.SetVertexBuffer(0, m_Model.m_VertexBuffer.VertexBufferView());
+        Context.SetRootSignature(m_RootSig);
+        Context.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        Context.SetVertexBuffer(0, m_Model.m_VertexBuffer.VertexBufferView());
     };
 
-    pfnSetupGraphicsState();
+    // Each pass declares the states it needs, and the frame graph places the transitions between them.  Graphics
+    // passes are handed gfxContext.  The light grid may run on the async compute queue, so it uses the context
+    // it is handed.
+    m_FrameGraph.Reset();
+
+    const uint32_t SceneDepth = m_FrameGraph.Import("Scene Depth", g_SceneDepthBuffer);
+    const uint32_t SceneColor = m_FrameGraph.Import("Scene Color", g_SceneColorBuffer, true);
+    const uint32_t LinearDepth = m_FrameGraph.Import("Linear Depth", g_LinearDepth[FrameIndex]);
+    const uint32_t SSAOBuffer = m_FrameGraph.Import("SSAO Full Res", g_SSAOFullScreen);
+    const uint32_t SunShadowMap = m_FrameGraph.Import("Sun Shadow Map", g_ShadowBuffer);
+    const uint32_t Velocity = m_FrameGraph.Import("Motion Vectors", g_VelocityBuffer);
+    const uint32_t LightBuffer = m_FrameGraph.Import("Light Buffer", Lighting::m_LightBuffer);
+    const uint32_t LightGrid = m_FrameGraph.Import("Light Grid", Lighting::m_LightGrid);
+    const uint32_t LightGridBitMask = m_FrameGraph.Import("Light Grid Bit Mask", Lighting::m_LightGridBitMask);
+    const uint32_t LightShadowArray = m_FrameGraph.Import("Light Shadow Array", Lighting::m_LightShadowArray);
+
+    // Particle simulation state lives inside ParticleEffects, so the update is kept as a side effect
+    m_FrameGraph.AddPass("Update Particles", [&](CommandContext&)
+    {
+        ParticleEffects::Update(gfxContext.GetComputeContext(), Graphics::GetFrameTime());
+    }, FrameGraphCompiler::kGraphicsQueue, true);
 
-    RenderLightShadows(gfxContext);
+    uint32_t Pass = m_FrameGraph.AddPass("Light Shadows", [&](CommandContext&)
+    {
+        pfnSetupGraphicsState(gfxContext);
+        RenderLightShadows(gfxContext);
+    });
+    m_FrameGraph.Write(Pass, LightShadowArray, D3D12_RESOURCE_STATE_COPY_DEST);
 
+    Pass = m_FrameGraph.AddPass("Z PrePass", [&](CommandContext&)
     {
         ScopedTimer _prof(L"Z PrePass", gfxContext);
 
-        gfxContext.SetDynamicConstantBufferView(1, sizeof(psConstants), &psConstants);
+        auto SetupDepthState = [&](GraphicsContext& Context, GraphicsPSO& PSO)
+        {
+            pfnSetupGraphicsState(Context);
+            Context.SetDynamicConstantBufferView(1, sizeof(psConstants), &psConstants);
+            Context.SetPipelineState(PSO);
+            Context.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
+            Context.SetViewportAndScissor(m_MainViewport, m_MainScissor);
+        };
 
         {
             ScopedTimer _prof(L"Opaque", gfxContext);
-            gfxContext.TransitionResource(g_SceneDepthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE, true);
             gfxContext.ClearDepth(g_SceneDepthBuffer);
 
 #ifdef _WAVE_OP
-            gfxContext.SetPipelineState(EnableWaveOps ? m_DepthWaveOpsPSO : m_DepthPSO );
+            GraphicsPSO& DepthPSO = EnableWaveOps ? m_DepthWaveOpsPSO : m_DepthPSO;
 #else
-            gfxContext.SetPipelineState(m_DepthPSO);
+            GraphicsPSO& DepthPSO = m_DepthPSO;
 #endif
-            gfxContext.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
-            gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupDepthState(Context, DepthPSO); },
+                m_ViewProjMatrix, kOpaque);
         }
 
         {
             ScopedTimer _prof(L"Cutout", gfxContext);
-            gfxContext.SetPipelineState(m_CutoutDepthPSO);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kCutout );
+            RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupDepthState(Context, m_CutoutDepthPSO); },
+                m_ViewProjMatrix, kCutout);
         }
-    }
-
-    SSAO::Render(gfxContext, m_Camera);
-
-    Lighting::FillLightGrid(gfxContext, m_Camera);
+    });
+    m_FrameGraph.Write(Pass, SceneDepth, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 
+    Pass = m_FrameGraph.AddPass("SSAO", [&](CommandContext&)
+    {
+        SSAO::Render(gfxContext, m_Camera);
+    });
+    m_FrameGraph.Read(Pass, SceneDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Write(Pass, LinearDepth, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_FrameGraph.Write(Pass, SSAOBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    if (SSAO::DebugDraw)
+        m_FrameGraph.Write(Pass, SceneColor, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    Pass = m_FrameGraph.AddPass("Fill Light Grid", [&](CommandContext& Context)
+    {
+        ScopedTimer _prof(L"FillLightGrid", Context);
+        Lighting::FillLightGrid(Context.GetComputeContext(), m_Camera);
+    }, FrameGraphCompiler::kComputeQueue);
+    m_FrameGraph.Read(Pass, LightBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Read(Pass, LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Write(Pass, LightGrid, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_FrameGraph.Write(Pass, LightGridBitMask, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    // With nothing to read them, the light grid and light shadows are culled while SSAO is being debugged
     if (!SSAO::DebugDraw)
     {
-        ScopedTimer _prof(L"Main Render", gfxContext);
-
-        gfxContext.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, true);
-        gfxContext.ClearColor(g_SceneColorBuffer);
-
-        pfnSetupGraphicsState();
-
+        Pass = m_FrameGraph.AddPass("Sun Shadow Map", [&](CommandContext&)
         {
             ScopedTimer _prof(L"Render Shadow Map", gfxContext);
 
             m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
                 (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
 
+            auto SetupShadowState = [&](GraphicsContext& Context, GraphicsPSO& PSO)
+            {
+                pfnSetupGraphicsState(Context);
+                Context.SetPipelineState(PSO);
+                g_ShadowBuffer.SetAsTarget(Context);
+            };
+
             g_ShadowBuffer.BeginRendering(gfxContext);
-            gfxContext.SetPipelineState(m_ShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kOpaque);
-            gfxContext.SetPipelineState(m_CutoutShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kCutout);
+            RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupShadowState(Context, m_ShadowPSO); },
+                m_SunShadow.GetViewProjMatrix(), kOpaque);
+            RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupShadowState(Context, m_CutoutShadowPSO); },
+                m_SunShadow.GetViewProjMatrix(), kCutout);
             g_ShadowBuffer.EndRendering(gfxContext);
-        }
+        });
+        m_FrameGraph.Write(Pass, SunShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 
-        if (SSAO::AsyncCompute)
+        Pass = m_FrameGraph.AddPass("Render Color", [&](CommandContext&)
         {
-            gfxContext.Flush();
-            pfnSetupGraphicsState();
+            ScopedTimer _prof(L"Render Color", gfxContext);
 
-            // Make the 3D queue wait for the Compute queue to finish SSAO
-            g_CommandManager.GetGraphicsQueue().StallForProducer(g_CommandManager.GetComputeQueue());
-        }
+            if (SSAO::AsyncCompute)
+            {
+                gfxContext.Flush();
 
-        {
-            ScopedTimer _prof(L"Render Color", gfxContext);
+                // Make the 3D queue wait for the Compute queue to finish SSAO
+                g_CommandManager.GetGraphicsQueue().StallForProducer(g_CommandManager.GetComputeQueue());
+            }
 
-            gfxContext.TransitionResource(g_SSAOFullScreen, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+            gfxContext.ClearColor(g_SceneColorBuffer);
+
+            auto SetupColorState = [&](GraphicsContext& Context, GraphicsPSO& PSO)
+            {
+                pfnSetupGraphicsState(Context);
+                Context.SetDynamicDescriptors(3, 0, _countof(m_ExtraTextures), m_ExtraTextures);
+                Context.SetDynamicConstantBufferView(1, sizeof(psConstants), &psConstants);
+                Context.SetPipelineState(PSO);
+                Context.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
+                Context.SetViewportAndScissor(m_MainViewport, m_MainScissor);
+            };
 
-            gfxContext.SetDynamicDescriptors(3, 0, _countof(m_ExtraTextures), m_ExtraTextures);
-            gfxContext.SetDynamicConstantBufferView(1, sizeof(psConstants), &psConstants);
 #ifdef _WAVE_OP
-            gfxContext.SetPipelineState(EnableWaveOps ? m_ModelWaveOpsPSO : m_ModelPSO );
+            GraphicsPSO& ModelPSO = EnableWaveOps ? m_ModelWaveOpsPSO : m_ModelPSO;
 #else
-            gfxContext.SetPipelineState(ShowWaveTileCounts ? m_WaveTileCountPSO : m_ModelPSO);
+            GraphicsPSO& ModelPSO = ShowWaveTileCounts ? m_WaveTileCountPSO : m_ModelPSO;
 #endif
-            gfxContext.TransitionResource(g_SceneDepthBuffer, D3D12_RESOURCE_STATE_DEPTH_READ);
-            gfxContext.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
-            gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-
-            RenderObjects( gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupColorState(Context, ModelPSO); },
+                m_ViewProjMatrix, kOpaque);
 
             if (!ShowWaveTileCounts)
             {
-                gfxContext.SetPipelineState(m_CutoutModelPSO);
-                RenderObjects( gfxContext, m_ViewProjMatrix, kCutout );
+                RenderObjectsInParallel(gfxContext, [&](GraphicsContext& Context) { SetupColorState(Context, m_CutoutModelPSO); },
+                    m_ViewProjMatrix, kCutout);
             }
-        }
-
+        });
+        m_FrameGraph.Read(Pass, SSAOBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, SunShadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, LightBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, LightShadowArray, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_FrameGraph.Read(Pass, SceneDepth, D3D12_RESOURCE_STATE_DEPTH_READ);
+        m_FrameGraph.Write(Pass, SceneColor, D3D12_RESOURCE_STATE_RENDER_TARGET);
     }
 
     // Some systems generate a per-pixel velocity buffer to better track dynamic and skinned meshes.  Everything
     // is static in our scene, so we generate velocity from camera motion and the depth buffer.  A velocity buffer
     // is necessary for all temporal effects (and motion blur).
-    MotionBlur::GenerateCameraVelocityBuffer(gfxContext, m_Camera, true);
+    Pass = m_FrameGraph.AddPass("Camera Velocity", [&](CommandContext&)
+    {
+        MotionBlur::GenerateCameraVelocityBuffer(gfxContext, m_Camera, true);
+    });
+    m_FrameGraph.Read(Pass, LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Write(Pass, Velocity, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-    TemporalEffects::ResolveImage(gfxContext);
+    Pass = m_FrameGraph.AddPass("Temporal Resolve", [&](CommandContext&)
+    {
+        TemporalEffects::ResolveImage(gfxContext);
+    });
+    m_FrameGraph.Read(Pass, LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Read(Pass, Velocity, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Write(Pass, SceneColor, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-    ParticleEffects::Render(gfxContext, m_Camera, g_SceneColorBuffer, g_SceneDepthBuffer,  g_LinearDepth[FrameIndex]);
+    Pass = m_FrameGraph.AddPass("Render Particles", [&](CommandContext&)
+    {
+        ParticleEffects::Render(gfxContext, m_Camera, g_SceneColorBuffer, g_SceneDepthBuffer,  g_LinearDepth[FrameIndex]);
+    });
+    m_FrameGraph.Read(Pass, SceneDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Read(Pass, LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_FrameGraph.Write(Pass, SceneColor, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
     // Until I work out how to couple these two, it's "either-or".
     if (DepthOfField::Enable)
-        DepthOfField::Render(gfxContext, m_Camera.GetNearClip(), m_Camera.GetFarClip());
+    {
+        Pass = m_FrameGraph.AddPass("Depth of Field", [&](CommandContext&)
+        {
+            DepthOfField::Render(gfxContext, m_Camera.GetNearClip(), m_Camera.GetFarClip());
+        });
+        m_FrameGraph.Read(Pass, LinearDepth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    }
     else
-        MotionBlur::RenderObjectBlur(gfxContext, g_VelocityBuffer);
+    {
+        Pass = m_FrameGraph.AddPass("Object Motion Blur", [&](CommandContext&)
+        {
+            MotionBlur::RenderObjectBlur(gfxContext, g_VelocityBuffer);
+        });
+        m_FrameGraph.Read(Pass, Velocity, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    }
+    m_FrameGraph.Write(Pass, SceneColor, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    // The effects above also transition the buffers they own, so a split barrier or a combined read state
+    // chosen by the graph could be undone in the middle of a pass
+    FrameGraphCompileOptions Options;
+    Options.AsyncCompute = AsyncLightGrid;
+    Options.UseSplitBarriers = false;
+    Options.CombineReads = false;
+    m_FrameGraph.Execute(gfxContext, Options);
 
     gfxContext.Finish();
 }
@@ -0,0 +1,428 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Replays barrier traces through BarrierOptimizer.  A small hand-written trace must
+// collapse, combine and split exactly as expected.  Thousands of random traces, with UAV and aliasing
+// barriers mixed in, are optimized under every combination of options, and each schedule has to pass
+// Validate(), keep combined read states inside AllowedStates, and survive a round trip through
+// Write() and Read().  Validate() itself must reject a schedule with a barrier taken out.
+//
+// Then it prints naive against emitted barrier and batch counts, and times Optimize(), for a generated
+// frame of passes or for a trace recorded from CommandContext and given on the command line.  Returns
+// nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core BarrierOptimizerBenchmark.cpp ..\..\Core\BarrierOptimizer.cpp
+//     g++ -std=c++14 -O2 -I../../Core BarrierOptimizerBenchmark.cpp ../../Core/BarrierOptimizer.cpp -o BarrierOptimizerBenchmark
+//
+//     BarrierOptimizerBenchmark [trace.txt]
+
+#include "BarrierOptimizer.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+namespace
+{
+    const BarrierState kRenderTarget = 0x4;
+    const BarrierState kUAV = kBarrierStateUnorderedAccess;
+    const BarrierState kDepthWrite = 0x10;
+    const BarrierState kDepthRead = 0x20;
+    const BarrierState kNonPixelSRV = 0x40;
+    const BarrierState kPixelSRV = 0x80;
+    const BarrierState kCopyDest = 0x400;
+    const BarrierState kCopySource = 0x800;
+
+    const BarrierState kStates[] =
+        { kRenderTarget, kUAV, kNonPixelSRV, kPixelSRV, kCopyDest, kCopySource, kDepthWrite, kDepthRead };
+
+    // D3D12_RESOURCE_STATES that a compute queue accepts
+    const BarrierState kComputeQueueStates = kUAV | kNonPixelSRV | kCopyDest | kCopySource;
+
+    BarrierOptimizerOptions MakeOptions( bool ExplicitAccesses, bool CombineReads, bool UseSplitBarriers,
+        BarrierState AllowedStates = ~0u )
+    {
+        BarrierOptimizerOptions Options;
+        Options.ExplicitAccesses = ExplicitAccesses;
+        Options.CombineReads = CombineReads;
+        Options.UseSplitBarriers = UseSplitBarriers;
+        Options.AllowedStates = AllowedStates;
+        return Options;
+    }
+
+    bool SameEvents( const BarrierTrace& A, const BarrierTrace& B )
+    {
+        const vector<BarrierEvent>& First = A.GetEvents();
+        const vector<BarrierEvent>& Second = B.GetEvents();
+        if (First.size() != Second.size())
+            return false;
+
+        for (size_t i = 0; i < First.size(); ++i)
+        {
+            const BarrierEvent& X = First[i];
+            const BarrierEvent& Y = Second[i];
+            if (X.EventType != Y.EventType || X.Resource != Y.Resource)
+                return false;
+            if (X.EventType == BarrierEvent::kAlias && X.OtherResource != Y.OtherResource)
+                return false;
+            if (X.EventType == BarrierEvent::kRequire && (X.Before != Y.Before || X.After != Y.After))
+                return false;
+        }
+        return true;
+    }
+
+    bool CheckRoundTrip( const BarrierTrace& Trace )
+    {
+        stringstream Text;
+        Trace.Write(Text);
+
+        BarrierTrace Copy;
+        if (!Copy.Read(Text) || !SameEvents(Trace, Copy))
+        {
+            printf("Trace of %zu events differs after Write() and Read()\n", Trace.GetEvents().size());
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckStats( const char* Name, const BarrierOptimizerStats& Stats, uint32_t Emitted, uint32_t Batches,
+        uint32_t Collapsed, uint32_t Combined, uint32_t Split, uint32_t DroppedUAV )
+    {
+        if (Stats.NaiveBarriers != 8 || Stats.NaiveBatches != 6 || Stats.EmittedBarriers != Emitted ||
+            Stats.EmittedBatches != Batches || Stats.CollapsedRequests != Collapsed || Stats.CombinedReads != Combined ||
+            Stats.SplitTransitions != Split || Stats.DroppedUAVBarriers != DroppedUAV)
+        {
+            printf("%s:  naive %u/%u, emitted %u/%u, collapsed %u, combined %u, split %u, dropped UAV %u\n", Name,
+                Stats.NaiveBarriers, Stats.NaiveBatches, Stats.EmittedBarriers, Stats.EmittedBatches,
+                Stats.CollapsedRequests, Stats.CombinedReads, Stats.SplitTransitions, Stats.DroppedUAVBarriers);
+            printf("%s:  expected naive 8/6, emitted %u/%u, collapsed %u, combined %u, split %u, dropped UAV %u\n", Name,
+                Emitted, Batches, Collapsed, Combined, Split, DroppedUAV);
+            return false;
+        }
+        return true;
+    }
+
+    // A render target written and then read by two passes, and a UAV written twice and then read,
+    // with one pass of unrelated work that a split barrier can hide behind
+    bool CheckHandTrace( void )
+    {
+        BarrierTrace Trace;
+        uint32_t Target = Trace.GetResourceId((void*)1);
+        uint32_t Buffer = Trace.GetResourceId((void*)2);
+
+        Trace.RecordTransition(Target, kPixelSRV, kRenderTarget);
+        Trace.RecordWork();
+        Trace.RecordTransition(Buffer, kPixelSRV, kUAV);
+        Trace.RecordWork();
+        Trace.RecordTransition(Buffer, kUAV, kUAV);
+        Trace.RecordWork();
+        Trace.RecordTransition(Target, kRenderTarget, kPixelSRV);
+        Trace.RecordTransition(Target, kPixelSRV, kRenderTarget);
+        Trace.RecordTransition(Target, kRenderTarget, kPixelSRV);
+        Trace.RecordWork();
+        Trace.RecordTransition(Target, kPixelSRV, kNonPixelSRV);
+        Trace.RecordWork();
+        Trace.RecordTransition(Buffer, kUAV, kPixelSRV);
+        Trace.RecordWork();
+
+        BarrierOptimizerStats Stats;
+        string Error;
+
+        // The three requests before the first read collapse to one, the two reads combine into
+        // PIXEL | NON_PIXEL_SHADER_RESOURCE, and the second UAV write keeps its UAV barrier
+        BarrierSchedule Implicit = BarrierOptimizer::Optimize(Trace, MakeOptions(false, true, true), &Stats);
+        if (!BarrierOptimizer::Validate(Trace, Implicit, &Error))
+        {
+            printf("Hand trace, implicit accesses:  %s\n", Error.c_str());
+            return false;
+        }
+        if (!CheckStats("Hand trace, implicit accesses", Stats, 5, 5, 2, 1, 0, 0))
+            return false;
+
+        const vector<OptimizedBarrier>& Combined = Implicit.Batches[3];
+        if (Combined.size() != 1 || Combined[0].After != (kPixelSRV | kNonPixelSRV) || !Implicit.Batches[4].empty())
+        {
+            printf("Hand trace:  the two reads of the render target were not combined\n");
+            return false;
+        }
+
+        // With explicit accesses, the transitions of the buffer and of the render target, and the last
+        // one of the buffer, begin as soon as the previous use ends
+        BarrierSchedule Explicit = BarrierOptimizer::Optimize(Trace, MakeOptions(true, true, true), &Stats);
+        if (!BarrierOptimizer::Validate(Trace, Explicit, &Error))
+        {
+            printf("Hand trace, explicit accesses:  %s\n", Error.c_str());
+            return false;
+        }
+        if (!CheckStats("Hand trace, explicit accesses", Stats, 8, 5, 2, 1, 3, 0))
+            return false;
+
+        // Nothing to combine or split, so only the collapsed requests are saved
+        BarrierOptimizer::Optimize(Trace, MakeOptions(true, false, false), &Stats);
+        if (!CheckStats("Hand trace, no combining or splitting", Stats, 6, 6, 2, 0, 0, 0))
+            return false;
+
+        return CheckRoundTrip(Trace);
+    }
+
+    BarrierTrace MakeRandomTrace( mt19937& Random )
+    {
+        BarrierTrace Trace;
+        const uint32_t NumResources = 1 + Random() % 6;
+        vector<BarrierState> Tracked(NumResources);
+        for (uint32_t i = 0; i < NumResources; ++i)
+        {
+            Trace.GetResourceId((const void*)(uintptr_t)(i + 1));
+            Tracked[i] = kStates[Random() % 8];
+        }
+
+        const uint32_t NumWork = Random() % 30;
+        for (uint32_t Work = 0; Work < NumWork; ++Work)
+        {
+            for (uint32_t Requests = Random() % 4; Requests > 0; --Requests)
+            {
+                uint32_t Resource = Random() % NumResources;
+                uint32_t Kind = Random() % 10;
+                // As CommandContext records them, UAV barriers only name resources in UNORDERED_ACCESS
+                if (Kind == 0 && Tracked[Resource] == kUAV)
+                    Trace.RecordUAVBarrier(Resource);
+                else if (Kind == 1 && NumResources > 1)
+                    Trace.RecordAliasBarrier(Resource, (Resource + 1) % NumResources);
+                else
+                {
+                    BarrierState State = kStates[Random() % 8];
+                    Trace.RecordTransition(Resource, Tracked[Resource], State);
+                    Tracked[Resource] = State;
+                }
+            }
+            Trace.RecordWork();
+        }
+        return Trace;
+    }
+
+    // A combined state is one that no request asked for.  It must not leave AllowedStates.
+    bool CombinedStatesAllowed( const BarrierTrace& Trace, const BarrierSchedule& Schedule, BarrierState AllowedStates )
+    {
+        set<pair<uint32_t, BarrierState>> Requested;
+        for (const BarrierEvent& Event : Trace.GetEvents())
+        {
+            if (Event.EventType == BarrierEvent::kRequire)
+                Requested.insert(make_pair(Event.Resource, Event.After));
+        }
+
+        for (const vector<OptimizedBarrier>& Batch : Schedule.Batches)
+        {
+            for (const OptimizedBarrier& Barrier : Batch)
+            {
+                if ((Barrier.BarrierType == OptimizedBarrier::kTransition || Barrier.BarrierType == OptimizedBarrier::kBeginSplit) &&
+                    Requested.count(make_pair(Barrier.Resource, Barrier.After)) == 0 && (Barrier.After & ~AllowedStates) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Takes out the first transition that precedes some work, so that the work sees the wrong state
+    bool DropFirstTransition( BarrierSchedule& Schedule )
+    {
+        for (size_t Pos = 0; Pos + 1 < Schedule.Batches.size(); ++Pos)
+        {
+            vector<OptimizedBarrier>& Batch = Schedule.Batches[Pos];
+            for (size_t i = 0; i < Batch.size(); ++i)
+            {
+                if (Batch[i].BarrierType == OptimizedBarrier::kTransition)
+                {
+                    Batch.erase(Batch.begin() + i);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool CheckRandomTraces( uint32_t NumTraces, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        uint32_t NumRejected = 0;
+
+        for (uint32_t TraceIndex = 0; TraceIndex < NumTraces; ++TraceIndex)
+        {
+            BarrierTrace Trace = MakeRandomTrace(Random);
+            if (!CheckRoundTrip(Trace))
+                return false;
+
+            for (uint32_t Flags = 0; Flags < 16; ++Flags)
+            {
+                const BarrierState AllowedStates = (Flags & 8) != 0 ? kComputeQueueStates : ~0u;
+                BarrierOptimizerOptions Options = MakeOptions((Flags & 1) != 0, (Flags & 2) != 0, (Flags & 4) != 0, AllowedStates);
+
+                BarrierOptimizerStats Stats;
+                BarrierSchedule Schedule = BarrierOptimizer::Optimize(Trace, Options, &Stats);
+
+                string Error;
+                if (!BarrierOptimizer::Validate(Trace, Schedule, &Error))
+                {
+                    printf("Random trace %u, options %x:  %s\n", TraceIndex, Flags, Error.c_str());
+                    Trace.Write(cout);
+                    return false;
+                }
+
+                if (!CombinedStatesAllowed(Trace, Schedule, AllowedStates))
+                {
+                    printf("Random trace %u, options %x:  a combined read state is outside AllowedStates\n", TraceIndex, Flags);
+                    return false;
+                }
+
+                // Without split barriers, there is never a reason to emit more barriers than CommandContext
+                // would.  Combining reads can move a transition into an earlier batch that had none.
+                const bool Splits = Options.ExplicitAccesses && Options.UseSplitBarriers;
+                if (!Splits && (Stats.EmittedBarriers > Stats.NaiveBarriers ||
+                    (!Options.CombineReads && Stats.EmittedBatches > Stats.NaiveBatches)))
+                {
+                    printf("Random trace %u, options %x:  emitted %u barriers in %u batches, naive %u in %u\n", TraceIndex,
+                        Flags, Stats.EmittedBarriers, Stats.EmittedBatches, Stats.NaiveBarriers, Stats.NaiveBatches);
+                    return false;
+                }
+
+                if (DropFirstTransition(Schedule))
+                {
+                    if (BarrierOptimizer::Validate(Trace, Schedule))
+                    {
+                        printf("Random trace %u, options %x:  Validate() accepted a schedule missing a transition\n", TraceIndex, Flags);
+                        return false;
+                    }
+                    ++NumRejected;
+                }
+            }
+        }
+
+        printf("%u random traces passed under 16 option sets, and Validate() rejected %u broken schedules.\n\n",
+            NumTraces, NumRejected);
+        return true;
+    }
+
+    // A frame of passes:  each pass renders or dispatches into a few targets and reads the outputs of
+    // earlier passes, and draws several times before moving on
+    BarrierTrace MakeFrameTrace( uint32_t NumPasses, uint32_t NumResources, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        BarrierTrace Trace;
+        vector<BarrierState> Tracked(NumResources, kPixelSRV);
+        for (uint32_t i = 0; i < NumResources; ++i)
+            Trace.GetResourceId((const void*)(uintptr_t)(i + 1));
+
+        for (uint32_t Pass = 0; Pass < NumPasses; ++Pass)
+        {
+            const bool Compute = Random() % 3 == 0;
+            const BarrierState WriteState = Compute ? kUAV : kRenderTarget;
+            const BarrierState ReadState = Compute ? kNonPixelSRV : kPixelSRV;
+
+            auto Require = [&]( uint32_t Resource, BarrierState State )
+            {
+                if (Tracked[Resource] == kUAV && State == kUAV)
+                    Trace.RecordUAVBarrier(Resource);
+                else
+                    Trace.RecordTransition(Resource, Tracked[Resource], State);
+                Tracked[Resource] = State;
+            };
+
+            for (uint32_t Writes = 1 + Random() % 2; Writes > 0; --Writes)
+                Require(Random() % NumResources, WriteState);
+            for (uint32_t Reads = Random() % 4; Reads > 0; --Reads)
+            {
+                uint32_t Resource = Random() % NumResources;
+                if (Tracked[Resource] != WriteState)
+                    Require(Resource, ReadState);
+            }
+
+            for (uint32_t Draws = 1 + Random() % 8; Draws > 0; --Draws)
+                Trace.RecordWork();
+        }
+        return Trace;
+    }
+
+    bool ReportTrace( const char* Name, const BarrierTrace& Trace )
+    {
+        printf("%s:  %zu events, %u resources\n\n", Name, Trace.GetEvents().size(), Trace.GetNumResources());
+        printf("%24s %16s %16s %8s %12s\n", "", "Barriers", "Batches", "Split", "Optimize");
+        printf("%24s %16s %16s\n", "", "naive/emitted", "naive/emitted");
+
+        struct Config
+        {
+            const char* Name;
+            BarrierOptimizerOptions Options;
+        };
+
+        const Config kConfigs[] =
+        {
+            { "Implicit accesses",      MakeOptions(false, true, true) },
+            { "Explicit, no splitting", MakeOptions(true, true, false) },
+            { "Explicit accesses",      MakeOptions(true, true, true) },
+        };
+
+        for (const Config& Next : kConfigs)
+        {
+            BarrierOptimizerStats Stats;
+            BarrierSchedule Schedule = BarrierOptimizer::Optimize(Trace, Next.Options, &Stats);
+
+            string Error;
+            if (!BarrierOptimizer::Validate(Trace, Schedule, &Error))
+            {
+                printf("%s, %s:  %s\n", Name, Next.Name, Error.c_str());
+                return false;
+            }
+
+            const uint32_t NumRuns = 20;
+            auto Start = chrono::steady_clock::now();
+            for (uint32_t Run = 0; Run < NumRuns; ++Run)
+                BarrierOptimizer::Optimize(Trace, Next.Options);
+            const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count() / NumRuns;
+
+            printf("%24s %9u/%6u %9u/%6u %8u %9.1f us\n", Next.Name, Stats.NaiveBarriers, Stats.EmittedBarriers,
+                Stats.NaiveBatches, Stats.EmittedBatches, Stats.SplitTransitions, Seconds * 1e6);
+        }
+        printf("\n");
+        return true;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if (!CheckHandTrace())
+        return 1;
+
+    printf("The hand-written trace collapses, combines and splits as expected.\n");
+
+    if (!CheckRandomTraces(3000, 7))
+        return 1;
+
+    if (argc > 1)
+    {
+        ifstream File(argv[1]);
+        BarrierTrace Recorded;
+        if (!File || !Recorded.Read(File))
+        {
+            printf("Could not read a barrier trace from %s\n", argv[1]);
+            return 1;
+        }
+        return ReportTrace(argv[1], Recorded) ? 0 : 1;
+    }
+
+    return ReportTrace("Generated frame of 400 passes", MakeFrameTrace(400, 96, 11)) ? 0 : 1;
+}
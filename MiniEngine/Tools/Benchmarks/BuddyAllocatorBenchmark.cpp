@@ -0,0 +1,267 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks BuddyAllocatorCore against the std::set free lists that BuddyAllocator used to
+// keep, one set of block offsets per order.  Both take the lowest free block of the smallest order that
+// fits and split off right halves, so a random run of allocations and frees must return the same
+// offsets and leave the same free blocks.  Statistics, IsAllocated() and CountFreeUnits() are checked
+// along the way.  Then both are timed on the same run.  Returns nonzero on the first mismatch.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core BuddyAllocatorBenchmark.cpp ..\..\Core\BuddyAllocatorCore.cpp
+//     g++ -std=c++14 -O2 -I../../Core BuddyAllocatorBenchmark.cpp ../../Core/BuddyAllocatorCore.cpp -o BuddyAllocatorBenchmark
+
+#include "BuddyAllocatorCore.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    class ReferenceBuddyAllocator
+    {
+    public:
+        explicit ReferenceBuddyAllocator( uint32_t MaxOrder ) : m_MaxOrder(MaxOrder), m_FreeBlocks(MaxOrder + 1)
+        {
+            m_FreeBlocks[MaxOrder].insert(0);
+        }
+
+        size_t Allocate( uint32_t Order )
+        {
+            if (Order > m_MaxOrder)
+                return BuddyAllocatorCore::kInvalidOffset;
+
+            if (m_FreeBlocks[Order].empty())
+            {
+                size_t Left = Allocate(Order + 1);
+                if (Left == BuddyAllocatorCore::kInvalidOffset)
+                    return Left;
+                m_FreeBlocks[Order].insert(Left + ((size_t)1 << Order));
+                return Left;
+            }
+
+            size_t Offset = *m_FreeBlocks[Order].begin();
+            m_FreeBlocks[Order].erase(m_FreeBlocks[Order].begin());
+            return Offset;
+        }
+
+        void Free( size_t Offset, uint32_t Order )
+        {
+            while (Order < m_MaxOrder)
+            {
+                auto Buddy = m_FreeBlocks[Order].find(Offset ^ ((size_t)1 << Order));
+                if (Buddy == m_FreeBlocks[Order].end())
+                    break;
+                m_FreeBlocks[Order].erase(Buddy);
+                Offset &= ~((size_t)1 << Order);
+                ++Order;
+            }
+            m_FreeBlocks[Order].insert(Offset);
+        }
+
+        size_t CountFreeUnits( size_t Offset, uint32_t Order ) const
+        {
+            const size_t End = Offset + ((size_t)1 << Order);
+            size_t FreeUnits = 0;
+            for (uint32_t Level = 0; Level <= m_MaxOrder; ++Level)
+            {
+                const size_t Size = (size_t)1 << Level;
+                for (size_t Block : m_FreeBlocks[Level])
+                {
+                    size_t First = max(Block, Offset);
+                    size_t Last = min(Block + Size, End);
+                    if (First < Last)
+                        FreeUnits += Last - First;
+                }
+            }
+            return FreeUnits;
+        }
+
+        const vector<set<size_t>>& GetFreeBlocks( void ) const { return m_FreeBlocks; }
+
+    private:
+        uint32_t m_MaxOrder;
+        vector<set<size_t>> m_FreeBlocks;
+    };
+
+    bool SameFreeBlocks( const BuddyAllocatorCore& Allocator, const ReferenceBuddyAllocator& Reference )
+    {
+        vector<set<size_t>> FreeBlocks(Allocator.GetMaxOrder() + 1);
+        Allocator.ForEachFreeBlock([&]( size_t Offset, uint32_t Order ) { FreeBlocks[Order].insert(Offset); });
+        return FreeBlocks == Reference.GetFreeBlocks();
+    }
+
+    bool CheckRandomRun( uint32_t MaxOrder, uint32_t MaxRequestOrder, uint32_t NumSteps, uint32_t Seed )
+    {
+        BuddyAllocatorCore Allocator(MaxOrder);
+        ReferenceBuddyAllocator Reference(MaxOrder);
+        map<size_t, uint32_t> Live;
+        mt19937 Random(Seed);
+
+        for (uint32_t Step = 0; Step < NumSteps; ++Step)
+        {
+            if (Live.empty() || Random() % 100 < 55)
+            {
+                // Mostly small requests, with the occasional one that can't fit
+                uint32_t Order = Random() % 8 == 0 ? Random() % (MaxOrder + 2) : Random() % (MaxRequestOrder + 1);
+                size_t Offset = Allocator.Allocate(Order);
+                size_t Expected = Reference.Allocate(Order);
+                if (Offset != Expected)
+                {
+                    printf("Allocate(%u) differs at step %u:  %zx, expected %zx\n", Order, Step, Offset, Expected);
+                    return false;
+                }
+                if (Offset == BuddyAllocatorCore::kInvalidOffset)
+                    continue;
+                if (!Allocator.IsAllocated(Offset, Order) || Live.count(Offset) > 0)
+                {
+                    printf("Block %zx of order %u is not marked allocated at step %u\n", Offset, Order, Step);
+                    return false;
+                }
+                Live[Offset] = Order;
+            }
+            else
+            {
+                auto Iter = Live.begin();
+                advance(Iter, Random() % Live.size());
+                Allocator.Free(Iter->first, Iter->second);
+                Reference.Free(Iter->first, Iter->second);
+                Live.erase(Iter);
+            }
+
+            if (Step % 97 == 0)
+            {
+                if (!SameFreeBlocks(Allocator, Reference))
+                {
+                    printf("Free blocks differ at step %u\n", Step);
+                    return false;
+                }
+
+                uint32_t Order = Random() % (MaxOrder + 1);
+                size_t Offset = (Random() % ((size_t)1 << (MaxOrder - Order))) << Order;
+                size_t FreeUnits = Allocator.CountFreeUnits(Offset, Order);
+                if (FreeUnits != Reference.CountFreeUnits(Offset, Order))
+                {
+                    printf("CountFreeUnits(%zx, %u) differs at step %u:  %zu, expected %zu\n", Offset, Order, Step,
+                        FreeUnits, Reference.CountFreeUnits(Offset, Order));
+                    return false;
+                }
+
+                size_t UsedUnits = 0, LargestFreeUnits = 0, NumFreeBlocks = 0;
+                for (auto& Block : Live)
+                    UsedUnits += (size_t)1 << Block.second;
+                for (uint32_t Level = 0; Level <= MaxOrder; ++Level)
+                {
+                    NumFreeBlocks += Reference.GetFreeBlocks()[Level].size();
+                    if (!Reference.GetFreeBlocks()[Level].empty())
+                        LargestFreeUnits = (size_t)1 << Level;
+                }
+
+                BuddyAllocatorStats Stats = Allocator.GetStats();
+                if (Stats.UsedUnits != UsedUnits || Stats.NumAllocations != Live.size() ||
+                    Stats.LargestFreeUnits != LargestFreeUnits || Stats.NumFreeBlocks != NumFreeBlocks)
+                {
+                    printf("Statistics differ at step %u\n", Step);
+                    return false;
+                }
+            }
+        }
+
+        // Freeing everything must merge back into the one block it started as
+        for (auto& Block : Live)
+        {
+            Allocator.Free(Block.first, Block.second);
+            Reference.Free(Block.first, Block.second);
+        }
+
+        BuddyAllocatorStats Stats = Allocator.GetStats();
+        if (!SameFreeBlocks(Allocator, Reference) || Stats.NumFreeBlocks != 1 || Stats.LargestFreeUnits != Stats.TotalUnits)
+        {
+            printf("Freeing every block of order %u did not leave one free block\n", MaxOrder);
+            return false;
+        }
+        return true;
+    }
+
+    // A steady state of Live blocks with one free and one allocation per step, as a frame's worth of
+    // buffers would churn
+    struct Request
+    {
+        uint32_t Order;
+        uint32_t FreeSlot;
+    };
+
+    template <typename Allocator>
+    double MeasureNsPerOp( Allocator& Heap, const vector<Request>& Requests, size_t NumLive, size_t& Sink )
+    {
+        vector<pair<size_t, uint32_t>> Live;
+        for (size_t i = 0; i < NumLive; ++i)
+            Live.emplace_back(Heap.Allocate(Requests[i].Order), Requests[i].Order);
+
+        auto Start = chrono::steady_clock::now();
+        for (size_t i = NumLive; i < Requests.size(); ++i)
+        {
+            pair<size_t, uint32_t>& Slot = Live[Requests[i].FreeSlot];
+            Heap.Free(Slot.first, Slot.second);
+            Slot = make_pair(Heap.Allocate(Requests[i].Order), Requests[i].Order);
+            Sink += Slot.first;
+        }
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+
+        return Seconds * 1e9 / (2.0 * (Requests.size() - NumLive));
+    }
+}
+
+int main( void )
+{
+    // Orders that fit a single bit tree word, two levels, and four levels
+    static const uint32_t kMaxOrders[] = { 6, 12, 20 };
+
+    for (uint32_t MaxOrder : kMaxOrders)
+    {
+        for (uint32_t Seed = 1; Seed <= 4; ++Seed)
+        {
+            if (!CheckRandomRun(MaxOrder, min(MaxOrder, 5u), 20000, Seed))
+                return 1;
+        }
+    }
+
+    printf("Allocate(), Free(), IsAllocated(), CountFreeUnits() and statistics match the reference.\n\n");
+
+    // Allocate() never fails here, because the live blocks can't add up to more than half the range
+    const uint32_t MaxOrder = 20;
+    const size_t NumLive = 8192;
+    mt19937 Random(7);
+    vector<Request> Requests(1 << 21);
+    for (Request& Next : Requests)
+    {
+        Next.Order = Random() % 6;
+        Next.FreeSlot = Random() % NumLive;
+    }
+
+    size_t Sink = 0;
+    BuddyAllocatorCore Allocator(MaxOrder);
+    ReferenceBuddyAllocator Reference(MaxOrder);
+    double BitTreeNs = MeasureNsPerOp(Allocator, Requests, NumLive, Sink);
+    double SetNs = MeasureNsPerOp(Reference, Requests, NumLive, Sink);
+
+    printf("%zu live blocks of 1-32 units in 2^%u:  bit trees %.1f ns/op, std::set %.1f ns/op\n",
+        NumLive, MaxOrder, BitTreeNs, SetNs);
+
+    // Printed so that the work can't be optimized away
+    printf("\n(%zx)\n", Sink);
+    return 0;
+}
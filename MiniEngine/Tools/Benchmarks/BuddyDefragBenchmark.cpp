@@ -0,0 +1,372 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Drives BuddyDefragSimulator.  Given a trace file (see BuddyDefragmenter.h for the format)
+// it replays that trace.  Otherwise it generates two:  steady churn, which buddy allocation keeps compact
+// by itself, and a level switch that leaves a scattered third of the heap live before streaming in large
+// blocks, which is the pattern that strands free space.  Each trace is replayed with defragmentation off
+// and with a range of per-frame budgets under both region policies.
+//
+// Before that, it plans moves directly against a BuddyAllocatorCore with a shadow copy of every unit
+// and checks that no destination overlaps live data, that each handle is moved from where it was, that
+// emptying a region really does produce a free block of the target order, and that a region inside a
+// larger live block is never chosen.  It returns nonzero if any of those fail, or if defragmenting the
+// level switch doesn't cut the failed allocations.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core BuddyDefragBenchmark.cpp ..\..\Core\BuddyDefragmenter.cpp ..\..\Core\BuddyAllocatorCore.cpp
+//     g++ -std=c++14 -O2 -I../../Core BuddyDefragBenchmark.cpp ../../Core/BuddyDefragmenter.cpp ../../Core/BuddyAllocatorCore.cpp -o BuddyDefragBenchmark
+//     BuddyDefragBenchmark [trace.txt [max order]]
+
+#include "BuddyDefragmenter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    struct ShadowBlock
+    {
+        size_t Offset;
+        uint32_t Order;
+    };
+
+    bool Claim( vector<int>& Owner, size_t Offset, uint32_t Order, int Id )
+    {
+        for (size_t Unit = Offset; Unit < Offset + ((size_t)1 << Order); ++Unit)
+        {
+            if (Owner[Unit] != -1)
+                return false;
+            Owner[Unit] = Id;
+        }
+        return true;
+    }
+
+    void Release( vector<int>& Owner, size_t Offset, uint32_t Order )
+    {
+        fill(Owner.begin() + Offset, Owner.begin() + Offset + ((size_t)1 << Order), -1);
+    }
+
+    // Scatters order-0 blocks across the range, then plans with a small budget until a block of
+    // TargetOrder can be allocated, freeing each step's sources before the next as a caller would.
+    bool CheckPlanning( uint32_t MaxOrder, uint32_t TargetOrder, size_t BudgetUnits, uint32_t Seed )
+    {
+        BuddyAllocatorCore Allocator(MaxOrder);
+        BuddyDefragmenter Defragmenter;
+        vector<int> Owner((size_t)1 << MaxOrder, -1);
+        vector<ShadowBlock> Blocks;
+        mt19937 Random(Seed);
+
+        for (size_t Offset; (Offset = Allocator.Allocate(0)) != BuddyAllocatorCore::kInvalidOffset; )
+        {
+            Blocks.push_back(ShadowBlock{ Offset, 0 });
+            Claim(Owner, Offset, 0, (int)Blocks.size() - 1);
+        }
+
+        // Keep a third of them, which leaves no aligned run of more than a few free units
+        for (size_t Id = 0; Id < Blocks.size(); ++Id)
+        {
+            if (Random() % 3 != 0)
+            {
+                Allocator.Free(Blocks[Id].Offset, 0);
+                Release(Owner, Blocks[Id].Offset, 0);
+                Blocks[Id].Order = ~0u;
+            }
+            else
+                Defragmenter.TrackAllocation(Blocks[Id].Offset, 0, &Blocks[Id]);
+        }
+
+        vector<BuddyRelocation> Moves;
+        for (uint32_t Step = 0; ; ++Step)
+        {
+            if (Step > ((size_t)1 << MaxOrder))
+            {
+                printf("PlanStep() made no progress towards order %u\n", TargetOrder);
+                return false;
+            }
+
+            Moves.clear();
+            if (Defragmenter.PlanStep(Allocator, TargetOrder, BudgetUnits, Moves))
+                break;
+
+            size_t UnitsMoved = 0;
+            for (const BuddyRelocation& Move : Moves)
+            {
+                ShadowBlock& Block = *(ShadowBlock*)Move.Handle;
+                const int Id = (int)(&Block - Blocks.data());
+                if (Block.Offset != Move.SrcOffset || Block.Order != Move.Order)
+                {
+                    printf("Move of block %d is from %zx, but it lives at %zx\n", Id, Move.SrcOffset, Block.Offset);
+                    return false;
+                }
+                if (!Claim(Owner, Move.DstOffset, Move.Order, Id))
+                {
+                    printf("Move of block %d to %zx overlaps live data\n", Id, Move.DstOffset);
+                    return false;
+                }
+                Block.Offset = Move.DstOffset;
+                UnitsMoved += (size_t)1 << Move.Order;
+            }
+
+            if (UnitsMoved > BudgetUnits && Moves.size() > 1)
+            {
+                printf("Step %u moved %zu units with a budget of %zu\n", Step, UnitsMoved, BudgetUnits);
+                return false;
+            }
+
+            // The copies are done, so the sources go back
+            for (const BuddyRelocation& Move : Moves)
+            {
+                Release(Owner, Move.SrcOffset, Move.Order);
+                Allocator.Free(Move.SrcOffset, Move.Order);
+            }
+        }
+
+        size_t Offset = Allocator.Allocate(TargetOrder);
+        if (Offset == BuddyAllocatorCore::kInvalidOffset || !Claim(Owner, Offset, TargetOrder, -2))
+        {
+            printf("PlanStep() reported a free block of order %u that isn't there\n", TargetOrder);
+            return false;
+        }
+        return true;
+    }
+
+    // A block larger than the target fills the low half and scattered units the high half.  The regions
+    // inside the large block hold nothing to move, but emptying them is impossible.
+    bool CheckLargeBlockSkipped( BuddyDefragmenter::RegionPolicy Policy )
+    {
+        BuddyAllocatorCore Allocator(4);
+        BuddyDefragmenter Defragmenter;
+        Defragmenter.Policy = Policy;
+        ShadowBlock Blocks[9];
+
+        Blocks[8] = ShadowBlock{ Allocator.Allocate(3), 3 };
+        Defragmenter.TrackAllocation(Blocks[8].Offset, 3, &Blocks[8]);
+        for (int i = 0; i < 8; ++i)
+            Blocks[i] = ShadowBlock{ Allocator.Allocate(0), 0 };
+        for (int i = 0; i < 8; ++i)
+        {
+            if (i % 2 == 0)
+                Defragmenter.TrackAllocation(Blocks[i].Offset, 0, &Blocks[i]);
+            else
+                Allocator.Free(Blocks[i].Offset, 0);
+        }
+
+        vector<BuddyRelocation> Moves;
+        for (int Step = 0; Step < 8; ++Step)
+        {
+            Moves.clear();
+            if (Defragmenter.PlanStep(Allocator, 2, 1, Moves))
+                return true;
+            for (const BuddyRelocation& Move : Moves)
+                Allocator.Free(Move.SrcOffset, Move.Order);
+        }
+
+        printf("PlanStep() chose a region inside a larger live block\n");
+        return false;
+    }
+
+    // A level's worth of single units fills the heap, and unloading it leaves a random third of them
+    // behind.  The next level then streams in one block of LargeUnits every four frames.  There is room for
+    // all of them, but hardly any aligned run is free.
+    string GenerateLevelSwitch( uint32_t MaxOrder, size_t NumLarge, size_t LargeUnits, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        ostringstream Trace;
+        const uint32_t NumSmall = 1u << MaxOrder;
+
+        Trace << "# Level switch:  " << NumSmall << " units, then " << NumLarge << " blocks of " << LargeUnits << "\n";
+        for (uint32_t Id = 0; Id < NumSmall; ++Id)
+            Trace << "a " << Id << " 1\n";
+        Trace << "e\n";
+
+        for (uint32_t Id = 0; Id < NumSmall; ++Id)
+        {
+            if (Random() % 3 != 0)
+                Trace << "f " << Id << "\n";
+        }
+        Trace << "e\n";
+
+        // Frees take a few frames to land, so leave time between requests as a streamer would
+        for (size_t i = 0; i < NumLarge; ++i)
+            Trace << "a " << NumSmall + i << " " << LargeUnits << "\ne\ne\ne\ne\n";
+
+        return Trace.str();
+    }
+
+    // Blocks of 1-8 units come and go every frame while the heap sits around 40% full, and a block of
+    // LargeUnits is held for a few frames now and then.  Buddy allocation keeps this compact on its own,
+    // so the defragmenter should rarely have anything to do.
+    string GenerateChurn( uint32_t MaxOrder, size_t NumFrames, size_t LargeUnits, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        ostringstream Trace;
+        vector<uint32_t> Small;
+        vector<pair<uint32_t, size_t>> Large;   // Id and the frame it is freed
+        vector<size_t> UnitsOf;
+        const size_t TargetUnits = ((size_t)1 << MaxOrder) * 2 / 5;
+        size_t SmallUnits = 0;
+
+        Trace << "# Churn:  " << NumFrames << " frames\n";
+        for (size_t Frame = 0; Frame < NumFrames; ++Frame)
+        {
+            for (int i = 0; i < 24; ++i)
+            {
+                if (SmallUnits < TargetUnits || Random() % 2 == 0)
+                {
+                    size_t Units = 1 + Random() % 8;
+                    Trace << "a " << UnitsOf.size() << " " << Units << "\n";
+                    Small.push_back((uint32_t)UnitsOf.size());
+                    UnitsOf.push_back(Units);
+                    SmallUnits += Units;
+                }
+                if (SmallUnits >= TargetUnits)
+                {
+                    size_t Index = Random() % Small.size();
+                    Trace << "f " << Small[Index] << "\n";
+                    SmallUnits -= UnitsOf[Small[Index]];
+                    Small[Index] = Small.back();
+                    Small.pop_back();
+                }
+            }
+
+            if (Frame % 16 == 0)
+            {
+                Trace << "a " << UnitsOf.size() << " " << LargeUnits << "\n";
+                Large.emplace_back((uint32_t)UnitsOf.size(), Frame + 20);
+                UnitsOf.push_back(LargeUnits);
+            }
+            for (size_t i = 0; i < Large.size(); )
+            {
+                if (Large[i].second == Frame)
+                {
+                    Trace << "f " << Large[i].first << "\n";
+                    Large[i] = Large.back();
+                    Large.pop_back();
+                }
+                else
+                    ++i;
+            }
+
+            Trace << "e\n";
+        }
+        return Trace.str();
+    }
+
+    void PrintReplays( const vector<BuddyTraceEvent>& Trace, uint32_t MaxOrder, BuddyDefragSimStats* Baseline,
+        BuddyDefragSimStats* Best )
+    {
+        static const size_t kBudgets[] = { 0, 4, 16, 64, 256 };
+        static const char* kPolicyNames[] = { "fewest moved", "highest address" };
+
+        printf("%16s %8s %8s %10s %12s %10s %10s\n", "Policy", "Budget", "Failed", "Moves", "Units moved", "Avg frag", "Peak frag");
+        for (int Policy = 0; Policy < 2; ++Policy)
+        {
+            for (size_t Budget : kBudgets)
+            {
+                if (Budget == 0 && Policy > 0)
+                    continue;
+
+                BuddyDefragSimStats Stats = BuddyDefragSimulator::Replay(Trace, MaxOrder, Budget, 3,
+                    (BuddyDefragmenter::RegionPolicy)Policy);
+
+                printf("%16s %8zu %8zu %10llu %12llu %10.2f %10.2f\n", Budget == 0 ? "off" : kPolicyNames[Policy],
+                    Budget, Stats.NumFailedAllocations, (unsigned long long)Stats.NumMoves,
+                    (unsigned long long)Stats.UnitsMoved, Stats.AverageFragmentation, Stats.PeakFragmentation);
+
+                if (Budget == 0)
+                    *Baseline = Stats;
+                else if (Stats.NumFailedAllocations < Best->NumFailedAllocations)
+                    *Best = Stats;
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main( int argc, char** argv )
+{
+    static const uint32_t kTargetOrders[] = { 3, 5, 7 };
+    for (uint32_t TargetOrder : kTargetOrders)
+    {
+        for (uint32_t Seed = 1; Seed <= 3; ++Seed)
+        {
+            if (!CheckPlanning(10, TargetOrder, 8, Seed))
+                return 1;
+        }
+    }
+    if (!CheckLargeBlockSkipped(BuddyDefragmenter::kFewestUnitsMoved) || !CheckLargeBlockSkipped(BuddyDefragmenter::kHighestAddress))
+        return 1;
+    printf("Planned moves never overlap live data and always end in a free block of the target order.\n\n");
+
+    vector<BuddyTraceEvent> Trace;
+    BuddyDefragSimStats Baseline = {}, Best = {};
+    Best.NumFailedAllocations = ~(size_t)0;
+
+    if (argc > 1)
+    {
+        ifstream File(argv[1]);
+        if (!File || !BuddyDefragSimulator::ParseTrace(File, Trace))
+        {
+            printf("Could not read a trace from %s\n", argv[1]);
+            return 1;
+        }
+        uint32_t MaxOrder = argc > 2 ? (uint32_t)atoi(argv[2]) : 16;
+        printf("%s, 2^%u units:\n", argv[1], MaxOrder);
+        PrintReplays(Trace, MaxOrder, &Baseline, &Best);
+        return 0;
+    }
+
+    // A malformed line must be rejected rather than skipped
+    istringstream Malformed("a 1 4\nx 2\ne\n");
+    if (BuddyDefragSimulator::ParseTrace(Malformed, Trace))
+    {
+        printf("ParseTrace() accepted a malformed line\n");
+        return 1;
+    }
+
+    const uint32_t MaxOrder = 12;
+
+    istringstream Generated(GenerateChurn(MaxOrder, 2000, 512, 7));
+    Trace.clear();
+    if (!BuddyDefragSimulator::ParseTrace(Generated, Trace))
+    {
+        printf("ParseTrace() rejected the generated trace\n");
+        return 1;
+    }
+    printf("Steady churn, 2^%u units, blocks of 512 held for 20 frames:\n", MaxOrder);
+    PrintReplays(Trace, MaxOrder, &Baseline, &Best);
+
+    Generated.clear();
+    Generated.str(GenerateLevelSwitch(MaxOrder, 32, 64, 7));
+    Trace.clear();
+    if (!BuddyDefragSimulator::ParseTrace(Generated, Trace))
+    {
+        printf("ParseTrace() rejected the generated trace\n");
+        return 1;
+    }
+    printf("Level switch, 2^%u units, then 32 blocks of 64:\n", MaxOrder);
+    Best.NumFailedAllocations = ~(size_t)0;
+    PrintReplays(Trace, MaxOrder, &Baseline, &Best);
+
+    if (Best.NumFailedAllocations >= Baseline.NumFailedAllocations)
+    {
+        printf("Defragmenting did not reduce the %zu failed allocations\n", Baseline.NumFailedAllocations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks ChunkedFile and times how its inflating scales with the number of workers.
+// Compress() followed by Decompress() must give back the original bytes for sizes on and either side of
+// a block boundary, with blocks that compress and blocks that are stored as they are.  The header and
+// index must describe the file the way Core/ChunkedFile.h and Tools/Scripts/PackChunked.py lay it out.
+// A bad magic, version or block count, a truncated index or block, and a corrupt compressed block must
+// all be rejected.
+//
+// Then it inflates the same data with no workers, one, three, and seven or one per hardware thread,
+// whichever is more, for several block sizes, next to ZipStream::Inflate() on a gzip of it, which is
+// what a .gz file costs.  Give it a file to time that instead:  a .cz file is inflated as it is, and
+// anything else is packed first.  Returns nonzero on the first failed check.
+//
+// Build and run from this directory with zlib:
+//
+//     cl /O2 /EHsc /I..\..\Core /I<zlib include> ChunkedFileBenchmark.cpp ..\..\Core\ChunkedFile.cpp ..\..\Core\JobSystem.cpp ..\..\Core\ZipStream.cpp <zlib lib>
+//     g++ -std=c++14 -O2 -pthread -I../../Core ChunkedFileBenchmark.cpp ../../Core/ChunkedFile.cpp ../../Core/JobSystem.cpp ../../Core/ZipStream.cpp -lz -o ChunkedFileBenchmark
+
+#include "ChunkedFile.h"
+#include "JobSystem.h"
+#include "ZipStream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <zlib.h>
+
+using namespace std;
+
+namespace
+{
+    // Runs of repeated words with noise between them, and every so often a stretch of pure noise that
+    // doesn't compress, so that some blocks are stored as they are
+    vector<uint8_t> MakeContents( size_t Size, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        vector<uint8_t> Contents(Size);
+        for (size_t i = 0; i < Contents.size(); )
+        {
+            const bool Noise = Random() % 16384 == 0;
+            const size_t RunLength = min((size_t)(Noise ? 1 << 16 : Random() % 64), Contents.size() - i);
+            const uint32_t Word = Random();
+            for (size_t j = 0; j < RunLength; ++j)
+                Contents[i + j] = Noise ? (uint8_t)Random() : (uint8_t)(Word >> (8 * (j & 3)));
+            i += RunLength;
+            if (i < Contents.size())
+                Contents[i++] = (uint8_t)Random();
+        }
+        return Contents;
+    }
+
+    vector<uint8_t> Gzip( const vector<uint8_t>& Source )
+    {
+        z_stream Stream = {};
+        deflateInit2(&Stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+        vector<uint8_t> Packed(deflateBound(&Stream, (uLong)Source.size()));
+        Stream.next_in = (Bytef*)Source.data();
+        Stream.avail_in = (uInt)Source.size();
+        Stream.next_out = Packed.data();
+        Stream.avail_out = (uInt)Packed.size();
+        deflate(&Stream, Z_FINISH);
+        Packed.resize(Stream.total_out);
+        deflateEnd(&Stream);
+        return Packed;
+    }
+
+    ChunkedFile::Header ReadHeader( const vector<uint8_t>& Packed )
+    {
+        ChunkedFile::Header FileHeader;
+        memcpy(&FileHeader, Packed.data(), sizeof(FileHeader));
+        return FileHeader;
+    }
+
+    ChunkedFile::BlockEntry ReadEntry( const vector<uint8_t>& Packed, uint32_t Index )
+    {
+        ChunkedFile::BlockEntry Entry;
+        memcpy(&Entry, Packed.data() + sizeof(ChunkedFile::Header) + Index * sizeof(Entry), sizeof(Entry));
+        return Entry;
+    }
+
+    bool Decompresses( const vector<uint8_t>& Packed, size_t Size, JobScheduler& Scheduler )
+    {
+        vector<uint8_t> Dest(Size);
+        return ChunkedFile::Decompress(Packed.data(), Packed.size(), Dest.data(), Scheduler);
+    }
+
+    // The header and index must tile the file exactly as the packer script writes it
+    bool CheckLayout( const vector<uint8_t>& Packed, size_t Size, uint32_t BlockSize, uint32_t& NumStored )
+    {
+        const ChunkedFile::Header FileHeader = ReadHeader(Packed);
+        if (FileHeader.Magic != ChunkedFile::kMagic || FileHeader.Version != ChunkedFile::kVersion ||
+            FileHeader.BlockSize != BlockSize || FileHeader.UncompressedSize != Size || FileHeader.Reserved != 0 ||
+            FileHeader.NumBlocks != (Size + BlockSize - 1) / BlockSize)
+        {
+            return false;
+        }
+
+        uint64_t Offset = sizeof(ChunkedFile::Header) + FileHeader.NumBlocks * sizeof(ChunkedFile::BlockEntry);
+        for (uint32_t i = 0; i < FileHeader.NumBlocks; ++i)
+        {
+            const ChunkedFile::BlockEntry Entry = ReadEntry(Packed, i);
+            if (Entry.Offset != Offset || Entry.CompressedSize > Entry.UncompressedSize ||
+                Entry.UncompressedSize != min((uint64_t)BlockSize, Size - (uint64_t)i * BlockSize))
+            {
+                return false;
+            }
+            NumStored += Entry.CompressedSize == Entry.UncompressedSize ? 1 : 0;
+            Offset += Entry.CompressedSize;
+        }
+        return Offset == Packed.size();
+    }
+
+    bool CheckRoundTrips( JobScheduler& Scheduler )
+    {
+        const uint32_t BlockSize = 64 << 10;
+        const size_t kSizes[] = { 1, 1000, BlockSize - 1, BlockSize, BlockSize + 1, 7 * BlockSize, 7 * BlockSize + 3,
+            40 * BlockSize + 12345 };
+
+        uint32_t NumStored = 0, NumBlocks = 0;
+        for (size_t Size : kSizes)
+        {
+            const vector<uint8_t> Contents = MakeContents(Size, (uint32_t)Size);
+            vector<uint8_t> Packed;
+            ChunkedFile::Compress(Contents.data(), Contents.size(), Packed, Scheduler, BlockSize);
+
+            if (!CheckLayout(Packed, Size, BlockSize, NumStored))
+            {
+                printf("Compress() of %zu bytes wrote a header or block index that doesn't match the file\n", Size);
+                return false;
+            }
+            NumBlocks += ReadHeader(Packed).NumBlocks;
+
+            if (ChunkedFile::GetUncompressedSize(Packed.data(), Packed.size()) != Size)
+            {
+                printf("GetUncompressedSize() of a %zu byte file gave %llu\n", Size,
+                    (unsigned long long)ChunkedFile::GetUncompressedSize(Packed.data(), Packed.size()));
+                return false;
+            }
+
+            // Poison the output so that a block that is skipped shows
+            vector<uint8_t> Dest(Size, 0xCD);
+            if (!ChunkedFile::Decompress(Packed.data(), Packed.size(), Dest.data(), Scheduler) || Dest != Contents)
+            {
+                printf("Decompress() of a %zu byte file didn't give back the original\n", Size);
+                return false;
+            }
+        }
+
+        if (NumStored == 0 || NumStored == NumBlocks)
+        {
+            printf("%u of %u blocks were stored as they are, so one of the two kinds went untested\n", NumStored, NumBlocks);
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckRejects( JobScheduler& Scheduler )
+    {
+        const uint32_t BlockSize = 64 << 10;
+        const size_t Size = 9 * BlockSize + 100;
+        const vector<uint8_t> Contents = MakeContents(Size, 7);
+        vector<uint8_t> Packed;
+        ChunkedFile::Compress(Contents.data(), Contents.size(), Packed, Scheduler, BlockSize);
+
+        const size_t IndexEnd = sizeof(ChunkedFile::Header) + ReadHeader(Packed).NumBlocks * sizeof(ChunkedFile::BlockEntry);
+
+        struct Case
+        {
+            const char* Name;
+            vector<uint8_t> File;
+        };
+        vector<Case> Cases;
+
+        Cases.push_back({ "a bad magic", Packed });
+        Cases.back().File[0] ^= 1;
+
+        Cases.push_back({ "a later version", Packed });
+        Cases.back().File[4] += 1;
+
+        Cases.push_back({ "a block count that doesn't cover the file", Packed });
+        Cases.back().File[12] += 1;
+
+        Cases.push_back({ "a block size of zero", Packed });
+        memset(Cases.back().File.data() + 8, 0, 4);
+
+        Cases.push_back({ "a truncated header", vector<uint8_t>(Packed.begin(), Packed.begin() + sizeof(ChunkedFile::Header) - 1) });
+        Cases.push_back({ "a truncated index", vector<uint8_t>(Packed.begin(), Packed.begin() + IndexEnd - 1) });
+        Cases.push_back({ "a truncated last block", vector<uint8_t>(Packed.begin(), Packed.end() - 1) });
+
+        // Stored blocks carry no checksum, so the corrupt byte goes in the first compressed one
+        for (uint32_t i = 0; i < ReadHeader(Packed).NumBlocks; ++i)
+        {
+            const ChunkedFile::BlockEntry Entry = ReadEntry(Packed, i);
+            if (Entry.CompressedSize < Entry.UncompressedSize)
+            {
+                Cases.push_back({ "a corrupt compressed block", Packed });
+                Cases.back().File[Entry.Offset + Entry.CompressedSize / 2] ^= 0x55;
+                break;
+            }
+        }
+
+        for (const Case& Bad : Cases)
+        {
+            if (Decompresses(Bad.File, Size, Scheduler))
+            {
+                printf("Decompress() accepted a file with %s\n", Bad.Name);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double Seconds( chrono::steady_clock::time_point Start )
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    }
+
+    // Output MB/s of Decompress() over enough runs for about 256 MB
+    double MeasureDecompress( const vector<uint8_t>& Packed, vector<uint8_t>& Dest, JobScheduler& Scheduler, bool& Success )
+    {
+        const uint32_t NumRuns = max(2u, (uint32_t)((256u << 20) / max((size_t)1, Dest.size())));
+        Success = true;
+
+        auto Start = chrono::steady_clock::now();
+        for (uint32_t Run = 0; Run < NumRuns; ++Run)
+            Success = ChunkedFile::Decompress(Packed.data(), Packed.size(), Dest.data(), Scheduler) && Success;
+        return (double)NumRuns * Dest.size() / 1e6 / Seconds(Start);
+    }
+
+    bool Report( const vector<uint8_t>& Contents, const vector<uint32_t>& WorkerCounts )
+    {
+        // The single thread baseline:  the same data as a .gz file
+        const vector<uint8_t> Gzipped = Gzip(Contents);
+        const uint32_t NumGzipRuns = max(2u, (uint32_t)((256u << 20) / Contents.size()));
+        vector<uint8_t> Inflated;
+        int Error;
+        bool Success = true;
+        auto Start = chrono::steady_clock::now();
+        for (uint32_t Run = 0; Run < NumGzipRuns; ++Run)
+            Success = ZipStream::Inflate(Gzipped.data(), Gzipped.size(), Inflated, Error) && Success;
+        const double GzipRate = (double)NumGzipRuns * Contents.size() / 1e6 / Seconds(Start);
+        if (!Success || Inflated != Contents)
+        {
+            printf("ZipStream::Inflate() didn't give back the original\n");
+            return false;
+        }
+
+        printf("%.1f MB, %.1f:1 as gzip, inflated by ZipStream::Inflate() at %.0f MB/s.\n\n", Contents.size() / 1e6,
+            (double)Contents.size() / Gzipped.size(), GzipRate);
+        printf("%10s %8s %8s %12s %10s\n", "Block", "Ratio", "Workers", "Decompress", "Speedup");
+
+        for (uint32_t BlockSize : { 256u << 10, 1u << 20, 4u << 20 })
+        {
+            JobScheduler Packer;
+            Packer.Start();
+            vector<uint8_t> Packed;
+            ChunkedFile::Compress(Contents.data(), Contents.size(), Packed, Packer, BlockSize);
+            Packer.Stop();
+
+            for (uint32_t NumWorkers : WorkerCounts)
+            {
+                JobScheduler Scheduler;
+                Scheduler.Start(NumWorkers);
+
+                vector<uint8_t> Dest(Contents.size());
+                const double Rate = MeasureDecompress(Packed, Dest, Scheduler, Success);
+                if (!Success || Dest != Contents)
+                {
+                    printf("Decompress() with %u workers didn't give back the original\n", NumWorkers);
+                    return false;
+                }
+                printf("%7u KB %7.1f:1 %8u %7.0f MB/s %9.2fx\n", BlockSize >> 10, (double)Contents.size() / Packed.size(),
+                    NumWorkers, Rate, Rate / GzipRate);
+            }
+        }
+        return true;
+    }
+
+    // A .cz file from the packer script is timed as it is
+    bool ReportChunkedFile( const vector<uint8_t>& Packed, const vector<uint32_t>& WorkerCounts )
+    {
+        const uint64_t Size = ChunkedFile::GetUncompressedSize(Packed.data(), Packed.size());
+        printf("%.1f MB in %u blocks of %u KB, %.1f:1.\n\n", Size / 1e6, ReadHeader(Packed).NumBlocks,
+            ReadHeader(Packed).BlockSize >> 10, (double)Size / Packed.size());
+        printf("%8s %12s\n", "Workers", "Decompress");
+
+        for (uint32_t NumWorkers : WorkerCounts)
+        {
+            JobScheduler Scheduler;
+            Scheduler.Start(NumWorkers);
+
+            vector<uint8_t> Dest((size_t)Size);
+            bool Success;
+            const double Rate = MeasureDecompress(Packed, Dest, Scheduler, Success);
+            if (!Success)
+            {
+                printf("Decompress() with %u workers failed\n", NumWorkers);
+                return false;
+            }
+            printf("%8u %7.0f MB/s\n", NumWorkers, Rate);
+        }
+        return true;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    const uint32_t NumThreads = max(1u, thread::hardware_concurrency());
+    const vector<uint32_t> WorkerCounts = { 0, 1, 3, max(7u, NumThreads - 1) };
+
+    for (uint32_t NumWorkers : WorkerCounts)
+    {
+        JobScheduler Scheduler;
+        Scheduler.Start(NumWorkers);
+        if (!CheckRoundTrips(Scheduler) || !CheckRejects(Scheduler))
+        {
+            printf("ChunkedFile with %u workers failed\n", NumWorkers);
+            return 1;
+        }
+    }
+
+    printf("Round trips, the file layout and rejecting bad files check out with 0, 1, 3 and %u workers.\n", WorkerCounts[3]);
+    printf("This machine has %u hardware threads.\n\n", NumThreads);
+
+    if (argc > 1)
+    {
+        ifstream File(argv[1], ios::binary);
+        if (!File)
+        {
+            printf("Couldn't open %s\n", argv[1]);
+            return 1;
+        }
+        const vector<uint8_t> Contents((istreambuf_iterator<char>(File)), istreambuf_iterator<char>());
+
+        if (ChunkedFile::GetUncompressedSize(Contents.data(), Contents.size()) != 0)
+            return ReportChunkedFile(Contents, WorkerCounts) ? 0 : 1;
+        if (Contents.empty())
+        {
+            printf("%s is empty\n", argv[1]);
+            return 1;
+        }
+        return Report(Contents, WorkerCounts) ? 0 : 1;
+    }
+
+    return Report(MakeContents(64 << 20, 64), WorkerCounts) ? 0 : 1;
+}
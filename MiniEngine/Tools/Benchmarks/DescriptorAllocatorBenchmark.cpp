@@ -0,0 +1,332 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks DescriptorAllocatorCore and reports how fast it hands out single descriptors.
+//
+// A random run of allocations and frees of 1-40 descriptors is checked against a shadow copy of every
+// descriptor.  Runs must not overlap or straddle heaps, a descriptor freed against a fence must not come
+// back before the fence completes, and the statistics must add up.  Free runs must be split to serve
+// smaller requests before any new heap space is used.  Thread caches must stay bounded with more
+// allocators per thread than a thread has cache slots.  Several threads then allocate and free at once,
+// and everything must be accounted for afterwards.  Returns nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core DescriptorAllocatorBenchmark.cpp ..\..\Core\DescriptorAllocatorCore.cpp ..\..\Core\BuddyAllocatorCore.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core DescriptorAllocatorBenchmark.cpp ../../Core/DescriptorAllocatorCore.cpp ../../Core/BuddyAllocatorCore.cpp -o DescriptorAllocatorBenchmark
+
+#include "DescriptorAllocatorCore.h"
+#include "PageRecyclerMock.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+    const uint32_t kDescriptorsPerHeap = 256;
+    const uint64_t kLive = ~0ull;
+
+    MockFence s_GraphicsFence(0);
+    MockFence s_ComputeFence(2);
+
+    bool IsFenceComplete( uint64_t FenceValue )
+    {
+        return (FenceValue >> 56) == 0 ? s_GraphicsFence.IsFenceComplete(FenceValue) : s_ComputeFence.IsFenceComplete(FenceValue);
+    }
+
+    // The "GPU" runs Behind submissions behind
+    void CompleteBehind( MockFence& Fence, uint64_t Behind )
+    {
+        uint64_t Next = Fence.GetNextValue();
+        if ((Next & 0xFFFFFFFFFFFFFFull) > Behind)
+            Fence.Complete(Next - Behind);
+    }
+
+    bool CheckStats( const DescriptorAllocatorCore& Allocator, uint64_t Live, uint64_t Padding, const char* When )
+    {
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        if (Stats.Live != Live || Stats.Padding != Padding || Stats.Capacity != (uint64_t)Stats.NumHeaps * kDescriptorsPerHeap ||
+            Stats.Free != Stats.Capacity - Stats.Live - Stats.PendingRelease || Stats.ThreadCached > Stats.Free)
+        {
+            printf("Statistics differ %s:  %llu live (expected %llu), %llu padding (expected %llu)\n", When,
+                (unsigned long long)Stats.Live, (unsigned long long)Live, (unsigned long long)Stats.Padding,
+                (unsigned long long)Padding);
+            return false;
+        }
+        return true;
+    }
+
+    // One entry per descriptor:  0 when free, kLive, or the fence it was freed against
+    bool CheckRandomRun( uint32_t ThreadCacheSize, uint32_t Seed )
+    {
+        DescriptorAllocatorCore Allocator(kDescriptorsPerHeap, []( uint32_t ){}, IsFenceComplete, ThreadCacheSize);
+        vector<uint64_t> Shadow;
+        vector<pair<uint32_t, uint32_t>> Live;
+        uint64_t LiveCount = 0, Padding = 0;
+        mt19937 Random(Seed);
+
+        for (uint32_t Step = 0; Step < 100000; ++Step)
+        {
+            if (Live.empty() || (Live.size() < 2000 && Random() % 2 == 0))
+            {
+                uint32_t Count = Random() % 8 == 0 ? 1 + Random() % 40 : 1;
+                uint32_t Index = Allocator.Allocate(Count);
+                uint32_t Size = DescriptorAllocatorCore::RoundUpCount(Count);
+
+                if (Index / kDescriptorsPerHeap != (Index + Size - 1) / kDescriptorsPerHeap)
+                {
+                    printf("%u descriptors at %u straddle two heaps\n", Size, Index);
+                    return false;
+                }
+                if (Shadow.size() < Index + Size)
+                    Shadow.resize(Index + Size, 0);
+                for (uint32_t i = Index; i < Index + Size; ++i)
+                {
+                    if (Shadow[i] == kLive)
+                    {
+                        printf("Descriptor %u was handed out twice\n", i);
+                        return false;
+                    }
+                    if (Shadow[i] != 0 && !IsFenceComplete(Shadow[i]))
+                    {
+                        printf("Descriptor %u was reused before fence %llx completed\n", i, (unsigned long long)Shadow[i]);
+                        return false;
+                    }
+                    Shadow[i] = kLive;
+                }
+
+                Live.emplace_back(Index, Count);
+                LiveCount += Size;
+                Padding += Size - Count;
+            }
+            else
+            {
+                size_t Which = Random() % Live.size();
+                pair<uint32_t, uint32_t> Run = Live[Which];
+                Live[Which] = Live.back();
+                Live.pop_back();
+
+                uint32_t Size = DescriptorAllocatorCore::RoundUpCount(Run.second);
+                LiveCount -= Size;
+                Padding -= Size - Run.second;
+
+                // A third are freed at once, and the rest against one of two queues' fences
+                uint64_t FenceValue = 0;
+                if (Random() % 3 != 0)
+                    FenceValue = Random() % 2 == 0 ? s_GraphicsFence.Signal() : s_ComputeFence.Signal();
+                for (uint32_t i = Run.first; i < Run.first + Size; ++i)
+                    Shadow[i] = FenceValue;
+                Allocator.Free(Run.first, Run.second, FenceValue);
+            }
+
+            if (Step % 8 == 0)
+            {
+                CompleteBehind(s_GraphicsFence, 4);
+                CompleteBehind(s_ComputeFence, 4);
+            }
+
+            if (Step % 1000 == 0 && !CheckStats(Allocator, LiveCount, Padding, "during a random run"))
+                return false;
+        }
+
+        for (auto& Run : Live)
+            Allocator.Free(Run.first, Run.second);
+        s_GraphicsFence.CompleteAll();
+        s_ComputeFence.CompleteAll();
+        Allocator.Reclaim();
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        if (!CheckStats(Allocator, 0, 0, "after freeing everything") || Stats.PendingRelease != 0)
+            return false;
+
+        // Every heap is needed by the peak, or nearly so, unless freed runs aren't being reused
+        if (Stats.Capacity > Stats.HighWaterLive * 2 + kDescriptorsPerHeap)
+        {
+            printf("%u heaps for a peak of %llu descriptors\n", Stats.NumHeaps, (unsigned long long)Stats.HighWaterLive);
+            return false;
+        }
+
+        Allocator.Allocate(3);
+        Allocator.Destroy();
+        if (Allocator.GetStats().Leaked != 4)
+        {
+            printf("Destroy() did not report 4 leaked descriptors\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool Expect( uint32_t Actual, uint32_t Expected, const char* What )
+    {
+        if (Actual != Expected)
+            printf("%s returned %u, expected %u\n", What, Actual, Expected);
+        return Actual == Expected;
+    }
+
+    bool CheckSplitting( void )
+    {
+        uint32_t NumHeaps = 0;
+        DescriptorAllocatorCore Allocator(kDescriptorsPerHeap, [&]( uint32_t ){ ++NumHeaps; }, IsFenceComplete, 0);
+
+        // A free run of 8 serves 1 + 1 + 2 + 4 before the heap is bumped again
+        uint32_t Run = Allocator.Allocate(8);
+        uint32_t Next = Allocator.Allocate(1);
+        Allocator.Free(Run, 8);
+        bool Passed = Expect(Allocator.Allocate(1), Run, "Allocate(1) from a free run of 8") &
+            Expect(Allocator.Allocate(1), Run + 1, "Allocate(1) from the split buddy") &
+            Expect(Allocator.Allocate(2), Run + 2, "Allocate(2) from the split run of 2") &
+            Expect(Allocator.Allocate(4), Run + 4, "Allocate(4) from the split run of 4") &
+            Expect(Allocator.Allocate(1), Next + 1, "Allocate(1) once the run is used up");
+
+        // A request of more than a heap fails, and one that doesn't fit the rest of the heap starts a new
+        // heap after splitting the remainder into free runs
+        Passed &= Expect(Allocator.Allocate(kDescriptorsPerHeap + 1), DescriptorAllocatorCore::kInvalidIndex,
+            "Allocate() of more than a heap");
+        Passed &= Expect(Allocator.Allocate(kDescriptorsPerHeap), kDescriptorsPerHeap, "Allocate() of a whole heap");
+        if (Allocator.Allocate(64) >= kDescriptorsPerHeap)
+        {
+            printf("Allocate(64) did not use the first heap's tail\n");
+            Passed = false;
+        }
+
+        // A fenced free isn't reused until the fence completes
+        uint32_t Fenced = Allocator.Allocate(16);
+        uint64_t FenceValue = s_GraphicsFence.Signal();
+        Allocator.Free(Fenced, 16, FenceValue);
+        Allocator.Reclaim();
+        if (Allocator.Allocate(16) == Fenced)
+        {
+            printf("A fenced free was reused before its fence\n");
+            Passed = false;
+        }
+        s_GraphicsFence.Complete(FenceValue);
+        Allocator.Reclaim();
+        Passed &= Expect(Allocator.Allocate(16), Fenced, "Allocate(16) once the fence completed");
+
+        Passed &= Expect(NumHeaps, 2, "The number of heaps created");
+        return Passed;
+    }
+
+    // More allocators than a thread has cache slots, used in turn, must each keep one bounded cache
+    bool CheckThreadCaches( void )
+    {
+        const uint32_t NumAllocators = 12;
+        const uint32_t CacheSize = 32;
+        vector<unique_ptr<DescriptorAllocatorCore>> Allocators;
+        for (uint32_t i = 0; i < NumAllocators; ++i)
+            Allocators.emplace_back(new DescriptorAllocatorCore(kDescriptorsPerHeap, []( uint32_t ){}, IsFenceComplete, CacheSize));
+
+        for (int Round = 0; Round < 100; ++Round)
+        {
+            for (auto& Allocator : Allocators)
+                Allocator->Free(Allocator->Allocate(1), 1);
+        }
+
+        vector<thread> Threads;
+        for (uint32_t t = 0; t < 4; ++t)
+        {
+            Threads.emplace_back([&]
+            {
+                vector<vector<uint32_t>> Held(NumAllocators);
+                for (int Round = 0; Round < 2000; ++Round)
+                {
+                    for (uint32_t i = 0; i < NumAllocators; ++i)
+                    {
+                        if (Round % 3 == 2)
+                        {
+                            Allocators[i]->Free(Held[i].back(), 1, Round % 2 == 0 ? s_ComputeFence.Signal() : 0);
+                            Held[i].pop_back();
+                        }
+                        else
+                            Held[i].push_back(Allocators[i]->Allocate(1));
+                    }
+                    CompleteBehind(s_ComputeFence, 1);
+                }
+                for (uint32_t i = 0; i < NumAllocators; ++i)
+                {
+                    for (uint32_t Index : Held[i])
+                        Allocators[i]->Free(Index, 1);
+                }
+            });
+        }
+        for (thread& Worker : Threads)
+            Worker.join();
+
+        s_ComputeFence.CompleteAll();
+        for (auto& Allocator : Allocators)
+        {
+            Allocator->Reclaim();
+            DescriptorAllocatorStats Stats = Allocator->GetStats();
+            if (Stats.Live != 0 || Stats.PendingRelease != 0 || Stats.ThreadCached > 5 * CacheSize)
+            {
+                printf("A thread cache grew past its size:  %llu cached, %llu live, %llu pending\n",
+                    (unsigned long long)Stats.ThreadCached, (unsigned long long)Stats.Live,
+                    (unsigned long long)Stats.PendingRelease);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double MeasureMillionsPerSecond( uint32_t ThreadCacheSize, uint32_t NumThreads )
+    {
+        DescriptorAllocatorCore Allocator(1024, []( uint32_t ){}, IsFenceComplete, ThreadCacheSize);
+        const uint32_t NumRounds = 200000;
+
+        auto Start = chrono::steady_clock::now();
+        vector<thread> Threads;
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&]
+            {
+                uint32_t Held[8];
+                for (uint32_t Round = 0; Round < NumRounds; ++Round)
+                {
+                    for (uint32_t& Index : Held)
+                        Index = Allocator.Allocate(1);
+                    for (uint32_t Index : Held)
+                        Allocator.Free(Index, 1);
+                }
+            });
+        }
+        for (thread& Worker : Threads)
+            Worker.join();
+
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+        return NumThreads * NumRounds * 8.0 / Seconds / 1e6;
+    }
+}
+
+int main( void )
+{
+    for (uint32_t Seed = 1; Seed <= 3; ++Seed)
+    {
+        if (!CheckRandomRun(32, Seed) || !CheckRandomRun(0, Seed))
+            return 1;
+    }
+    if (!CheckSplitting() || !CheckThreadCaches())
+        return 1;
+
+    printf("Runs never overlap or straddle heaps, fenced frees wait for their fences, free runs are split\n"
+        "before new space is used, and thread caches stay bounded.\n\n");
+
+    const uint32_t MaxThreads = max(4u, thread::hardware_concurrency());
+    printf("%8s %20s %20s\n", "Threads", "Thread cache", "No thread cache");
+    for (uint32_t Threads = 1; Threads <= MaxThreads; Threads *= 2)
+    {
+        double Cached = MeasureMillionsPerSecond(32, Threads);
+        double Locked = MeasureMillionsPerSecond(0, Threads);
+        printf("%8u %12.1f Mdesc/s %12.1f Mdesc/s\n", Threads, Cached, Locked);
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks MappedFile and ZipStream::Inflate() against plain reads and the original bytes, and
+// reports their throughput.  It writes a set of files into the directory given on the command line (the
+// current one by default), then
+//
+//   * reads each one with an ifstream into a vector, as ReadFileSync() used to, and maps it with
+//     MappedFile::Map(), touching every cache line of both and checking that they match
+//   * inflates gzip and zlib copies straight from their mappings, in one piece and in callback-sized
+//     chunks, and checks the output against the original
+//   * checks that truncated and corrupt streams are rejected, and that an empty file is found but not mapped
+//
+// The files are read warm, so this measures the cost of getting cached file data into the loader rather
+// than the disk.  Returns nonzero on the first mismatch.  Build and run from this directory with zlib:
+//
+//     cl /O2 /EHsc /I..\..\Core /I<zlib include> FileBenchmark.cpp ..\..\Core\MappedFile.cpp ..\..\Core\ZipStream.cpp <zlib lib>
+//     g++ -std=c++14 -O2 -I../../Core FileBenchmark.cpp ../../Core/MappedFile.cpp ../../Core/ZipStream.cpp -lz -o FileBenchmark
+
+#include "MappedFile.h"
+#include "ZipStream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+
+namespace
+{
+    const size_t kNumFiles = 24;
+    const size_t kFileSize = 4 << 20;
+    const int kNumPasses = 3;
+
+    // Runs of repeated words with noise between them, which deflate compresses about 5:1 like typical
+    // texture and mesh data
+    vector<uint8_t> MakeContents( uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        vector<uint8_t> Contents(kFileSize);
+        for (size_t i = 0; i < Contents.size(); )
+        {
+            const uint32_t Word = Random();
+            const size_t RunLength = min((size_t)(Random() % 64), Contents.size() - i);
+            for (size_t j = 0; j < RunLength; ++j)
+                Contents[i + j] = (uint8_t)(Word >> (8 * (j & 3)));
+            i += RunLength;
+            if (i < Contents.size())
+                Contents[i++] = (uint8_t)Random();
+        }
+        return Contents;
+    }
+
+    // WindowBits of 15 writes a zlib stream, and 15 + 16 a gzip stream
+    vector<uint8_t> Deflate( const vector<uint8_t>& Source, int WindowBits )
+    {
+        z_stream Stream = {};
+        deflateInit2(&Stream, 6, Z_DEFLATED, WindowBits, 8, Z_DEFAULT_STRATEGY);
+
+        vector<uint8_t> Packed(deflateBound(&Stream, (uLong)Source.size()));
+        Stream.next_in = (Bytef*)Source.data();
+        Stream.avail_in = (uInt)Source.size();
+        Stream.next_out = Packed.data();
+        Stream.avail_out = (uInt)Packed.size();
+        deflate(&Stream, Z_FINISH);
+        Packed.resize(Stream.total_out);
+        deflateEnd(&Stream);
+        return Packed;
+    }
+
+    string Narrow( const wstring& Wide )
+    {
+        return string(Wide.begin(), Wide.end());
+    }
+
+    // Touching every cache line is what a loader parsing the file does at the very least
+    uint64_t TouchLines( const uint8_t* Data, size_t Size )
+    {
+        uint64_t Sum = 0;
+        for (size_t i = 0; i < Size; i += 64)
+            Sum += Data[i];
+        return Sum;
+    }
+
+    double Seconds( chrono::steady_clock::time_point Start )
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    }
+
+    bool Fail( const char* What, const wstring& FileName )
+    {
+        printf("%s:  %s\n", What, Narrow(FileName).c_str());
+        return false;
+    }
+
+    bool BenchmarkReads( const vector<wstring>& FileNames, const vector<vector<uint8_t>>& Contents )
+    {
+        const double TotalMB = FileNames.size() * kFileSize / 1e6;
+
+        for (int Pass = 0; Pass < kNumPasses; ++Pass)
+        {
+            uint64_t Sum = 0;
+
+            auto Start = chrono::steady_clock::now();
+            for (const wstring& FileName : FileNames)
+            {
+                ifstream File(Narrow(FileName), ios::binary);
+                const size_t Size = (size_t)File.seekg(0, ios::end).tellg();
+                vector<uint8_t> Buffer(Size);
+                File.seekg(0).read((char*)Buffer.data(), Size);
+                Sum += TouchLines(Buffer.data(), Buffer.size());
+            }
+            const double StreamTime = Seconds(Start);
+
+            Start = chrono::steady_clock::now();
+            for (const wstring& FileName : FileNames)
+            {
+                ByteView View = MappedFile::Map(FileName);
+                Sum -= TouchLines(View.data(), View.size());
+            }
+            const double MapTime = Seconds(Start);
+
+            if (Sum != 0)
+                return Fail("Mapped and streamed contents differ", L"");
+
+            printf("Read pass %d:   ifstream %7.0f MB/s   mapped %7.0f MB/s\n", Pass, TotalMB / StreamTime, TotalMB / MapTime);
+        }
+
+        for (size_t i = 0; i < FileNames.size(); ++i)
+        {
+            ByteView View = MappedFile::Map(FileNames[i]);
+            if (View.size() != Contents[i].size() || memcmp(View.data(), Contents[i].data(), View.size()) != 0)
+                return Fail("Mapping doesn't match what was written", FileNames[i]);
+        }
+
+        return true;
+    }
+
+    bool BenchmarkInflate( const char* Format, const vector<wstring>& FileNames, const vector<vector<uint8_t>>& Contents )
+    {
+        const double TotalMB = FileNames.size() * kFileSize / 1e6;
+
+        for (int Pass = 0; Pass < kNumPasses; ++Pass)
+        {
+            double WholeTime = 0.0, ChunkedTime = 0.0;
+
+            for (size_t i = 0; i < FileNames.size(); ++i)
+            {
+                ByteView Packed = MappedFile::Map(FileNames[i]);
+                vector<uint8_t> Inflated;
+                int Error;
+
+                auto Start = chrono::steady_clock::now();
+                bool Success = ZipStream::Inflate(Packed.data(), Packed.size(), Inflated, Error);
+                WholeTime += Seconds(Start);
+
+                if (!Success || Inflated != Contents[i])
+                    return Fail("Inflated contents differ", FileNames[i]);
+
+                // The chunks must arrive in order, back to back, and cover the whole file
+                size_t Received = 0;
+                bool InOrder = true;
+                auto OnChunk = [&]( const uint8_t* Data, size_t Size )
+                {
+                    InOrder = InOrder && Received + Size <= Contents[i].size() &&
+                        memcmp(Data, Contents[i].data() + Received, Size) == 0;
+                    Received += Size;
+                };
+
+                Start = chrono::steady_clock::now();
+                Success = ZipStream::Inflate(Packed.data(), Packed.size(), Inflated, Error, OnChunk);
+                ChunkedTime += Seconds(Start);
+
+                if (!Success || !InOrder || Received != Contents[i].size() || Inflated != Contents[i])
+                    return Fail("Chunked inflate differs", FileNames[i]);
+            }
+
+            printf("%s pass %d:   whole %7.0f MB/s   chunked %7.0f MB/s\n", Format, Pass, TotalMB / WholeTime, TotalMB / ChunkedTime);
+        }
+
+        ByteView Packed = MappedFile::Map(FileNames[0]);
+        vector<uint8_t> Inflated;
+        int Error;
+
+        if (ZipStream::Inflate(Packed.data(), Packed.size() / 2, Inflated, Error) || !Inflated.empty())
+            return Fail("A truncated stream was accepted", FileNames[0]);
+
+        vector<uint8_t> Corrupt(Packed.begin(), Packed.end());
+        for (size_t i = Corrupt.size() / 3; i < Corrupt.size() / 3 + 64; ++i)
+            Corrupt[i] ^= 0x5A;
+        if (ZipStream::Inflate(Corrupt.data(), Corrupt.size(), Inflated, Error))
+            return Fail("A corrupt stream was accepted", FileNames[0]);
+
+        return true;
+    }
+
+    // An empty file can't be mapped, but GetFileSize() must still tell it from a missing one, which is
+    // how ReadFileSync() returns an empty buffer for it rather than NullFile
+    bool CheckEmptyFile( const wstring& FileName )
+    {
+        if (!MappedFile::WriteAtomic(FileName, nullptr, 0))
+            return Fail("Couldn't write", FileName);
+
+        MappedFile File;
+        uint64_t Size = ~0ull;
+        const bool Opened = File.Open(FileName);
+        const bool Found = MappedFile::GetFileSize(FileName, Size);
+        remove(Narrow(FileName).c_str());
+
+        if (Opened || !Found || Size != 0)
+            return Fail("An empty file was mapped or not found", FileName);
+        if (MappedFile::GetFileSize(FileName, Size))
+            return Fail("A missing file was found", FileName);
+        return true;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    string Dir = argc > 1 ? argv[1] : ".";
+    const wstring Prefix = wstring(Dir.begin(), Dir.end()) + L"/FileBenchmark";
+
+    vector<vector<uint8_t>> Contents;
+    vector<wstring> RawNames, GzipNames, ZlibNames;
+    size_t GzipBytes = 0;
+
+    for (size_t i = 0; i < kNumFiles; ++i)
+    {
+        Contents.push_back(MakeContents((uint32_t)i + 1));
+
+        RawNames.push_back(Prefix + to_wstring(i) + L".bin");
+        GzipNames.push_back(RawNames.back() + L".gz");
+        ZlibNames.push_back(RawNames.back() + L".z");
+
+        const vector<uint8_t> Gzip = Deflate(Contents.back(), 15 + 16);
+        const vector<uint8_t> Zlib = Deflate(Contents.back(), 15);
+        GzipBytes += Gzip.size();
+
+        if (!MappedFile::WriteAtomic(RawNames.back(), Contents.back().data(), Contents.back().size()) ||
+            !MappedFile::WriteAtomic(GzipNames.back(), Gzip.data(), Gzip.size()) ||
+            !MappedFile::WriteAtomic(ZlibNames.back(), Zlib.data(), Zlib.size()))
+        {
+            Fail("Couldn't write", RawNames.back());
+            return 1;
+        }
+    }
+
+    printf("%zu files of %zu MB, compressed %.1f:1\n\n", kNumFiles, kFileSize >> 20, (double)kNumFiles * kFileSize / GzipBytes);
+
+    // Gzip records its size, so it inflates into one allocation.  Zlib doesn't, so its buffer grows.
+    const bool Passed = CheckEmptyFile(Prefix + L"Empty.bin") && BenchmarkReads(RawNames, Contents) && BenchmarkInflate("Gzip", GzipNames, Contents) &&
+        BenchmarkInflate("Zlib", ZlibNames, Contents);
+
+    for (size_t i = 0; i < kNumFiles; ++i)
+    {
+        remove(Narrow(RawNames[i]).c_str());
+        remove(Narrow(GzipNames[i]).c_str());
+        remove(Narrow(ZlibNames[i]).c_str());
+    }
+
+    if (!Passed)
+        return 1;
+
+    printf("\nAll contents match, empty files are found, and truncated and corrupt streams are rejected.\n");
+    return 0;
+}
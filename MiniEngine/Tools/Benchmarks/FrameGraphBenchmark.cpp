@@ -0,0 +1,624 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks FrameGraphCompiler plans.  A hand-written graph shaped like ModelViewer's frame must
+// cull its dead passes, run its compute pass async with one wait before its consumer, and alias the
+// transients that are never live together.  Then thousands of random graphs are compiled under every
+// combination of options and each plan is checked against a simple model of the graph:
+//
+//   - Surviving passes are exactly those that an output, a side effect or a later surviving pass needs,
+//     in the order they were added.
+//   - Replaying the barriers puts every resource in the state each pass asked for, with no split barrier
+//     in flight, and leaves outputs in their final states.
+//   - The graphics queue waits for an async pass before it touches anything that pass used.
+//   - Transients that are live together, counting until the wait for an async pass, never share memory.
+//
+// Graphs that read a transient before writing it must fail to compile.  Finally it times Compile() on a
+// large graph.  Returns nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core FrameGraphBenchmark.cpp ..\..\Core\FrameGraphCompiler.cpp ..\..\Core\BarrierOptimizer.cpp ..\..\Core\IntervalAllocator.cpp
+//     g++ -std=c++14 -O2 -I../../Core FrameGraphBenchmark.cpp ../../Core/FrameGraphCompiler.cpp ../../Core/BarrierOptimizer.cpp ../../Core/IntervalAllocator.cpp -o FrameGraphBenchmark
+
+#include "FrameGraphCompiler.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    const BarrierState kRenderTarget = 0x4;
+    const BarrierState kUAV = kBarrierStateUnorderedAccess;
+    const BarrierState kDepthWrite = 0x10;
+    const BarrierState kDepthRead = 0x20;
+    const BarrierState kNonPixelSRV = 0x40;
+    const BarrierState kPixelSRV = 0x80;
+    const BarrierState kCopyDest = 0x400;
+    const BarrierState kCopySource = 0x800;
+
+    const BarrierState kWriteStates[] = { kRenderTarget, kUAV, kDepthWrite, kCopyDest };
+    const BarrierState kReadStates[] = { kNonPixelSRV, kPixelSRV, kDepthRead, kCopySource };
+
+    // The same graph as FrameGraphCompiler sees it, kept here to check plans against
+    struct ResourceModel
+    {
+        bool IsTransient;
+        bool IsOutput;
+        BarrierState InitialState;
+        BarrierState FinalState;
+        uint64_t SizeInBytes;
+        uint64_t Alignment;
+    };
+
+    struct AccessModel
+    {
+        uint32_t Resource;
+        BarrierState State;
+        bool IsWrite;
+    };
+
+    struct PassModel
+    {
+        FrameGraphCompiler::QueueType Queue;
+        bool HasSideEffects;
+        vector<AccessModel> Accesses;
+    };
+
+    struct GraphModel
+    {
+        vector<ResourceModel> Resources;
+        vector<PassModel> Passes;
+
+        void Build( FrameGraphCompiler& Graph ) const
+        {
+            Graph.Clear();
+            for (const ResourceModel& Res : Resources)
+            {
+                if (Res.IsTransient)
+                    Graph.CreateTransient("transient", Res.SizeInBytes, Res.Alignment, Res.InitialState);
+                else
+                    Graph.ImportResource("imported", Res.InitialState, Res.IsOutput, Res.FinalState);
+            }
+            for (const PassModel& Pass : Passes)
+            {
+                uint32_t Index = Graph.AddPass("pass", Pass.Queue, Pass.HasSideEffects);
+                for (const AccessModel& Acc : Pass.Accesses)
+                {
+                    if (Acc.IsWrite)
+                        Graph.Write(Index, Acc.Resource, Acc.State);
+                    else
+                        Graph.Read(Index, Acc.Resource, Acc.State);
+                }
+            }
+        }
+    };
+
+    // A pass survives if it has side effects, or writes an output or something a later survivor uses.
+    // Repeated until nothing changes, rather than in one sweep as the compiler does it.
+    vector<bool> FindLivePasses( const GraphModel& Model, bool Cull )
+    {
+        const size_t NumPasses = Model.Passes.size();
+        vector<bool> Alive(NumPasses, !Cull);
+
+        for (bool Changed = Cull; Changed; )
+        {
+            Changed = false;
+            for (size_t Pass = 0; Pass < NumPasses; ++Pass)
+            {
+                if (Alive[Pass])
+                    continue;
+
+                bool Keep = Model.Passes[Pass].HasSideEffects;
+                for (const AccessModel& Acc : Model.Passes[Pass].Accesses)
+                {
+                    if (!Acc.IsWrite)
+                        continue;
+                    Keep = Keep || Model.Resources[Acc.Resource].IsOutput;
+                    for (size_t Later = Pass + 1; Later < NumPasses && !Keep; ++Later)
+                    {
+                        for (const AccessModel& Use : Model.Passes[Later].Accesses)
+                            Keep = Keep || (Alive[Later] && Use.Resource == Acc.Resource);
+                    }
+                }
+
+                if (Keep)
+                {
+                    Alive[Pass] = true;
+                    Changed = true;
+                }
+            }
+        }
+        return Alive;
+    }
+
+    bool UsesResource( const PassModel& Pass, uint32_t Resource )
+    {
+        for (const AccessModel& Acc : Pass.Accesses)
+        {
+            if (Acc.Resource == Resource)
+                return true;
+        }
+        return false;
+    }
+
+    // The step at which the graphics queue has waited for async step Async, or NumSteps for the end
+    uint32_t FindCoveringStep( const FrameGraphPlan& Plan, uint32_t Async )
+    {
+        const uint32_t NumSteps = (uint32_t)Plan.Steps.size();
+        for (uint32_t StepIdx = Async + 1; StepIdx < NumSteps; ++StepIdx)
+        {
+            for (uint32_t Waited : Plan.Steps[StepIdx].Waits)
+            {
+                if (Waited >= Async)
+                    return StepIdx;
+            }
+        }
+        for (uint32_t Waited : Plan.FinalWaits)
+        {
+            if (Waited >= Async)
+                return NumSteps;
+        }
+        return NumSteps + 1;
+    }
+
+    bool CheckPlan( const GraphModel& Model, const FrameGraphCompileOptions& Options, const FrameGraphPlan& Plan,
+        const char* Name )
+    {
+        const uint32_t NumSteps = (uint32_t)Plan.Steps.size();
+        const uint32_t NumResources = (uint32_t)Model.Resources.size();
+
+        // Culling and order
+        vector<bool> Alive = FindLivePasses(Model, Options.CullPasses);
+        vector<uint32_t> Expected;
+        for (uint32_t Pass = 0; Pass < (uint32_t)Model.Passes.size(); ++Pass)
+        {
+            if (Alive[Pass])
+                Expected.push_back(Pass);
+        }
+
+        bool SamePasses = Expected.size() == NumSteps;
+        for (uint32_t StepIdx = 0; SamePasses && StepIdx < NumSteps; ++StepIdx)
+            SamePasses = Plan.Steps[StepIdx].Pass == Expected[StepIdx];
+        if (!SamePasses)
+        {
+            printf("%s:  %u passes survived, expected %zu, or they are out of order\n", Name, NumSteps, Expected.size());
+            return false;
+        }
+        if (Plan.Stats.NumCulledPasses != Model.Passes.size() - NumSteps)
+        {
+            printf("%s:  %u passes reported culled, expected %zu\n", Name, Plan.Stats.NumCulledPasses, Model.Passes.size() - NumSteps);
+            return false;
+        }
+
+        // Async passes, and the waits for them
+        for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+        {
+            const FrameGraphStep& Step = Plan.Steps[StepIdx];
+            const PassModel& Pass = Model.Passes[Step.Pass];
+
+            bool CanBeAsync = Options.AsyncCompute && Pass.Queue == FrameGraphCompiler::kComputeQueue;
+            for (const AccessModel& Acc : Pass.Accesses)
+                CanBeAsync = CanBeAsync && (Acc.State & ~FrameGraphCompiler::kValidComputeStates) == 0;
+            if (Step.Async != CanBeAsync)
+            {
+                printf("%s:  step %u should%s be async\n", Name, StepIdx, CanBeAsync ? "" : " not");
+                return false;
+            }
+
+            for (uint32_t Waited : Step.Waits)
+            {
+                if (Waited >= StepIdx || !Plan.Steps[Waited].Async)
+                {
+                    printf("%s:  step %u waits for step %u, which is not an earlier async step\n", Name, StepIdx, Waited);
+                    return false;
+                }
+            }
+        }
+
+        vector<uint32_t> CoveredAt(NumSteps, NumSteps + 1);
+        for (uint32_t Async = 0; Async < NumSteps; ++Async)
+        {
+            if (!Plan.Steps[Async].Async)
+                continue;
+
+            const PassModel& AsyncPass = Model.Passes[Plan.Steps[Async].Pass];
+            CoveredAt[Async] = FindCoveringStep(Plan, Async);
+
+            for (uint32_t Later = Async + 1; Later <= NumSteps; ++Later)
+            {
+                const bool LaterIsAsync = Later < NumSteps && Plan.Steps[Later].Async;
+                const vector<OptimizedBarrier>& Barriers = Later < NumSteps ? Plan.Steps[Later].Barriers : Plan.FinalBarriers;
+
+                bool Touches = false;
+                if (Later < NumSteps && !LaterIsAsync)
+                {
+                    for (const AccessModel& Acc : Model.Passes[Plan.Steps[Later].Pass].Accesses)
+                        Touches = Touches || UsesResource(AsyncPass, Acc.Resource);
+                }
+                for (const OptimizedBarrier& Barrier : Barriers)
+                {
+                    if (Barrier.BarrierType == OptimizedBarrier::kAlias || (Barrier.BarrierType == OptimizedBarrier::kUAV && LaterIsAsync))
+                        continue;
+                    Touches = Touches || UsesResource(AsyncPass, Barrier.Resource);
+                }
+
+                if (Touches && CoveredAt[Async] > Later)
+                {
+                    printf("%s:  the graphics queue touches a resource of async step %u at step %u before waiting\n", Name, Async, Later);
+                    return false;
+                }
+            }
+        }
+
+        // Replay the barriers
+        vector<BarrierState> State(NumResources);
+        vector<bool> InSplit(NumResources, false);
+        vector<BarrierState> SplitTarget(NumResources);
+        for (uint32_t Res = 0; Res < NumResources; ++Res)
+            State[Res] = Model.Resources[Res].InitialState;
+
+        for (uint32_t StepIdx = 0; StepIdx <= NumSteps; ++StepIdx)
+        {
+            const vector<OptimizedBarrier>& Barriers = StepIdx < NumSteps ? Plan.Steps[StepIdx].Barriers : Plan.FinalBarriers;
+            for (const OptimizedBarrier& Barrier : Barriers)
+            {
+                const uint32_t Res = Barrier.Resource;
+                if (Barrier.BarrierType == OptimizedBarrier::kTransition || Barrier.BarrierType == OptimizedBarrier::kBeginSplit)
+                {
+                    if (InSplit[Res] || State[Res] != Barrier.Before)
+                    {
+                        printf("%s:  transition of resource %u before step %u starts from the wrong state\n", Name, Res, StepIdx);
+                        return false;
+                    }
+                    if (Barrier.BarrierType == OptimizedBarrier::kTransition)
+                        State[Res] = Barrier.After;
+                    else
+                    {
+                        InSplit[Res] = true;
+                        SplitTarget[Res] = Barrier.After;
+                    }
+                }
+                else if (Barrier.BarrierType == OptimizedBarrier::kEndSplit)
+                {
+                    if (!InSplit[Res] || SplitTarget[Res] != Barrier.After)
+                    {
+                        printf("%s:  split barrier of resource %u ends before step %u without a begin\n", Name, Res, StepIdx);
+                        return false;
+                    }
+                    InSplit[Res] = false;
+                    State[Res] = Barrier.After;
+                }
+            }
+
+            if (StepIdx == NumSteps)
+                break;
+
+            for (const AccessModel& Acc : Model.Passes[Plan.Steps[StepIdx].Pass].Accesses)
+            {
+                const BarrierState Current = State[Acc.Resource];
+                bool Satisfied = Acc.State == kBarrierStateCommon ? Current == kBarrierStateCommon : (Current & Acc.State) == Acc.State;
+                if (InSplit[Acc.Resource] || !Satisfied)
+                {
+                    printf("%s:  resource %u is in state %x for step %u, which asked for %x\n", Name, Acc.Resource, Current,
+                        StepIdx, Acc.State);
+                    return false;
+                }
+                if (Plan.Steps[StepIdx].Async && (Current & ~FrameGraphCompiler::kValidComputeStates) != 0)
+                {
+                    printf("%s:  async step %u sees resource %u in state %x, which the compute queue can't use\n", Name,
+                        StepIdx, Acc.Resource, Current);
+                    return false;
+                }
+            }
+        }
+
+        for (uint32_t Res = 0; Res < NumResources; ++Res)
+        {
+            const BarrierState Final = Model.Resources[Res].FinalState;
+            if (InSplit[Res] || (Final != FrameGraphCompiler::kNoFinalState && State[Res] != Final))
+            {
+                printf("%s:  resource %u ends in state %x, not %x\n", Name, Res, State[Res], Final);
+                return false;
+            }
+        }
+
+        // Transient placement.  An async pass's transients stay live until the graphics queue waits for it.
+        vector<uint32_t> FirstUse(NumResources, ~0u), LastUse(NumResources, 0);
+        for (uint32_t StepIdx = 0; StepIdx < NumSteps; ++StepIdx)
+        {
+            for (const AccessModel& Acc : Model.Passes[Plan.Steps[StepIdx].Pass].Accesses)
+            {
+                FirstUse[Acc.Resource] = min(FirstUse[Acc.Resource], StepIdx);
+                LastUse[Acc.Resource] = max(LastUse[Acc.Resource], Plan.Steps[StepIdx].Async ? CoveredAt[StepIdx] - 1 : StepIdx);
+            }
+        }
+
+        for (uint32_t A = 0; A < NumResources; ++A)
+        {
+            const ResourceModel& First = Model.Resources[A];
+            const uint64_t Offset = Plan.TransientOffsets[A];
+            if (!First.IsTransient || FirstUse[A] == ~0u)
+            {
+                if (Offset != FrameGraphCompiler::kUnplaced)
+                {
+                    printf("%s:  resource %u was placed, but is not a transient in use\n", Name, A);
+                    return false;
+                }
+                continue;
+            }
+
+            if (Offset == FrameGraphCompiler::kUnplaced || Offset % First.Alignment != 0 ||
+                Offset + First.SizeInBytes > Plan.TransientHeapSize)
+            {
+                printf("%s:  transient %u is unplaced, misaligned or outside the heap\n", Name, A);
+                return false;
+            }
+
+            for (uint32_t B = A + 1; B < NumResources; ++B)
+            {
+                const uint64_t Other = Plan.TransientOffsets[B];
+                if (Other == FrameGraphCompiler::kUnplaced)
+                    continue;
+
+                const bool LiveTogether = !Options.AliasTransients || (FirstUse[A] <= LastUse[B] && FirstUse[B] <= LastUse[A]);
+                const bool SharesMemory = Offset < Other + Model.Resources[B].SizeInBytes && Other < Offset + First.SizeInBytes;
+                if (LiveTogether && SharesMemory)
+                {
+                    printf("%s:  transients %u and %u are live together in the same memory\n", Name, A, B);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Roughly ModelViewer's frame, with a pass whose output nobody reads
+    GraphModel MakeHandGraph( void )
+    {
+        GraphModel Model;
+        auto Import = [&]( BarrierState Initial, bool IsOutput, BarrierState Final ) -> uint32_t
+        {
+            ResourceModel Res = { false, IsOutput, Initial, Final, 0, 1 };
+            Model.Resources.push_back(Res);
+            return (uint32_t)Model.Resources.size() - 1;
+        };
+        auto Transient = [&]( uint64_t Size ) -> uint32_t
+        {
+            ResourceModel Res = { true, false, kRenderTarget, FrameGraphCompiler::kNoFinalState, Size, 65536 };
+            Model.Resources.push_back(Res);
+            return (uint32_t)Model.Resources.size() - 1;
+        };
+        auto Pass = [&]( FrameGraphCompiler::QueueType Queue, bool HasSideEffects, vector<AccessModel> Accesses )
+        {
+            PassModel Desc = { Queue, HasSideEffects, Accesses };
+            Model.Passes.push_back(Desc);
+        };
+
+        const FrameGraphCompiler::QueueType Graphics = FrameGraphCompiler::kGraphicsQueue;
+        const FrameGraphCompiler::QueueType Compute = FrameGraphCompiler::kComputeQueue;
+
+        uint32_t Depth = Import(kDepthWrite, false, FrameGraphCompiler::kNoFinalState);
+        uint32_t Color = Import(kRenderTarget, true, kPixelSRV);
+        uint32_t Grid = Import(kPixelSRV, false, FrameGraphCompiler::kNoFinalState);
+        uint32_t LinearDepth = Import(kNonPixelSRV, false, FrameGraphCompiler::kNoFinalState);
+        uint32_t Occlusion = Transient(1 << 20);
+        uint32_t Shadow = Transient(1 << 20);
+        uint32_t Unused = Transient(1 << 19);
+        uint32_t Bloom = Transient(1 << 19);
+        uint32_t Timestamps = Import(kCopyDest, false, FrameGraphCompiler::kNoFinalState);
+
+        Pass(Graphics, false, { { Depth, kDepthWrite, true } });
+        Pass(Graphics, false, { { Depth, kNonPixelSRV, false }, { LinearDepth, kUAV, true }, { Occlusion, kUAV, true } });
+        Pass(Compute, false, { { LinearDepth, kNonPixelSRV, false }, { Grid, kUAV, true } });
+        Pass(Graphics, false, { { Shadow, kDepthWrite, true } });
+        Pass(Graphics, false, { { Unused, kRenderTarget, true } });
+        Pass(Graphics, false, { { Occlusion, kPixelSRV, false }, { Shadow, kPixelSRV, false }, { Grid, kPixelSRV, false },
+            { Depth, kDepthRead, false }, { Color, kRenderTarget, true } });
+        Pass(Graphics, false, { { Color, kPixelSRV, false }, { Bloom, kRenderTarget, true } });
+        Pass(Graphics, false, { { Bloom, kPixelSRV, false }, { Color, kRenderTarget, true } });
+        Pass(Graphics, true, { { Timestamps, kCopyDest, true } });
+        return Model;
+    }
+
+    bool CheckHandGraph( void )
+    {
+        GraphModel Model = MakeHandGraph();
+        FrameGraphCompiler Graph;
+        Model.Build(Graph);
+
+        FrameGraphCompileOptions Options;
+        FrameGraphPlan Plan;
+        string Error;
+        if (!Graph.Compile(Options, Plan, &Error))
+        {
+            printf("Hand graph:  %s\n", Error.c_str());
+            return false;
+        }
+        if (!CheckPlan(Model, Options, Plan, "Hand graph"))
+            return false;
+
+        // The pass writing Unused is culled, the grid pass runs async and the color pass waits for it, and
+        // Occlusion and Shadow, which are read by the same pass, can't share memory.  Bloom can reuse either.
+        const FrameGraphStats& Stats = Plan.Stats;
+        if (Stats.NumPasses != 8 || Stats.NumCulledPasses != 1 || Stats.NumAsyncPasses != 1 || Stats.NumSyncPoints != 1 ||
+            Stats.NumTransients != 3 || Stats.TransientBytes != (5 << 19) || Stats.TransientHeapSize != (4 << 19))
+        {
+            printf("Hand graph:  %u passes, %u culled, %u async, %u waits, %u transients in %llu of %llu bytes\n",
+                Stats.NumPasses, Stats.NumCulledPasses, Stats.NumAsyncPasses, Stats.NumSyncPoints, Stats.NumTransients,
+                (unsigned long long)Stats.TransientHeapSize, (unsigned long long)Stats.TransientBytes);
+            return false;
+        }
+        if (!Plan.Steps[2].Async || Plan.Steps[4].Waits.size() != 1 || Plan.Steps[4].Waits[0] != 2)
+        {
+            printf("Hand graph:  the color pass does not wait for the async grid pass\n");
+            return false;
+        }
+
+        // A transient read before anything writes it, and a pass that writes and reads the same resource
+        Model.Passes[1].Accesses[2].IsWrite = false;
+        Model.Build(Graph);
+        if (Graph.Compile(Options, Plan))
+        {
+            printf("Hand graph:  a transient read before it is written compiled\n");
+            return false;
+        }
+
+        Model = MakeHandGraph();
+        Model.Passes[5].Accesses.push_back({ 0, kDepthWrite, true });
+        Model.Build(Graph);
+        if (Graph.Compile(Options, Plan))
+        {
+            printf("Hand graph:  a pass that reads and writes the same resource compiled\n");
+            return false;
+        }
+        return true;
+    }
+
+    GraphModel MakeRandomGraph( mt19937& Random, uint32_t NumResources, uint32_t NumPasses, uint32_t MaxAccesses )
+    {
+        GraphModel Model;
+        for (uint32_t i = 0; i < NumResources; ++i)
+        {
+            ResourceModel Res = {};
+            Res.IsTransient = Random() % 2 == 0;
+            Res.InitialState = Random() % 2 ? kWriteStates[Random() % 4] : kReadStates[Random() % 4];
+            Res.FinalState = FrameGraphCompiler::kNoFinalState;
+            Res.Alignment = Res.IsTransient ? (uint64_t)4096 << (Random() % 5) : 1;
+            Res.SizeInBytes = Res.IsTransient ? (1 + Random() % 16) * 4096 : 0;
+            if (!Res.IsTransient)
+            {
+                Res.IsOutput = Random() % 3 == 0;
+                if (Random() % 2 == 0)
+                    Res.FinalState = kReadStates[Random() % 4];
+            }
+            Model.Resources.push_back(Res);
+        }
+
+        vector<bool> Written(NumResources, false);
+        for (uint32_t p = 0; p < NumPasses; ++p)
+        {
+            PassModel Pass;
+            Pass.Queue = Random() % 2 ? FrameGraphCompiler::kComputeQueue : FrameGraphCompiler::kGraphicsQueue;
+            Pass.HasSideEffects = Random() % 6 == 0;
+
+            // Compute passes mostly stick to the states the compute queue accepts
+            const bool ComputeStates = Pass.Queue == FrameGraphCompiler::kComputeQueue && Random() % 4 != 0;
+
+            vector<bool> Used(NumResources, false);
+            for (uint32_t Accesses = 1 + Random() % MaxAccesses; Accesses > 0; --Accesses)
+            {
+                uint32_t Res = Random() % NumResources;
+                if (Used[Res])
+                    continue;
+                Used[Res] = true;
+
+                AccessModel Acc;
+                Acc.Resource = Res;
+                Acc.IsWrite = Random() % 3 == 0 || (Model.Resources[Res].IsTransient && !Written[Res]);
+                if (ComputeStates)
+                    Acc.State = Acc.IsWrite ? (Random() % 2 ? kUAV : kCopyDest) : (Random() % 2 ? kNonPixelSRV : kCopySource);
+                else
+                    Acc.State = Acc.IsWrite ? kWriteStates[Random() % 4] : kReadStates[Random() % 4];
+
+                Written[Res] = Written[Res] || Acc.IsWrite;
+                Pass.Accesses.push_back(Acc);
+            }
+            Model.Passes.push_back(Pass);
+        }
+        return Model;
+    }
+
+    bool CheckRandomGraphs( uint32_t NumGraphs, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        FrameGraphCompiler Graph;
+        uint64_t NumCulled = 0, NumAsync = 0, BytesSaved = 0;
+
+        for (uint32_t GraphIndex = 0; GraphIndex < NumGraphs; ++GraphIndex)
+        {
+            const uint32_t NumResources = 1 + Random() % 10;
+            const uint32_t NumPasses = 1 + Random() % 14;
+            GraphModel Model = MakeRandomGraph(Random, NumResources, NumPasses, 4);
+            Model.Build(Graph);
+
+            for (uint32_t Flags = 0; Flags < 32; ++Flags)
+            {
+                FrameGraphCompileOptions Options;
+                Options.CullPasses = (Flags & 1) != 0;
+                Options.AliasTransients = (Flags & 2) != 0;
+                Options.AsyncCompute = (Flags & 4) != 0;
+                Options.UseSplitBarriers = (Flags & 8) != 0;
+                Options.CombineReads = (Flags & 16) != 0;
+
+                char Name[64];
+                snprintf(Name, sizeof(Name), "Random graph %u, options %x", GraphIndex, Flags);
+
+                FrameGraphPlan Plan;
+                string Error;
+                if (!Graph.Compile(Options, Plan, &Error))
+                {
+                    printf("%s:  %s\n", Name, Error.c_str());
+                    return false;
+                }
+                if (!CheckPlan(Model, Options, Plan, Name))
+                    return false;
+
+                if (Flags == 31)
+                {
+                    NumCulled += Plan.Stats.NumCulledPasses;
+                    NumAsync += Plan.Stats.NumAsyncPasses;
+                    BytesSaved += Plan.Stats.TransientBytes - Plan.Stats.TransientHeapSize;
+                }
+            }
+        }
+
+        printf("%u random graphs passed under 32 option sets, with %llu passes culled, %llu run async, and %llu KB\n"
+            "saved by aliasing.\n\n", NumGraphs, (unsigned long long)NumCulled, (unsigned long long)NumAsync,
+            (unsigned long long)BytesSaved / 1024);
+        return true;
+    }
+}
+
+int main( void )
+{
+    if (!CheckHandGraph())
+        return 1;
+
+    printf("The hand-written graph culls, runs async and aliases as expected.\n");
+
+    if (!CheckRandomGraphs(4000, 3))
+        return 1;
+
+    mt19937 Random(5);
+    GraphModel Model = MakeRandomGraph(Random, 150, 300, 6);
+    FrameGraphCompiler Graph;
+    Model.Build(Graph);
+
+    FrameGraphCompileOptions Options;
+    FrameGraphPlan Plan;
+    if (!Graph.Compile(Options, Plan) || !CheckPlan(Model, Options, Plan, "Large graph"))
+        return 1;
+
+    const uint32_t NumRuns = 20;
+    auto Start = chrono::steady_clock::now();
+    for (uint32_t Run = 0; Run < NumRuns; ++Run)
+        Graph.Compile(Options, Plan);
+    const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count() / NumRuns;
+
+    const FrameGraphStats& Stats = Plan.Stats;
+    printf("%zu passes and %zu resources:  %u passes kept, %u async with %u waits, %u barriers (%u split),\n"
+        "%llu KB of transients in a %llu KB heap.  Compile() takes %.2f ms.\n", Model.Passes.size(), Model.Resources.size(),
+        Stats.NumPasses, Stats.NumAsyncPasses, Stats.NumSyncPoints, Stats.NumBarriers, Stats.NumSplitBarriers,
+        (unsigned long long)Stats.TransientBytes / 1024, (unsigned long long)Stats.TransientHeapSize / 1024, Seconds * 1e3);
+    return 0;
+}
@@ -0,0 +1,374 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks the H3D version 2 container and times loading a model from it against version 1.
+// Sections of odd sizes must come back from Write() and Parse() byte for byte, each on a 4K boundary, with
+// empty ones left out.  Files that are truncated, misaligned, list a section twice or have a bad header must
+// be refused, and so must a change to any byte after the header unless the hash isn't checked.
+//
+// Then it writes models of two sizes both ways into the directory given on the command line (the current
+// one by default) and loads each the way Model::LoadH3D() does:
+//
+//   * version 1 as before:  fread() the header, meshes and materials, then each stream into its own new[]
+//     buffer, the indices twice, copy every stream to the upload buffer, and free them
+//   * version 2:  map the file, Parse() it with and without checking the hash, copy the header, meshes and
+//     materials, and copy the streams to the upload buffer straight from the mapping
+//
+// A plain buffer stands in for the upload heap, so this measures the CPU side of a load.  The files are
+// read warm, so it is the cost of getting cached data into the loader, not of the disk.  Returns nonzero
+// on the first failed check.  Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core /I..\..\Model H3DBenchmark.cpp ..\..\Model\H3DFile.cpp ..\..\Core\Hash.cpp ..\..\Core\MappedFile.cpp
+//     g++ -std=c++14 -O2 -I../../Core -I../../Model H3DBenchmark.cpp ../../Model/H3DFile.cpp ../../Core/Hash.cpp ../../Core/MappedFile.cpp -o H3DBenchmark
+
+#include "H3DFile.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace H3DFile;
+
+namespace
+{
+    // How Model lays out its header, meshes and materials in a 64-bit build
+    const uint32_t kHeaderSize = 64;
+    const uint32_t kMeshSize = 336;
+    const uint32_t kMaterialSize = 992;
+
+    bool Fail( const char* Message )
+    {
+        printf("%s\n", Message);
+        return false;
+    }
+
+    string Narrow( const wstring& Wide )
+    {
+        return string(Wide.begin(), Wide.end());
+    }
+
+    vector<uint8_t> RandomBytes( size_t Size, mt19937& Random )
+    {
+        vector<uint8_t> Bytes(Size);
+        for (uint8_t& Byte : Bytes)
+            Byte = (uint8_t)Random();
+        return Bytes;
+    }
+
+    bool CheckRoundTrip( void )
+    {
+        mt19937 Random(1);
+
+        // Nothing lines up with a page, and the depth-only indices are left out
+        const size_t kSizes[kNumSectionTypes] = { kHeaderSize, 3 * kMeshSize, 2 * kMaterialSize, 5000 * 56, 3 * 1111 * 2, 5000 * 12, 0 };
+        const uint32_t kElementSizes[kNumSectionTypes] = { kHeaderSize, kMeshSize, kMaterialSize, 1, 1, 1, 1 };
+
+        vector<uint8_t> Contents[kNumSectionTypes];
+        SectionView In[kNumSectionTypes];
+        for (uint32_t Type = 0; Type < kNumSectionTypes; ++Type)
+        {
+            Contents[Type] = RandomBytes(kSizes[Type], Random);
+            In[Type].Data = Contents[Type].data();
+            In[Type].Size = Contents[Type].size();
+            In[Type].ElementSize = kElementSizes[Type];
+        }
+
+        vector<uint8_t> File;
+        Write(In, File);
+
+        SectionView Out[kNumSectionTypes];
+        if (File.size() % kSectionAlignment != 0 || !IsH3DFile(File.data(), File.size()) || !Parse(File.data(), File.size(), Out))
+            return Fail("A file just written was refused");
+
+        for (uint32_t Type = 0; Type < kNumSectionTypes; ++Type)
+        {
+            if (kSizes[Type] == 0)
+            {
+                if (Out[Type].Data != nullptr)
+                    return Fail("An empty section was written");
+                continue;
+            }
+
+            if (Out[Type].Size != kSizes[Type] || Out[Type].ElementSize != kElementSizes[Type] ||
+                memcmp(Out[Type].Data, Contents[Type].data(), kSizes[Type]) != 0)
+            {
+                return Fail("A section didn't come back as it was written");
+            }
+
+            if ((Out[Type].Data - File.data()) % kSectionAlignment != 0)
+                return Fail("A section doesn't start on a 4K boundary");
+        }
+
+        // A model with nothing in it is a header and a page
+        SectionView Empty[kNumSectionTypes] = {};
+        vector<uint8_t> EmptyFile;
+        Write(Empty, EmptyFile);
+        if (EmptyFile.size() != kSectionAlignment || !Parse(EmptyFile.data(), EmptyFile.size(), Out))
+            return Fail("An empty model didn't round trip");
+
+        // Version 1 files start with the mesh count, not the magic
+        const uint32_t Version1[4] = { 12, 3, 4096, 1024 };
+        if (IsH3DFile((const uint8_t*)Version1, sizeof(Version1)) || IsH3DFile(File.data(), 3))
+            return Fail("A version 1 file, or too few bytes, was taken for version 2");
+
+        return true;
+    }
+
+    bool CheckRejects( void )
+    {
+        mt19937 Random(2);
+        vector<uint8_t> Vertices = RandomBytes(100000, Random), Indices = RandomBytes(30000, Random);
+        SectionView In[kNumSectionTypes] = {};
+        In[kVertexData] = { Vertices.data(), Vertices.size(), 1 };
+        In[kIndexData] = { Indices.data(), Indices.size(), 1 };
+
+        vector<uint8_t> File;
+        Write(In, File);
+
+        SectionView Out[kNumSectionTypes];
+        const size_t TableOffset = sizeof(Header);
+
+        // The header:  magic, version, and the file size it records
+        for (size_t Offset : { (size_t)0, (size_t)4, (size_t)16 })
+        {
+            vector<uint8_t> Corrupt = File;
+            Corrupt[Offset] ^= 1;
+            if (Parse(Corrupt.data(), Corrupt.size(), Out, false))
+                return Fail("A file with a bad header was accepted");
+        }
+
+        // The hash covers the table of contents and every section, up to the last byte of padding
+        for (size_t Offset : { TableOffset + 20, (size_t)kSectionAlignment + 5, File.size() / 2, File.size() - 1 })
+        {
+            vector<uint8_t> Corrupt = File;
+            Corrupt[Offset] ^= 1;
+            if (Parse(Corrupt.data(), Corrupt.size(), Out))
+                return Fail("A changed byte got past the hash");
+            if (Offset != TableOffset + 20 && !Parse(Corrupt.data(), Corrupt.size(), Out, false))
+                return Fail("A changed section byte was refused without checking the hash");
+        }
+
+        if (Parse(File.data(), File.size() - kSectionAlignment, Out, false) || Parse(File.data(), 16, Out, false))
+            return Fail("A truncated file was accepted");
+
+        // A section that doesn't start on a page, that runs past the end, or that is listed twice
+        vector<uint8_t> Misaligned = File;
+        const uint64_t BadOffset = kSectionAlignment + 4;
+        memcpy(Misaligned.data() + TableOffset + offsetof(Section, Offset), &BadOffset, sizeof(BadOffset));
+        if (Parse(Misaligned.data(), Misaligned.size(), Out, false))
+            return Fail("A section that doesn't start on a page was accepted");
+
+        vector<uint8_t> Overrun = File;
+        const uint64_t BadSize = File.size();
+        memcpy(Overrun.data() + TableOffset + offsetof(Section, Size), &BadSize, sizeof(BadSize));
+        if (Parse(Overrun.data(), Overrun.size(), Out, false))
+            return Fail("A section that runs past the end of the file was accepted");
+
+        vector<uint8_t> Duplicate = File;
+        const uint32_t VertexType = kVertexData;
+        memcpy(Duplicate.data() + TableOffset + sizeof(Section) + offsetof(Section, Type), &VertexType, sizeof(VertexType));
+        if (Parse(Duplicate.data(), Duplicate.size(), Out, false))
+            return Fail("A section listed twice was accepted");
+
+        return true;
+    }
+
+    struct ModelSize
+    {
+        const char* Name;
+        uint32_t NumMeshes;
+        uint32_t NumMaterials;
+        size_t VertexBytes;
+        size_t IndexBytes;
+        size_t DepthVertexBytes;
+    };
+
+    struct ModelFiles
+    {
+        vector<uint8_t> Meshes;
+        vector<uint8_t> Materials;
+        size_t VertexBytes;
+        size_t IndexBytes;
+        size_t DepthVertexBytes;
+        wstring Version1;
+        wstring Version2;
+    };
+
+    // Version 1 is the header and then each array in turn, the indices twice
+    bool WriteModel( const ModelSize& Size, const wstring& Prefix, ModelFiles& Files )
+    {
+        mt19937 Random(Size.NumMeshes);
+        const vector<uint8_t> Header = RandomBytes(kHeaderSize, Random);
+        const vector<uint8_t> Vertices = RandomBytes(Size.VertexBytes, Random);
+        const vector<uint8_t> Indices = RandomBytes(Size.IndexBytes, Random);
+        const vector<uint8_t> DepthVertices = RandomBytes(Size.DepthVertexBytes, Random);
+        Files.Meshes = RandomBytes(Size.NumMeshes * kMeshSize, Random);
+        Files.Materials = RandomBytes(Size.NumMaterials * kMaterialSize, Random);
+        Files.VertexBytes = Size.VertexBytes;
+        Files.IndexBytes = Size.IndexBytes;
+        Files.DepthVertexBytes = Size.DepthVertexBytes;
+        Files.Version1 = Prefix + L"1.h3d";
+        Files.Version2 = Prefix + L"2.h3d";
+
+        const vector<uint8_t>* Parts[] = { &Header, &Files.Meshes, &Files.Materials, &Vertices, &Indices, &DepthVertices, &Indices };
+        vector<uint8_t> Version1;
+        for (const vector<uint8_t>* Part : Parts)
+            Version1.insert(Version1.end(), Part->begin(), Part->end());
+
+        SectionView Sections[kNumSectionTypes] = {};
+        Sections[kModelHeader] = { Header.data(), Header.size(), kHeaderSize };
+        Sections[kMeshes] = { Files.Meshes.data(), Files.Meshes.size(), kMeshSize };
+        Sections[kMaterials] = { Files.Materials.data(), Files.Materials.size(), kMaterialSize };
+        Sections[kVertexData] = { Vertices.data(), Vertices.size(), 1 };
+        Sections[kIndexData] = { Indices.data(), Indices.size(), 1 };
+        Sections[kVertexDataDepth] = { DepthVertices.data(), DepthVertices.size(), 1 };
+
+        vector<uint8_t> Version2;
+        Write(Sections, Version2);
+
+        return MappedFile::WriteAtomic(Files.Version1, Version1.data(), Version1.size()) &&
+            MappedFile::WriteAtomic(Files.Version2, Version2.data(), Version2.size());
+    }
+
+    // What the old Model::LoadH3D() did before creating the buffers
+    bool LoadVersion1( const ModelFiles& Files, vector<uint8_t>& Upload )
+    {
+        FILE* File = fopen(Narrow(Files.Version1).c_str(), "rb");
+        if (File == nullptr)
+            return false;
+
+        uint8_t Header[kHeaderSize];
+        uint8_t* Meshes = new uint8_t[Files.Meshes.size()];
+        uint8_t* Materials = new uint8_t[Files.Materials.size()];
+        bool Ok = fread(Header, sizeof(Header), 1, File) == 1 &&
+            fread(Meshes, Files.Meshes.size(), 1, File) == 1 &&
+            fread(Materials, Files.Materials.size(), 1, File) == 1;
+
+        const size_t StreamSizes[] = { Files.VertexBytes, Files.IndexBytes, Files.DepthVertexBytes, Files.IndexBytes };
+        size_t UploadOffset = 0;
+        for (size_t StreamSize : StreamSizes)
+        {
+            uint8_t* Stream = new uint8_t[StreamSize];
+            Ok = Ok && fread(Stream, StreamSize, 1, File) == 1;
+            if (Ok)
+                memcpy(Upload.data() + UploadOffset, Stream, StreamSize);
+            UploadOffset += StreamSize;
+            delete [] Stream;
+        }
+
+        fclose(File);
+        Ok = Ok && memcmp(Meshes, Files.Meshes.data(), Files.Meshes.size()) == 0;
+        delete [] Meshes;
+        delete [] Materials;
+        return Ok;
+    }
+
+    // What Model::LoadH3D() does now
+    bool LoadVersion2( const ModelFiles& Files, vector<uint8_t>& Upload, bool VerifyHash )
+    {
+        ByteView File = MappedFile::Map(Files.Version2);
+        SectionView Sections[kNumSectionTypes];
+        if (File.empty() || !Parse(File.data(), File.size(), Sections, VerifyHash))
+            return false;
+
+        uint8_t Header[kHeaderSize];
+        memcpy(Header, Sections[kModelHeader].Data, kHeaderSize);
+        uint8_t* Meshes = new uint8_t[Sections[kMeshes].Size];
+        uint8_t* Materials = new uint8_t[Sections[kMaterials].Size];
+        memcpy(Meshes, Sections[kMeshes].Data, Sections[kMeshes].Size);
+        memcpy(Materials, Sections[kMaterials].Data, Sections[kMaterials].Size);
+
+        size_t UploadOffset = 0;
+        for (SectionType Type : { kVertexData, kIndexData, kVertexDataDepth })
+        {
+            memcpy(Upload.data() + UploadOffset, Sections[Type].Data, Sections[Type].Size);
+            UploadOffset += Sections[Type].Size;
+        }
+
+        const bool Ok = Sections[kIndexDataDepth].Data == nullptr && memcmp(Meshes, Files.Meshes.data(), Files.Meshes.size()) == 0;
+        delete [] Meshes;
+        delete [] Materials;
+        return Ok;
+    }
+
+    template <typename Body>
+    double BestMs( uint32_t NumRuns, Body&& Load )
+    {
+        double Best = 1e30;
+        for (uint32_t Run = 0; Run < NumRuns; ++Run)
+        {
+            auto Start = chrono::steady_clock::now();
+            if (!Load())
+                return -1.0;
+            Best = min(Best, chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count());
+        }
+        return Best;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    if (!CheckRoundTrip() || !CheckRejects())
+        return 1;
+
+    printf("Sections round trip on 4K boundaries, and bad headers, tables and contents are refused.\n\n");
+
+    string Dir = argc > 1 ? argv[1] : ".";
+    const wstring Prefix = wstring(Dir.begin(), Dir.end()) + L"/H3DBenchmark";
+
+    // About Sponza's size, and a model eight times as large
+    const ModelSize kModels[] =
+    {
+        { "Small", 400, 30, 10 << 20, 3 << 20, 3 << 20 },
+        { "Large", 3200, 240, 80 << 20, 24 << 20, 24 << 20 },
+    };
+
+    printf("%6s %10s %10s %14s %14s %14s\n", "", "Version 1", "Version 2", "Version 1", "Version 2", "No hash");
+
+    bool Passed = true;
+    for (const ModelSize& Size : kModels)
+    {
+        ModelFiles Files;
+        const string Name = Size.Name;
+        if (!WriteModel(Size, Prefix + wstring(Name.begin(), Name.end()), Files))
+        {
+            printf("Couldn't write the %s model in %s\n", Size.Name, Dir.c_str());
+            return 1;
+        }
+
+        uint64_t Version1Size = 0, Version2Size = 0;
+        MappedFile::GetFileSize(Files.Version1, Version1Size);
+        MappedFile::GetFileSize(Files.Version2, Version2Size);
+
+        vector<uint8_t> Upload(Size.VertexBytes + 2 * Size.IndexBytes + Size.DepthVertexBytes);
+        const double Version1Ms = BestMs(5, [&]{ return LoadVersion1(Files, Upload); });
+        const double Version2Ms = BestMs(5, [&]{ return LoadVersion2(Files, Upload, true); });
+        const double NoHashMs = BestMs(5, [&]{ return LoadVersion2(Files, Upload, false); });
+
+        remove(Narrow(Files.Version1).c_str());
+        remove(Narrow(Files.Version2).c_str());
+
+        if (Version1Ms < 0.0 || Version2Ms < 0.0 || NoHashMs < 0.0)
+        {
+            printf("The %s model didn't load back as it was written\n", Size.Name);
+            Passed = false;
+            break;
+        }
+
+        printf("%6s %7.1f MB %7.1f MB %11.1f ms %11.1f ms %11.1f ms\n", Size.Name, Version1Size / 1e6, Version2Size / 1e6,
+            Version1Ms, Version2Ms, NoHashMs);
+    }
+
+    return Passed ? 0 : 1;
+}
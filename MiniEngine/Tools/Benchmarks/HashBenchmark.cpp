@@ -0,0 +1,178 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks Utility::HashRange() against a bit-at-a-time CRC32-C and reports its throughput.
+// The hashes are persisted in the PSO disk cache, so the SSE4.2 and table-driven paths must agree bit for
+// bit, for every length and alignment, and must keep agreeing with the reference below.  Returns nonzero
+// on the first mismatch.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core HashBenchmark.cpp ..\..\Core\Hash.cpp
+//     g++ -std=c++14 -O2 -I../../Core HashBenchmark.cpp ../../Core/Hash.cpp -o HashBenchmark
+
+#include "Hash.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace Utility;
+
+namespace
+{
+    uint32_t ReferenceCrc32c( uint32_t Crc, const void* Data, size_t Size )
+    {
+        const uint8_t* Bytes = (const uint8_t*)Data;
+        for (size_t i = 0; i < Size; ++i)
+        {
+            Crc ^= Bytes[i];
+            for (int Bit = 0; Bit < 8; ++Bit)
+                Crc = (Crc >> 1) ^ (0x82F63B78u & (0u - (Crc & 1)));
+        }
+        return Crc;
+    }
+
+    uint32_t ReferenceCrc32c( uint32_t Crc, uint64_t Word )
+    {
+        return ReferenceCrc32c(Crc, &Word, sizeof(Word));
+    }
+
+    // A single chain is a plain CRC32-C of the bytes, seeded with the low half of the hash
+    size_t ReferenceHashSingle( const uint32_t* Begin, const uint32_t* End, size_t Hash )
+    {
+        return ReferenceCrc32c((uint32_t)Hash, Begin, (End - Begin) * sizeof(uint32_t));
+    }
+
+    // Mirrors the lane layout and constants in Hash.cpp.  A change there changes every PSO cache key.
+    size_t ReferenceHashInterleaved( const uint32_t* Iter, const uint32_t* End, size_t Hash )
+    {
+        uint32_t Crc0 = (uint32_t)Hash;
+        uint32_t Crc1 = Crc0 ^ 0x9E3779B9u;
+        uint32_t Crc2 = Crc0 ^ 0x85EBCA6Bu;
+
+        for (; Iter + 6 <= End; Iter += 6)
+        {
+            Crc0 = ReferenceCrc32c(Crc0, Iter, 8);
+            Crc1 = ReferenceCrc32c(Crc1, Iter + 2, 8);
+            Crc2 = ReferenceCrc32c(Crc2, Iter + 4, 8);
+        }
+
+        Crc0 = (uint32_t)ReferenceHashSingle(Iter, End, Crc0);
+        Crc0 = ReferenceCrc32c(Crc0, Crc1 * 0x9E3779B97F4A7C15ull);
+        return ReferenceCrc32c(Crc0, Crc2 * 0xC2B2AE3D27D4EB4Full);
+    }
+
+    size_t ReferenceHashRange( const uint32_t* Begin, const uint32_t* End, size_t Hash )
+    {
+        if ((size_t)(End - Begin) >= HashInternal::kInterleavedHashMinWords)
+            return ReferenceHashInterleaved(Begin, End, Hash);
+        else
+            return ReferenceHashSingle(Begin, End, Hash);
+    }
+
+    bool CheckAgainstReference( bool UseHardware, const vector<uint32_t>& Words )
+    {
+        HashInternal::g_CpuHasCrc32 = UseHardware;
+
+        // Both word alignments of a 64-bit load, every length through a few interleaved iterations
+        for (size_t Offset = 0; Offset < 2; ++Offset)
+        {
+            for (size_t Length = 0; Length <= 300; ++Length)
+            {
+                const uint32_t* Begin = Words.data() + Offset;
+                const uint32_t* End = Begin + Length;
+                const size_t Seed = 2166136261U + Length;
+
+                if (HashRange(Begin, End, Seed) != ReferenceHashRange(Begin, End, Seed) ||
+                    HashInternal::HashRangeSingle(Begin, End, Seed) != ReferenceHashSingle(Begin, End, Seed))
+                {
+                    printf("%s path disagrees with the reference:  %zu words at offset %zu\n",
+                        UseHardware ? "SSE4.2" : "Software", Length, Offset);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    double MeasureGBps( size_t (*HashFunc)(const uint32_t*, const uint32_t*, size_t), const vector<uint32_t>& Words,
+        size_t RangeWords, size_t& Sink )
+    {
+        const size_t TotalBytes = (size_t)1 << 30;
+        const size_t Repeats = TotalBytes / (RangeWords * sizeof(uint32_t));
+        const size_t NumRanges = Words.size() / RangeWords;
+
+        auto Start = chrono::steady_clock::now();
+        for (size_t i = 0; i < Repeats; ++i)
+        {
+            const uint32_t* Begin = Words.data() + (i % NumRanges) * RangeWords;
+            Sink += HashFunc(Begin, Begin + RangeWords, i);
+        }
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+
+        return Repeats * RangeWords * sizeof(uint32_t) / Seconds / 1e9;
+    }
+}
+
+int main( void )
+{
+    const bool HasCrc32 = HashInternal::g_CpuHasCrc32;
+
+    // The standard CRC32-C check value, which validates the reference itself
+    if ((ReferenceCrc32c(0xFFFFFFFF, "123456789", 9) ^ 0xFFFFFFFF) != 0xE3069283)
+    {
+        printf("The reference CRC32-C is wrong\n");
+        return 1;
+    }
+
+    mt19937 Random(1);
+    vector<uint32_t> Words(1 << 22);
+    for (uint32_t& Word : Words)
+        Word = Random();
+
+    if (!CheckAgainstReference(false, Words) || (HasCrc32 && !CheckAgainstReference(true, Words)))
+        return 1;
+
+    printf("SSE4.2 %s.  %s the reference for 0-300 words at both alignments.\n\n",
+        HasCrc32 ? "present" : "absent", HasCrc32 ? "Software and SSE4.2 paths match" : "Software path matches");
+
+    static const size_t kRangeBytes[] = { 64, 256, 4096, 65536, 16 << 20 };
+
+    printf("%10s %14s %14s %14s %14s\n", "Bytes", "SSE4.2 single", "SSE4.2 3-lane", "Soft single", "Soft 3-lane");
+
+    size_t Sink = 0;
+    for (size_t RangeBytes : kRangeBytes)
+    {
+        const size_t RangeWords = RangeBytes / sizeof(uint32_t);
+        double Rates[4] = {};
+
+        if (HasCrc32)
+        {
+            HashInternal::g_CpuHasCrc32 = true;
+            Rates[0] = MeasureGBps(HashInternal::HashRangeSingle, Words, RangeWords, Sink);
+            Rates[1] = MeasureGBps(HashRange, Words, RangeWords, Sink);
+        }
+
+        HashInternal::g_CpuHasCrc32 = false;
+        Rates[2] = MeasureGBps(HashInternal::HashRangeSingle, Words, RangeWords, Sink);
+        Rates[3] = MeasureGBps(HashRange, Words, RangeWords, Sink);
+
+        printf("%10zu %11.2f GB/s %9.2f GB/s %9.2f GB/s %9.2f GB/s\n", RangeBytes, Rates[0], Rates[1], Rates[2], Rates[3]);
+    }
+
+    HashInternal::g_CpuHasCrc32 = HasCrc32;
+
+    // Printed so that the hashing can't be optimized away.  Ranges under 256 bytes never take the 3-lane
+    // path, so both columns time the same code there.
+    printf("\n(%zx)\n", Sink);
+    return 0;
+}
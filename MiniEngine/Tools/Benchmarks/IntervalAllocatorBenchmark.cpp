@@ -0,0 +1,290 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks IntervalAllocator placements by brute force.  For random sets of intervals, no two
+// that are live at the same time may overlap in memory, every block must be aligned and inside the heap,
+// and each must sit at the lowest aligned offset clear of the larger blocks placed before it.  Without
+// aliasing nothing may overlap at all.  GetPeakLiveSize() and GetTotalSize() are recomputed one time step
+// and one block at a time, and the heap may never be smaller than the peak.
+//
+// Then it reports how close first-fit decreasing gets to the peak, for random intervals and for nested
+// scopes like those BufferManager opens, and times Allocate().  Returns nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core IntervalAllocatorBenchmark.cpp ..\..\Core\IntervalAllocator.cpp
+//     g++ -std=c++14 -O2 -I../../Core IntervalAllocatorBenchmark.cpp ../../Core/IntervalAllocator.cpp -o IntervalAllocatorBenchmark
+
+#include "IntervalAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    struct Block
+    {
+        uint32_t Begin;
+        uint32_t End;
+        uint64_t SizeInBytes;
+        uint64_t Alignment;
+    };
+
+    bool LiveTogether( const Block& A, const Block& B )
+    {
+        return A.Begin <= B.End && B.Begin <= A.End;
+    }
+
+    bool RangesOverlap( uint64_t A, uint64_t SizeA, uint64_t B, uint64_t SizeB )
+    {
+        return A < B + SizeB && B < A + SizeA;
+    }
+
+    uint64_t AlignUp( uint64_t Value, uint64_t Alignment )
+    {
+        return (Value + Alignment - 1) / Alignment * Alignment;
+    }
+
+    bool CheckPlacement( const vector<Block>& Blocks, bool Alias, const char* Name )
+    {
+        IntervalAllocator Allocator;
+        for (const Block& Next : Blocks)
+            Allocator.AddInterval(Next.Begin, Next.End, Next.SizeInBytes, Next.Alignment);
+
+        const uint64_t HeapSize = Allocator.Allocate(Alias);
+        const uint32_t NumBlocks = (uint32_t)Blocks.size();
+
+        uint64_t TotalSize = 0, MaxAlignment = 1;
+        for (const Block& Next : Blocks)
+        {
+            TotalSize += AlignUp(Next.SizeInBytes, Next.Alignment);
+            MaxAlignment = max(MaxAlignment, Next.Alignment);
+        }
+
+        if (HeapSize != Allocator.GetHeapSize() || Allocator.GetHeapAlignment() != MaxAlignment || HeapSize % MaxAlignment != 0)
+        {
+            printf("%s:  heap of %llu bytes is not a multiple of the largest alignment %llu\n", Name,
+                (unsigned long long)HeapSize, (unsigned long long)MaxAlignment);
+            return false;
+        }
+        if (Allocator.GetTotalSize() != TotalSize)
+        {
+            printf("%s:  GetTotalSize() is %llu, expected %llu\n", Name, (unsigned long long)Allocator.GetTotalSize(),
+                (unsigned long long)TotalSize);
+            return false;
+        }
+
+        // The most memory live at any time step
+        uint32_t LastTime = 0;
+        for (const Block& Next : Blocks)
+            LastTime = max(LastTime, Next.End);
+
+        uint64_t PeakLive = 0;
+        for (uint32_t Time = 0; Time <= LastTime; ++Time)
+        {
+            uint64_t Live = 0;
+            for (const Block& Next : Blocks)
+            {
+                if (Next.Begin <= Time && Time <= Next.End)
+                    Live += Next.SizeInBytes;
+            }
+            PeakLive = max(PeakLive, Live);
+        }
+
+        if (Allocator.GetPeakLiveSize() != PeakLive)
+        {
+            printf("%s:  GetPeakLiveSize() is %llu, expected %llu\n", Name, (unsigned long long)Allocator.GetPeakLiveSize(),
+                (unsigned long long)PeakLive);
+            return false;
+        }
+        if (HeapSize < PeakLive)
+        {
+            printf("%s:  heap of %llu bytes is smaller than the %llu bytes live at once\n", Name,
+                (unsigned long long)HeapSize, (unsigned long long)PeakLive);
+            return false;
+        }
+
+        for (uint32_t A = 0; A < NumBlocks; ++A)
+        {
+            const uint64_t Offset = Allocator.GetOffset(A);
+            if (Offset % Blocks[A].Alignment != 0 || Offset + Blocks[A].SizeInBytes > HeapSize)
+            {
+                printf("%s:  block %u at %llu is misaligned or outside the heap\n", Name, A, (unsigned long long)Offset);
+                return false;
+            }
+
+            for (uint32_t B = A + 1; B < NumBlocks; ++B)
+            {
+                if (Allocator.LifetimesOverlap(A, B) != LiveTogether(Blocks[A], Blocks[B]))
+                {
+                    printf("%s:  LifetimesOverlap(%u, %u) is wrong\n", Name, A, B);
+                    return false;
+                }
+
+                const bool Conflict = !Alias || LiveTogether(Blocks[A], Blocks[B]);
+                if (Conflict && RangesOverlap(Offset, Blocks[A].SizeInBytes, Allocator.GetOffset(B), Blocks[B].SizeInBytes))
+                {
+                    printf("%s:  blocks %u and %u share memory while both are live\n", Name, A, B);
+                    return false;
+                }
+            }
+
+            // Larger blocks, and equal ones that begin earlier or were added earlier, are placed first.  No
+            // lower aligned offset may be clear of all of those that are live at the same time.
+            for (uint64_t Lower = 0; Lower < Offset; Lower += Blocks[A].Alignment)
+            {
+                bool Clear = true;
+                for (uint32_t B = 0; B < NumBlocks && Clear; ++B)
+                {
+                    const bool PlacedBefore = Blocks[B].SizeInBytes > Blocks[A].SizeInBytes ||
+                        (Blocks[B].SizeInBytes == Blocks[A].SizeInBytes &&
+                            (Blocks[B].Begin < Blocks[A].Begin || (Blocks[B].Begin == Blocks[A].Begin && B < A)));
+                    if (PlacedBefore && (!Alias || LiveTogether(Blocks[A], Blocks[B])))
+                        Clear = !RangesOverlap(Lower, Blocks[A].SizeInBytes, Allocator.GetOffset(B), Blocks[B].SizeInBytes);
+                }
+                if (Clear)
+                {
+                    printf("%s:  block %u was placed at %llu, but %llu was free\n", Name, A, (unsigned long long)Offset,
+                        (unsigned long long)Lower);
+                    return false;
+                }
+            }
+        }
+
+        if (!Allocator.Validate())
+        {
+            printf("%s:  Validate() rejected a correct placement\n", Name);
+            return false;
+        }
+        return true;
+    }
+
+    vector<Block> MakeRandomBlocks( mt19937& Random, uint32_t NumBlocks, uint32_t NumSteps )
+    {
+        vector<Block> Blocks(NumBlocks);
+        for (Block& Next : Blocks)
+        {
+            Next.Begin = Random() % NumSteps;
+            Next.End = Next.Begin + Random() % 6;
+            Next.SizeInBytes = (1 + Random() % 64) * 4096;
+            Next.Alignment = (uint64_t)4096 << (Random() % 5);
+        }
+        return Blocks;
+    }
+
+    // Scopes nested as BufferManager opens them:  each scope lasts as long as its children, and holds a
+    // few render targets for all of that time
+    void AddScope( mt19937& Random, vector<Block>& Blocks, uint32_t& Time, uint32_t Depth )
+    {
+        const uint32_t Begin = Time;
+        const uint32_t NumChildren = Depth < 3 ? Random() % 4 : 0;
+        for (uint32_t Child = 0; Child < NumChildren; ++Child)
+            AddScope(Random, Blocks, Time, Depth + 1);
+        const uint32_t End = Time++;
+
+        for (uint32_t Target = 1 + Random() % 3; Target > 0; --Target)
+        {
+            // 1920x1080 at 4, 8 or 16 bytes a pixel, or a half or quarter resolution buffer
+            const uint64_t Pixels = (1920ull * 1080) >> (2 * (Random() % 3));
+            const uint64_t Size = AlignUp(Pixels * (4ull << (Random() % 3)), 65536);
+            Block Next = { Begin, End, Size, 65536 };
+            Blocks.push_back(Next);
+        }
+    }
+}
+
+int main( void )
+{
+    // Two blocks that are never live together share memory, and one live alongside both goes after them
+    const vector<Block> Hand = { { 0, 1, 4 << 20, 65536 }, { 2, 3, 4 << 20, 65536 }, { 1, 2, 2 << 20, 65536 } };
+    {
+        IntervalAllocator Allocator;
+        for (const Block& Next : Hand)
+            Allocator.AddInterval(Next.Begin, Next.End, Next.SizeInBytes, Next.Alignment);
+        if (Allocator.Allocate() != (6 << 20) || Allocator.GetOffset(0) != 0 || Allocator.GetOffset(1) != 0 ||
+            Allocator.GetOffset(2) != (4 << 20))
+        {
+            printf("Hand case:  heap of %llu bytes, offsets %llu, %llu and %llu\n", (unsigned long long)Allocator.GetHeapSize(),
+                (unsigned long long)Allocator.GetOffset(0), (unsigned long long)Allocator.GetOffset(1),
+                (unsigned long long)Allocator.GetOffset(2));
+            return 1;
+        }
+        if (Allocator.Allocate(false) != (10 << 20))
+        {
+            printf("Hand case:  heap of %llu bytes without aliasing, expected %u\n", (unsigned long long)Allocator.GetHeapSize(), 10 << 20);
+            return 1;
+        }
+    }
+
+    mt19937 Random(1);
+    double WorstRatio = 1.0, SumRatio = 0.0;
+    const uint32_t NumRuns = 5000;
+    for (uint32_t Run = 0; Run < NumRuns; ++Run)
+    {
+        const uint32_t NumBlocks = 1 + Random() % 30;
+        vector<Block> Blocks = MakeRandomBlocks(Random, NumBlocks, 20);
+
+        char Name[64];
+        snprintf(Name, sizeof(Name), "Random run %u", Run);
+        if (!CheckPlacement(Blocks, true, Name) || !CheckPlacement(Blocks, false, Name))
+            return 1;
+
+        IntervalAllocator Allocator;
+        for (const Block& Next : Blocks)
+            Allocator.AddInterval(Next.Begin, Next.End, Next.SizeInBytes, Next.Alignment);
+        // The heap is rounded up to the largest alignment, so compare against the peak rounded the same way
+        const uint64_t Heap = Allocator.Allocate();
+        const double Ratio = (double)Heap / AlignUp(Allocator.GetPeakLiveSize(), Allocator.GetHeapAlignment());
+        WorstRatio = max(WorstRatio, Ratio);
+        SumRatio += Ratio;
+    }
+
+    printf("%u random sets of 1-30 intervals placed with nothing live at once sharing memory, each at its lowest free offset.\n",
+        NumRuns);
+    printf("Heap against peak live size:  %.3f on average, %.3f at worst.\n\n", SumRatio / NumRuns, WorstRatio);
+
+    uint64_t TotalSize = 0, HeapSize = 0, PeakSize = 0;
+    for (uint32_t Run = 0; Run < 200; ++Run)
+    {
+        vector<Block> Blocks;
+        uint32_t Time = 0;
+        AddScope(Random, Blocks, Time, 0);
+        if (!CheckPlacement(Blocks, true, "Nested scopes"))
+            return 1;
+
+        IntervalAllocator Allocator;
+        for (const Block& Next : Blocks)
+            Allocator.AddInterval(Next.Begin, Next.End, Next.SizeInBytes, Next.Alignment);
+        HeapSize += Allocator.Allocate();
+        TotalSize += Allocator.GetTotalSize();
+        PeakSize += Allocator.GetPeakLiveSize();
+    }
+    printf("200 nested scope trees:  %.1f MB of render targets in %.1f MB of heap, %.1f MB live at most.\n\n",
+        TotalSize / 200.0 / (1 << 20), HeapSize / 200.0 / (1 << 20), PeakSize / 200.0 / (1 << 20));
+
+    printf("%10s %14s\n", "Intervals", "Allocate()");
+    for (uint32_t NumBlocks = 50; NumBlocks <= 800; NumBlocks *= 2)
+    {
+        IntervalAllocator Allocator;
+        for (const Block& Next : MakeRandomBlocks(Random, NumBlocks, NumBlocks / 2))
+            Allocator.AddInterval(Next.Begin, Next.End, Next.SizeInBytes, Next.Alignment);
+
+        const uint32_t NumAllocations = 20;
+        auto Start = chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NumAllocations; ++i)
+            Allocator.Allocate();
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count() / NumAllocations;
+        printf("%10u %11.1f us\n", NumBlocks, Seconds * 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,569 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks IoScheduler against a mock disk whose reads can be held open, so the queue is in a
+// known state when each check is made.  Reads must start highest priority first and in order of arrival
+// within a priority, and a promoted read must move up.  Requests for the same path, queued or in flight,
+// must share one read and one buffer, and so must Schedule() requests for the same key.  A read that every waiter cancelled must not happen, a shared read
+// must still reach the waiters that didn't cancel, and a request that joins a read just as it is being
+// dropped must still get its data.  Prefetches must never take the last thread, Stop() must drop what is
+// queued and finish what is in flight, and the statistics must add up.
+//
+// Then it times reads that take a millisecond each, with critical requests mixed into a flood of
+// prefetches, and reports the latency of each priority next to what one first-come first-served queue
+// gives.  Returns nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core IoSchedulerBenchmark.cpp ..\..\Core\IoScheduler.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core IoSchedulerBenchmark.cpp ../../Core/IoScheduler.cpp -o IoSchedulerBenchmark
+
+#include "IoScheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <set>
+
+using namespace std;
+
+namespace
+{
+    typedef IoScheduler::Buffer Buffer;
+    typedef shared_future<Buffer> Future;
+
+    // Reads return the path's characters as bytes.  A held path doesn't return until it is released.
+    class MockDisk
+    {
+    public:
+        MockDisk() : m_InFlight(0), m_MaxInFlight(0), m_Delay(0) {}
+
+        Buffer Read( const wstring& Path )
+        {
+            unique_lock<mutex> Lock(m_Mutex);
+            m_Order.push_back(Path);
+            ++m_Reads[Path];
+            m_MaxInFlight = max(m_MaxInFlight, ++m_InFlight);
+            m_Changed.notify_all();
+            m_Changed.wait(Lock, [&]{ return m_Held.count(Path) == 0; });
+            const chrono::microseconds Delay = m_Delay;
+            Lock.unlock();
+
+            if (Delay.count() > 0)
+                this_thread::sleep_for(Delay);
+
+            Lock.lock();
+            --m_InFlight;
+            return make_shared<vector<unsigned char>>(Path.begin(), Path.end());
+        }
+
+        IoScheduler::ReadFunction Function( void ) { return [this]( const wstring& Path ) { return Read(Path); }; }
+
+        void Hold( const wstring& Path )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            m_Held.insert(Path);
+        }
+
+        void Release( const wstring& Path )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            m_Held.erase(Path);
+            m_Changed.notify_all();
+        }
+
+        void WaitUntilStarted( const wstring& Path )
+        {
+            unique_lock<mutex> Lock(m_Mutex);
+            m_Changed.wait(Lock, [&]{ return m_Reads.count(Path) != 0; });
+        }
+
+        uint32_t GetReads( const wstring& Path )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            auto Found = m_Reads.find(Path);
+            return Found == m_Reads.end() ? 0 : Found->second;
+        }
+
+        vector<wstring> GetOrder( void )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            return m_Order;
+        }
+
+        uint32_t GetMaxInFlight( void )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            return m_MaxInFlight;
+        }
+
+        void SetDelay( chrono::microseconds Delay )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            m_Delay = Delay;
+        }
+
+    private:
+        mutex m_Mutex;
+        condition_variable m_Changed;
+        set<wstring> m_Held;
+        map<wstring, uint32_t> m_Reads;
+        vector<wstring> m_Order;
+        uint32_t m_InFlight;
+        uint32_t m_MaxInFlight;
+        chrono::microseconds m_Delay;
+    };
+
+    bool HasData( const Future& Result, const wstring& Path )
+    {
+        const Buffer& Data = Result.get();
+        return Data != nullptr && *Data == vector<unsigned char>(Path.begin(), Path.end());
+    }
+
+    bool Fail( const char* Message )
+    {
+        printf("%s\n", Message);
+        return false;
+    }
+
+    // Sums of the per-priority statistics
+    IoScheduler::PriorityStats Totals( const IoScheduler& Scheduler )
+    {
+        const IoScheduler::Stats Stats = Scheduler.GetStats();
+        IoScheduler::PriorityStats Sum = {};
+        for (const IoScheduler::PriorityStats& Priority : Stats.ByPriority)
+        {
+            Sum.Requests += Priority.Requests;
+            Sum.Reads += Priority.Reads;
+            Sum.Coalesced += Priority.Coalesced;
+            Sum.Cancelled += Priority.Cancelled;
+        }
+        return Sum;
+    }
+
+    bool CheckStats( const IoScheduler& Scheduler, uint64_t Requests, uint64_t Reads, uint64_t Coalesced, uint64_t Cancelled )
+    {
+        const IoScheduler::PriorityStats Sum = Totals(Scheduler);
+        if (Sum.Requests != Requests || Sum.Reads != Reads || Sum.Coalesced != Coalesced || Sum.Cancelled != Cancelled)
+        {
+            printf("Expected %llu requests, %llu reads, %llu coalesced and %llu cancelled, counted %llu, %llu, %llu and %llu\n",
+                (unsigned long long)Requests, (unsigned long long)Reads, (unsigned long long)Coalesced, (unsigned long long)Cancelled,
+                (unsigned long long)Sum.Requests, (unsigned long long)Sum.Reads, (unsigned long long)Sum.Coalesced,
+                (unsigned long long)Sum.Cancelled);
+            return false;
+        }
+        return true;
+    }
+
+    // Without workers, reads happen on the calling thread before Read() returns
+    bool CheckInline( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+
+        Future First = Scheduler.Read(L"a", IoScheduler::kPrefetch);
+        if (First.wait_for(chrono::seconds(0)) != future_status::ready || !HasData(First, L"a"))
+            return Fail("A read before Start() didn't complete on the calling thread");
+
+        IoCancelToken Cancelled;
+        Cancelled.Cancel();
+        if (Scheduler.Read(L"b", IoScheduler::kVisible, Cancelled).get() != nullptr || Disk.GetReads(L"b") != 0)
+            return Fail("A cancelled read before Start() was read anyway");
+
+        return CheckStats(Scheduler, 2, 1, 0, 1);
+    }
+
+    // With one thread held on a read, everything else queues, and then comes out in priority order
+    bool CheckPriorityOrder( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(1);
+
+        Disk.Hold(L"gate");
+        Future Gate = Scheduler.Read(L"gate", IoScheduler::kCritical);
+        Disk.WaitUntilStarted(L"gate");
+
+        vector<Future> Results;
+        vector<wstring> Paths;
+        auto Queue = [&]( const wstring& Path, IoScheduler::PriorityClass Priority )
+        {
+            Results.push_back(Scheduler.Read(Path, Priority));
+            Paths.push_back(Path);
+        };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            Queue(L"prefetch" + to_wstring(i), IoScheduler::kPrefetch);
+            Queue(L"visible" + to_wstring(i), IoScheduler::kVisible);
+        }
+        Queue(L"critical0", IoScheduler::kCritical);
+        Queue(L"critical1", IoScheduler::kCritical);
+
+        // Asking again at a higher priority promotes the queued read, and shares it
+        Results.push_back(Scheduler.Read(L"prefetch3", IoScheduler::kCritical));
+        Paths.push_back(L"prefetch3");
+
+        Disk.Release(L"gate");
+        for (size_t i = 0; i < Results.size(); ++i)
+        {
+            if (!HasData(Results[i], Paths[i]))
+                return Fail("A queued read returned the wrong data");
+        }
+
+        const vector<wstring> Expected = { L"gate", L"critical0", L"critical1", L"prefetch3", L"visible0", L"visible1",
+            L"visible2", L"visible3", L"prefetch0", L"prefetch1", L"prefetch2" };
+        if (Disk.GetOrder() != Expected)
+        {
+            printf("Reads started in the order:");
+            for (const wstring& Path : Disk.GetOrder())
+                printf(" %ls", Path.c_str());
+            printf("\n");
+            return false;
+        }
+
+        if (Results.back().get() != Results[6].get())
+            return Fail("A promoted read handed its waiters different buffers");
+
+        const IoScheduler::Stats Stats = Scheduler.GetStats();
+        if (Stats.ByPriority[IoScheduler::kCritical].Coalesced != 1 || Stats.ByPriority[IoScheduler::kPrefetch].Reads != 3 ||
+            Stats.ByPriority[IoScheduler::kCritical].Reads != 4 || Stats.MaxReadsInFlight != 1 || Disk.GetMaxInFlight() != 1)
+        {
+            return Fail("A promoted read wasn't counted at the priority it was read at");
+        }
+
+        return CheckStats(Scheduler, 12, 11, 1, 0);
+    }
+
+    bool CheckCoalescing( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(1);
+
+        // Joining a read that is still queued
+        Disk.Hold(L"gate");
+        Future Gate = Scheduler.Read(L"gate");
+        Disk.WaitUntilStarted(L"gate");
+
+        vector<Future> Queued;
+        for (int i = 0; i < 5; ++i)
+            Queued.push_back(Scheduler.Read(L"queued", (IoScheduler::PriorityClass)(i % IoScheduler::kNumPriorities)));
+
+        // Joining a read that is in flight
+        Disk.Hold(L"flight");
+        Future First = Scheduler.Read(L"flight");
+        Disk.Release(L"gate");
+        Disk.WaitUntilStarted(L"flight");
+
+        vector<Future> InFlight = { First };
+        for (int i = 0; i < 3; ++i)
+            InFlight.push_back(Scheduler.Read(L"flight", IoScheduler::kPrefetch));
+        Disk.Release(L"flight");
+
+        for (const Future& Result : Queued)
+        {
+            if (!HasData(Result, L"queued") || Result.get() != Queued[0].get())
+                return Fail("Requests that joined a queued read didn't all get its buffer");
+        }
+        for (const Future& Result : InFlight)
+        {
+            if (!HasData(Result, L"flight") || Result.get() != InFlight[0].get())
+                return Fail("Requests that joined a read in flight didn't all get its buffer");
+        }
+
+        if (Disk.GetReads(L"queued") != 1 || Disk.GetReads(L"flight") != 1)
+            return Fail("Requests for the same path read it more than once");
+
+        // Once a read completes, the next request reads again
+        if (!HasData(Scheduler.Read(L"flight"), L"flight") || Disk.GetReads(L"flight") != 2)
+            return Fail("A request after the read completed didn't read again");
+
+        return CheckStats(Scheduler, 11, 4, 7, 0);
+    }
+
+    // Schedule() coalesces by key, as StreamingTexture relies on when it asks for the same mip twice, and its
+    // reads don't go through the read function, so a key naming part of a file doesn't share the file's read.
+    bool CheckScheduledReads( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(1);
+
+        Disk.Hold(L"gate");
+        Future Gate = Scheduler.Read(L"gate");
+        Disk.WaitUntilStarted(L"gate");
+
+        atomic<uint32_t> Mip2Reads(0), Mip3Reads(0);
+        auto ReadMip2 = [&]( void ) { ++Mip2Reads; return make_shared<vector<unsigned char>>(7, (unsigned char)2); };
+        auto ReadMip3 = [&]( void ) { ++Mip3Reads; return make_shared<vector<unsigned char>>(5, (unsigned char)3); };
+
+        vector<Future> Mip2;
+        for (int i = 0; i < 3; ++i)
+        {
+            shared_ptr<promise<Buffer>> Done = make_shared<promise<Buffer>>();
+            Mip2.push_back(Done->get_future().share());
+            Scheduler.Schedule(L"file#mip2", (IoScheduler::PriorityClass)i, IoCancelToken(), ReadMip2,
+                [Done]( const Buffer& Data ) { Done->set_value(Data); });
+        }
+
+        Future File = Scheduler.Read(L"file");
+        promise<Buffer> Mip3Done;
+        Scheduler.Schedule(L"file#mip3", IoScheduler::kVisible, IoCancelToken(), ReadMip3,
+            [&]( const Buffer& Data ) { Mip3Done.set_value(Data); });
+        Disk.Release(L"gate");
+
+        for (const Future& Result : Mip2)
+        {
+            if (Result.get() == nullptr || Result.get()->size() != 7 || Result.get() != Mip2[0].get())
+                return Fail("Scheduled requests with the same key didn't all get the one buffer");
+        }
+
+        const Buffer Mip3 = Mip3Done.get_future().get();
+        if (!HasData(File, L"file") || Mip3 == nullptr || Mip3->size() != 5)
+            return Fail("A path read and a scheduled read of another key got the wrong data");
+
+        if (Mip2Reads != 1 || Mip3Reads != 1 || Disk.GetReads(L"file") != 1 || Disk.GetReads(L"file#mip2") != 0)
+            return Fail("Scheduled reads ran more than once per key, or went through the read function");
+
+        return CheckStats(Scheduler, 6, 4, 2, 0);
+    }
+
+    bool CheckCancelling( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(1);
+
+        Disk.Hold(L"gate");
+        Future Gate = Scheduler.Read(L"gate");
+        Disk.WaitUntilStarted(L"gate");
+
+        IoCancelToken Cancelled;
+        Cancelled.Cancel();
+
+        // Every waiter cancelled:  not read at all
+        Future Dropped = Scheduler.Read(L"dropped", IoScheduler::kVisible, Cancelled);
+        Future DroppedToo = Scheduler.Read(L"dropped", IoScheduler::kCritical, Cancelled);
+
+        // Cancelled after it was queued
+        IoCancelToken Later;
+        Future CancelledLater = Scheduler.Read(L"later", IoScheduler::kVisible, Later);
+        Later.Cancel();
+
+        // One waiter cancelled and one not:  read, and only the second gets the data
+        Future SharedCancelled = Scheduler.Read(L"shared", IoScheduler::kVisible, Cancelled);
+        Future SharedWanted = Scheduler.Read(L"shared", IoScheduler::kPrefetch);
+
+        Disk.Release(L"gate");
+
+        if (Dropped.get() != nullptr || DroppedToo.get() != nullptr || Disk.GetReads(L"dropped") != 0)
+            return Fail("A read that every waiter cancelled was read, or its waiters got data");
+        if (CancelledLater.get() != nullptr || Disk.GetReads(L"later") != 0)
+            return Fail("A read cancelled while queued was read");
+        if (SharedCancelled.get() != nullptr || !HasData(SharedWanted, L"shared") || Disk.GetReads(L"shared") != 1)
+            return Fail("A shared read with one cancelled waiter didn't reach just the other one");
+
+        // Cancelled while in flight:  the read finishes, but the data is dropped
+        IoCancelToken InFlight;
+        Disk.Hold(L"flight");
+        Future CancelledInFlight = Scheduler.Read(L"flight", IoScheduler::kVisible, InFlight);
+        Disk.WaitUntilStarted(L"flight");
+        InFlight.Cancel();
+        Disk.Release(L"flight");
+        if (CancelledInFlight.get() != nullptr)
+            return Fail("A read cancelled in flight handed over its data");
+
+        return CheckStats(Scheduler, 7, 3, 2, 5);
+    }
+
+    // A request that joins a read the moment its only waiter is found cancelled must not be dropped with it
+    bool CheckCancelRace( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(2);
+
+        IoCancelToken Cancelled;
+        Cancelled.Cancel();
+
+        atomic<uint32_t> Missing(0);
+        vector<thread> Submitters;
+        for (uint32_t t = 0; t < 2; ++t)
+        {
+            Submitters.emplace_back([&, t]
+            {
+                for (uint32_t i = 0; i < 20000; ++i)
+                {
+                    const wstring Path = to_wstring(t) + L"/" + to_wstring(i);
+                    Scheduler.Read(Path, IoScheduler::kVisible, Cancelled, nullptr);
+                    this_thread::yield();
+                    if (!HasData(Scheduler.Read(Path, IoScheduler::kVisible), Path))
+                        ++Missing;
+                }
+            });
+        }
+        for (thread& Submitter : Submitters)
+            Submitter.join();
+
+        if (Missing > 0)
+        {
+            printf("%u requests that weren't cancelled got nothing, because they joined a read as it was dropped\n", Missing.load());
+            return false;
+        }
+        return true;
+    }
+
+    // With two threads, prefetches may only ever have one, so a critical read starts at once
+    bool CheckPrefetchReserve( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(2);
+
+        Disk.Hold(L"prefetch0");
+        Disk.Hold(L"prefetch1");
+        Future First = Scheduler.Read(L"prefetch0", IoScheduler::kPrefetch);
+        Future Second = Scheduler.Read(L"prefetch1", IoScheduler::kPrefetch);
+        Disk.WaitUntilStarted(L"prefetch0");
+
+        Future Critical = Scheduler.Read(L"critical", IoScheduler::kCritical);
+        if (Critical.wait_for(chrono::seconds(10)) != future_status::ready || !HasData(Critical, L"critical"))
+            return Fail("A critical read waited behind a prefetch");
+        if (Disk.GetReads(L"prefetch1") != 0)
+            return Fail("A second prefetch took the last thread");
+
+        Disk.Release(L"prefetch0");
+        Disk.Release(L"prefetch1");
+        if (!HasData(First, L"prefetch0") || !HasData(Second, L"prefetch1"))
+            return Fail("A held back prefetch didn't complete");
+        return true;
+    }
+
+    bool CheckStop( void )
+    {
+        MockDisk Disk;
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(1);
+
+        Disk.Hold(L"flight");
+        Future InFlight = Scheduler.Read(L"flight");
+        Disk.WaitUntilStarted(L"flight");
+
+        vector<Future> Queued;
+        for (int i = 0; i < 8; ++i)
+            Queued.push_back(Scheduler.Read(L"queued" + to_wstring(i), (IoScheduler::PriorityClass)(i % IoScheduler::kNumPriorities)));
+
+        // Stop() waits for the read in flight, so it is let go once Stop() has had time to drop the queue
+        thread Releaser([&]
+        {
+            this_thread::sleep_for(chrono::milliseconds(50));
+            Disk.Release(L"flight");
+        });
+        Scheduler.Stop();
+        Releaser.join();
+
+        if (!HasData(InFlight, L"flight"))
+            return Fail("Stop() dropped a read in flight");
+        for (const Future& Result : Queued)
+        {
+            if (Result.get() != nullptr)
+                return Fail("Stop() read what was still queued");
+        }
+        if (!CheckStats(Scheduler, 9, 1, 0, 8))
+            return false;
+
+        // Stopped, it reads inline again, and it can be started again
+        if (!HasData(Scheduler.Read(L"inline"), L"inline"))
+            return Fail("A read after Stop() failed");
+        Scheduler.Start(2);
+        if (!HasData(Scheduler.Read(L"restarted"), L"restarted"))
+            return Fail("A read after restarting failed");
+
+        const vector<IoScheduler::RequestStats> Recent = Scheduler.GetRecentRequests();
+        const size_t NumCancelled = count_if(Recent.begin(), Recent.end(), []( const IoScheduler::RequestStats& Request )
+            { return Request.Cancelled; });
+        if (Recent.size() != 11 || Recent.back().Path != L"restarted" || NumCancelled != 8)
+            return Fail("The recent requests don't match what was asked for");
+        return true;
+    }
+
+    struct LatencyResult
+    {
+        double AverageMs[IoScheduler::kNumPriorities];
+        double MaxMs[IoScheduler::kNumPriorities];
+    };
+
+    // Every tenth request is critical and the rest are prefetches, all asked for at once.  With
+    // FirstComeFirstServed they all go in one queue, and the latencies are split out by what they would
+    // have been.
+    LatencyResult MeasureLatency( uint32_t NumThreads, bool FirstComeFirstServed )
+    {
+        MockDisk Disk;
+        Disk.SetDelay(chrono::milliseconds(1));
+        IoScheduler Scheduler(Disk.Function());
+        Scheduler.Start(NumThreads);
+
+        const uint32_t NumRequests = 400;
+        vector<double> LatencyMs(NumRequests);
+        vector<IoScheduler::PriorityClass> Priorities;
+        atomic<uint32_t> Remaining(NumRequests);
+        for (uint32_t i = 0; i < NumRequests; ++i)
+        {
+            Priorities.push_back(i % 10 == 9 ? IoScheduler::kCritical : IoScheduler::kPrefetch);
+            const chrono::steady_clock::time_point RequestTime = chrono::steady_clock::now();
+            Scheduler.Read(to_wstring(i), FirstComeFirstServed ? IoScheduler::kVisible : Priorities.back(), IoCancelToken(),
+                [&, i, RequestTime]( const Buffer& )
+                {
+                    LatencyMs[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - RequestTime).count();
+                    --Remaining;
+                });
+        }
+
+        // Stop() would drop what is still queued
+        while (Remaining > 0)
+            this_thread::sleep_for(chrono::milliseconds(1));
+
+        LatencyResult Latency = {};
+        uint32_t Counts[IoScheduler::kNumPriorities] = {};
+        for (uint32_t i = 0; i < NumRequests; ++i)
+        {
+            Latency.AverageMs[Priorities[i]] += LatencyMs[i];
+            Latency.MaxMs[Priorities[i]] = max(Latency.MaxMs[Priorities[i]], LatencyMs[i]);
+            ++Counts[Priorities[i]];
+        }
+        for (uint32_t Priority = 0; Priority < IoScheduler::kNumPriorities; ++Priority)
+            Latency.AverageMs[Priority] /= max(1u, Counts[Priority]);
+        return Latency;
+    }
+}
+
+int main( void )
+{
+    if (!CheckInline() || !CheckPriorityOrder() || !CheckCoalescing() || !CheckScheduledReads() || !CheckCancelling() ||
+        !CheckCancelRace() || !CheckPrefetchReserve() || !CheckStop())
+    {
+        return 1;
+    }
+
+    printf("Priority order, promotion, coalescing, scheduled reads, cancelling, the prefetch reserve and Stop() check out.\n\n");
+    printf("400 reads of 1 ms, every tenth critical and the rest prefetches, all at once:\n\n");
+    printf("%8s %22s %22s %22s\n", "Threads", "Critical avg / max", "Prefetch avg / max", "One queue, critical");
+
+    for (uint32_t NumThreads : { 2u, 4u, 8u })
+    {
+        const LatencyResult Prioritized = MeasureLatency(NumThreads, false);
+        const LatencyResult Single = MeasureLatency(NumThreads, true);
+        printf("%8u %9.1f / %6.1f ms %9.1f / %6.1f ms %9.1f / %6.1f ms\n", NumThreads,
+            Prioritized.AverageMs[IoScheduler::kCritical], Prioritized.MaxMs[IoScheduler::kCritical],
+            Prioritized.AverageMs[IoScheduler::kPrefetch], Prioritized.MaxMs[IoScheduler::kPrefetch],
+            Single.AverageMs[IoScheduler::kCritical], Single.MaxMs[IoScheduler::kCritical]);
+    }
+    return 0;
+}
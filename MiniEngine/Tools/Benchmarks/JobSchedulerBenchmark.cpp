@@ -0,0 +1,327 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks and times JobScheduler with no workers, one, three, and seven or one per hardware
+// thread, whichever is more.
+// ParallelFor() must visit every index exactly once for any range and grain.  Jobs held on a counter must
+// not start until every job signalling it is done, even jobs submitted by those jobs.  Jobs that wait on
+// jobs they spawned, and threads outside the scheduler submitting and waiting at once, must all finish.
+// Stop() must run whatever is still queued, and the job count in the statistics must add up.
+//
+// Then it times a frame of simulated draw recording serially, through ParallelFor(), and through a pool
+// with one locked queue, and the cost of submitting and waiting for an empty job.  Returns nonzero on the
+// first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core JobSchedulerBenchmark.cpp ..\..\Core\JobSystem.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core JobSchedulerBenchmark.cpp ../../Core/JobSystem.cpp -o JobSchedulerBenchmark
+
+#include "JobSystem.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    bool CheckParallelFor( JobScheduler& Scheduler, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        for (uint32_t Run = 0; Run < 300; ++Run)
+        {
+            const uint32_t Begin = Random() % 4 == 0 ? 0 : Random() % 1000;
+            const uint32_t End = Begin + (Random() % 8 == 0 ? Random() % 3 : Random() % 20000);
+            const uint32_t Grain = Random() % 4 == 0 ? 0 : 1 + Random() % 512;
+
+            vector<atomic<uint32_t>> Visits(End);
+            for (atomic<uint32_t>& Count : Visits)
+                Count = 0;
+
+            atomic<bool> OutOfRange(false);
+            Scheduler.ParallelFor(Begin, End, Grain, [&]( uint32_t RangeBegin, uint32_t RangeEnd )
+            {
+                if (RangeBegin < Begin || RangeEnd > End || RangeBegin >= RangeEnd)
+                    OutOfRange = true;
+                for (uint32_t i = RangeBegin; i < RangeEnd && i < End; ++i)
+                    ++Visits[i];
+            });
+
+            for (uint32_t i = 0; i < End; ++i)
+            {
+                if (OutOfRange || Visits[i] != (i >= Begin ? 1u : 0u))
+                {
+                    printf("ParallelFor(%u, %u, %u) visited index %u %u times\n", Begin, End, Grain, i, Visits[i].load());
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A -> B -> C, where B's first job adds more jobs to B while it runs
+    bool CheckDependencies( JobScheduler& Scheduler )
+    {
+        for (uint32_t Run = 0; Run < 2000; ++Run)
+        {
+            JobCounter A, B, C;
+            atomic<uint32_t> Stage(0), FinishedA(0), FinishedB(0);
+            atomic<bool> Early(false);
+
+            for (uint32_t i = 0; i < 8; ++i)
+                Scheduler.Submit([&]{ ++FinishedA; }, &A);
+
+            Scheduler.Submit([&]
+            {
+                if (FinishedA != 8)
+                    Early = true;
+                Stage = 1;
+                for (uint32_t i = 0; i < 4; ++i)
+                    Scheduler.Submit([&]{ ++FinishedB; }, &B);
+            }, &B, &A);
+
+            Scheduler.Submit([&]
+            {
+                if (Stage != 1 || FinishedB != 4)
+                    Early = true;
+                Stage = 2;
+            }, &C, &B);
+
+            Scheduler.Wait(C);
+            if (Early || Stage != 2)
+            {
+                printf("A job held on a counter started before the jobs signalling it were done\n");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Jobs that wait on the jobs they spawn, submitted from several threads outside the scheduler at once
+    bool CheckNestedWaits( JobScheduler& Scheduler )
+    {
+        atomic<uint32_t> Leaves(0);
+
+        vector<thread> Submitters;
+        for (uint32_t t = 0; t < 3; ++t)
+        {
+            Submitters.emplace_back([&]
+            {
+                JobCounter Outer;
+                for (uint32_t i = 0; i < 32; ++i)
+                {
+                    Scheduler.Submit([&]
+                    {
+                        JobCounter Inner;
+                        for (uint32_t j = 0; j < 32; ++j)
+                            Scheduler.Submit([&]{ ++Leaves; }, &Inner);
+                        Scheduler.Wait(Inner);
+                    }, &Outer);
+                }
+                Scheduler.Wait(Outer);
+            });
+        }
+        for (thread& Submitter : Submitters)
+            Submitter.join();
+
+        if (Leaves != 3 * 32 * 32)
+        {
+            printf("Nested waits ran %u of %u jobs\n", Leaves.load(), 3 * 32 * 32);
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckScheduler( uint32_t NumWorkers )
+    {
+        JobScheduler Scheduler;
+        Scheduler.Start(NumWorkers);
+        if (NumWorkers > 0 && Scheduler.GetNumWorkers() != NumWorkers)
+        {
+            printf("Start(%u) started %u workers\n", NumWorkers, Scheduler.GetNumWorkers());
+            return false;
+        }
+
+        if (!CheckParallelFor(Scheduler, NumWorkers + 1) || !CheckDependencies(Scheduler) || !CheckNestedWaits(Scheduler))
+            return false;
+
+        // Every job submitted is run exactly once, and Stop() runs what is left without anyone waiting
+        Scheduler.ResetStats();
+        atomic<uint32_t> Ran(0);
+        JobCounter Gate;
+        Scheduler.Submit([&]{ ++Ran; }, &Gate);
+        for (uint32_t i = 0; i < 1000; ++i)
+            Scheduler.Submit([&]{ ++Ran; }, nullptr, &Gate);
+        Scheduler.Stop();
+
+        JobSchedulerStats Stats = Scheduler.GetStats();
+        if (Ran != 1001 || Stats.JobsRun != 1001)
+        {
+            printf("%u jobs ran and %llu were counted after Stop(), expected 1001\n", Ran.load(), (unsigned long long)Stats.JobsRun);
+            return false;
+        }
+        return true;
+    }
+
+    // What a simple pool does:  one mutex and condition variable around one queue of jobs
+    class LockedPool
+    {
+    public:
+        explicit LockedPool( uint32_t NumWorkers ) : m_Stopping(false)
+        {
+            for (uint32_t i = 0; i < NumWorkers; ++i)
+                m_Workers.emplace_back([this]{ WorkerLoop(); });
+        }
+
+        ~LockedPool()
+        {
+            {
+                lock_guard<mutex> Guard(m_Mutex);
+                m_Stopping = true;
+            }
+            m_WakeUp.notify_all();
+            for (thread& Worker : m_Workers)
+                Worker.join();
+        }
+
+        void ParallelFor( uint32_t Begin, uint32_t End, uint32_t Grain, const JobScheduler::RangeFunction& Body )
+        {
+            atomic<uint32_t> Pending(0);
+            for (uint32_t RangeBegin = Begin; RangeBegin < End; RangeBegin += Grain)
+            {
+                const uint32_t RangeEnd = min(End, RangeBegin + Grain);
+                ++Pending;
+                {
+                    lock_guard<mutex> Guard(m_Mutex);
+                    m_Jobs.push_back([&, RangeBegin, RangeEnd]{ Body(RangeBegin, RangeEnd); --Pending; });
+                }
+                m_WakeUp.notify_one();
+            }
+
+            // The caller helps until the queue is empty, then waits for the stragglers
+            while (Pending > 0)
+            {
+                function<void (void)> Job;
+                {
+                    lock_guard<mutex> Guard(m_Mutex);
+                    if (!m_Jobs.empty())
+                    {
+                        Job = move(m_Jobs.front());
+                        m_Jobs.pop_front();
+                    }
+                }
+                if (Job)
+                    Job();
+                else
+                    this_thread::yield();
+            }
+        }
+
+    private:
+        void WorkerLoop( void )
+        {
+            for (;;)
+            {
+                function<void (void)> Job;
+                {
+                    unique_lock<mutex> Lock(m_Mutex);
+                    m_WakeUp.wait(Lock, [this]{ return !m_Jobs.empty() || m_Stopping; });
+                    if (m_Jobs.empty())
+                        return;
+                    Job = move(m_Jobs.front());
+                    m_Jobs.pop_front();
+                }
+                Job();
+            }
+        }
+
+        vector<thread> m_Workers;
+        mutex m_Mutex;
+        condition_variable m_WakeUp;
+        deque<function<void (void)>> m_Jobs;
+        bool m_Stopping;
+    };
+
+    // Stands in for recording one draw:  a few hundred nanoseconds, some draws much heavier than others
+    void RecordDraws( uint32_t Begin, uint32_t End )
+    {
+        volatile double Sink = 0.0;
+        for (uint32_t Draw = Begin; Draw < End; ++Draw)
+        {
+            const uint32_t Work = Draw % 97 == 0 ? 600 : 60;
+            for (uint32_t k = 0; k < Work; ++k)
+                Sink = Sink + sqrt((double)Draw + k);
+        }
+    }
+
+    template <typename Body>
+    double MeasureMsPerFrame( uint32_t NumFrames, Body&& Frame )
+    {
+        auto Start = chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NumFrames; ++i)
+            Frame();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count() / NumFrames;
+    }
+}
+
+int main( void )
+{
+    const uint32_t NumThreads = max(1u, thread::hardware_concurrency());
+    const uint32_t kWorkerCounts[] = { 0, 1, 3, max(7u, NumThreads - 1) };
+
+    for (uint32_t NumWorkers : kWorkerCounts)
+    {
+        if (!CheckScheduler(NumWorkers))
+        {
+            printf("JobScheduler with %u workers failed\n", NumWorkers);
+            return 1;
+        }
+    }
+
+    printf("ParallelFor(), dependencies, nested waits and Stop() behave with 0, 1, 3 and %u workers.\n\n", kWorkerCounts[3]);
+
+    const uint32_t NumDraws = 20000;
+    const uint32_t NumFrames = 50;
+    const double SerialMs = MeasureMsPerFrame(NumFrames, []{ RecordDraws(0, NumDraws); });
+
+    printf("%u draws a frame, recorded serially in %.2f ms:\n\n", NumDraws, SerialMs);
+    printf("%8s %8s %14s %14s %12s %10s\n", "Workers", "Grain", "JobScheduler", "Locked queue", "Empty job", "Stolen");
+
+    for (uint32_t NumWorkers = 1; NumWorkers < max(2u, NumThreads); NumWorkers *= 2)
+    {
+        JobScheduler Scheduler;
+        Scheduler.Start(NumWorkers);
+        LockedPool Pool(NumWorkers);
+
+        // Submitting and waiting for one empty job at a time
+        const uint32_t NumEmptyJobs = 100000;
+        auto Start = chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NumEmptyJobs; ++i)
+        {
+            JobCounter Done;
+            Scheduler.Submit([]{}, &Done);
+            Scheduler.Wait(Done);
+        }
+        const double EmptyNs = chrono::duration<double, nano>(chrono::steady_clock::now() - Start).count() / NumEmptyJobs;
+
+        for (uint32_t Grain : { 16u, 64u, 256u })
+        {
+            Scheduler.ResetStats();
+            double StealingMs = MeasureMsPerFrame(NumFrames, [&]{ Scheduler.ParallelFor(0, NumDraws, Grain, RecordDraws); });
+            double LockedMs = MeasureMsPerFrame(NumFrames, [&]{ Pool.ParallelFor(0, NumDraws, Grain, RecordDraws); });
+            printf("%8u %8u %11.2f ms %11.2f ms %9.0f ns %10llu\n", NumWorkers, Grain, StealingMs, LockedMs, EmptyNs,
+                (unsigned long long)Scheduler.GetStats().JobsStolen);
+        }
+        Scheduler.Stop();
+    }
+    return 0;
+}
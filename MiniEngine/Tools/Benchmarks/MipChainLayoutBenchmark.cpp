@@ -0,0 +1,304 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks MipChainLayout against a 4096x4096 BC1 file worked out by hand, then against a reference
+// that sizes each mip the way DDSTextureLoader's GetSurfaceInfo() does, for random sizes, mip counts and BC,
+// packed and plain formats.  Each mip must start where the one before it ends and the chain must fit in the
+// file, to the byte.  SelectTail(), with and without packed mips, SelectMipForSize() and GetFileRange() must
+// agree with a search over every mip, and descriptions that make no sense must be refused.
+//
+// Then it times Create() on a full chain and SelectMipForSize(), which StreamingTexture calls for every request.
+// Returns nonzero on the first failed check.  Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core MipChainLayoutBenchmark.cpp ..\..\Core\MipChainLayout.cpp
+//     g++ -std=c++14 -O2 -I../../Core MipChainLayoutBenchmark.cpp ../../Core/MipChainLayout.cpp -o MipChainLayoutBenchmark
+
+#include "MipChainLayout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    bool Fail( const char* Message )
+    {
+        printf("%s\n", Message);
+        return false;
+    }
+
+    // What a DDS reader takes a format to be:  BC formats are 4x4 blocks, packed formats like YUY2 are two
+    // pixels to four bytes, and the rest are whole pixels.
+    struct Format
+    {
+        const char* Name;
+        uint32_t BlockWidth;
+        uint32_t BlockHeight;
+        uint32_t BytesPerBlock;
+    };
+
+    const Format kFormats[] =
+    {
+        { "BC1", 4, 4, 8 },
+        { "BC3", 4, 4, 16 },
+        { "YUY2", 2, 1, 4 },
+        { "R8", 1, 1, 1 },
+        { "R8G8B8A8", 1, 1, 4 },
+        { "R32G32B32A32", 1, 1, 16 },
+    };
+
+    // As GetSurfaceInfo() computes it
+    void ReferenceMip( const Format& Fmt, uint32_t Width, uint32_t Height, uint64_t& RowBytes, uint64_t& NumRows )
+    {
+        if (Fmt.BlockWidth == 4)
+        {
+            RowBytes = max(1u, (Width + 3) / 4) * (uint64_t)Fmt.BytesPerBlock;
+            NumRows = max(1u, (Height + 3) / 4);
+        }
+        else if (Fmt.BlockWidth == 2)
+        {
+            RowBytes = ((Width + 1) >> 1) * (uint64_t)Fmt.BytesPerBlock;
+            NumRows = Height;
+        }
+        else
+        {
+            RowBytes = (uint64_t)Width * Fmt.BytesPerBlock;
+            NumRows = Height;
+        }
+    }
+
+    uint64_t ReferenceChainSize( const Format& Fmt, uint32_t Width, uint32_t Height, uint32_t NumMips )
+    {
+        uint64_t Size = 0;
+        for (uint32_t Mip = 0; Mip < NumMips; ++Mip)
+        {
+            uint64_t RowBytes, NumRows;
+            ReferenceMip(Fmt, max(Width >> Mip, 1u), max(Height >> Mip, 1u), RowBytes, NumRows);
+            Size += RowBytes * NumRows;
+        }
+        return Size;
+    }
+
+    bool CheckByHand( void )
+    {
+        // The headers of a DDS file with a DX10 header take 4 + 124 + 20 bytes
+        const uint64_t DataOffset = 148;
+        const uint64_t ChainSize = 11184824;    // 4x4, 2x2 and 1x1 each take a whole 8-byte block
+
+        MipChainLayout Layout;
+        if (Layout.Create(DataOffset, DataOffset + ChainSize - 1, 4096, 4096, 13, 4, 4, 8))
+            return Fail("A file a byte short of the chain was accepted");
+        if (Layout.GetNumMips() != 0)
+            return Fail("A refused layout kept its mips");
+        if (!Layout.Create(DataOffset, DataOffset + ChainSize, 4096, 4096, 13, 4, 4, 8))
+            return Fail("A 4096x4096 BC1 chain was refused");
+
+        const MipChainLayout::MipLevel& Mip0 = Layout.GetMip(0);
+        const MipChainLayout::MipLevel& Mip1 = Layout.GetMip(1);
+        const MipChainLayout::MipLevel& Mip12 = Layout.GetMip(12);
+        if (Layout.GetNumMips() != 13 || Mip0.FileOffset != 148 || Mip0.Size != 8388608 || Mip0.RowBytes != 8192 ||
+            Mip0.NumRows != 1024 || Mip1.FileOffset != 148 + 8388608 || Mip1.Size != 2097152 ||
+            Mip12.Width != 1 || Mip12.Height != 1 || Mip12.RowBytes != 8 || Mip12.NumRows != 1 || Mip12.Size != 8 ||
+            Mip12.FileOffset != DataOffset + ChainSize - 8)
+        {
+            return Fail("The 4096x4096 BC1 mips are in the wrong places");
+        }
+
+        // Mip 4 is 256x256
+        if (Layout.SelectTail(256) != 4 || Layout.SelectTail(255) != 5 || Layout.SelectTail(0) != 12 ||
+            Layout.SelectTail(4096) != 0 || Layout.SelectTail(256, 2) != 2 || Layout.SelectTail(256, 9) != 4)
+        {
+            return Fail("SelectTail() chose the wrong tail of the 4096x4096 chain");
+        }
+
+        if (Layout.SelectMipForSize(4096, 4096) != 0 || Layout.SelectMipForSize(5000, 10) != 0 ||
+            Layout.SelectMipForSize(1000, 1000) != 2 || Layout.SelectMipForSize(1024, 1024) != 2 ||
+            Layout.SelectMipForSize(1025, 1) != 1 || Layout.SelectMipForSize(1, 1) != 12 ||
+            Layout.SelectMipForSize(0, 0) != 12)
+        {
+            return Fail("SelectMipForSize() chose the wrong mip of the 4096x4096 chain");
+        }
+
+        uint64_t Offset, Size;
+        Layout.GetFileRange(4, 13, Offset, Size);
+        if (Offset != Layout.GetMip(4).FileOffset || Offset + Size != DataOffset + ChainSize)
+            return Fail("The tail's file range is wrong");
+        Layout.GetFileRange(0, 1, Offset, Size);
+        if (Offset != 148 || Size != 8388608)
+            return Fail("Mip 0's file range is wrong");
+
+        // A 300x17 YUY2 texture:  odd widths round up to a whole pair of pixels
+        if (!Layout.Create(0, 1 << 20, 300, 17, 3, 2, 1, 4))
+            return Fail("A 300x17 YUY2 chain was refused");
+        if (Layout.GetMip(0).RowBytes != 600 || Layout.GetMip(0).NumRows != 17 || Layout.GetMip(2).Width != 75 ||
+            Layout.GetMip(2).Height != 4 || Layout.GetMip(2).RowBytes != 152 || Layout.SelectMipForSize(100, 4) != 1)
+        {
+            return Fail("The 300x17 YUY2 mips are wrong");
+        }
+
+        // Descriptions that make no sense
+        if (Layout.Create(0, 1 << 20, 0, 16, 1, 1, 1, 4) || Layout.Create(0, 1 << 20, 16, 0, 1, 1, 1, 4) ||
+            Layout.Create(0, 1 << 20, 16, 16, 0, 1, 1, 4) || Layout.Create(0, 1 << 20, 16, 16, 33, 1, 1, 4) ||
+            Layout.Create(0, 1 << 20, 16, 16, 1, 0, 1, 4) || Layout.Create(0, 1 << 20, 16, 16, 1, 1, 0, 4) ||
+            Layout.Create(0, 1 << 20, 16, 16, 1, 1, 1, 0))
+        {
+            return Fail("A layout with a zero size, mip count or block, or more than 32 mips, was accepted");
+        }
+
+        return true;
+    }
+
+    bool CheckAgainstReference( uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        MipChainLayout Layout;
+
+        for (uint32_t Run = 0; Run < 20000; ++Run)
+        {
+            const Format& Fmt = kFormats[Random() % (sizeof(kFormats) / sizeof(kFormats[0]))];
+
+            // Powers of two half the time, and anything up to 16384 otherwise
+            const uint32_t Width = Random() % 2 ? 1u << (Random() % 15) : 1 + Random() % 16384;
+            uint32_t Height = Random() % 2 ? 1u << (Random() % 15) : 1 + Random() % 16384;
+            if (Random() % 4 == 0)
+                Height = Width;
+
+            uint32_t FullChain = 1;
+            while ((max(Width, Height) >> FullChain) > 0)
+                ++FullChain;
+            const uint32_t NumMips = Random() % 4 == 0 ? 1 + Random() % FullChain : FullChain;
+
+            const uint64_t DataOffset = Random() % 2 ? 128 : 148;
+            const uint64_t ChainSize = ReferenceChainSize(Fmt, Width, Height, NumMips);
+
+            if (Layout.Create(DataOffset, DataOffset + ChainSize - 1, Width, Height, NumMips,
+                Fmt.BlockWidth, Fmt.BlockHeight, Fmt.BytesPerBlock))
+            {
+                printf("%ux%u %s with %u mips was accepted from a file a byte short\n", Width, Height, Fmt.Name, NumMips);
+                return false;
+            }
+
+            if (!Layout.Create(DataOffset, DataOffset + ChainSize + Random() % 64, Width, Height, NumMips,
+                Fmt.BlockWidth, Fmt.BlockHeight, Fmt.BytesPerBlock) || Layout.GetNumMips() != NumMips)
+            {
+                printf("%ux%u %s with %u mips was refused\n", Width, Height, Fmt.Name, NumMips);
+                return false;
+            }
+
+            uint64_t Offset = DataOffset;
+            for (uint32_t Mip = 0; Mip < NumMips; ++Mip)
+            {
+                const MipChainLayout::MipLevel& Level = Layout.GetMip(Mip);
+                const uint32_t MipWidth = max(Width >> Mip, 1u);
+                const uint32_t MipHeight = max(Height >> Mip, 1u);
+
+                uint64_t RowBytes, NumRows;
+                ReferenceMip(Fmt, MipWidth, MipHeight, RowBytes, NumRows);
+
+                if (Level.Width != MipWidth || Level.Height != MipHeight || Level.RowBytes != RowBytes ||
+                    Level.NumRows != NumRows || Level.Size != RowBytes * NumRows || Level.FileOffset != Offset)
+                {
+                    printf("Mip %u of %ux%u %s differs from the reference\n", Mip, Width, Height, Fmt.Name);
+                    return false;
+                }
+                Offset += Level.Size;
+            }
+
+            // The finest mip no larger than MaxDimension, or the last if none is, then no later than FirstPackedMip
+            const uint32_t MaxDimension = Random() % 2 ? 1u << (Random() % 15) : Random() % 16384;
+            const uint32_t FirstPackedMip = Random() % 2 ? UINT32_MAX : Random() % NumMips;
+            uint32_t ExpectedTail = NumMips - 1;
+            for (uint32_t Mip = 0; Mip < NumMips; ++Mip)
+            {
+                if (max(Layout.GetMip(Mip).Width, Layout.GetMip(Mip).Height) <= MaxDimension)
+                {
+                    ExpectedTail = Mip;
+                    break;
+                }
+            }
+            ExpectedTail = min(ExpectedTail, FirstPackedMip);
+
+            if (Layout.SelectTail(MaxDimension, FirstPackedMip) != ExpectedTail)
+            {
+                printf("SelectTail(%u, %u) of %ux%u with %u mips chose %u, expected %u\n", MaxDimension, FirstPackedMip,
+                    Width, Height, NumMips, Layout.SelectTail(MaxDimension, FirstPackedMip), ExpectedTail);
+                return false;
+            }
+
+            // The coarsest mip at least as large as the request, or mip 0 if none is
+            const uint32_t WantWidth = Random() % (Width + Width / 2 + 1);
+            const uint32_t WantHeight = Random() % 2 ? WantWidth : Random() % (Height + Height / 2 + 1);
+            uint32_t ExpectedMip = 0;
+            for (uint32_t Mip = NumMips; Mip-- > 0; )
+            {
+                if (Layout.GetMip(Mip).Width >= WantWidth && Layout.GetMip(Mip).Height >= WantHeight)
+                {
+                    ExpectedMip = Mip;
+                    break;
+                }
+            }
+
+            if (Layout.SelectMipForSize(WantWidth, WantHeight) != ExpectedMip)
+            {
+                printf("SelectMipForSize(%u, %u) of %ux%u with %u mips chose %u, expected %u\n", WantWidth, WantHeight,
+                    Width, Height, NumMips, Layout.SelectMipForSize(WantWidth, WantHeight), ExpectedMip);
+                return false;
+            }
+
+            // Any run of mips is one range, from the start of the first to the end of the last
+            const uint32_t FirstMip = Random() % NumMips;
+            const uint32_t EndMip = FirstMip + 1 + Random() % (NumMips - FirstMip);
+            uint64_t RangeOffset, RangeSize, ExpectedSize = 0;
+            for (uint32_t Mip = FirstMip; Mip < EndMip; ++Mip)
+                ExpectedSize += Layout.GetMip(Mip).Size;
+
+            Layout.GetFileRange(FirstMip, EndMip, RangeOffset, RangeSize);
+            if (RangeOffset != Layout.GetMip(FirstMip).FileOffset || RangeSize != ExpectedSize)
+            {
+                printf("GetFileRange(%u, %u) of %ux%u %s is wrong\n", FirstMip, EndMip, Width, Height, Fmt.Name);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main( void )
+{
+    if (!CheckByHand())
+        return 1;
+
+    for (uint32_t Seed = 1; Seed <= 10; ++Seed)
+    {
+        if (!CheckAgainstReference(Seed))
+            return 1;
+    }
+
+    printf("Mip sizes, file offsets, tails, mips for a size and file ranges agree with the reference.\n\n");
+
+    const uint32_t NumCalls = 1000000;
+    MipChainLayout Layout;
+    volatile uint32_t Sink = 0;
+
+    auto Start = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumCalls / 10; ++i)
+        Sink = Sink + Layout.Create(148, UINT64_MAX, 4096, 4096, 13, 4, 4, 8);
+    const double CreateNs = chrono::duration<double, nano>(chrono::steady_clock::now() - Start).count() / (NumCalls / 10);
+
+    Start = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumCalls; ++i)
+        Sink = Sink + Layout.SelectMipForSize(i & 4095, (i >> 3) & 4095);
+    const double SelectNs = chrono::duration<double, nano>(chrono::steady_clock::now() - Start).count() / NumCalls;
+
+    printf("Create() on a 13-mip chain:  %.0f ns\nSelectMipForSize():  %.1f ns\n", CreateNs, SelectNs);
+    return 0;
+}
@@ -0,0 +1,290 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Stress tests PageRecycler with the pages and fences from PageRecyclerMock.h.  Recording
+// threads take pages, tag them, and discard them against one of two queues' fences, which complete a few
+// submissions behind.  A page's Owner tag holds either the fence it was discarded
+// against or the thread holding it, so a page handed out twice, or before its fence completed, is
+// caught the moment it is requested.
+//
+// The same run is repeated with a page cap, with idle trimming, and across many recyclers per thread
+// (as with one command allocator pool per queue type), checking that pages are accounted for afterwards.
+// Then it times requests against the single mutex and queue that the pool used before.  Returns nonzero
+// on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core PageRecyclerBenchmark.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core PageRecyclerBenchmark.cpp -o PageRecyclerBenchmark
+
+#include "PageRecycler.h"
+#include "PageRecyclerMock.h"
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+    typedef PageRecycler<MockPage> Recycler;
+
+    const uint64_t kHeldTag = 1ull << 63;
+    const uint64_t kFramesInFlight = 4;
+
+    struct StressOptions
+    {
+        uint32_t NumThreads;
+        uint32_t NumRecyclers;
+        uint32_t FramesPerThread;
+        size_t MaxPages;            // Zero for no cap
+        bool TrimIdle;
+    };
+
+    struct StressResult
+    {
+        bool Passed;
+        size_t TotalPages;
+        size_t PeakPagesInUse;
+        uint64_t CapWaits;
+        uint64_t PagesTrimmed;
+    };
+
+    MockFence s_GraphicsFence(0);
+    MockFence s_ComputeFence(1);
+    MockFence* const s_Fences[2] = { &s_GraphicsFence, &s_ComputeFence };
+
+    MockFence& FenceFor( uint64_t FenceValue )
+    {
+        return *s_Fences[FenceValue >> 56];
+    }
+
+    bool TakePage( MockPage* Page, uint64_t Tag )
+    {
+        uint64_t Previous = Page->Owner.load();
+        if ((Previous & kHeldTag) != 0)
+        {
+            printf("A page held by thread %u was handed out again\n", (uint32_t)(Previous & ~kHeldTag));
+            return false;
+        }
+        if (Previous != 0 && !FenceFor(Previous).IsFenceComplete(Previous))
+        {
+            printf("A page was handed out before fence %llx completed\n", (unsigned long long)Previous);
+            return false;
+        }
+        if (!Page->Owner.compare_exchange_strong(Previous, Tag))
+        {
+            printf("Two threads took the same page at once\n");
+            return false;
+        }
+        return true;
+    }
+
+    StressResult RunStress( const StressOptions& Options )
+    {
+        vector<unique_ptr<Recycler>> Recyclers;
+        for (uint32_t i = 0; i < Options.NumRecyclers; ++i)
+        {
+            Recyclers.emplace_back(new Recycler([]{ return new MockPage(64); },
+                []( uint64_t Value ){ return FenceFor(Value).IsFenceComplete(Value); }));
+            if (Options.MaxPages > 0)
+                Recyclers.back()->SetMaxPages(Options.MaxPages, []( uint64_t Value ){ FenceFor(Value).Complete(Value); });
+        }
+
+        atomic<bool> Failed(false);
+
+        vector<thread> Threads;
+        for (uint32_t t = 0; t < Options.NumThreads; ++t)
+        {
+            Threads.emplace_back([&, t]
+            {
+                const uint64_t Tag = kHeldTag | t;
+                vector<MockPage*> Pages;
+                for (uint32_t Frame = 0; Frame < Options.FramesPerThread && !Failed.load(); ++Frame)
+                {
+                    Recycler& Pool = *Recyclers[(Frame + t) % Options.NumRecyclers];
+                    MockFence& Fence = *s_Fences[Frame & 1];
+
+                    Pages.clear();
+                    for (uint32_t i = 0; i < 1 + (Frame * 7 + t) % 4; ++i)
+                    {
+                        MockPage* Page = Pool.RequestPage();
+                        if (!TakePage(Page, Tag))
+                            Failed = true;
+                        Pages.push_back(Page);
+                    }
+
+                    // The fence is signaled once the pages' commands have been "submitted"
+                    uint64_t FenceValue = Fence.Signal();
+                    for (MockPage* Page : Pages)
+                        Page->Owner = FenceValue;
+                    Pool.DiscardPages(FenceValue, Pages);
+
+                    // The "GPU" runs kFramesInFlight submissions behind on each queue
+                    if ((FenceValue & 0xFFFFFFFFFFFFFFull) > kFramesInFlight)
+                        Fence.Complete(FenceValue - kFramesInFlight);
+
+                    if (Options.TrimIdle && t == 0 && Frame % 256 == 0)
+                        Pool.TrimIdle();
+                }
+            });
+        }
+
+        for (thread& Worker : Threads)
+            Worker.join();
+
+        StressResult Result = {};
+        Result.Passed = !Failed;
+
+        for (MockFence* Fence : s_Fences)
+            Fence->CompleteAll();
+
+        for (auto& Pool : Recyclers)
+        {
+            Pool->Reclaim(true);
+            PageRecyclerStats Stats = Pool->GetStats();
+            if (Stats.PagesInUse != 0 || Stats.RetiredPages != 0 ||
+                Stats.TotalPages != Stats.DepotPages + Stats.MagazinePages)
+            {
+                printf("Pages are unaccounted for:  %zu total, %zu in the depot, %zu in magazines, %zu in use, %zu retired\n",
+                    Stats.TotalPages, Stats.DepotPages, Stats.MagazinePages, Stats.PagesInUse, Stats.RetiredPages);
+                Result.Passed = false;
+            }
+
+            Result.TotalPages += Stats.TotalPages;
+            Result.PeakPagesInUse += Stats.PeakPagesInUse;
+            Result.CapWaits += Stats.CapWaits;
+            Result.PagesTrimmed += Stats.PagesTrimmed;
+        }
+        return Result;
+    }
+
+    // What LinearAllocatorPageManager did before: one lock around a queue of retired pages and a queue of
+    // ready ones
+    class LockedPagePool
+    {
+    public:
+        ~LockedPagePool()
+        {
+            for (MockPage* Page : m_AllPages)
+                delete Page;
+        }
+
+        MockPage* RequestPage( void )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+
+            while (!m_Retired.empty() && s_GraphicsFence.IsFenceComplete(m_Retired.front().first))
+            {
+                m_Ready.push(m_Retired.front().second);
+                m_Retired.pop();
+            }
+
+            if (!m_Ready.empty())
+            {
+                MockPage* Page = m_Ready.front();
+                m_Ready.pop();
+                return Page;
+            }
+
+            m_AllPages.push_back(new MockPage(64));
+            return m_AllPages.back();
+        }
+
+        void DiscardPages( uint64_t FenceValue, const vector<MockPage*>& Pages )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            for (MockPage* Page : Pages)
+                m_Retired.push(make_pair(FenceValue, Page));
+        }
+
+    private:
+        mutex m_Mutex;
+        vector<MockPage*> m_AllPages;
+        queue<pair<uint64_t, MockPage*>> m_Retired;
+        queue<MockPage*> m_Ready;
+    };
+
+    template <typename Pool>
+    double MeasureMillionsPerSecond( Pool& Pages, uint32_t NumThreads, uint32_t RequestsPerThread )
+    {
+        auto Start = chrono::steady_clock::now();
+
+        vector<thread> Threads;
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&]
+            {
+                vector<MockPage*> Batch(4);
+                for (uint32_t i = 0; i < RequestsPerThread; i += 4)
+                {
+                    for (MockPage*& Page : Batch)
+                        Page = Pages.RequestPage();
+                    uint64_t FenceValue = s_GraphicsFence.Signal();
+                    Pages.DiscardPages(FenceValue, Batch);
+                    if (FenceValue > kFramesInFlight)
+                        s_GraphicsFence.Complete(FenceValue - kFramesInFlight);
+                }
+            });
+        }
+        for (thread& Worker : Threads)
+            Worker.join();
+
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+        return NumThreads * (double)RequestsPerThread / Seconds / 1e6;
+    }
+}
+
+int main( void )
+{
+    const uint32_t NumThreads = max(4u, thread::hardware_concurrency());
+
+    struct Config
+    {
+        const char* Name;
+        StressOptions Options;
+    };
+
+    const Config kConfigs[] =
+    {
+        { "One recycler",           { NumThreads, 1, 20000, 0, false } },
+        { "Capped at 16 pages",     { NumThreads, 1, 20000, 16, false } },
+        { "Trimmed when idle",      { NumThreads, 1, 20000, 0, true } },
+        { "40 recyclers",           { NumThreads, 40, 20000, 0, false } },
+    };
+
+    printf("%u threads, 1-4 pages a frame, fences completed %llu behind:\n\n", NumThreads, (unsigned long long)kFramesInFlight);
+    printf("%20s %12s %12s %12s %12s\n", "", "Pages", "Peak in use", "Cap waits", "Trimmed");
+    for (const Config& Next : kConfigs)
+    {
+        StressResult Result = RunStress(Next.Options);
+        if (!Result.Passed)
+        {
+            printf("%s failed\n", Next.Name);
+            return 1;
+        }
+        printf("%20s %12zu %12zu %12llu %12llu\n", Next.Name, Result.TotalPages, Result.PeakPagesInUse,
+            (unsigned long long)Result.CapWaits, (unsigned long long)Result.PagesTrimmed);
+    }
+
+    printf("\nNo page was handed out twice or before its fence, and every page was accounted for.\n\n");
+
+    printf("%8s %16s %16s\n", "Threads", "PageRecycler", "Locked queue");
+    for (uint32_t Threads = 1; Threads <= NumThreads; Threads *= 2)
+    {
+        Recycler Pages([]{ return new MockPage(64); }, []( uint64_t Value ){ return s_GraphicsFence.IsFenceComplete(Value); });
+        LockedPagePool Locked;
+        double RecyclerRate = MeasureMillionsPerSecond(Pages, Threads, 400000);
+        double LockedRate = MeasureMillionsPerSecond(Locked, Threads, 400000);
+        printf("%8u %10.1f Mreq/s %10.1f Mreq/s\n", Threads, RecyclerRate, LockedRate);
+    }
+    return 0;
+}
@@ -0,0 +1,309 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks TGAFile::Decode() and the SIMD conversion kernels against the scalar kernel and reports
+// their throughput.  Images are generated in memory:  raw and run-length encoded, 8-, 24- and 32-bit, with the
+// bottom-left and top-left origins, with and without an ID field, serial and split over the job scheduler.
+// Every decode must match, pixel for pixel, the scalar conversion of the pixels that went into the file, and
+// truncated or unsupported files must be rejected.  Returns nonzero on the first mismatch.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core TGABenchmark.cpp ..\..\Core\TGAFile.cpp ..\..\Core\JobSystem.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core TGABenchmark.cpp ../../Core/TGAFile.cpp ../../Core/JobSystem.cpp -o TGABenchmark
+
+#include "TGAFile.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const TGAFile::Kernel kKernels[] = { TGAFile::kScalar, TGAFile::kSSSE3, TGAFile::kAVX2 };
+    const char* kKernelNames[] = { "scalar", "SSSE3", "AVX2" };
+
+    enum ImageType { kTrueColor = 2, kGrayscale = 3, kTrueColorRLE = 10, kGrayscaleRLE = 11 };
+
+    struct TestImage
+    {
+        vector<uint8_t> File;
+        vector<uint32_t> Expected;
+    };
+
+    // What Decode() must produce from these file pixels, using only the scalar kernel
+    vector<uint32_t> ScalarReference( const uint8_t* Pixels, size_t Count, uint32_t BytesPerPixel )
+    {
+        vector<uint32_t> Out(Count);
+        if (BytesPerPixel == 3)
+            TGAFile::ConvertBGR(Pixels, Out.data(), Count, TGAFile::kScalar);
+        else if (BytesPerPixel == 4)
+            TGAFile::ConvertBGRA(Pixels, Out.data(), Count, TGAFile::kScalar);
+        else
+        {
+            for (size_t i = 0; i < Count; ++i)
+                Out[i] = 0xFF000000u | Pixels[i] * 0x010101u;
+        }
+        return Out;
+    }
+
+    // Alternates run and raw packets of random length.  Packets cross row boundaries, as many writers' do.
+    void EncodeRLE( const uint8_t* Pixels, size_t Count, uint32_t BytesPerPixel, vector<uint8_t>& Out, mt19937& Random )
+    {
+        for (size_t i = 0; i < Count; )
+        {
+            const size_t Length = min((size_t)(Random() % 128 + 1), Count - i);
+            const uint8_t* First = Pixels + i * BytesPerPixel;
+
+            // A run only encodes pixels that really repeat, so the original pixels stay the reference
+            size_t RunLength = 1;
+            while (RunLength < Length && memcmp(First, First + RunLength * BytesPerPixel, BytesPerPixel) == 0)
+                ++RunLength;
+
+            if (RunLength > 1)
+            {
+                Out.push_back((uint8_t)(0x80 | (RunLength - 1)));
+                Out.insert(Out.end(), First, First + BytesPerPixel);
+                i += RunLength;
+            }
+            else
+            {
+                Out.push_back((uint8_t)(Length - 1));
+                Out.insert(Out.end(), First, First + Length * BytesPerPixel);
+                i += Length;
+            }
+        }
+    }
+
+    // RunChance is how often a pixel repeats the one before it
+    TestImage MakeImage( ImageType Type, uint32_t Width, uint32_t Height, uint32_t Bits, bool TopDown, uint8_t IdLength,
+        float RunChance, mt19937& Random )
+    {
+        const uint32_t BytesPerPixel = Bits / 8;
+        const size_t Count = (size_t)Width * Height;
+
+        vector<uint8_t> Pixels(Count * BytesPerPixel);
+        uniform_real_distribution<float> Chance(0.0f, 1.0f);
+        for (size_t i = 0; i < Count; ++i)
+        {
+            uint8_t* Pixel = Pixels.data() + i * BytesPerPixel;
+            if (i > 0 && Chance(Random) < RunChance)
+                memcpy(Pixel, Pixel - BytesPerPixel, BytesPerPixel);
+            else
+            {
+                for (uint32_t c = 0; c < BytesPerPixel; ++c)
+                    Pixel[c] = (uint8_t)Random();
+            }
+        }
+
+        TestImage Image;
+        Image.File.assign(18 + IdLength, 0);
+        Image.File[0] = IdLength;
+        Image.File[2] = (uint8_t)Type;
+        Image.File[12] = (uint8_t)Width;
+        Image.File[13] = (uint8_t)(Width >> 8);
+        Image.File[14] = (uint8_t)Height;
+        Image.File[15] = (uint8_t)(Height >> 8);
+        Image.File[16] = (uint8_t)Bits;
+        Image.File[17] = (uint8_t)((TopDown ? 0x20 : 0) | (BytesPerPixel == 4 ? 8 : 0));
+        for (uint8_t i = 0; i < IdLength; ++i)
+            Image.File[18 + i] = (uint8_t)Random();
+
+        if (Type == kTrueColorRLE || Type == kGrayscaleRLE)
+            EncodeRLE(Pixels.data(), Count, BytesPerPixel, Image.File, Random);
+        else
+            Image.File.insert(Image.File.end(), Pixels.begin(), Pixels.end());
+
+        Image.Expected = ScalarReference(Pixels.data(), Count, BytesPerPixel);
+        return Image;
+    }
+
+    bool CheckKernels( mt19937& Random )
+    {
+        // Every length through a few SIMD iterations and the tails, from buffers of exactly the right size so
+        // that a memory checker catches overreads
+        for (size_t Count = 0; Count < 200; ++Count)
+        {
+            for (uint32_t BytesPerPixel = 3; BytesPerPixel <= 4; ++BytesPerPixel)
+            {
+                vector<uint8_t> Source(Count * BytesPerPixel);
+                for (uint8_t& Byte : Source)
+                    Byte = (uint8_t)Random();
+
+                const vector<uint32_t> Expected = ScalarReference(Source.data(), Count, BytesPerPixel);
+
+                for (TGAFile::Kernel Use : kKernels)
+                {
+                    if (!TGAFile::IsKernelSupported(Use))
+                        continue;
+
+                    vector<uint32_t> Out(Count);
+                    if (BytesPerPixel == 3)
+                        TGAFile::ConvertBGR(Source.data(), Out.data(), Count, Use);
+                    else
+                        TGAFile::ConvertBGRA(Source.data(), Out.data(), Count, Use);
+
+                    if (Out != Expected)
+                    {
+                        printf("%s kernel differs from scalar:  %zu %u-byte pixels\n", kKernelNames[Use], Count, BytesPerPixel);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool CheckDecode( JobScheduler& Scheduler, mt19937& Random )
+    {
+        // Both sides of the parallel threshold of a million pixels, and odd shapes
+        static const uint32_t kSizes[][2] = { { 1, 1 }, { 7, 3 }, { 33, 2000 }, { 1500, 777 }, { 1024, 1024 } };
+        static const ImageType kTypes[] = { kTrueColor, kTrueColorRLE, kGrayscale, kGrayscaleRLE };
+
+        for (auto& Size : kSizes)
+        {
+            for (ImageType Type : kTypes)
+            {
+                const bool IsGray = Type == kGrayscale || Type == kGrayscaleRLE;
+                for (uint32_t Bits = 8; Bits <= 32; Bits += 8)
+                {
+                    if (Bits == 16 || IsGray != (Bits == 8))
+                        continue;
+
+                    for (int TopDown = 0; TopDown < 2; ++TopDown)
+                    {
+                        const TestImage Image = MakeImage(Type, Size[0], Size[1], Bits, TopDown != 0, TopDown ? 0 : 5, 0.5f, Random);
+
+                        for (JobScheduler* UseScheduler : { (JobScheduler*)nullptr, &Scheduler })
+                        {
+                            vector<uint32_t> Pixels;
+                            uint32_t Width, Height;
+                            if (!TGAFile::Decode(Image.File.data(), Image.File.size(), Pixels, Width, Height, UseScheduler) ||
+                                Width != Size[0] || Height != Size[1] || Pixels != Image.Expected)
+                            {
+                                printf("Decode differs from scalar:  type %d, %u-bit, %ux%u, %s, %s\n", Type, Bits, Size[0], Size[1],
+                                    TopDown ? "top-down" : "bottom-up", UseScheduler ? "parallel" : "serial");
+                                return false;
+                            }
+                        }
+
+                        vector<uint32_t> Pixels;
+                        uint32_t Width, Height;
+                        if (TGAFile::Decode(Image.File.data(), Image.File.size() - 1, Pixels, Width, Height, &Scheduler) || !Pixels.empty())
+                        {
+                            printf("A truncated file was accepted:  type %d, %u-bit, %ux%u\n", Type, Bits, Size[0], Size[1]);
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Color-mapped and 16-bit images aren't supported
+        TestImage ColorMapped = MakeImage(kTrueColor, 4, 4, 8, false, 0, 0.0f, Random);
+        ColorMapped.File[2] = 1;
+        TestImage SixteenBit = MakeImage(kTrueColor, 4, 4, 16, false, 0, 0.0f, Random);
+
+        vector<uint32_t> Pixels;
+        uint32_t Width, Height;
+        if (TGAFile::Decode(ColorMapped.File.data(), ColorMapped.File.size(), Pixels, Width, Height) ||
+            TGAFile::Decode(SixteenBit.File.data(), SixteenBit.File.size(), Pixels, Width, Height))
+        {
+            printf("An unsupported file was accepted\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    template <typename Function>
+    double MeasureMBps( size_t Bytes, Function Run )
+    {
+        const int kRepeats = 5;
+        auto Start = chrono::steady_clock::now();
+        for (int i = 0; i < kRepeats; ++i)
+            Run();
+        const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+        return kRepeats * Bytes / Seconds / 1e6;
+    }
+
+    void Benchmark( JobScheduler& Scheduler, mt19937& Random )
+    {
+        const uint32_t kSize = 4096;
+        const size_t Count = (size_t)kSize * kSize;
+
+        printf("%ux%u images.  Rates are of decoded RGBA8 output.\n\n", kSize, kSize);
+
+        for (uint32_t Bits = 24; Bits <= 32; Bits += 8)
+        {
+            const uint32_t BytesPerPixel = Bits / 8;
+            const TestImage Raw = MakeImage(kTrueColor, kSize, kSize, Bits, false, 0, 0.0f, Random);
+            const uint8_t* Source = Raw.File.data() + 18;
+            vector<uint32_t> Out(Count);
+
+            for (TGAFile::Kernel Use : kKernels)
+            {
+                if (!TGAFile::IsKernelSupported(Use))
+                    continue;
+
+                const double Rate = MeasureMBps(Count * 4, [&]( void )
+                {
+                    if (BytesPerPixel == 3)
+                        TGAFile::ConvertBGR(Source, Out.data(), Count, Use);
+                    else
+                        TGAFile::ConvertBGRA(Source, Out.data(), Count, Use);
+                });
+                printf("%u-bit %-8s kernel       %7.0f MB/s\n", Bits, kKernelNames[Use], Rate);
+            }
+
+            // Runs of about eight pixels, as in flat-shaded art
+            const TestImage RLE = MakeImage(kTrueColorRLE, kSize, kSize, Bits, true, 0, 0.875f, Random);
+
+            for (const TestImage* Image : { &Raw, &RLE })
+            {
+                for (JobScheduler* UseScheduler : { (JobScheduler*)nullptr, &Scheduler })
+                {
+                    uint32_t Width, Height;
+                    const double Rate = MeasureMBps(Count * 4, [&]( void )
+                    {
+                        TGAFile::Decode(Image->File.data(), Image->File.size(), Out, Width, Height, UseScheduler);
+                    });
+                    printf("%u-bit %s decode, %-8s %7.0f MB/s\n", Bits, Image == &Raw ? "raw" : "RLE", UseScheduler ? "parallel" : "serial", Rate);
+                }
+            }
+            printf("\n");
+        }
+    }
+}
+
+int main( void )
+{
+    mt19937 Random(1);
+
+    JobScheduler Scheduler;
+    Scheduler.Start();
+
+    printf("SSSE3 %s, AVX2 %s\n", TGAFile::IsKernelSupported(TGAFile::kSSSE3) ? "present" : "absent",
+        TGAFile::IsKernelSupported(TGAFile::kAVX2) ? "present" : "absent");
+
+    const bool Passed = CheckKernels(Random) && CheckDecode(Scheduler, Random);
+    if (Passed)
+    {
+        printf("Kernels and decodes match the scalar path.\n\n");
+        Benchmark(Scheduler, Random);
+    }
+
+    Scheduler.Stop();
+    return Passed ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Checks and times VertexWeld::WeldVertices(), the model converter's vertex deduplication.
+// Without an epsilon it must keep exactly the vertices, in the same order and with the same remap, as the
+// pairwise comparison it replaced, for random meshes of several strides.  With one, it must match the same
+// comparison made on copies whose floats are rounded to multiples of the epsilon, with -0 and +0 the same,
+// and bytes outside the float ranges must never be rounded.
+//
+// Then it welds grid meshes of increasing size both ways, the old way only while it takes seconds rather
+// than minutes, and welds a model of many meshes the way OptimizeRemoveDuplicateVertices() does, through
+// ParallelFor() with several numbers of workers.  Returns nonzero on the first failed check.
+//
+// Build and run from this directory:
+//
+//     cl /O2 /EHsc /I..\..\Core /I..\..\ModelConverter VertexWeldBenchmark.cpp ..\..\ModelConverter\VertexWeld.cpp ..\..\Core\Hash.cpp ..\..\Core\JobSystem.cpp
+//     g++ -std=c++14 -O2 -pthread -I../../Core -I../../ModelConverter VertexWeldBenchmark.cpp ../../ModelConverter/VertexWeld.cpp ../../Core/Hash.cpp ../../Core/JobSystem.cpp -o VertexWeldBenchmark
+
+#include "VertexWeld.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace VertexWeld;
+
+namespace
+{
+    // Position, an RGBA8 color, normal and texture coordinate, as the converter lays them out
+    const uint32_t kStride = 36;
+    const FloatRange kFloatRanges[] = { { 0, 3 }, { 16, 3 }, { 28, 2 } };
+    const uint32_t kNumFloatRanges = 3;
+
+    bool Fail( const char* Message )
+    {
+        printf("%s\n", Message);
+        return false;
+    }
+
+    struct WeldResult
+    {
+        vector<uint8_t> Vertices;
+        vector<uint32_t> Remap;
+        uint32_t Count;
+
+        bool operator==( const WeldResult& Other ) const
+        {
+            return Count == Other.Count && Remap == Other.Remap &&
+                memcmp(Vertices.data(), Other.Vertices.data(), Vertices.size()) == 0;
+        }
+    };
+
+    // The pairwise comparison WeldVertices() replaced, with the keys to compare given separately so that
+    // it can stand in for welding with an epsilon too
+    WeldResult PairwiseWeld( const vector<uint8_t>& Vertices, const vector<uint8_t>& Keys, uint32_t Stride )
+    {
+        const uint32_t NumVertices = (uint32_t)(Vertices.size() / Stride);
+        WeldResult Result = { vector<uint8_t>(Vertices.size()), vector<uint32_t>(NumVertices, (uint32_t)-1), 0 };
+
+        for (uint32_t V1 = 0; V1 < NumVertices; ++V1)
+        {
+            if (Result.Remap[V1] != (uint32_t)-1)
+                continue;
+
+            const uint32_t Slot = Result.Count++;
+            Result.Remap[V1] = Slot;
+            memcpy(&Result.Vertices[Slot * Stride], &Vertices[V1 * Stride], Stride);
+
+            for (uint32_t V2 = V1 + 1; V2 < NumVertices; ++V2)
+            {
+                if (Result.Remap[V2] == (uint32_t)-1 && memcmp(&Keys[V1 * Stride], &Keys[V2 * Stride], Stride) == 0)
+                    Result.Remap[V2] = Slot;
+            }
+        }
+        return Result;
+    }
+
+    vector<uint8_t> RoundKeys( const vector<uint8_t>& Vertices, uint32_t Stride, const FloatRange* Ranges,
+        uint32_t NumRanges, float Epsilon )
+    {
+        vector<uint8_t> Keys = Vertices;
+        for (size_t Vertex = 0; Vertex < Keys.size(); Vertex += Stride)
+        {
+            for (uint32_t Range = 0; Range < NumRanges; ++Range)
+            {
+                for (uint32_t Component = 0; Component < Ranges[Range].count; ++Component)
+                {
+                    float Value;
+                    uint8_t* Address = &Keys[Vertex + Ranges[Range].offset + Component * sizeof(float)];
+                    memcpy(&Value, Address, sizeof(Value));
+                    Value = roundf(Value * (1.0f / Epsilon));
+                    if (Value == 0.0f)
+                        Value = 0.0f;
+                    memcpy(Address, &Value, sizeof(Value));
+                }
+            }
+        }
+        return Keys;
+    }
+
+    WeldResult Weld( const vector<uint8_t>& Vertices, uint32_t Stride, const FloatRange* Ranges, uint32_t NumRanges,
+        float Epsilon )
+    {
+        const uint32_t NumVertices = (uint32_t)(Vertices.size() / Stride);
+        WeldResult Result = { vector<uint8_t>(Vertices.size()), vector<uint32_t>(NumVertices), 0 };
+        Result.Count = WeldVertices(Vertices.data(), Result.Vertices.data(), NumVertices, Stride, Ranges, NumRanges,
+            Epsilon, Result.Remap.data());
+        return Result;
+    }
+
+    void SetFloat( vector<uint8_t>& Vertices, uint32_t Vertex, uint32_t Offset, float Value )
+    {
+        memcpy(&Vertices[Vertex * kStride + Offset], &Value, sizeof(Value));
+    }
+
+    bool CheckByHand( void )
+    {
+        // Positions either side of zero, and either side of half the epsilon
+        const float Epsilon = 0.01f;
+        const float kX[] = { 0.0f, -0.0f, 0.003f, -0.004f, 0.007f, 0.012f, 0.0f };
+        const uint32_t NumVertices = sizeof(kX) / sizeof(kX[0]);
+
+        vector<uint8_t> Vertices(NumVertices * kStride, 0);
+        for (uint32_t Vertex = 0; Vertex < NumVertices; ++Vertex)
+            SetFloat(Vertices, Vertex, 0, kX[Vertex]);
+
+        // The last vertex differs from the first only in its color
+        Vertices[6 * kStride + 12] = 255;
+
+        WeldResult Exact = Weld(Vertices, kStride, kFloatRanges, kNumFloatRanges, 0.0f);
+        const vector<uint32_t> kExactRemap = { 0, 1, 2, 3, 4, 5, 6 };
+        if (Exact.Count != 7 || Exact.Remap != kExactRemap)
+            return Fail("Without an epsilon, vertices that differ in any byte must be kept apart");
+
+        WeldResult Welded = Weld(Vertices, kStride, kFloatRanges, kNumFloatRanges, Epsilon);
+        const vector<uint32_t> kWeldedRemap = { 0, 0, 0, 0, 1, 1, 2 };
+        if (Welded.Count != 3 || Welded.Remap != kWeldedRemap)
+            return Fail("With an epsilon, floats must weld to the nearest multiple and the color must not");
+
+        // The first of each set is kept as it was, not rounded
+        if (memcmp(&Welded.Vertices[kStride], &Vertices[4 * kStride], kStride) != 0 ||
+            memcmp(&Welded.Vertices[2 * kStride], &Vertices[6 * kStride], kStride) != 0)
+            return Fail("A welded vertex was not copied from the first of its set");
+
+        // No float ranges leaves nothing to round
+        WeldResult NoRanges = Weld(Vertices, kStride, nullptr, 0, Epsilon);
+        if (NoRanges.Count != 7)
+            return Fail("Bytes outside the float ranges were rounded");
+
+        WeldResult Empty = Weld(vector<uint8_t>(), kStride, kFloatRanges, kNumFloatRanges, Epsilon);
+        if (Empty.Count != 0)
+            return Fail("An empty mesh produced vertices");
+
+        return true;
+    }
+
+    // Vertices drawn from a small pool, so that most have duplicates, some of them a sign or a rounding
+    // error away
+    vector<uint8_t> RandomVertices( uint32_t NumVertices, uint32_t Stride, uint32_t PoolSize, mt19937& Random )
+    {
+        vector<uint8_t> Pool(PoolSize * Stride);
+        for (uint32_t Word = 0; Word < Pool.size() / 4; ++Word)
+        {
+            float Value = (float)(int)(Random() % 9 - 4) * 0.25f;
+            if (Random() % 4 == 0)
+                Value = -Value;
+            else if (Random() % 4 == 0)
+                Value += ((float)(Random() % 1000) - 500.0f) * 1e-6f;
+            memcpy(&Pool[Word * 4], &Value, sizeof(Value));
+        }
+
+        vector<uint8_t> Vertices(NumVertices * Stride);
+        for (uint32_t Vertex = 0; Vertex < NumVertices; ++Vertex)
+            memcpy(&Vertices[Vertex * Stride], &Pool[(Random() % PoolSize) * Stride], Stride);
+        return Vertices;
+    }
+
+    bool CheckAgainstPairwise( uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        for (uint32_t Run = 0; Run < 200; ++Run)
+        {
+            const uint32_t Stride = 4 * (1 + Random() % 12);
+            const uint32_t NumVertices = Random() % 3000;
+            const uint32_t PoolSize = 1 + Random() % 400;
+            vector<uint8_t> Vertices = RandomVertices(NumVertices, Stride, PoolSize, Random);
+
+            // Every float but the last, so that one word is always compared exactly
+            const FloatRange Ranges[] = { { 0, Stride / 8 }, { (Stride / 8) * 4, Stride / 4 - Stride / 8 - 1 } };
+            const float Epsilon = Run % 2 ? 0.001f : 0.1f;
+
+            if (!(Weld(Vertices, Stride, Ranges, 2, 0.0f) == PairwiseWeld(Vertices, Vertices, Stride)))
+                return Fail("Without an epsilon, WeldVertices() differs from the pairwise comparison");
+
+            if (!(Weld(Vertices, Stride, Ranges, 2, Epsilon) ==
+                PairwiseWeld(Vertices, RoundKeys(Vertices, Stride, Ranges, 2, Epsilon), Stride)))
+                return Fail("With an epsilon, WeldVertices() differs from the pairwise comparison of rounded copies");
+        }
+        return true;
+    }
+
+    // A grid of Size by Size quads listed two triangles at a time, as Assimp hands the converter meshes
+    // when it hasn't joined their vertices.  Six vertices per quad, of which about four are unique.
+    vector<uint8_t> GridMesh( uint32_t Size, float Offset )
+    {
+        const uint32_t kCorners[6][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+
+        vector<uint8_t> Vertices(Size * Size * 6 * kStride, 0);
+        uint32_t Vertex = 0;
+        for (uint32_t Y = 0; Y < Size; ++Y)
+        {
+            for (uint32_t X = 0; X < Size; ++X)
+            {
+                for (const uint32_t* Corner : kCorners)
+                {
+                    const float U = (float)(X + Corner[0]) / Size, V = (float)(Y + Corner[1]) / Size;
+                    SetFloat(Vertices, Vertex, 0, U + Offset);
+                    SetFloat(Vertices, Vertex, 8, V);
+                    Vertices[Vertex * kStride + 15] = 255;
+                    SetFloat(Vertices, Vertex, 20, 1.0f);
+                    SetFloat(Vertices, Vertex, 28, U);
+                    SetFloat(Vertices, Vertex, 32, V);
+                    ++Vertex;
+                }
+            }
+        }
+        return Vertices;
+    }
+
+    template <typename Function>
+    double BestMs( uint32_t Runs, Function Body )
+    {
+        double Best = 1e30;
+        for (uint32_t Run = 0; Run < Runs; ++Run)
+        {
+            auto Start = chrono::high_resolution_clock::now();
+            Body();
+            Best = min(Best, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - Start).count());
+        }
+        return Best;
+    }
+
+    // Welds every mesh into the space it had, as OptimizeRemoveDuplicateVertices() does
+    uint32_t WeldModel( JobScheduler& Scheduler, const vector<vector<uint8_t>>& Meshes, vector<uint8_t>& Welded,
+        vector<uint32_t>& Counts )
+    {
+        const size_t MeshBytes = Meshes[0].size();
+        Scheduler.ParallelFor(0, (uint32_t)Meshes.size(), 1, [&]( uint32_t Begin, uint32_t End )
+        {
+            for (uint32_t Mesh = Begin; Mesh < End; ++Mesh)
+            {
+                const uint32_t NumVertices = (uint32_t)(MeshBytes / kStride);
+                vector<uint32_t> Remap(NumVertices);
+                Counts[Mesh] = WeldVertices(Meshes[Mesh].data(), &Welded[Mesh * MeshBytes], NumVertices, kStride,
+                    kFloatRanges, kNumFloatRanges, 0.0f, Remap.data());
+            }
+        });
+
+        uint32_t Total = 0;
+        for (uint32_t Count : Counts)
+            Total += Count;
+        return Total;
+    }
+}
+
+int main( void )
+{
+    if (!CheckByHand())
+        return 1;
+
+    for (uint32_t Seed = 1; Seed <= 5; ++Seed)
+    {
+        if (!CheckAgainstPairwise(Seed))
+        {
+            printf("Seed %u\n", Seed);
+            return 1;
+        }
+    }
+
+    printf("WeldVertices() matches the pairwise comparison exactly and on rounded copies.\n\n");
+
+    printf("%10s %10s %14s %14s %14s\n", "Vertices", "Unique", "Pairwise", "Hashed", "Hashed, 1e-4");
+
+    for (uint32_t Size : { 16, 32, 64, 100, 256, 1024 })
+    {
+        const vector<uint8_t> Vertices = GridMesh(Size, 0.0f);
+        const uint32_t NumVertices = (uint32_t)(Vertices.size() / kStride);
+
+        WeldResult Hashed;
+        const double HashedMs = BestMs(3, [&]{ Hashed = Weld(Vertices, kStride, kFloatRanges, kNumFloatRanges, 0); });
+        const double EpsilonMs = BestMs(3, [&]{ Weld(Vertices, kStride, kFloatRanges, kNumFloatRanges, 1e-4f); });
+
+        if (Hashed.Count != (Size + 1) * (Size + 1))
+        {
+            printf("A grid didn't weld to one vertex per corner\n");
+            return 1;
+        }
+
+        char Pairwise[32] = "-";
+        if (NumVertices <= 60000)
+        {
+            WeldResult Reference;
+            const double PairwiseMs = BestMs(1, [&]{ Reference = PairwiseWeld(Vertices, Vertices, kStride); });
+            if (!(Reference == Hashed))
+            {
+                printf("A grid welded differently from the pairwise comparison\n");
+                return 1;
+            }
+            snprintf(Pairwise, sizeof(Pairwise), "%.2f ms", PairwiseMs);
+        }
+
+        printf("%10u %10u %14s %11.2f ms %11.2f ms\n", NumVertices, Hashed.Count, Pairwise, HashedMs, EpsilonMs);
+    }
+
+    // A model of 256 meshes of 24576 vertices each, 6.3M in all
+    vector<vector<uint8_t>> Meshes;
+    for (uint32_t Mesh = 0; Mesh < 256; ++Mesh)
+        Meshes.push_back(GridMesh(64, (float)Mesh));
+
+    vector<uint8_t> Welded(Meshes.size() * Meshes[0].size());
+    vector<uint32_t> Counts(Meshes.size());
+
+    printf("\n%u meshes of %u vertices:\n", (uint32_t)Meshes.size(), (uint32_t)(Meshes[0].size() / kStride));
+
+    for (uint32_t NumWorkers : { 0u, 1u, 3u, max(7u, thread::hardware_concurrency() - 1) })
+    {
+        JobScheduler Scheduler;
+        Scheduler.Start(NumWorkers);
+        const double ModelMs = BestMs(3, [&]{ WeldModel(Scheduler, Meshes, Welded, Counts); });
+        const uint32_t Total = WeldModel(Scheduler, Meshes, Welded, Counts);
+        Scheduler.Stop();
+
+        if (Total != Meshes.size() * 65 * 65)
+        {
+            printf("A mesh of the model didn't weld to one vertex per corner\n");
+            return 1;
+        }
+
+        printf("%10u workers %11.2f ms\n", NumWorkers, ModelMs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Compares ZipStream::Inflate() with the Inflate() that FileUtility.cpp used before it.  The
+// old one inflated into a fresh 1 MB block per inflate() call and then copied every block into the result.
+// The new one sizes its output from the gzip trailer and inflates straight into it.  Both must produce the
+// original bytes for gzip and zlib streams of several sizes and compression ratios, and the new one must
+// also deliver them in order through its callback.
+//
+// For each stream it prints the throughput of both, in output MB/s, and the memory each holds besides the
+// input:  the old blocks plus the result, and ZipStream's one buffer.  A zlib stream records no size, so
+// that buffer starts at a guess and doubles, briefly holding both copies.  Everything is in memory, so
+// this measures inflating rather than reading; FileBenchmark.cpp covers the reads.  Returns nonzero on
+// the first mismatch.  Build and run from this directory with zlib:
+//
+//     cl /O2 /EHsc /I..\..\Core /I<zlib include> ZipStreamBenchmark.cpp ..\..\Core\ZipStream.cpp <zlib lib>
+//     g++ -std=c++14 -O2 -I../../Core ZipStreamBenchmark.cpp ../../Core/ZipStream.cpp -lz -o ZipStreamBenchmark
+
+#include "ZipStream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <zlib.h>
+
+using namespace std;
+
+namespace
+{
+    struct FreeDeleter
+    {
+        void operator()( uint8_t* Block ) const { free(Block); }
+    };
+
+    // The old FileUtility.cpp Inflate(), except that its blocks are released with free() rather than
+    // delete.  Note that it never returns on a truncated stream, because inflate() keeps answering
+    // Z_BUF_ERROR, so it is only given whole ones here.
+    bool InflateOld( const uint8_t* Source, size_t SourceSize, vector<uint8_t>& Dest, int& Error, size_t& PeakBytes,
+        uint32_t ChunkSize = 0x100000 )
+    {
+        vector<unique_ptr<uint8_t, FreeDeleter>> Blocks;
+
+        z_stream Stream = {};
+        Stream.data_type = Z_BINARY;
+        Stream.total_in = Stream.avail_in = (uInt)SourceSize;
+        Stream.next_in = (Bytef*)Source;
+
+        Error = inflateInit2(&Stream, 15 + 32);
+
+        while (Error == Z_OK || Error == Z_BUF_ERROR)
+        {
+            Stream.avail_out = ChunkSize;
+            Stream.next_out = (uint8_t*)malloc(ChunkSize);
+            Blocks.emplace_back(Stream.next_out);
+            Error = inflate(&Stream, Z_NO_FLUSH);
+        }
+
+        if (Error != Z_STREAM_END)
+        {
+            inflateEnd(&Stream);
+            return false;
+        }
+
+        Dest.resize(Stream.total_out);
+        PeakBytes = Blocks.size() * ChunkSize + Dest.size();
+
+        uint8_t* Next = Dest.data();
+        size_t Remaining = Dest.size();
+        for (size_t i = 0; i < Blocks.size(); ++i)
+        {
+            size_t CopySize = min(Remaining, (size_t)ChunkSize);
+            memcpy(Next, Blocks[i].get(), CopySize);
+            Next += CopySize;
+            Remaining -= CopySize;
+        }
+
+        inflateEnd(&Stream);
+        return true;
+    }
+
+    // Runs of repeated words with noise between them.  Longer runs compress better.
+    vector<uint8_t> MakeContents( size_t Size, uint32_t MaxRun, uint32_t Seed )
+    {
+        mt19937 Random(Seed);
+        vector<uint8_t> Contents(Size);
+        for (size_t i = 0; i < Contents.size(); )
+        {
+            const uint32_t Word = Random();
+            const size_t RunLength = min((size_t)(Random() % MaxRun), Contents.size() - i);
+            for (size_t j = 0; j < RunLength; ++j)
+                Contents[i + j] = (uint8_t)(Word >> (8 * (j & 3)));
+            i += RunLength;
+            if (i < Contents.size())
+                Contents[i++] = (uint8_t)Random();
+        }
+        return Contents;
+    }
+
+    // WindowBits of 15 writes a zlib stream, and 15 + 16 a gzip stream
+    vector<uint8_t> Deflate( const vector<uint8_t>& Source, int WindowBits )
+    {
+        z_stream Stream = {};
+        deflateInit2(&Stream, 6, Z_DEFLATED, WindowBits, 8, Z_DEFAULT_STRATEGY);
+
+        vector<uint8_t> Packed(deflateBound(&Stream, (uLong)Source.size()));
+        Stream.next_in = (Bytef*)Source.data();
+        Stream.avail_in = (uInt)Source.size();
+        Stream.next_out = Packed.data();
+        Stream.avail_out = (uInt)Packed.size();
+        deflate(&Stream, Z_FINISH);
+        Packed.resize(Stream.total_out);
+        deflateEnd(&Stream);
+        return Packed;
+    }
+
+    double Seconds( chrono::steady_clock::time_point Start )
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    }
+
+    bool CompareStream( const char* Format, const vector<uint8_t>& Contents, const vector<uint8_t>& Packed )
+    {
+        // Enough repeats for about 64 MB of output, and at least three
+        const uint32_t NumRuns = max(3u, (uint32_t)((64u << 20) / Contents.size()));
+        const double TotalMB = (double)NumRuns * Contents.size() / 1e6;
+
+        double OldTime = 0.0, NewTime = 0.0, ChunkedTime = 0.0;
+        size_t OldPeak = 0, NewPeak = 0;
+
+        for (uint32_t Run = 0; Run < NumRuns; ++Run)
+        {
+            vector<uint8_t> Old, New, Chunked;
+            int Error;
+
+            auto Start = chrono::steady_clock::now();
+            bool Success = InflateOld(Packed.data(), Packed.size(), Old, Error, OldPeak);
+            OldTime += Seconds(Start);
+            if (!Success || Old != Contents)
+            {
+                printf("%s, %zu bytes:  the old Inflate() differs from the original\n", Format, Contents.size());
+                return false;
+            }
+
+            Start = chrono::steady_clock::now();
+            Success = ZipStream::Inflate(Packed.data(), Packed.size(), New, Error);
+            NewTime += Seconds(Start);
+            NewPeak = New.capacity();
+            if (!Success || New != Contents)
+            {
+                printf("%s, %zu bytes:  ZipStream::Inflate() differs from the original\n", Format, Contents.size());
+                return false;
+            }
+
+            size_t Received = 0;
+            bool InOrder = true;
+            auto OnChunk = [&]( const uint8_t* Data, size_t Size )
+            {
+                InOrder = InOrder && Received + Size <= Contents.size() && memcmp(Data, Contents.data() + Received, Size) == 0;
+                Received += Size;
+            };
+
+            Start = chrono::steady_clock::now();
+            Success = ZipStream::Inflate(Packed.data(), Packed.size(), Chunked, Error, OnChunk);
+            ChunkedTime += Seconds(Start);
+            if (!Success || !InOrder || Received != Contents.size() || Chunked != Contents)
+            {
+                printf("%s, %zu bytes:  ZipStream::Inflate() with a callback differs from the original\n", Format, Contents.size());
+                return false;
+            }
+        }
+
+        printf("%5s %9.1f MB %6.1f:1 %9.0f MB/s %9.0f MB/s %9.0f MB/s %10.1f MB %9.1f MB\n", Format, Contents.size() / 1e6,
+            (double)Contents.size() / Packed.size(), TotalMB / OldTime, TotalMB / NewTime, TotalMB / ChunkedTime,
+            OldPeak / 1e6, NewPeak / 1e6);
+        return true;
+    }
+}
+
+int main( void )
+{
+    static const size_t kSizes[] = { 64 << 10, 1 << 20, 16 << 20, 64 << 20 };
+    static const uint32_t kMaxRuns[] = { 16, 256 };
+
+    printf("%5s %12s %8s %14s %14s %14s %13s %12s\n", "", "Size", "Ratio", "Old", "ZipStream", "Callback", "Old peak", "New peak");
+
+    for (uint32_t MaxRun : kMaxRuns)
+    {
+        for (size_t Size : kSizes)
+        {
+            const vector<uint8_t> Contents = MakeContents(Size, MaxRun, (uint32_t)Size + MaxRun);
+            if (!CompareStream("Gzip", Contents, Deflate(Contents, 15 + 16)) ||
+                !CompareStream("Zlib", Contents, Deflate(Contents, 15)))
+            {
+                return 1;
+            }
+        }
+    }
+
+    printf("\nBoth produce the original bytes for every stream.  The peaks leave out the compressed input.\n");
+    return 0;
+}
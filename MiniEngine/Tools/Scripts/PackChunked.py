@@ -0,0 +1,55 @@
+# Compresses files into the chunked format that Utility::ReadFileSync() looks for as "<file>.cz".  Each block
+# is compressed on its own so that the engine can inflate them all in parallel.  See Core/ChunkedFile.h.
+#
+# Usage:  python PackChunked.py [-b block_size_kb] [-l level] [-j jobs] files...
+
+import struct
+import zlib
+
+MAGIC = 0x5A43454D	# "MECZ"
+VERSION = 1
+HEADER = struct.Struct('<IIIIQQ')
+BLOCK_ENTRY = struct.Struct('<QII')
+
+def CompressBlock( args ):
+	block, level = args
+	packed = zlib.compress(block, level)
+	# A block that doesn't shrink is stored as it is
+	return packed if len(packed) < len(block) else block
+
+def PackFile( fileName, blockSize=1 << 20, level=6, pool=None ):
+	with open(fileName, 'rb') as infile:
+		contents = infile.read()
+
+	blocks = [contents[i:i + blockSize] for i in range(0, len(contents), blockSize)]
+	work = [(block, level) for block in blocks]
+	packedBlocks = pool.map(CompressBlock, work) if pool else list(map(CompressBlock, work))
+
+	offset = HEADER.size + BLOCK_ENTRY.size * len(blocks)
+	index = bytearray()
+	for block, packed in zip(blocks, packedBlocks):
+		index += BLOCK_ENTRY.pack(offset, len(packed), len(block))
+		offset += len(packed)
+
+	with open(fileName + '.cz', 'wb') as outfile:
+		outfile.write(HEADER.pack(MAGIC, VERSION, blockSize, len(blocks), len(contents), 0))
+		outfile.write(index)
+		for packed in packedBlocks:
+			outfile.write(packed)
+
+	print('{0}:  {1} bytes -> {2} bytes in {3} blocks'.format(fileName, len(contents), offset, len(blocks)))
+
+if __name__ == "__main__":
+	import argparse
+	import multiprocessing
+
+	parser = argparse.ArgumentParser(description='Pack files into independently compressed blocks')
+	parser.add_argument('-b', '--block-size', type=int, default=1024, help='Uncompressed block size in KB')
+	parser.add_argument('-l', '--level', type=int, default=6, help='zlib compression level')
+	parser.add_argument('-j', '--jobs', type=int, default=multiprocessing.cpu_count(), help='Compression processes')
+	parser.add_argument('files', nargs='+')
+	args = parser.parse_args()
+
+	with multiprocessing.Pool(args.jobs) as pool:
+		for file in args.files:
+			PackFile(file, args.block_size * 1024, args.level, pool)